@@ -0,0 +1,75 @@
+#ifndef ALLOC_STATS__H__
+#define ALLOC_STATS__H__
+#include <utils.h>
+#include <Histogram.h>
+
+//=====================================================================================================================
+// Always-on counters of a frame buffer allocator (CMemAlloc).
+struct SAllocStatsSnapshot
+{
+    static const int g_max_sizes = 16;  // distinct requested sizes counted, the others go to 'other_sizes'
+
+    uint64_t  allocations;
+    uint64_t  pool_hits;  // an idle buffer was reused
+    uint64_t  fresh;  // a new buffer (MemAlloc)
+    uint64_t  failures;
+    uint64_t  releases;
+    uint64_t  bytes_allocated;  // of all allocations, for the frame bandwidth
+    uint64_t  first_ns, last_ns;  // MonotonicTimeNs() of the first and the latest allocation, 0 - none yet
+    int64_t  bytes_outstanding;
+    int64_t  peak_bytes_outstanding;
+    unsigned  size_count;
+    BM_UINT32  sizes[g_max_sizes];  // in the order they were first requested
+    uint64_t  size_counts[g_max_sizes];
+    uint64_t  other_sizes;
+    CHistogram  allocate_ns;
+    CHistogram  release_ns;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+class CAllocStats
+{
+    static const size_t g_cache_line = 64;
+
+    struct SCounter
+    {
+        volatile int64_t  value;
+        char  pad[ g_cache_line - sizeof(int64_t) ];
+    };
+
+    // Written by AllocateBuffer; the release side is a cache line away, outstanding bytes are the difference.
+    SCounter  allocations;
+    SCounter  pool_hits;
+    SCounter  failures;
+    SCounter  bytes_allocated;
+    SCounter  first_ns;
+    SCounter  last_ns;
+    SCounter  peak_bytes_outstanding;
+
+    volatile int32_t  sizes[SAllocStatsSnapshot::g_max_sizes];  // 0 - free slot
+    volatile int32_t  size_counts[SAllocStatsSnapshot::g_max_sizes];
+    volatile int32_t  other_sizes;
+    CHistogram  allocate_ns;
+    char  pad[g_cache_line];
+
+    // Written by ReleaseBuffer.
+    SCounter  releases;
+    SCounter  bytes_released;
+    CHistogram  release_ns;
+
+public:
+    CAllocStats();
+
+    // 'now_ns' - MonotonicTimeNs() at the end of the allocation, 'ns' - its duration.
+    void Allocated( BM_UINT32 size, bool fresh, uint64_t ns, uint64_t now_ns );
+    void Failed()  { Int64AtomicAdd( &failures.value, 1 ); }
+    void Released( BM_UINT32 size, uint64_t ns );
+
+    // Consistent per counter, not across them.
+    void Snapshot( SAllocStatsSnapshot* s ) const;
+};
+
+// Table of a snapshot, every line starts with "[index] ".
+void PrintAllocStats( int index, const SAllocStatsSnapshot& s, size_t idle_buffers );
+
+#endif // !defined(ALLOC_STATS__H__)
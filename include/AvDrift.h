@@ -0,0 +1,34 @@
+#ifndef AV_DRIFT__H__
+#define AV_DRIFT__H__
+#include <stdint.h>
+
+//=====================================================================================================================
+// Audio packet end offsets from their video frame ends, with a least-squares fit whose slope is the clock drift.
+// Called from the callback thread only.
+class CAvDrift
+{
+    uint64_t  count;
+    double  x0;  // video time of the first sample, the fit runs on x - x0 to keep the sums well-conditioned
+    double  offset0;
+    double  last_x;
+    double  sx, sy, sxx, sxy;
+    double  max_abs_offset;
+
+public:
+    CAvDrift()  { Reset(); }
+    void Reset();
+
+    // Both in seconds.
+    void Add( double video_sec, double offset_sec );
+
+    uint64_t Count() const  { return count; }
+    double SpanSec() const  { return last_x; }
+
+    // Drift in parts per million, positive if audio runs fast, 0 before two samples.
+    double DriftPpm() const;
+
+    double FirstOffsetSec() const  { return offset0; }
+    double MaxAbsOffsetSec() const  { return max_abs_offset; }
+};
+
+#endif // !defined(AV_DRIFT__H__)
@@ -0,0 +1,46 @@
+#ifndef BENCH__H__
+#define BENCH__H__
+
+//=====================================================================================================================
+// Microbenchmarks selectable from the command line. Each one prints its report to stdout and returns the process
+// exit code.
+
+// Frame buffer pool: std::multimap free list vs size-class pool, 16 devices x 60 fps of 1080p UYVY.
+int BenchBufferPool();
+
+// AllocateBuffer latency percentiles under concurrent release/allocate/reset, mutex vs lock-free pool.
+int BenchBufferPoolContention();
+
+// ProtectIdle/FreeIdle wall time of a deep buffer queue versus the number of verification workers.
+int BenchBufferPoolReset();
+
+// Guard pattern fill/verify throughput of every vector kernel on a 4K v210 frame, checks they match the scalar one.
+int BenchMemPattern();
+
+// LogEvent latency of several callback threads with the records printed synchronously and through the log ring.
+int BenchLog();
+
+// UYVY to I420/NV12/yuv422p frames/s of every conversion kernel at SD, 1080 and 2160, single core and sliced on the
+// worker pool, checks them against a per-pixel reference conversion.
+int BenchPixelConvert();
+
+// v210 to 16-bit planar unpack and pack frames/s of every kernel, single core and sliced, checks both round trips are
+// bit-exact.
+int BenchV210();
+
+// Frame analyzer luma statistics and block signatures, ms per 1080p and 2160 UYVY and v210 frame of every kernel on
+// every row and on the sampled rows, checks the sums against a per-pixel reference.
+int BenchFrameAnalyzer();
+
+#if defined(__linux__)
+// Page faults, dTLB misses and throughput of 4K UHD frame buffers for every MemArena mode.
+int BenchMemArena();
+
+// Zero-copy recorder write paths (io_uring vs writer threads), 16 streams of 1080p frames to the -record directory.
+int BenchRecorder();
+
+// Shared-memory frame export: Publish() to reader process latency percentiles for several reader poll periods.
+int BenchFrameExport();
+#endif
+
+#endif // !defined(BENCH__H__)
@@ -0,0 +1,121 @@
+#ifndef BUFFER_POOL__H__
+#define BUFFER_POOL__H__
+#include <utils.h>
+#include <vector>
+
+class CWorkerPool;
+
+//=====================================================================================================================
+// Lock-free pool of frame buffers, one free list (Treiber stack) per distinct size. Idle buffers are protected and
+// verified as jobs on a CWorkerPool; only one thread at a time may call ProtectIdle()/FreeIdle()/VerifySome().
+class CBufferPool
+{
+    struct SDesc
+    {
+        char* volatile  ptr;
+        BM_UINT32  size;
+        int32_t  size_class;
+        volatile int32_t  next;  // next descriptor in a free list or in the spare list
+        volatile int32_t  state;
+        volatile BM_UINT32  verified;  // protected buffer bytes already checked by VerifySome()
+        uint64_t  protect_ns;  // MonotonicTimeNs() of MemProtect
+        bool  readable;  // MemVerifyRange() can check it while protected, not so under page protection
+    };
+
+    struct SSizeClass
+    {
+        volatile int64_t  free_head;  // tagged head: generation in the high 32 bits, descriptor index in the low ones
+        volatile int32_t  size;  // 0 - class slot is not used
+        volatile int32_t  live;  // buffers of the class plus Allocate() calls working with it, -1 - being released
+    };
+
+    SDesc*  descs;
+    volatile int32_t  descs_count;
+    volatile int64_t  spare_head;  // descriptors of freed buffers, ready for reuse
+    volatile int64_t  guarded_head;  // protected buffers
+
+    SSizeClass*  classes;
+    volatile int32_t  last_class;
+
+    volatile int32_t*  slots;  // pointer -> descriptor index
+    size_t  slots_mask;
+
+    volatile int32_t  outstanding;
+    volatile int32_t  idle;
+    volatile int32_t  corrupted;  // a protected buffer failed verification before it was returned to a free list
+
+    struct SIdleJob
+    {
+        int32_t  desc;
+        bool  ok;
+        char  report[256];
+    };
+
+    CWorkerPool*  workers;
+    std::vector<SIdleJob>  idle_jobs;
+    int  jobs_index;
+
+    int32_t  verify_next;  // VerifySome() goes round the descriptor table
+    uint64_t  quiet_ns;  // time after MemProtect before a protected buffer is checked by VerifySome()/ProtectIdle()
+
+    void DetachIdle();
+    void Reattach( int32_t j );
+    static void ProtectJob( void* ctx, size_t j );
+    static void FreeJob( void* ctx, size_t j );
+
+    CBufferPool( const CBufferPool& );
+    CBufferPool& operator=( const CBufferPool& );
+
+    size_t Slot( const char* ptr ) const;
+    int32_t FindClass( BM_UINT32 size );
+    bool PinClass( int32_t k, BM_UINT32 size );
+    void ReleaseClasses();
+    int32_t NewDesc();
+    void IndexDesc( int32_t j );
+    void UnindexDesc( int32_t j );
+    int32_t LookupDesc( const void* ptr ) const;
+    int32_t ClaimDesc( int32_t j, int32_t state );
+
+    int32_t Pop( volatile int64_t* head );
+    void Push( volatile int64_t* head, int32_t first, int32_t last );
+    int32_t Detach( volatile int64_t* head );
+
+public:
+    CBufferPool();
+    ~CBufferPool();
+
+    // Throws std::bad_alloc for size 0, when out of memory or size classes. '*fresh' - the buffer is new (MemAlloc).
+    char* Allocate( int index, BM_UINT32 size, bool* fresh = NULL );
+
+    // Returns false if the buffer does not belong to the pool, '*size' is set to the buffer size otherwise.
+    bool Release( void* ptr, BM_UINT32* size = NULL );
+
+    // Guards the idle buffers; those guarded by the previous call (and quiet since) are verified and reused.
+    void ProtectIdle( int index );
+
+    // Verifies and frees all idle buffers, returns false if any of them has been corrupted.
+    bool FreeIdle( int index );
+
+    // A protected buffer has failed verification since the last FreeIdle().
+    bool Corrupted() const  { return corrupted != 0; }
+
+    // Checks up to 'max_bytes' of buffers protected for the quiet time (SetQuietTime), returns the bytes checked.
+    size_t VerifySome( int index, size_t max_bytes );
+
+    // Makes 'count' buffers of 'size' idle and resident, returns how many (fewer if memory ran out).
+    size_t Reserve( int index, BM_UINT32 size, size_t count );
+
+    // Frees unprotected idle buffers above 'keep', returns their number. Not concurrently with FreeIdle().
+    size_t TrimIdle( size_t keep );
+
+    // NULL - CWorkerPool::Shared().
+    void SetWorkers( CWorkerPool* pool )  { workers = pool; }
+
+    // Default 1 sec, a device may still be writing a buffer for a while after its release.
+    void SetQuietTime( uint64_t ns )  { quiet_ns = ns; }
+
+    size_t OutstandingCount() const  { return (size_t)outstanding; }
+    size_t IdleCount() const  { return (size_t)idle; }
+};
+
+#endif // !defined(BUFFER_POOL__H__)
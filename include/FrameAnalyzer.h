@@ -0,0 +1,110 @@
+#ifndef FRAME_ANALYZER__H__
+#define FRAME_ANALYZER__H__
+#include <utils.h>
+#include <FramePipeline.h>
+#include <Histogram.h>
+#include <vector>
+
+//=====================================================================================================================
+// Luma statistics of every 'row_step'-th row of a UYVY or v210 frame on the 8-bit scale, and block luma sums (the
+// signature two frames are compared by).
+static const unsigned g_analyze_block_width = 64;
+static const unsigned g_analyze_block_rows = 16;
+
+struct SFrameLuma
+{
+    uint64_t  count;  // samples
+    uint64_t  sum, sum_sq;
+
+    double Mean() const;
+    double Variance() const;
+};
+
+size_t FrameAnalyzeBlockCount( unsigned width, unsigned height, unsigned row_step );
+
+// Bytes of the scratch row FrameAnalyze needs for v210 frames of 'width' pixels.
+size_t FrameAnalyzeScratchSize( unsigned width );
+
+// Fills 'blocks' (FrameAnalyzeBlockCount) and 'luma'. Returns false for other pixel formats.
+bool FrameAnalyze( BMDPixelFormat format, const void* src, size_t row_bytes, unsigned width, unsigned height,
+                                        unsigned row_step, void* scratch, uint32_t* blocks, SFrameLuma* luma );
+
+// The largest mean absolute luma difference of a block between two frames of the same size.
+double FrameBlockDiff( const uint32_t* a, const uint32_t* b, unsigned width, unsigned height, unsigned row_step );
+
+// "scalar", "sse2" or "avx2", the widest the CPU supports by default; every kernel gives the same sums.
+const char* FrameAnalyzeKernelName();
+bool FrameAnalyzeSetKernel( const char* name );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Thresholds of CFrameAnalyzer, luma on the 8-bit scale.
+struct SAnalyzeParams
+{
+    unsigned  row_step;  // odd, so both fields of an interlaced frame are sampled
+    double  flat_variance;  // a frame of no more luma variance is flat
+    double  black_luma;  // a flat frame of no higher mean luma is black
+    double  freeze_diff;  // a frame no block of which differs from the previous frame by more is frozen
+    unsigned  hold_frames;  // consecutive frames that start or stop a condition
+
+    SAnalyzeParams() : row_step(3), flat_variance(4.0), black_luma(32.0), freeze_diff(0.5), hold_frames(3)  {}
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Pipeline stage reporting black, flat and frozen (never flat) frames of a device with their stream time; frames
+// without an input source are skipped.
+class CFrameAnalyzer
+{
+public:
+    enum ECondition
+    {
+        Black,
+        Flat,
+        Freeze,
+        ConditionCount
+    };
+
+private:
+    struct SCondition
+    {
+        bool  active;
+        unsigned  run;  // consecutive frames disagreeing with 'active'
+        int64_t  run_time;  // stream time of the first of them
+        int64_t  since;  // stream time 'active' took effect
+        uint32_t  events;  // starts
+        int64_t  total;  // 1/240000 s in finished conditions
+    };
+
+    int  index;
+    SAnalyzeParams  params;
+    SCondition  conditions[ConditionCount];
+
+    // Signatures of the current and the previous frame, resized on a format change only.
+    std::vector<uint32_t>  blocks[2];
+    std::vector<uint8_t>  scratch;
+    int  current;
+    bool  have_previous;
+    unsigned  width, height;
+    int64_t  last_end;  // stream time the last frame ends
+
+    // Statistics of all runs, written by the consumer thread only.
+    CHistogram  analyze_ns;
+    uint64_t  frames, no_signal, skipped;
+
+    CFrameAnalyzer( const CFrameAnalyzer& );
+    CFrameAnalyzer& operator=( const CFrameAnalyzer& );
+
+    void Update( ECondition c, bool state, int64_t time, const SFrameLuma& luma, double diff );
+    void Stop( ECondition c, int64_t time );
+
+public:
+    CFrameAnalyzer();
+
+    void Init( int device_index, const SAnalyzeParams& analyze_params );
+
+    // FFrameStage, 'ctx' is the CFrameAnalyzer.
+    static void Stage( void* ctx, const SCapturedFrame& frame );
+
+    void PrintStats();
+};
+
+#endif // !defined(FRAME_ANALYZER__H__)
@@ -0,0 +1,63 @@
+#ifndef FRAME_EXPORT__H__
+#define FRAME_EXPORT__H__
+#include <utils.h>
+#include <FrameShm.h>
+
+//=====================================================================================================================
+// Shared-memory frame export of one device (Linux): the SExportHeader ring in "/cct-export-dev<N>" (FrameShm.h), a
+// release thread that polls the reader acknowledgements. The frame buffers stay in the shared arena of the device.
+class CFrameExporter
+{
+public:
+    static const unsigned  g_poll_period_ms = 1;
+    static const unsigned  g_drain_timeout_ms = 200;  // Drain() waits this long for the readers
+    static const unsigned  g_reader_check_period_ms = 100;  // readers whose process has gone are dropped
+
+private:
+    int  index;
+    char  name[32];
+    SExportHeader*  header;
+    IUnknown*  held[g_export_capacity];  // by the frame slot, written by Publish() only
+    uint64_t  write_seq;  // producer copy of header->write_seq
+
+    volatile int32_t  stopping;
+    bool  started;
+    CWaitableCondition  stopped;
+    CMutex  release_lock;  // the release thread and Drain()
+
+    // Statistics of all runs, 'published', 'overflows' and 'unshared' are written by the producer only.
+    uint64_t  published, overflows, unshared;
+    volatile int32_t  revoked;  // released by Drain() without an acknowledgement
+    volatile int32_t  readers_dropped;
+
+    CFrameExporter( const CFrameExporter& );
+    CFrameExporter& operator=( const CFrameExporter& );
+
+    // Releases the frames before 'seq'.
+    void ReleaseTo( uint64_t seq );
+    uint64_t AckedSeq( bool check_readers );
+    static void ThreadFunc( void* ctx );
+
+public:
+    CFrameExporter();
+    ~CFrameExporter();
+
+    // Creates the shared memory object and starts the release thread; needs MemArenaSetShared(true).
+    bool Open( int device_index, const SThreadPlacement& placement );
+    const char* Name() const  { return name; }
+
+    // Driver callback thread, no locks or system calls. 'hold' is released once every reader has acknowledged it.
+    bool Publish( const void* bytes, const SExportFrame& frame, IUnknown* hold );
+    bool Publish( IDeckLinkVideoInputFrame* video, uint64_t arrived_ns );
+
+    // Before the allocator is reset: waits up to g_drain_timeout_ms for the readers, then revokes the rest.
+    void Drain();
+
+    // Drains, stops the release thread, marks the export closed for the readers and removes the name.
+    void Close();
+
+    int ReaderCount() const;
+    void PrintStats();
+};
+
+#endif // !defined(FRAME_EXPORT__H__)
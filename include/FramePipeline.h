@@ -0,0 +1,88 @@
+#ifndef FRAME_PIPELINE__H__
+#define FRAME_PIPELINE__H__
+#include <utils.h>
+
+//=====================================================================================================================
+// A frame handed from the driver callback to the consumer thread of the device.
+struct SCapturedFrame
+{
+    int  index;  // device index
+    IDeckLinkVideoInputFrame*  video;
+    IDeckLinkAudioInputPacket*  audio;  // NULL if the audio input is off
+    uint64_t  arrived_ns;  // MonotonicTimeNs() at VideoInputFrameArrived
+};
+
+// Processing stage, called on the consumer thread for every frame in arrival order.
+typedef void (*FFrameStage)( void* ctx, const SCapturedFrame& frame );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Capture pipeline of one device: a single-producer single-consumer ring from the callback to a consumer thread that
+// runs the stages. A frame beyond the depth limit is dropped (an overflow); the consumer polls, Push() never wakes it.
+class CFramePipeline
+{
+public:
+    static const int32_t  g_capacity = 64;  // must be a power of 2
+    static const int  g_max_stages = 8;
+    static const unsigned  g_poll_period_ms = 1;
+
+private:
+    struct SStage
+    {
+        FFrameStage  func;
+        void*  ctx;
+    };
+
+    SCapturedFrame  ring[g_capacity];
+    volatile int32_t  head;  // next frame to pop, advanced by the consumer once the frame is released
+    volatile int32_t  tail;  // next free slot, advanced by the producer
+    int32_t  depth_limit;
+
+    SStage  stages[g_max_stages];
+    int  stage_count;
+
+    volatile int32_t  stopping;
+    bool  started;
+    CWaitableCondition  stopped;
+
+    // Statistics since ResetCounters(), 'high_water' and 'overflow_count' are written by the producer only.
+    int32_t  high_water;
+    volatile int32_t  overflow_count;
+    volatile int32_t  processed_count;
+
+    CFramePipeline( const CFramePipeline& );
+    CFramePipeline& operator=( const CFramePipeline& );
+
+    void Consume();
+    static void ThreadFunc( void* ctx );
+
+public:
+    CFramePipeline();
+    ~CFramePipeline();
+
+    // Stages are added before Start().
+    bool AddStage( FFrameStage func, void* ctx );
+
+    // Starts the consumer thread, at most 'depth' (1..g_capacity) frames are queued or being processed.
+    void Start( unsigned depth, const SThreadPlacement& placement = SThreadPlacement() );
+    bool IsStarted() const  { return started; }
+
+    // Driver callback thread. Returns false if the frame has not been queued.
+    bool Push( int index, IDeckLinkVideoInputFrame* video, IDeckLinkAudioInputPacket* audio, uint64_t arrived_ns );
+
+    // Waits until every queued frame is processed and released (after StopStreams).
+    void Drain();
+
+    // Processes the queued frames and stops the consumer thread, returns when it has finished.
+    void Stop();
+
+    int32_t Depth() const  { return tail - head; }
+    int32_t DepthLimit() const  { return depth_limit; }
+    int32_t HighWater() const  { return high_water; }
+    uint32_t OverflowCount() const  { return (uint32_t)overflow_count; }
+    uint32_t ProcessedCount() const  { return (uint32_t)processed_count; }
+
+    // Called while the callbacks are stopped.
+    void ResetCounters()  { high_water = 0; overflow_count = 0; processed_count = 0; }
+};
+
+#endif // !defined(FRAME_PIPELINE__H__)
@@ -0,0 +1,48 @@
+#ifndef FRAME_READER__H__
+#define FRAME_READER__H__
+#include <FrameShm.h>
+#include <stddef.h>
+
+//=====================================================================================================================
+// Reader of the shared-memory frame export of one device, maps the frame buffers read-only. The arena is opened
+// through /proc/<exporter pid>/fd, so the reader needs ptrace read access to the exporter: the same user as a
+// dumpable exporter, or CAP_SYS_PTRACE.
+class CFrameReader
+{
+    SExportHeader*  header;
+    const char*  arena;
+    uint64_t  arena_size;
+    int  slot;  // in header->readers
+    uint64_t  next_seq;
+    unsigned  poll_us;
+    SExportFrame  frame;  // copy of the ring slot handed out by Next()
+
+    CFrameReader( const CFrameReader& );
+    CFrameReader& operator=( const CFrameReader& );
+
+public:
+    CFrameReader();
+    ~CFrameReader()  { Close(); }
+
+    // 'name' - the shared memory object ("/cct-export-dev<N>"). Returns false (reported to stderr) if it does not
+    // exist, the exporter has gone or every reader slot is taken.
+    bool Open( const char* name );
+    void Close();
+
+    // Next() checks for a new frame every 'us' microseconds (default 50), 0 - spins with sched_yield.
+    void SetPollPeriod( unsigned us )  { poll_us = us; }
+
+    // The next frame, NULL if none has come in 'timeout_ms' or the exporter has closed (Closed()).
+    const SExportFrame* Next( unsigned timeout_ms );
+    bool Closed() const;
+
+    const void* Data( const SExportFrame& f ) const  { return arena + f.offset; }
+
+    // False if the exporter has revoked the frame (its data may be overwritten), check after reading the data.
+    bool Valid( const SExportFrame& f ) const;
+
+    // Done with 'f' and every frame before it; the exporter holds at most g_export_capacity frames for a reader.
+    void Ack( const SExportFrame& f );
+};
+
+#endif // !defined(FRAME_READER__H__)
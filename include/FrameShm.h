@@ -0,0 +1,63 @@
+#ifndef FRAME_SHM__H__
+#define FRAME_SHM__H__
+#include <stdint.h>
+
+//=====================================================================================================================
+// Layout of the shared-memory frame export of one device, plain data only (readers build against it alone). Frame
+// data is at 'offset' in /proc/<pid>/fd/<arena_fd> of the exporter (ptrace read access, see FrameReader.h).
+static const uint32_t g_export_magic = 0x4D485343;  // "CSHM"
+static const uint32_t g_export_version = 1;
+static const uint32_t g_export_capacity = 16;  // frames held at most, a power of 2
+static const int g_export_max_readers = 8;
+
+// Readers[].state
+enum EExportReaderState
+{
+    ExportReaderFree = 0,
+    ExportReaderJoining,  // claimed, 'pid' and 'ack_seq' are being set; the exporter skips the slot
+    ExportReaderActive
+};
+
+struct SExportFrame
+{
+    uint64_t  seq;
+    uint64_t  offset;  // in the arena file
+    uint32_t  size;  // payload bytes, row_bytes x height
+    uint32_t  flags;  // BMDFrameFlags
+    int64_t  stream_time;  // 1/240000 s
+    int64_t  duration;
+    uint64_t  arrived_ns;  // CLOCK_MONOTONIC at VideoInputFrameArrived
+    uint32_t  width, height, row_bytes;
+    uint32_t  pixel_format;  // BMDPixelFormat
+};
+
+struct SExportReader
+{
+    volatile uint32_t  state;  // EExportReaderState, claimed with a compare-exchange
+    volatile int32_t  pid;  // a reader whose process is gone is dropped by the exporter
+    volatile uint64_t  ack_seq;  // frames before it are no longer used by the reader
+    char  pad[ 64 - 16 ];
+};
+
+struct SExportHeader
+{
+    uint32_t  magic;
+    uint32_t  version;
+    int32_t  pid;  // of the exporter
+    int32_t  arena_fd;
+    uint64_t  arena_size;
+    uint32_t  capacity;
+    uint32_t  max_readers;
+    volatile uint32_t  closed;  // the exporter has gone, no more frames
+    char  pad0[ 64 - 36 ];
+
+    volatile uint64_t  write_seq;  // frames published
+    char  pad1[ 64 - 8 ];
+    volatile uint64_t  release_seq;  // frames given back to the allocator
+    char  pad2[ 64 - 8 ];
+
+    SExportReader  readers[g_export_max_readers];
+    SExportFrame  frames[g_export_capacity];
+};
+
+#endif // !defined(FRAME_SHM__H__)
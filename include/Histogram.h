@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM__H__
+#define HISTOGRAM__H__
+#include <stdint.h>
+
+//=====================================================================================================================
+// Log-linear histogram of nanosecond values, 32 sub-buckets per power of two (about 3%). One writer thread, no
+// atomics; readers Add() while it goes on.
+class CHistogram
+{
+public:
+    static const int g_sub_bits = 6;
+    static const int g_value_bits = 40;
+    static const int g_bucket_count = ( g_value_bits - g_sub_bits + 2 ) << ( g_sub_bits - 1 );
+
+private:
+    volatile int32_t  counts[g_bucket_count];
+    volatile uint64_t  max_value;
+
+public:
+    CHistogram()  { Reset(); }
+
+    void Record( uint64_t v );
+
+    // Not synchronized with Record().
+    void Reset();
+
+    // Merges the counts of 'h' into this one.
+    void Add( const CHistogram& h );
+
+    uint64_t Count() const;
+    uint64_t Max() const  { return max_value; }
+
+    // Upper bound of the bucket holding the 'q'-quantile (0 < q <= 1), 0 if the histogram is empty.
+    uint64_t Percentile( double q ) const;
+};
+
+#endif // !defined(HISTOGRAM__H__)
@@ -0,0 +1,30 @@
+#ifndef LOG__H__
+#define LOG__H__
+#include <utils.h>
+
+//=====================================================================================================================
+// Asynchronous log for the driver callback threads: a lock-free ring of binary records printed by a writer thread.
+struct SLogRecord
+{
+    uint64_t  time_ns;
+    int32_t  index;  // device index
+    int32_t  event;
+    int64_t  args[4];
+};
+
+// Prints one record, runs on the writer thread.
+typedef void (*FLogFormat)( const SLogRecord& r );
+
+// Starts the writer thread. 'sync' - no writer, LogEvent() prints the record itself.
+void LogStart( FLogFormat format, bool sync = false );
+
+// Returns false if the record has been dropped (the ring is full), a callback never waits.
+bool LogEvent( int index, int event, int64_t a0 = 0, int64_t a1 = 0, int64_t a2 = 0, int64_t a3 = 0 );
+
+// Waits until every record logged before the call is printed.
+void LogFlush();
+
+// Records dropped so far.
+uint32_t LogDropCount();
+
+#endif // !defined(LOG__H__)
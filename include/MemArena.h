@@ -0,0 +1,78 @@
+#ifndef MEM_ARENA__H__
+#define MEM_ARENA__H__
+#include <stdint.h>
+
+//=====================================================================================================================
+// Linux frame buffer arenas behind MemAlloc/MemFree (MemAlloc-linux.cpp): one mmap reservation per device index.
+enum EMemArenaMode
+{
+    MemArenaHeap = 0,  // no arena, page-unaligned heap allocations (the generic MemAlloc)
+    MemArenaPages,  // arena of regular pages
+    MemArenaThp,  // arena with MADV_HUGEPAGE (transparent huge pages)
+    MemArenaHugeTlb,  // MAP_HUGETLB extents, falls back to MemArenaThp if no huge pages are reserved
+
+    MemArenaModeCount
+};
+
+// Mode of the arenas created after the call (on the first MemAlloc of each device index).
+void MemArenaSetMode( EMemArenaMode mode );
+EMemArenaMode MemArenaGetMode();
+const char* MemArenaModeName( EMemArenaMode mode );
+
+// Returns false if 'name' is not a mode name.
+bool MemArenaParseMode( const char* name, EMemArenaMode* mode );
+
+// MemPrefault also mlocks arena buffers; a failure (RLIMIT_MEMLOCK) is reported once.
+void MemArenaSetLock( bool lock );
+bool MemArenaGetLock();
+
+//---------------------------------------------------------------------------------------------------------------------
+// Arenas created after the call are memfd_create(2) files other processes can map (FrameExport.h); MemArenaHugeTlb
+// falls back to MemArenaThp.
+void MemArenaSetShared( bool shared );
+bool MemArenaGetShared();
+
+// memfd of the shared arena of device 'index' (the arena is created if need be) and the size of the file, -1 if the
+// arenas are not shared or the arena could not be created.
+int MemArenaSharedFd( int index, uint64_t* size );
+
+// Offset of 'ptr' in the shared arena file of device 'index', false if the buffer is not in that arena.
+bool MemArenaSharedOffset( int index, const void* ptr, uint64_t* offset );
+
+//---------------------------------------------------------------------------------------------------------------------
+// NUMA node the arena of device 'index' is mbind()-ed to (set before its first MemAlloc), -1 - none (default).
+void MemArenaSetNode( int index, int node );
+int MemArenaGetNode( int index );
+
+// True if 'node' is an online memory node; without NUMA support in the kernel only node 0 is.
+bool MemNodeIsOnline( int node );
+
+// Node of the PCI slot of DeckLink device 'index' (/sys/class/blackmagic/io<index>/device/numa_node), -1 - unknown.
+int MemNodeOfDevice( int index );
+
+// Where the pages of the buffers of a device in use are, counted by move_pages(2).
+struct SMemNodePages
+{
+    uint64_t  local;  // on the node of the arena
+    uint64_t  remote;
+    uint64_t  absent;  // not faulted in (or the query failed)
+};
+
+// Returns false if the arena of device 'index' is not bound to a node.
+bool MemArenaNodePages( int index, SMemNodePages* pages );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Process-wide page faults (getrusage) and dTLB load misses (perf counter, if perf_event_paranoid allows).
+struct SMemCounters
+{
+    uint64_t  minor_faults;
+    uint64_t  major_faults;
+    uint64_t  dtlb_misses;
+    bool  has_dtlb;
+};
+
+// Opens the perf counter, must be called before any threads are started so they inherit it.
+void MemCountersInit();
+void MemCountersRead( SMemCounters* counters );
+
+#endif // !defined(MEM_ARENA__H__)
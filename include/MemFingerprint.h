@@ -0,0 +1,27 @@
+#ifndef MEM_FINGERPRINT__H__
+#define MEM_FINGERPRINT__H__
+#include <stddef.h>
+#include <stdint.h>
+
+//=====================================================================================================================
+// CRC32C fingerprint of a released buffer, computed in pieces. 'sample_lines' > 0 - only that many cache lines of
+// every 4K page, picked from 'seed'.
+struct SMemFingerprint
+{
+    uint32_t  crc[4];
+    uint32_t  seed;
+    unsigned  sample_lines;  // 0 - all bytes
+    size_t  end;  // bytes [0, end) are hashed
+};
+
+void MemFingerprintInit( SMemFingerprint* f, unsigned sample_lines, uint32_t seed );
+
+// Hashes [f->end, end) of the buffer; f->end stops at a whole block (or page) unless 'end' is the buffer size.
+void MemFingerprintUpdate( SMemFingerprint* f, const void* ptr, size_t sz, size_t end );
+
+uint32_t MemFingerprintValue( const SMemFingerprint* f );
+
+// "crc32c-sse4.2" or "crc32c-table".
+const char* MemFingerprintKernelName();
+
+#endif // !defined(MEM_FINGERPRINT__H__)
@@ -0,0 +1,25 @@
+#ifndef MEM_PATTERN__H__
+#define MEM_PATTERN__H__
+#include <stddef.h>
+
+//=====================================================================================================================
+// Guard pattern of released buffers: a pseudo-random sequence of 32-bit words written over the whole buffer and
+// checked when the buffer is taken back.
+void MemPatternFill( void* ptr, size_t sz );
+
+// Reports the first mismatch (see MemUnprotect) and returns false if the buffer does not hold the pattern.
+bool MemPatternVerify( int index, const void* ptr, size_t sz, char* report = NULL, size_t report_size = 0 );
+
+// Checks bytes [begin, end) only (rounded to whole words), a buffer can be verified in pieces.
+bool MemPatternVerifyRange( int index, const void* ptr, size_t sz, size_t begin, size_t end,
+                                                                    char* report = NULL, size_t report_size = 0 );
+
+// printf to stdout if 'report' is NULL, snprintf to 'report' otherwise.
+void MemReport( char* report, size_t report_size, const char* format, ... );
+
+// Fill and verify run on the widest vector kernel the CPU supports ("scalar", "sse2", "avx2", "avx512"), the words
+// written are the same for every kernel. MemPatternSetKernel returns false if the kernel is unknown or not supported.
+const char* MemPatternKernelName();
+bool MemPatternSetKernel( const char* name );
+
+#endif // !defined(MEM_PATTERN__H__)
@@ -2,10 +2,21 @@
 #define MEM_UTILS__H__
 #include <stddef.h>
 
-void* MemAlloc( size_t sz );
+// 'index' is the device index, memory of different devices may come from different arenas.
+void* MemAlloc( int index, size_t sz );
 void MemFree( void* ptr );
 
-void MemProtect( int index, void* ptr, size_t sz );
-bool MemUnprotect( int index, void* ptr, size_t sz );
+// Makes the buffer resident before its first use, so the capture path does not take the page faults.
+void MemPrefault( int index, void* ptr, size_t sz );
+
+// Returns false if the buffer cannot be read until MemUnprotect, MemVerifyRange has nothing to check in it.
+bool MemProtect( int index, void* ptr, size_t sz );
+// Returns false if the buffer has been touched since MemProtect, reported to stdout or to 'report' if not NULL.
+// The first 'verified' bytes have already been checked by MemVerifyRange and are skipped.
+bool MemUnprotect( int index, void* ptr, size_t sz, size_t verified = 0, char* report = NULL, size_t report_size = 0 );
+
+// Checks [begin, end) of a buffer that stays protected, not of one MemProtect has reported unreadable.
+bool MemVerifyRange( int index, const void* ptr, size_t sz, size_t begin, size_t end,
+                                                                    char* report = NULL, size_t report_size = 0 );
 
 #endif // !defined(MEM_UTILS__H__)
@@ -0,0 +1,31 @@
+#ifndef MEM_VERIFY__H__
+#define MEM_VERIFY__H__
+
+//=====================================================================================================================
+// How MemProtect/MemUnprotect guard released buffers on Linux (MemProtect-linux.cpp).
+enum EMemVerifyMode
+{
+    MemVerifyPattern = 0,  // fill with the guard pattern, verify the whole buffer in MemUnprotect
+    MemVerifyPages,  // the guard pattern under mprotect(PROT_NONE): a CPU access faults, is recorded by the
+                     // SIGSEGV handler and reported by MemUnprotect, a device (DMA) write bypasses the page tables
+                     // and fails the pattern check in MemUnprotect; nothing is checked in the background
+    MemVerifyHash,  // CRC32C fingerprint of the contents at release, compared in MemUnprotect; nothing is written
+    MemVerifySampled,  // as MemVerifyHash, but only a few random cache lines of every page are hashed
+
+    MemVerifyModeCount
+};
+
+// Must be called before the first MemProtect. MemVerifyPages needs page-aligned buffers, i.e. a MemArena mode other
+// than MemArenaHeap.
+void MemVerifySetMode( EMemVerifyMode mode );
+EMemVerifyMode MemVerifyGetMode();
+const char* MemVerifyModeName( EMemVerifyMode mode );
+
+// Returns false if 'name' is not a mode name.
+bool MemVerifyParseMode( const char* name, EMemVerifyMode* mode );
+
+// Cache lines per 4K page hashed by MemVerifySampled (1..64).
+void MemVerifySetSampleLines( unsigned lines );
+unsigned MemVerifyGetSampleLines();
+
+#endif // !defined(MEM_VERIFY__H__)
@@ -0,0 +1,92 @@
+#ifndef PIXEL_CONVERT__H__
+#define PIXEL_CONVERT__H__
+#include <utils.h>
+#include <BufferPool.h>
+#include <FramePipeline.h>
+#include <Histogram.h>
+
+class CWorkerPool;
+
+//=====================================================================================================================
+// Conversion of 8-bit UYVY frames (even width) to planar layouts, the planes packed without padding: Y, then U and V
+// (i420: 4:2:0, rows averaged; yuv422p) or interleaved UV (nv12).
+enum EPixelLayout
+{
+    PixelLayoutI420 = 0,
+    PixelLayoutNv12,
+    PixelLayoutYuv422p,
+    PixelLayoutCount
+};
+
+const char* PixelLayoutName( EPixelLayout layout );
+bool PixelLayoutParse( const char* name, EPixelLayout* layout );
+
+size_t PixelLayoutSize( EPixelLayout layout, unsigned width, unsigned height );
+
+// Converts rows [row0, row1) of the frame, 'row0' is even (and so is 'row1', unless it is 'height').
+void PixelConvertRows( EPixelLayout layout, const void* src, size_t src_row_bytes, unsigned width, unsigned height,
+                                                                            void* dst, unsigned row0, unsigned row1 );
+
+// Converts the whole frame in 'slices' horizontal slices of even rows on 'workers' (NULL - on the calling thread).
+void PixelConvert( EPixelLayout layout, const void* src, size_t src_row_bytes, unsigned width, unsigned height,
+                                                                    void* dst, CWorkerPool* workers, unsigned slices );
+
+//---------------------------------------------------------------------------------------------------------------------
+// 10-bit v210 to and from 16-bit planar 4:2:2 (Y, U, V; samples in the low 10 bits). Round trips are bit-exact: packing
+// zeroes the row padding.
+size_t V210RowBytes( unsigned width );
+size_t V210PlanarSize( unsigned width, unsigned height );
+
+// Rows [row0, row1), 'dst' and 'src' are the whole planar frame.
+void V210UnpackRows( const void* src, size_t src_row_bytes, unsigned width, unsigned height, void* dst,
+                                                                                        unsigned row0, unsigned row1 );
+void V210PackRows( const void* src, unsigned width, unsigned height, void* dst, size_t dst_row_bytes,
+                                                                                        unsigned row0, unsigned row1 );
+
+// The whole frame in 'slices' horizontal slices on 'workers' (NULL - on the calling thread).
+void V210Unpack( const void* src, size_t src_row_bytes, unsigned width, unsigned height, void* dst,
+                                                                                CWorkerPool* workers, unsigned slices );
+void V210Pack( const void* src, unsigned width, unsigned height, void* dst, size_t dst_row_bytes,
+                                                                                CWorkerPool* workers, unsigned slices );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Capture pixel formats of -pixel-format: "uyvy" (bmdFormat8BitYUV) and "v210" (bmdFormat10BitYUV).
+const char* PixelFormatName( BMDPixelFormat format );
+bool PixelFormatParse( const char* name, BMDPixelFormat* format );
+size_t PixelFormatRowBytes( BMDPixelFormat format, unsigned width );  // other formats: width*4
+
+// "scalar", "ssse3" or "avx2", the widest the CPU supports by default; every kernel writes the same bytes.
+const char* PixelConvertKernelName();
+bool PixelConvertSetKernel( const char* name );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Pipeline stage converting UYVY and unpacking v210 frames into buffers of its own CBufferPool, in slices on the
+// worker pool. Frames of other pixel formats are skipped.
+class CFrameConverter
+{
+    int  index;
+    EPixelLayout  layout;
+    CWorkerPool*  workers;
+    unsigned  slices;
+    CBufferPool  pool;
+
+    // Statistics of all runs, written by the consumer thread only.
+    CHistogram  convert_ns;
+    uint64_t  frames, v210_frames, skipped, alloc_failures;  // 'frames' counts both formats
+
+    CFrameConverter( const CFrameConverter& );
+    CFrameConverter& operator=( const CFrameConverter& );
+
+public:
+    CFrameConverter();
+
+    // 'worker_pool' NULL - CWorkerPool::Shared(); 'slice_count' 0 - one slice per worker and one for the caller.
+    void Init( int device_index, EPixelLayout pixel_layout, CWorkerPool* worker_pool = NULL, unsigned slice_count = 0 );
+
+    // FFrameStage, 'ctx' is the CFrameConverter.
+    static void Stage( void* ctx, const SCapturedFrame& frame );
+
+    void PrintStats();
+};
+
+#endif // !defined(PIXEL_CONVERT__H__)
@@ -0,0 +1,158 @@
+#ifndef RECORDER__H__
+#define RECORDER__H__
+#include <utils.h>
+#include <FramePipeline.h>
+#include <stdio.h>
+#include <sys/uio.h>
+#include <deque>
+#include <vector>
+
+//=====================================================================================================================
+// Raw capture recorder (Linux): frames are written from the allocator buffers with O_DIRECT and released when the
+// write completes. Needs a page arena; every frame takes a whole number of g_record_block bytes in the video file.
+enum ERecordIo
+{
+    RecordIoUring,  // io_uring (raw syscalls, no liburing), completions are reaped by the consumer thread
+    RecordIoThreads,  // pwritev on a few writer threads of the device, completions run on them
+
+    RecordIoCount
+};
+
+const char* RecordIoName( ERecordIo io );
+bool RecordIoParse( const char* name, ERecordIo* io );
+
+// Directory of the recordings, NULL - no recording (default).
+void RecordSetDir( const char* dir );
+const char* RecordGetDir();
+
+// Write path of the recorders opened after the call (default RecordIoUring).
+void RecordSetIo( ERecordIo io );
+ERecordIo RecordGetIo();
+
+static const size_t g_record_block = 4096;
+
+// One record per frame in dev<N>.index, little endian, as in memory.
+struct SRecordIndexEntry
+{
+    int64_t  stream_time;  // 1/240000 s
+    int64_t  duration;
+    uint64_t  video_offset;  // in dev<N>.video, a multiple of g_record_block
+    uint64_t  audio_offset;  // in dev<N>.audio
+    uint32_t  video_size;  // payload bytes, RowBytes x Height; 0 - not recorded (see CRecorder)
+    uint32_t  audio_size;  // 0 - no audio packet
+    uint32_t  width, height, row_bytes;
+    uint32_t  pixel_format;  // BMDPixelFormat
+    uint32_t  flags;  // BMDFrameFlags
+    uint32_t  reserved;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Queue of asynchronous positioned writes. Write() blocks while 'depth' writes are in flight.
+class CRecordQueue
+{
+public:
+    // Called once per write when it completes with the 'item' of the write, 'result' is the byte count or -errno.
+    typedef void (*FDone)( void* ctx, void* item, long result );
+
+private:
+    struct SWrite
+    {
+        int  fd;
+        struct iovec*  iov;
+        uint64_t  offset;
+        void*  item;
+    };
+
+    ERecordIo  io;
+    unsigned  depth;
+    FDone  done;
+    void*  done_ctx;
+    std::vector<struct iovec>  iovs;  // one per slot
+    std::vector<SWrite>  slots;
+    std::vector<unsigned>  free_slots;  // io_uring: used by the consumer thread only; writer threads: under 'lock'
+
+    // io_uring
+    int  ring_fd;
+    void*  sq_ring;
+    void*  cq_ring;
+    size_t  sq_ring_size, cq_ring_size;
+    struct io_uring_sqe*  sqes;
+    unsigned  *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned  *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe*  cqes;
+
+    // Writer threads
+    CMutex  lock;
+    CSemaphore  queued;  // a write in 'pending' or stopping
+    CSemaphore  slots_free;  // counts 'free_slots'
+    std::deque<unsigned>  pending;
+    int  running_threads;
+    bool  stopping;
+    CWaitableCondition  stopped;
+
+    CRecordQueue( const CRecordQueue& );
+    CRecordQueue& operator=( const CRecordQueue& );
+
+    bool SetupRing();
+    void Complete( unsigned slot, long result );
+    bool Reap( bool wait );
+    static void ThreadFunc( void* ctx );
+
+public:
+    CRecordQueue();
+    ~CRecordQueue();
+
+    // RecordIoUring falls back to RecordIoThreads if io_uring is not available (reported).
+    void Start( ERecordIo mode, unsigned queue_depth, int writer_threads, const SThreadPlacement& placement,
+                                                                                        FDone done_func, void* ctx );
+    ERecordIo Io() const  { return io; }
+
+    // Returns false (nothing queued, no callback) if the write could not be submitted.
+    bool Write( int fd, const void* buf, size_t len, uint64_t offset, void* item );
+
+    // Runs the callbacks of completed writes (io_uring), does not wait.
+    void Poll();
+
+    // Waits until every write has completed.
+    void Flush();
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Recorder of one device: dev<N>.video, dev<N>.audio and dev<N>.index. Stage() runs on the consumer thread, Flush()
+// before the allocator is reset.
+class CRecorder
+{
+    int  index;
+    int  video_fd, audio_fd;
+    bool  direct;  // video_fd is O_DIRECT
+    FILE*  index_file;
+    uint64_t  video_offset, audio_offset;
+    uint32_t  audio_frame_bytes;
+    CRecordQueue  queue;
+
+    // Statistics of all runs; 'write_errors' is also counted by the writer threads.
+    volatile int32_t  write_errors;
+    uint64_t  frames, skipped, video_bytes, audio_bytes;
+    uint64_t  first_ns, last_ns;  // arrival of the first and the latest recorded frame
+
+    CRecorder( const CRecorder& );
+    CRecorder& operator=( const CRecorder& );
+
+    static void VideoDone( void* ctx, void* item, long result );
+
+public:
+    CRecorder();
+    ~CRecorder();
+
+    // Creates (truncates) the files in 'dir' and starts the write queue.
+    bool Open( const char* dir, int device_index, ERecordIo io, uint32_t audio_frame_bytes,
+                                                                                const SThreadPlacement& placement );
+
+    // FFrameStage, 'ctx' is the CRecorder.
+    static void Stage( void* ctx, const SCapturedFrame& frame );
+
+    void Flush();
+    void PrintStats();
+};
+
+#endif // !defined(RECORDER__H__)
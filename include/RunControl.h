@@ -0,0 +1,82 @@
+#ifndef RUN_CONTROL__H__
+#define RUN_CONTROL__H__
+#include <utils.h>
+
+//=====================================================================================================================
+enum ERunState
+{
+    RunIdle,
+    RunStarting,  // QueryInterface .. StartStreams
+    RunStreaming,
+    RunStopping,  // StopStreams/PauseStreams .. teardown and the wait before the next start
+    RunVerifying,  // CMemAlloc::Reset/Protect
+    RunFailed,
+    RunStateCount
+};
+
+// In the order of precedence, a later Stop() can only raise the status.
+enum ERunStatus
+{
+    RunActive,
+    RunCompleted,  // -duration has passed
+    RunDeviceError,  // every device thread has given up
+    RunValidationFailed,
+    RunStatusCount
+};
+
+const char* RunStateName( ERunState state );
+const char* RunStatusName( ERunStatus status );
+
+//=====================================================================================================================
+// Stop token and state of the device threads. Stop() wakes every registered device condition right away.
+class CRunControl
+{
+public:
+    static const int g_max_devices = 16;
+
+private:
+    volatile int32_t  status;  // ERunStatus
+    volatile int32_t  stop_index;  // device of the stop, -1 - none or the main thread
+    volatile int32_t  active;  // registered device threads that have not left yet
+    int  device_count;
+    uint64_t  start_ns;
+    volatile uint64_t  stop_ns;
+
+    struct SDevice
+    {
+        CWaitableCondition*  wakeup;
+        volatile int32_t  state;  // ERunState
+        uint64_t  wake_ns;  // from Stop() to the device leaving RunStreaming, 0 - not yet
+        uint64_t  restart_count;
+    };
+
+    SDevice  devices[g_max_devices];
+    CWaitableCondition  finished;
+
+public:
+    CRunControl();
+
+    // Before the device thread starts.
+    void Register( int index, CWaitableCondition* wakeup );
+
+    // Returns true if this call has raised the status.
+    bool Stop( ERunStatus s, int index );
+
+    bool Stopped() const  { return status != RunActive; }
+    ERunStatus Status() const  { return (ERunStatus)status; }
+
+    void SetState( int index, ERunState state );
+    ERunState State( int index ) const  { return (ERunState)devices[index].state; }
+    void CountRestart( int index )  { ++devices[index].restart_count; }
+
+    // The device thread exits.
+    void Leave( int index );
+
+    // Returns false if 'timeout_ms' has passed and a device thread is still running, 0 - no timeout.
+    bool WaitFinished( unsigned timeout_ms );
+
+    // "RESULT status=... " line (key=value pairs) for scripts, returns the process exit code: 0 - completed.
+    int PrintStatus() const;
+};
+
+#endif // !defined(RUN_CONTROL__H__)
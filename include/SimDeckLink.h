@@ -0,0 +1,15 @@
+#ifndef SIM_DECK_LINK__H__
+#define SIM_DECK_LINK__H__
+#include <utils.h>
+
+//=====================================================================================================================
+// Software DeckLink backend: emulates 'device_count' capture devices which deliver frames (taken from the installed
+// IDeckLinkMemoryAllocator) at the cadence of the enabled display mode. When format detection is enabled and
+// 'format_change_period_sec' is non-zero, every device reports a display mode change with that period.
+IDeckLinkIterator* CreateSimDeckLinkIteratorInstance( int device_count, unsigned format_change_period_sec );
+
+// Frame content of the simulated devices: 0 - black (default); otherwise UYVY and v210 frames cycle through
+// 'period_sec' of moving content, 'period_sec' of the same picture frozen and 'period_sec' of black.
+void SimSetContentCycle( unsigned period_sec );
+
+#endif // !defined(SIM_DECK_LINK__H__)
@@ -0,0 +1,17 @@
+#ifndef THREAD_PLACEMENT__H__
+#define THREAD_PLACEMENT__H__
+#include <utils.h>
+
+//=====================================================================================================================
+// Option text of SThreadPlacement (see StartThread in utils.h).
+
+// "2,4-6" - CPUs 2, 4, 5 and 6; CPUs 0 .. SCpuSet::g_max_cpus-1. Returns false if the list is malformed or empty.
+bool ParseCpuList( const char* s, SCpuSet* cpus );
+
+// "other", "fifo:<priority>" or "rr:<priority>", priority 1..99.
+bool ParseThreadSched( const char* s, SThreadPlacement* placement );
+
+// "cpus=2-3 sched=fifo:80 name=cct-dev0", the name is left out if empty.
+void FormatThreadPlacement( const SThreadPlacement& placement, char* buf, size_t size );
+
+#endif // !defined(THREAD_PLACEMENT__H__)
@@ -0,0 +1,51 @@
+#ifndef WORKER_POOL__H__
+#define WORKER_POOL__H__
+#include <utils.h>
+
+//=====================================================================================================================
+// Fixed set of worker threads running batches of independent jobs. Several threads may run batches at the same time,
+// the calling thread always works on its own batch too, so a pool without workers runs the batch serially.
+class CWorkerPool
+{
+public:
+    typedef void (*FJob)( void* ctx, size_t j );
+
+private:
+    struct SBatch
+    {
+        FJob  func;
+        void*  ctx;
+        size_t  count, next, done;
+        CWaitableCondition  finished;
+        SBatch*  next_batch;
+    };
+
+    CMutex  lock;
+    CSemaphore  wake;
+    SBatch*  batches;
+    int  threads;
+    bool  stopping;
+    int  running_threads;
+    CWaitableCondition  stopped;
+
+    CWorkerPool( const CWorkerPool& );
+    CWorkerPool& operator=( const CWorkerPool& );
+
+    bool TakeJob( SBatch* only, SBatch** batch, size_t* j );
+    void FinishJob( SBatch* batch );
+    static void ThreadFunc( void* ctx );
+
+public:
+    explicit CWorkerPool( int thread_count );
+    ~CWorkerPool();
+
+    int ThreadCount() const  { return threads; }
+
+    // Calls func(ctx,j) for every j in [0,count) and returns when all of them are done.
+    void Run( FJob func, void* ctx, size_t count );
+
+    // Pool shared by all devices, one worker per CPU (the calling thread makes up for the one it occupies).
+    static CWorkerPool& Shared();
+};
+
+#endif // !defined(WORKER_POOL__H__)
@@ -16,12 +16,57 @@ inline int32_t Int32AtomicAdd( volatile int32_t* p, int32_t x )
     return InterlockedExchangeAdd( (volatile LONG*)p, x );
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+// Returns the previous value, '*p' is set to 'x' only if it was equal to 'cmp'.
+inline int32_t Int32CompareExchange( volatile int32_t* p, int32_t x, int32_t cmp )
+{
+    return InterlockedCompareExchange( (volatile LONG*)p, x, cmp );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+inline int64_t Int64CompareExchange( volatile int64_t* p, int64_t x, int64_t cmp )
+{
+    return InterlockedCompareExchange64( (volatile LONGLONG*)p, x, cmp );
+}
+
+// Returns the previous value.
+inline int64_t Int64AtomicAdd( volatile int64_t* p, int64_t x )
+{
+    return InterlockedExchangeAdd64( (volatile LONGLONG*)p, x );
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 inline void WaitSec( unsigned duration_sec )
 {
     Sleep( duration_sec*1000 );
 }
 
+inline void WaitMs( unsigned duration_ms )
+{
+    Sleep(duration_ms);
+}
+
+inline void YieldThread()
+{
+    SwitchToThread();
+}
+
+// Identity of the calling thread, only for comparison.
+inline uint64_t CurrentThreadId()
+{
+    return ::GetCurrentThreadId();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+inline uint64_t MonotonicTimeNs()
+{
+    LARGE_INTEGER freq, cnt;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&cnt);
+    return  (uint64_t)( cnt.QuadPart / freq.QuadPart ) * 1000000000ULL
+                                        + (uint64_t)( cnt.QuadPart % freq.QuadPart ) * 1000000000ULL / freq.QuadPart;
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 inline bool InitCom()
 {
@@ -73,11 +118,40 @@ public:
     ~CWaitableCondition()  { ::CloseHandle(m_h); }
 
     void Wait()  { ::WaitForSingleObject( m_h, INFINITE ); }
+    bool Wait( unsigned timeout_ms )  { return ::WaitForSingleObject( m_h, timeout_ms ) != WAIT_TIMEOUT; }
     bool Value() const  { return ::WaitForSingleObject( m_h, 0 ) != WAIT_TIMEOUT; }
     void SetTrue()  { ::SetEvent(m_h); }
     void SetFalse()  { ::ResetEvent(m_h); }
 };
 
+//---------------------------------------------------------------------------------------------------------------------
+class CSemaphore
+{
+    HANDLE  m_h;
+
+public:
+    CSemaphore() : m_h( ::CreateSemaphore( NULL, 0, 0x7fffffff, NULL ) )
+    {
+        if( m_h == NULL )
+        {
+            throw std::runtime_error("CSemaphore: CreateSemaphore failed");
+        }
+    }
+
+    ~CSemaphore()  { ::CloseHandle(m_h); }
+
+    void Wait()  { ::WaitForSingleObject( m_h, INFINITE ); }
+    void Post( int32_t count = 1 )  { ::ReleaseSemaphore( m_h, count, NULL ); }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+inline unsigned CpuCount()
+{
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 inline IDeckLinkIterator* CreateDeckLinkIteratorInstance()
 {
@@ -101,7 +175,9 @@ typedef unsigned long BM_UINT32;
 #else // !defined(_WIN32)
 //=====================================================================================================================
 #include <string.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 
 //---------------------------------------------------------------------------------------------------------------------
 #if defined(__APPLE__)
@@ -111,6 +187,8 @@ const REFIID IID_IUnknown = CFUUIDGetUUIDBytes(IUnknownUUID);
 
 #elif defined(__linux__)
 #include <time.h>
+
+typedef int64_t LONGLONG;
 #else
 #error "Unsupported OS"
 #endif
@@ -121,6 +199,30 @@ inline void WaitSec( unsigned duration_sec )
     sleep(duration_sec);
 }
 
+inline void WaitMs( unsigned duration_ms )
+{
+    usleep( duration_ms*1000 );
+}
+
+inline void YieldThread()
+{
+    sched_yield();
+}
+
+// Identity of the calling thread, only for comparison.
+inline uint64_t CurrentThreadId()
+{
+    return (uint64_t)(uintptr_t)pthread_self();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+inline uint64_t MonotonicTimeNs()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return  (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 #if defined(__i386__) || defined(__amd64__)
 
@@ -130,6 +232,25 @@ inline int32_t Int32AtomicAdd( volatile int32_t* p, int32_t x )
     return x;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+// Returns the previous value, '*p' is set to 'x' only if it was equal to 'cmp'.
+inline int32_t Int32CompareExchange( volatile int32_t* p, int32_t x, int32_t cmp )
+{
+    return __sync_val_compare_and_swap( p, cmp, x );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+inline int64_t Int64CompareExchange( volatile int64_t* p, int64_t x, int64_t cmp )
+{
+    return __sync_val_compare_and_swap( p, cmp, x );
+}
+
+// Returns the previous value.
+inline int64_t Int64AtomicAdd( volatile int64_t* p, int64_t x )
+{
+    return __sync_fetch_and_add( p, x );
+}
+
 #else
 #error "Unsupported CPU architecture"
 #endif
@@ -169,13 +290,23 @@ class CWaitableCondition
     bool  m_value;
 
 public:
-    CWaitableCondition( bool value = false ) : m_value(value)  {}
+    CWaitableCondition( bool value = false ) : m_value(value)
+    {
+        int err = pthread_cond_init( &m_cond, NULL );
+
+        if( err != 0 )
+        {
+            throw  std::runtime_error("pthread_cond_init failed");
+        }
+    }
+
+    ~CWaitableCondition()  { pthread_cond_destroy(&m_cond); }
 
     void Wait()
     {
         m_mutex.Lock();
 
-        if( !m_value )
+        while( !m_value )
         {
             pthread_cond_wait( &m_cond, m_mutex.Ptr() );
         }
@@ -183,6 +314,29 @@ public:
         m_mutex.Unlock();
     }
 
+    // Returns false if 'timeout_ms' has passed and the value is still false.
+    bool Wait( unsigned timeout_ms )
+    {
+        struct timespec ts;
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec += timeout_ms / 1000;
+        ts.tv_nsec += (long)( timeout_ms % 1000 ) * 1000000L;
+
+        if( ts.tv_nsec >= 1000000000L )
+        {
+            ++ts.tv_sec;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        m_mutex.Lock();
+
+        while(  !m_value  &&  pthread_cond_timedwait( &m_cond, m_mutex.Ptr(), &ts ) == 0  );
+
+        bool value = m_value;
+        m_mutex.Unlock();
+        return value;
+    }
+
     bool Value() const  {  return  m_value;  }
 
     void SetTrue()
@@ -202,6 +356,56 @@ public:
     }
 };
 
+//-----------------------------------------------------------------------------
+class CSemaphore
+{
+    CMutex  m_mutex;
+    pthread_cond_t  m_cond;
+    int32_t  m_count;
+
+public:
+    CSemaphore() : m_count(0)
+    {
+        int err = pthread_cond_init( &m_cond, NULL );
+
+        if( err != 0 )
+        {
+            throw  std::runtime_error("pthread_cond_init failed");
+        }
+    }
+
+    ~CSemaphore()  { pthread_cond_destroy(&m_cond); }
+
+    void Wait()
+    {
+        m_mutex.Lock();
+
+        while( m_count == 0 )
+        {
+            pthread_cond_wait( &m_cond, m_mutex.Ptr() );
+        }
+
+        --m_count;
+        m_mutex.Unlock();
+    }
+
+    void Post( int32_t count = 1 )
+    {
+        m_mutex.Lock();
+
+        m_count += count;
+        pthread_cond_broadcast(&m_cond);
+        m_mutex.Unlock();
+    }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+inline unsigned CpuCount()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return ( n > 0 ? (unsigned)n : 1 );
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 #define STDMETHODCALLTYPE
 
@@ -225,8 +429,62 @@ public:
 };
 
 //=====================================================================================================================
+enum EThreadSched
+{
+    ThreadSchedDefault,  // SCHED_OTHER, normal priority
+    ThreadSchedFifo,
+    ThreadSchedRr
+};
+
+// CPUs 0 .. g_max_cpus-1, as many as a Linux cpu_set_t holds. On Windows CPU j is CPU j%64 of processor group j/64.
+struct SCpuSet
+{
+    static const int g_max_cpus = 1024;
+
+    uint64_t  bits[g_max_cpus/64];
+
+    SCpuSet()  { Clear(); }
+
+    void Clear()  { for( int j = 0; j < g_max_cpus/64; ++j )  bits[j] = 0; }
+    void Set( int cpu )  { bits[cpu/64] |= (uint64_t)1 << ( cpu%64 ); }
+    bool IsSet( int cpu ) const  { return (  ( bits[cpu/64] >> ( cpu%64 ) ) & 1  ) != 0; }
+
+    bool Empty() const
+    {
+        for( int j = 0; j < g_max_cpus/64; ++j )
+        {
+            if( bits[j] != 0 )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+// Where a thread runs. The default placement changes nothing.
+struct SThreadPlacement
+{
+    SCpuSet  cpus;  // empty - any CPU
+    int  sched;  // EThreadSched
+    int  priority;  // of ThreadSchedFifo/ThreadSchedRr, 1 (lowest) .. 99
+    char  name[16];  // "" - keep the name, Linux takes up to 15 characters
+
+    SThreadPlacement(): sched(ThreadSchedDefault), priority(0)  { name[0] = 0; }
+};
+
 typedef void (*FTaskAction)( void* ctx );
 
 void StartThread( FTaskAction func, void* ctx );
 
+// The new thread applies 'placement' to itself before 'func' runs; if that fails, the thread still runs.
+void StartThread( FTaskAction func, void* ctx, const SThreadPlacement& placement );
+
+// Applies 'placement' to the calling thread, returns false if a part of it failed (reported to stderr).
+bool PlaceThread( const SThreadPlacement& placement );
+
+// Effective placement of the calling thread.
+void GetThreadPlacement( SThreadPlacement* placement );
+
 #endif // !defined(UTILS__H__)
@@ -0,0 +1,159 @@
+#include <AllocStats.h>
+#include <stdio.h>
+
+//=====================================================================================================================
+CAllocStats::CAllocStats()
+{
+    allocations.value = 0;
+    pool_hits.value = 0;
+    failures.value = 0;
+    bytes_allocated.value = 0;
+    first_ns.value = 0;
+    last_ns.value = 0;
+    peak_bytes_outstanding.value = 0;
+    releases.value = 0;
+    bytes_released.value = 0;
+    other_sizes = 0;
+
+    for( int j = 0; j < SAllocStatsSnapshot::g_max_sizes; ++j )
+    {
+        sizes[j] = 0;
+        size_counts[j] = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CAllocStats::Allocated( BM_UINT32 size, bool fresh, uint64_t ns, uint64_t now_ns )
+{
+    Int64AtomicAdd( &allocations.value, 1 );
+    int64_t allocated = Int64AtomicAdd( &bytes_allocated.value, size ) + size;
+
+    if( first_ns.value == 0 )
+    {
+        Int64CompareExchange( &first_ns.value, (int64_t)now_ns, 0 );
+    }
+
+    last_ns.value = (int64_t)now_ns;
+
+    if( !fresh )
+    {
+        Int64AtomicAdd( &pool_hits.value, 1 );
+    }
+
+    // Read, never written here: the release side owns its line.
+    int64_t bytes = allocated - bytes_released.value;
+    int64_t peak = peak_bytes_outstanding.value;
+
+    while( bytes > peak )
+    {
+        int64_t prev = Int64CompareExchange( &peak_bytes_outstanding.value, bytes, peak );
+
+        if( prev == peak )
+        {
+            break;
+        }
+
+        peak = prev;
+    }
+
+    // A slot is claimed with CAS by the first allocation of a size, a size is found in the first few slots.
+    int j = 0;
+
+    for( ; j < SAllocStatsSnapshot::g_max_sizes; ++j )
+    {
+        int32_t s = sizes[j];
+
+        if(  s == 0  &&  ( s = Int32CompareExchange( &sizes[j], (int32_t)size, 0 ) ) == 0  )
+        {
+            s = (int32_t)size;
+        }
+
+        if( s == (int32_t)size )
+        {
+            Int32AtomicAdd( &size_counts[j], 1 );
+            break;
+        }
+    }
+
+    if( j == SAllocStatsSnapshot::g_max_sizes )
+    {
+        Int32AtomicAdd( &other_sizes, 1 );
+    }
+
+    allocate_ns.Record(ns);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CAllocStats::Released( BM_UINT32 size, uint64_t ns )
+{
+    Int64AtomicAdd( &releases.value, 1 );
+    Int64AtomicAdd( &bytes_released.value, size );
+    release_ns.Record(ns);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CAllocStats::Snapshot( SAllocStatsSnapshot* s ) const
+{
+    s->allocations = (uint64_t)allocations.value;
+    s->pool_hits = (uint64_t)pool_hits.value;
+    s->fresh = s->allocations - s->pool_hits;
+    s->failures = (uint64_t)failures.value;
+    s->releases = (uint64_t)releases.value;
+    s->bytes_allocated = (uint64_t)bytes_allocated.value;
+    s->first_ns = (uint64_t)first_ns.value;
+    s->last_ns = (uint64_t)last_ns.value;
+    s->bytes_outstanding = (int64_t)s->bytes_allocated - bytes_released.value;
+    s->peak_bytes_outstanding = peak_bytes_outstanding.value;
+    s->size_count = 0;
+
+    for(  int j = 0;  j < SAllocStatsSnapshot::g_max_sizes  &&  sizes[j] != 0;  ++j  )
+    {
+        s->sizes[j] = (BM_UINT32)sizes[j];
+        s->size_counts[j] = (uint32_t)size_counts[j];
+        s->size_count = j + 1;
+    }
+
+    s->other_sizes = (uint32_t)other_sizes;
+
+    s->allocate_ns.Reset();
+    s->allocate_ns.Add(allocate_ns);
+    s->release_ns.Reset();
+    s->release_ns.Add(release_ns);
+}
+
+//=====================================================================================================================
+void PrintAllocStats( int index, const SAllocStatsSnapshot& s, size_t idle_buffers )
+{
+    printf( "[%d] CMemAlloc stats: allocations=%llu (pool hits=%llu, fresh=%llu), failures=%llu, releases=%llu\n",
+                    index, (unsigned long long)s.allocations, (unsigned long long)s.pool_hits,
+                    (unsigned long long)s.fresh, (unsigned long long)s.failures, (unsigned long long)s.releases );
+    printf( "[%d]   outstanding=%.1f MB (%lld buffers), peak=%.1f MB, idle buffers=%lu\n", index,
+                    (double)s.bytes_outstanding / ( 1 << 20 ), (long long)( s.allocations - s.releases ),
+                    (double)s.peak_bytes_outstanding / ( 1 << 20 ), (unsigned long)idle_buffers );
+
+    double elapsed_sec = (double)( s.last_ns - s.first_ns ) * 1e-9;
+    printf( "[%d]   allocated=%.2f GB, %.1f MB/s, %.2f MB/allocation\n", index, (double)s.bytes_allocated / ( 1 << 30 ),
+                    ( elapsed_sec > 0 ? (double)s.bytes_allocated / ( 1 << 20 ) / elapsed_sec : 0.0 ),
+                    ( s.allocations > 0 ? (double)s.bytes_allocated / ( 1 << 20 ) / s.allocations : 0.0 ) );
+    printf( "[%d]   %16s %12s\n", index, "buf_size", "allocations" );
+
+    for( unsigned j = 0; j < s.size_count; ++j )
+    {
+        printf( "[%d]   %16lu %12llu\n", index, (unsigned long)s.sizes[j], (unsigned long long)s.size_counts[j] );
+    }
+
+    if( s.other_sizes > 0 )
+    {
+        printf( "[%d]   %16s %12llu\n", index, "other", (unsigned long long)s.other_sizes );
+    }
+
+    const CHistogram* latency[2] = { &s.allocate_ns, &s.release_ns };
+    static const char* const names[2] = { "allocate", "release" };
+
+    for( int k = 0; k < 2; ++k )
+    {
+        printf( "[%d]   %-8s latency: p50=%.1f us, p99=%.1f us, p99.9=%.1f us, max=%.1f us\n", index, names[k],
+                        latency[k]->Percentile(0.5) * 1e-3, latency[k]->Percentile(0.99) * 1e-3,
+                        latency[k]->Percentile(0.999) * 1e-3, latency[k]->Max() * 1e-3 );
+    }
+}
@@ -0,0 +1,58 @@
+#include <AvDrift.h>
+
+//=====================================================================================================================
+void CAvDrift::Reset()
+{
+    count = 0;
+    x0 = 0;
+    offset0 = 0;
+    last_x = 0;
+    sx = 0;  sy = 0;  sxx = 0;  sxy = 0;
+    max_abs_offset = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CAvDrift::Add( double video_sec, double offset_sec )
+{
+    if( count == 0 )
+    {
+        x0 = video_sec;
+        offset0 = offset_sec;
+    }
+
+    double x = video_sec - x0;
+    double y = offset_sec - offset0;
+
+    ++count;
+    last_x = x;
+    sx += x;
+    sy += y;
+    sxx += x*x;
+    sxy += x*y;
+
+    double a = ( offset_sec >= 0 ? offset_sec : -offset_sec );
+
+    if( a > max_abs_offset )
+    {
+        max_abs_offset = a;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+double CAvDrift::DriftPpm() const
+{
+    if( count < 2 )
+    {
+        return 0;
+    }
+
+    double n = (double)count;
+    double d = n*sxx - sx*sx;
+
+    if( d <= 0 )
+    {
+        return 0;
+    }
+
+    return ( n*sxy - sx*sy ) / d * 1e6;
+}
@@ -0,0 +1,368 @@
+#include <Bench.h>
+#include <BufferPool.h>
+#include <MemPattern.h>
+#include <MemUtils.h>
+#include <WorkerPool.h>
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+// The former CMemAlloc bookkeeping, kept as the reference point.
+class CMultimapPool
+{
+    std::multimap<BM_UINT32,char*>  free_buffers;
+    std::map<char*,BM_UINT32>  alloc_buffers;
+
+public:
+    ~CMultimapPool()
+    {
+        for(  std::multimap<BM_UINT32,char*>::const_iterator it = free_buffers.begin();
+                it != free_buffers.end();  ++it  )
+        {
+            MemFree(it->second);
+        }
+    }
+
+    char* Allocate( int index, BM_UINT32 buf_size )
+    {
+        char* ptr;
+        std::multimap<BM_UINT32,char*>::iterator it = free_buffers.lower_bound(buf_size);
+
+        if( it != free_buffers.end() )
+        {
+            ptr = it->second;
+            buf_size = it->first;
+            free_buffers.erase(it);
+        }
+        else
+        {
+            ptr = (char*)MemAlloc( index, buf_size );
+        }
+
+        alloc_buffers[ptr] = buf_size;
+        return ptr;
+    }
+
+    bool Release( void* buffer )
+    {
+        std::map<char*,BM_UINT32>::iterator it = alloc_buffers.find( (char*)buffer );
+
+        if( it == alloc_buffers.end() )
+        {
+            return false;
+        }
+
+        free_buffers.insert( std::multimap<BM_UINT32,char*>::value_type( it->second, it->first ) );
+        alloc_buffers.erase(it);
+        return true;
+    }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_bench_devices = 16;
+static const int g_bench_fps = 60;
+static const int g_bench_seconds = 600;
+static const int g_bench_queue_depth = 8;  // frames held by the driver/application at a time
+static const BM_UINT32 g_bench_buf_size = 1920*1080*2;
+
+struct SBenchResult
+{
+    double  avg_ns, max_ns;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Replays the AllocateBuffer/ReleaseBuffer sequence of g_bench_devices devices (round-robin, one frame each per
+// tick), every call is made under a per-device CMutex like in CMemAlloc.
+template<class TPool>
+SBenchResult RunBench()
+{
+    TPool  pools[g_bench_devices];
+    CMutex  locks[g_bench_devices];
+    std::vector<char*>  held( g_bench_devices*g_bench_queue_depth, (char*)NULL );
+
+    const int ticks = g_bench_fps * g_bench_seconds;
+    uint64_t max_ns = 0;
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int t = 0; t < ticks; ++t )
+    {
+        for( int d = 0; d < g_bench_devices; ++d )
+        {
+            uint64_t op_start = MonotonicTimeNs();
+            char*& slot = held[ d*g_bench_queue_depth + t % g_bench_queue_depth ];
+            CMutexLockGuard lock_guard( locks[d] );
+
+            if( slot != NULL )
+            {
+                pools[d].Release(slot);
+            }
+
+            slot = pools[d].Allocate( d, g_bench_buf_size );
+
+            uint64_t op_ns = MonotonicTimeNs() - op_start;
+            max_ns = ( op_ns > max_ns ? op_ns : max_ns );
+        }
+    }
+
+    uint64_t total_ns = MonotonicTimeNs() - t0;
+
+    for( size_t j = 0; j < held.size(); ++j )
+    {
+        if( held[j] != NULL )
+        {
+            pools[ j/g_bench_queue_depth ].Release( held[j] );
+        }
+    }
+
+    SBenchResult r;
+    r.avg_ns = (double)total_ns / ( (double)ticks * g_bench_devices );
+    r.max_ns = (double)max_ns;
+    return r;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// The former CMemAlloc locking: every call, including the verification scan, under one mutex.
+class CLockedPool
+{
+    CMutex  lock;
+    CBufferPool  pool;
+
+public:
+    char* Allocate( int index, BM_UINT32 size )  { CMutexLockGuard lock_guard(lock); return pool.Allocate(index,size); }
+    bool Release( void* ptr )  { CMutexLockGuard lock_guard(lock); return pool.Release(ptr); }
+    void ProtectIdle( int index )  { CMutexLockGuard lock_guard(lock); pool.ProtectIdle(index); }
+    bool FreeIdle( int index )  { CMutexLockGuard lock_guard(lock); return pool.FreeIdle(index); }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_contention_threads = 3;  // driver threads sharing one device pool
+static const int g_contention_ops = 5000;  // AllocateBuffer calls per driver thread
+static const int g_contention_queue_depth = 4;
+static const uint64_t g_contention_gap_ns = 200000;  // between ReleaseBuffer and the next AllocateBuffer
+
+template<class TPool>
+struct SContentionCtx
+{
+    TPool  pool;
+    volatile int32_t  drivers_running;
+    volatile int32_t  stop;
+    unsigned long  reset_count;
+    bool  verified;
+    CWaitableCondition  reset_done;
+    std::vector<uint32_t>  latency_ns[g_contention_threads];
+    volatile int32_t  next_thread;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Release/Allocate loop of a driver thread, records the latency of every Allocate().
+template<class TPool>
+void ContentionDriverFunc( void* p )
+{
+    SContentionCtx<TPool>& ctx = *(SContentionCtx<TPool>*)p;
+    std::vector<uint32_t>& latency = ctx.latency_ns[ Int32AtomicAdd( &ctx.next_thread, 1 ) ];
+    char* held[g_contention_queue_depth] = {};
+
+    for( int j = 0; j < g_contention_ops; ++j )
+    {
+        char*& slot = held[ j % g_contention_queue_depth ];
+
+        if( slot != NULL )
+        {
+            ctx.pool.Release(slot);
+        }
+
+        // Busy wait keeps the released buffer idle (and visible to the restart thread) for a while.
+        uint64_t t0 = MonotonicTimeNs();
+
+        while( MonotonicTimeNs() - t0 < g_contention_gap_ns );
+
+        t0 = MonotonicTimeNs();
+        slot = ctx.pool.Allocate( 0, g_bench_buf_size );
+        latency.push_back( (uint32_t)( MonotonicTimeNs() - t0 ) );
+    }
+
+    for( int j = 0; j < g_contention_queue_depth; ++j )
+    {
+        ctx.pool.Release( held[j] );
+    }
+
+    if( Int32AtomicAdd( &ctx.drivers_running, -1 ) == 1 )
+    {
+        ctx.stop = 1;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Back-to-back restart cycles: protect the idle buffers, then verify and free them (CMemAlloc::Release + Reset).
+template<class TPool>
+void ContentionResetFunc( void* p )
+{
+    SContentionCtx<TPool>& ctx = *(SContentionCtx<TPool>*)p;
+
+    while( !ctx.stop )
+    {
+        ctx.pool.ProtectIdle(0);
+        ctx.verified &= ctx.pool.FreeIdle(0);
+        ++ctx.reset_count;
+    }
+
+    ctx.reset_done.SetTrue();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<class TPool>
+void RunContentionBench( const char* name )
+{
+    SContentionCtx<TPool>* ctx = new SContentionCtx<TPool>;
+    ctx->drivers_running = g_contention_threads;
+    ctx->stop = 0;
+    ctx->reset_count = 0;
+    ctx->verified = true;
+    ctx->next_thread = 0;
+
+    for( int j = 0; j < g_contention_threads; ++j )
+    {
+        ctx->latency_ns[j].reserve(g_contention_ops);
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    StartThread( &ContentionResetFunc<TPool>, ctx );
+
+    for( int j = 0; j < g_contention_threads; ++j )
+    {
+        StartThread( &ContentionDriverFunc<TPool>, ctx );
+    }
+
+    ctx->reset_done.Wait();
+    double elapsed_sec = (double)( MonotonicTimeNs() - t0 ) * 1e-9;
+
+    std::vector<uint32_t> all;
+
+    for( int j = 0; j < g_contention_threads; ++j )
+    {
+        all.insert( all.end(), ctx->latency_ns[j].begin(), ctx->latency_ns[j].end() );
+    }
+
+    std::sort( all.begin(), all.end() );
+    size_t n = all.size();
+
+    printf( "  %-24s p50=%8lu ns, p99=%10lu ns, p99.9=%10lu ns, max=%10lu ns, resets=%lu, %.2f sec%s\n",  name,
+                    (unsigned long)all[n/2],  (unsigned long)all[n*99/100],  (unsigned long)all[n*999/1000],
+                    (unsigned long)all[n-1],  ctx->reset_count,  elapsed_sec,
+                    ( ctx->verified ? "" : " (CORRUPTION)" ) );
+    fflush(stdout);
+
+    delete ctx;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_reset_buffers = 48;  // a deep driver queue of 1080p UYVY frames
+
+// Wall time of ProtectIdle (device release) and FreeIdle (CMemAlloc::Reset) with 'threads' workers. With 'background'
+// the buffers are checked by VerifySome() in between, as the background verifier does during the restart pause.
+static void RunResetBench( int threads, bool background = false )
+{
+    CWorkerPool workers(threads);
+    CBufferPool pool;
+    char* buffers[g_reset_buffers];
+
+    pool.SetWorkers(&workers);
+    pool.SetQuietTime(0);  // no device writing the buffers
+
+    for( int j = 0; j < g_reset_buffers; ++j )
+    {
+        buffers[j] = pool.Allocate( 0, g_bench_buf_size );
+    }
+
+    for( int j = 0; j < g_reset_buffers; ++j )
+    {
+        pool.Release( buffers[j] );
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+    pool.ProtectIdle(0);
+    uint64_t t1 = MonotonicTimeNs();
+
+    if(background)
+    {
+        while( pool.VerifySome( 0, (size_t)1 << 20 ) > 0 );
+    }
+
+    uint64_t t2 = MonotonicTimeNs();
+    bool ok = pool.FreeIdle(0);
+    uint64_t t3 = MonotonicTimeNs();
+
+    printf( "  %2d worker(s) + caller: protect %8.2f ms, background %8.2f ms, verify+free %8.2f ms%s\n",  threads,
+                        (double)( t1 - t0 ) * 1e-6,  (double)( t2 - t1 ) * 1e-6,  (double)( t3 - t2 ) * 1e-6,
+                                                                                ( ok ? "" : "  CORRUPTION!!!" ) );
+    fflush(stdout);
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchBufferPool()
+{
+    printf( "Buffer pool benchmark: %d devices x %d fps x %d sec, buf_size=%lu, queue_depth=%d\n",
+                g_bench_devices, g_bench_fps, g_bench_seconds, (unsigned long)g_bench_buf_size, g_bench_queue_depth );
+    printf( "(time per Release+Allocate pair including the lock)\n\n" );
+
+    SBenchResult old_r = RunBench<CMultimapPool>();
+    printf( "  std::multimap free list: avg=%8.1f ns, max=%10.1f ns\n", old_r.avg_ns, old_r.max_ns );
+
+    SBenchResult new_r = RunBench<CBufferPool>();
+    printf( "  CBufferPool size class:  avg=%8.1f ns, max=%10.1f ns\n", new_r.avg_ns, new_r.max_ns );
+
+    printf( "\n  speedup: %.2fx\n", old_r.avg_ns / new_r.avg_ns );
+    fflush(stdout);
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int BenchBufferPoolContention()
+{
+    printf( "Buffer pool contention benchmark: %d driver threads x %d AllocateBuffer calls, buf_size=%lu, "
+                "queue_depth=%d,\nconcurrent restart thread doing ProtectIdle+FreeIdle back to back\n\n",
+                g_contention_threads, g_contention_ops, (unsigned long)g_bench_buf_size, g_contention_queue_depth );
+
+    RunContentionBench<CLockedPool>("mutex (former CMemAlloc):");
+    RunContentionBench<CBufferPool>("lock-free CBufferPool:");
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int BenchBufferPoolReset()
+{
+    int max_threads = (int)CpuCount() - 1;
+
+    printf( "Buffer pool reset benchmark: %d buffers x %lu bytes, up to %d workers\n",
+                                                    g_reset_buffers, (unsigned long)g_bench_buf_size, max_threads );
+
+    const char* kernels[] = { MemPatternKernelName(), "scalar" };
+
+    for( int k = 0; k < 2; ++k )
+    {
+        MemPatternSetKernel( kernels[k] );
+        printf( "\n guard pattern kernel: %s\n", kernels[k] );
+
+        for( int threads = 0; threads <= max_threads; threads = ( threads == 0 ? 1 : threads*2 ) )
+        {
+            RunResetBench(threads);
+        }
+
+        if(  max_threads > 0  &&  ( max_threads & ( max_threads - 1 ) ) != 0  )
+        {
+            RunResetBench(max_threads);
+        }
+    }
+
+    printf( "\n incremental background verification (CBufferPool::VerifySome), kernel: %s\n", kernels[0] );
+    MemPatternSetKernel( kernels[0] );
+    RunResetBench( max_threads, true );
+    return 0;
+}
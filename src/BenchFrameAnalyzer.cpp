@@ -0,0 +1,231 @@
+#include <Bench.h>
+#include <FrameAnalyzer.h>
+#include <MemUtils.h>
+#include <PixelConvert.h>
+#include <utils.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+struct SBenchSize
+{
+    const char*  name;
+    unsigned  width, height;
+    unsigned  row_pad;  // row bytes beyond the pixel format needs
+    bool  timed;  // false - correctness check only
+};
+
+// The last one ends in a partial block column and a partial band, and has padded rows.
+static const SBenchSize g_bench_sizes[] =
+{
+    { "1080", 1920, 1080, 0, true },
+    { "2160", 3840, 2160, 0, true },
+    { "odd",  1926,   53, 64, false },
+};
+
+static const BMDPixelFormat g_bench_formats[] = { bmdFormat8BitYUV, bmdFormat10BitYUV };
+static const char* const g_bench_kernels[] = { "scalar", "sse2", "avx2" };
+
+static const size_t g_bench_bytes = 64 << 20;  // source frames cycled through, more than the caches hold
+static const int g_bench_repeats = 240;
+static const double g_bench_budget_ms = 1.0;  // per 1080p frame on one core
+
+//---------------------------------------------------------------------------------------------------------------------
+// Straightforward luma of pixel 'x' on the 8-bit scale, for the reference sums.
+static unsigned ReferenceLuma( BMDPixelFormat format, const uint8_t* row, unsigned x )
+{
+    if( format == bmdFormat8BitYUV )
+    {
+        return row[ 2*x + 1 ];
+    }
+
+    // Y0 word 0 bits 10-19, Y1 word 1 bits 0-9, Y2 word 1 bits 20-29, Y3 word 2 bits 10-19, Y4 and Y5 word 3.
+    static const unsigned word[6] = { 0, 1, 1, 2, 3, 3 };
+    static const unsigned shift[6] = { 10, 0, 20, 10, 0, 20 };
+    const uint32_t* w = (const uint32_t*)( row + x/6*16 );
+    return ( ( w[ word[x%6] ] >> shift[x%6] ) & 0x3ff ) >> 2;
+}
+
+static void ReferenceAnalyze( BMDPixelFormat format, const uint8_t* src, size_t row_bytes, unsigned width,
+                                    unsigned height, unsigned row_step, uint32_t* blocks, SFrameLuma* luma )
+{
+    size_t columns = ( width + g_analyze_block_width - 1 ) / g_analyze_block_width;
+    memset( blocks, 0, FrameAnalyzeBlockCount( width, height, row_step ) * sizeof(uint32_t) );
+    memset( luma, 0, sizeof(*luma) );
+
+    for( unsigned r = 0, j = 0; r < height; r += row_step, ++j )
+    {
+        for( unsigned x = 0; x < width; ++x )
+        {
+            unsigned y = ReferenceLuma( format, src + r * row_bytes, x );
+            blocks[ j / g_analyze_block_rows * columns + x / g_analyze_block_width ] += y;
+            luma->sum += y;
+            luma->sum_sq += y * y;
+            ++luma->count;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Milliseconds per frame of 'repeats' analyses cycling through 'count' frames, checks the sums of the first frame
+// against the reference.
+static double Measure( BMDPixelFormat format, const SBenchSize& s, uint8_t* const* frames, int count,
+                                                                            unsigned row_step, int repeats, bool* ok )
+{
+    size_t row_bytes = PixelFormatRowBytes( format, s.width ) + s.row_pad;
+    size_t block_count = FrameAnalyzeBlockCount( s.width, s.height, row_step );
+    std::vector<uint32_t> blocks(block_count), ref_blocks(block_count);
+    std::vector<uint8_t> scratch( FrameAnalyzeScratchSize(s.width) );
+    SFrameLuma luma, ref;
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int j = 0; j < repeats; ++j )
+    {
+        FrameAnalyze( format, frames[ j % count ], row_bytes, s.width, s.height, row_step, &scratch[0], &blocks[0],
+                                                                                                            &luma );
+    }
+
+    uint64_t t1 = MonotonicTimeNs();
+
+    FrameAnalyze( format, frames[0], row_bytes, s.width, s.height, row_step, &scratch[0], &blocks[0], &luma );
+    ReferenceAnalyze( format, frames[0], row_bytes, s.width, s.height, row_step, &ref_blocks[0], &ref );
+
+    *ok = (  blocks == ref_blocks  &&  luma.count == ref.count  &&  luma.sum == ref.sum  &&
+                                                                                    luma.sum_sq == ref.sum_sq  );
+    return  ( t1 - t0 ) * 1e-6 / repeats;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// A frame against itself differs by nothing, against a copy with the luma of a 96x64 corner changed by more than the
+// freeze threshold.
+static bool CheckBlockDiff( BMDPixelFormat format, const SBenchSize& s, const uint8_t* frame, uint8_t* copy )
+{
+    size_t row_bytes = PixelFormatRowBytes( format, s.width ) + s.row_pad;
+    size_t block_count = FrameAnalyzeBlockCount( s.width, s.height, 1 );
+    std::vector<uint32_t> a(block_count), b(block_count);
+    std::vector<uint8_t> scratch( FrameAnalyzeScratchSize(s.width) );
+    SFrameLuma luma;
+
+    memcpy( copy, frame, row_bytes * s.height );
+
+    // Every sample loses its top bit and gains a quarter of the range, so none wraps around.
+    for( unsigned r = 0; r < 64  &&  r < s.height; ++r )
+    {
+        uint8_t* p = copy + r * row_bytes;
+
+        for( unsigned x = 0; x < 96; ++x )
+        {
+            if( format == bmdFormat8BitYUV )
+            {
+                p[ 2*x + 1 ] = (uint8_t)( p[ 2*x + 1 ] & 0x7f ) + 32;
+            }
+            else if( x % 6 == 0 )
+            {
+                uint32_t* w = (uint32_t*)( p + x/6*16 );
+
+                for( int k = 0; k < 4; ++k )
+                {
+                    w[k] = ( w[k] & 0x1ff7fdff ) + 0x08020080;
+                }
+            }
+        }
+    }
+
+    FrameAnalyze( format, frame, row_bytes, s.width, s.height, 1, &scratch[0], &a[0], &luma );
+    double same = FrameBlockDiff( &a[0], &a[0], s.width, s.height, 1 );
+    FrameAnalyze( format, copy, row_bytes, s.width, s.height, 1, &scratch[0], &b[0], &luma );
+    double changed = FrameBlockDiff( &a[0], &b[0], s.width, s.height, 1 );
+
+    return  same == 0.0  &&  changed > SAnalyzeParams().freeze_diff;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchFrameAnalyzer()
+{
+    const char* default_kernel = FrameAnalyzeKernelName();
+    unsigned default_step = SAnalyzeParams().row_step;
+    int result = 0;
+
+    printf( "Frame analyzer benchmark: luma mean/variance and block signatures, ms/frame on one core per kernel for"
+                " every row and every %u rows, %.1f ms budget per 1080p frame (default kernel: %s)\n", default_step,
+                g_bench_budget_ms, default_kernel );
+
+    for( size_t n = 0; n < sizeof(g_bench_sizes)/sizeof(g_bench_sizes[0]); ++n )
+    {
+        const SBenchSize& s = g_bench_sizes[n];
+
+        for( size_t f = 0; f < sizeof(g_bench_formats)/sizeof(g_bench_formats[0]); ++f )
+        {
+            BMDPixelFormat format = g_bench_formats[f];
+            size_t frame_size = ( PixelFormatRowBytes( format, s.width ) + s.row_pad ) * s.height;
+            int count = ( s.timed ? (int)( g_bench_bytes / frame_size ) + 1 : 1 );
+            int repeats = ( s.timed ? g_bench_repeats : 1 );
+            std::vector<uint8_t*> frames(count);
+            uint32_t x = 0x12345678;
+
+            for( int j = 0; j < count; ++j )
+            {
+                frames[j] = (uint8_t*)MemAlloc( 0, frame_size );
+
+                for( size_t k = 0; k < frame_size; ++k )
+                {
+                    x = x * 1664525 + 1013904223;
+                    frames[j][k] = (uint8_t)( x >> 24 );
+                }
+            }
+
+            printf( "\n%s %ux%u %s%s:\n", s.name, s.width, s.height, PixelFormatName(format),
+                                                                    ( s.timed ? "" : " (correctness only)" ) );
+
+            for( size_t k = 0; k < sizeof(g_bench_kernels)/sizeof(g_bench_kernels[0]); ++k )
+            {
+                if( !FrameAnalyzeSetKernel( g_bench_kernels[k] ) )
+                {
+                    printf( "  %-8s not supported by the CPU\n", g_bench_kernels[k] );
+                    continue;
+                }
+
+                bool ok_all, ok_step;
+                double ms_all = Measure( format, s, &frames[0], count, 1, repeats, &ok_all );
+                double ms_step = Measure( format, s, &frames[0], count, default_step, repeats, &ok_step );
+                bool ok = (  ok_all  &&  ok_step  );
+                printf( "  %-8s", g_bench_kernels[k] );
+
+                if( s.timed )
+                {
+                    printf( " every row %6.3f ms, every %u rows %6.3f ms", ms_all, default_step, ms_step );
+
+                    if(  strcmp( s.name, "1080" ) == 0  &&  strcmp( g_bench_kernels[k], default_kernel ) == 0  )
+                    {
+                        printf( "  (%s budget)", ( ms_step <= g_bench_budget_ms ? "within" : "OVER" ) );
+                    }
+                }
+
+                printf( "%s\n", ( !ok ? "  MISMATCH!!!" : s.timed ? "" : "  ok" ) );
+                result = ( ok ? result : 1 );
+                fflush(stdout);
+            }
+
+            FrameAnalyzeSetKernel(default_kernel);
+
+            uint8_t* copy = (uint8_t*)MemAlloc( 0, frame_size );
+            bool ok = CheckBlockDiff( format, s, frames[0], copy );
+            printf( "  block diff %s\n", ( ok ? "ok" : "MISMATCH!!!" ) );
+            result = ( ok ? result : 1 );
+            MemFree(copy);
+
+            for( int j = 0; j < count; ++j )
+            {
+                MemFree( frames[j] );
+            }
+        }
+    }
+
+    return result;
+}
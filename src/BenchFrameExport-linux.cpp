@@ -0,0 +1,223 @@
+#include <Bench.h>
+#include <FrameExport.h>
+#include <FrameReader.h>
+#include <Histogram.h>
+#include <MemArena.h>
+#include <MemUtils.h>
+#include <utils.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_bench_index = 16;  // arena and export name of no real device
+static const int g_bench_readers = 2;  // processes
+static const int g_bench_frames = 600;
+static const int g_bench_buffers = g_export_capacity + 4;  // one is always free
+static const unsigned g_bench_period_us = 4167;  // 240 fps
+static const size_t g_bench_frame_size = 1920*1080*2;  // 1080p UYVY
+static const unsigned g_bench_poll_us[] = { 0, 50, 500 };
+
+//---------------------------------------------------------------------------------------------------------------------
+// Result of a reader process, in memory shared with the parent.
+struct SReaderResult
+{
+    CHistogram  latency_ns;  // VideoInputFrameArrived (Publish) to Next() in the reader
+    uint32_t  frames;
+    uint32_t  data_errors;  // the frame markers do not match the descriptor
+    uint32_t  revoked;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// A captured frame: the buffer is in use until the last reference is released.
+class CBenchFrame : public IUnknown
+{
+    volatile int32_t  ref_count;
+
+public:
+    char*  buffer;
+
+    CBenchFrame() : ref_count(0), buffer(NULL)  {}
+
+    bool Busy() const  { return ref_count != 0; }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID /*iid*/, LPVOID* ppv )
+    {
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return (ULONG)( Int32AtomicAdd( &ref_count, 1 ) + 1 ); }
+    virtual ULONG STDMETHODCALLTYPE Release()  { return (ULONG)( Int32AtomicAdd( &ref_count, -1 ) - 1 ); }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static void ReaderProcess( const char* name, unsigned poll_us, SReaderResult* result )
+{
+    CFrameReader reader;
+    reader.SetPollPeriod(poll_us);
+
+    if( !reader.Open(name) )
+    {
+        return;
+    }
+
+    while( const SExportFrame* f = reader.Next(2000) )
+    {
+        uint64_t latency = MonotonicTimeNs() - f->arrived_ns;
+        const uint32_t* p = (const uint32_t*)reader.Data(*f);
+
+        if(  p[0] != (uint32_t)f->seq  ||  p[ f->size/sizeof(uint32_t) - 1 ] != (uint32_t)f->seq  )
+        {
+            ++result->data_errors;
+        }
+
+        if( !reader.Valid(*f) )
+        {
+            ++result->revoked;
+        }
+
+        reader.Ack(*f);
+        result->latency_ns.Record(latency);
+        ++result->frames;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Forks the readers (the export is open by then), publishes g_bench_frames frames at 240 fps, closes the export and
+// collects the results.
+static bool RunBench( unsigned poll_us, CBenchFrame* frames, SReaderResult* results )
+{
+    char name[32];
+    snprintf( name, sizeof(name), "/cct-export-dev%d", g_bench_index );
+    CFrameExporter exporter;
+
+    if( !exporter.Open( g_bench_index, SThreadPlacement() ) )
+    {
+        return false;
+    }
+
+    pid_t pids[g_bench_readers];
+
+    for( int j = 0; j < g_bench_readers; ++j )
+    {
+        new( &results[j] ) SReaderResult();
+        fflush(stdout);
+        pids[j] = fork();
+
+        if( pids[j] == 0 )
+        {
+            ReaderProcess( name, poll_us, &results[j] );
+            _exit(0);
+        }
+    }
+
+    for(  int k = 0;  k < 500  &&  exporter.ReaderCount() < g_bench_readers;  ++k  )
+    {
+        WaitMs(10);
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int k = 0; k < g_bench_frames; ++k )
+    {
+        while( MonotonicTimeNs() - t0 < (uint64_t)k * g_bench_period_us * 1000 );
+
+        CBenchFrame* frame = frames;
+
+        while( frame->Busy() )
+        {
+            ++frame;
+        }
+
+        // The markers the readers check, the rest of the frame stands for the DMA.
+        uint32_t* p = (uint32_t*)frame->buffer;
+        p[0] = (uint32_t)k;
+        p[ g_bench_frame_size/sizeof(uint32_t) - 1 ] = (uint32_t)k;
+
+        SExportFrame f;
+        memset( &f, 0, sizeof(f) );
+        f.width = 1920;
+        f.height = 1080;
+        f.row_bytes = 1920*2;
+        f.size = (uint32_t)g_bench_frame_size;
+        f.pixel_format = bmdFormat8BitYUV;
+        f.stream_time = (int64_t)k * 1000;
+        f.duration = 1000;
+
+        frame->AddRef();
+        f.arrived_ns = MonotonicTimeNs();
+        exporter.Publish( frame->buffer, f, frame );
+        frame->Release();
+    }
+
+    exporter.PrintStats();
+    exporter.Close();
+
+    for( int j = 0; j < g_bench_readers; ++j )
+    {
+        waitpid( pids[j], NULL, 0 );
+
+        const CHistogram& h = results[j].latency_ns;
+        printf( "  poll %3u us  reader %d: %4u frames, latency p50=%6.1f us, p99=%6.1f us, p99.9=%6.1f us,"
+                            " max=%7.1f us, data_errors=%u, revoked=%u\n", poll_us, j, results[j].frames,
+                            h.Percentile(0.5) * 1e-3, h.Percentile(0.99) * 1e-3, h.Percentile(0.999) * 1e-3,
+                            h.Max() * 1e-3, results[j].data_errors, results[j].revoked );
+    }
+
+    fflush(stdout);
+    return true;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchFrameExport()
+{
+    EMemArenaMode saved_mode = MemArenaGetMode();
+    bool saved_shared = MemArenaGetShared();
+    MemArenaSetMode(MemArenaPages);
+    MemArenaSetShared(true);
+
+    void* p = mmap( NULL, sizeof(SReaderResult) * g_bench_readers, PROT_READ | PROT_WRITE,
+                                                                            MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+    if( p == MAP_FAILED )
+    {
+        fprintf( stderr, "BenchFrameExport: mmap failed: %s\n", strerror(errno) );
+        return 1;
+    }
+
+    static CBenchFrame frames[g_bench_buffers];
+
+    for( int j = 0; j < g_bench_buffers; ++j )
+    {
+        frames[j].buffer = (char*)MemAlloc( g_bench_index, g_bench_frame_size );
+        memset( frames[j].buffer, 0x80, g_bench_frame_size );
+    }
+
+    printf( "Frame export benchmark: %d reader processes, %d frames x %lu bytes at %.0f fps, callback (Publish) to"
+                    " reader latency\n\n", g_bench_readers, g_bench_frames, (unsigned long)g_bench_frame_size,
+                    1e6 / g_bench_period_us );
+
+    int exit_code = 0;
+
+    for(  size_t j = 0;  j < sizeof(g_bench_poll_us)/sizeof(g_bench_poll_us[0])  &&  exit_code == 0;  ++j  )
+    {
+        exit_code = ( RunBench( g_bench_poll_us[j], frames, (SReaderResult*)p ) ? 0 : 1 );
+    }
+
+    for( int j = 0; j < g_bench_buffers; ++j )
+    {
+        MemFree( frames[j].buffer );
+    }
+
+    munmap( p, sizeof(SReaderResult) * g_bench_readers );
+    MemArenaSetShared(saved_shared);
+    MemArenaSetMode(saved_mode);
+    return exit_code;
+}
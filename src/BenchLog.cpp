@@ -0,0 +1,126 @@
+#include <Bench.h>
+#include <Log.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_log_threads = 8;  // callback threads of 8 devices
+static const int g_log_bursts = 200;
+static const int g_log_burst_events = 16;  // messages of one callback burst, then the thread sleeps 1 ms
+
+static FILE* g_log_out = NULL;
+
+//---------------------------------------------------------------------------------------------------------------------
+// A line of the VideoInputFrameArrived size, written through to a temporary file.
+static void FormatBenchRecord( const SLogRecord& r )
+{
+    fprintf( g_log_out, "[%d] CInputCallback::VideoInputFrameArrived: signal started - video_time=%lld/240000, "
+                        "audio_time=%lld/240000\n",  r.index,  (long long)r.args[0],  (long long)r.args[1] );
+    fflush(g_log_out);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+struct SLogBenchCtx
+{
+    std::vector<uint32_t>  latency_ns[g_log_threads];
+    volatile int32_t  next_thread;
+    volatile int32_t  running;
+    CWaitableCondition  done;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static void LogBenchThreadFunc( void* p )
+{
+    SLogBenchCtx& ctx = *(SLogBenchCtx*)p;
+    int index = Int32AtomicAdd( &ctx.next_thread, 1 );
+    std::vector<uint32_t>& latency = ctx.latency_ns[index];
+
+    for( int j = 0; j < g_log_bursts; ++j )
+    {
+        for( int k = 0; k < g_log_burst_events; ++k )
+        {
+            uint64_t t0 = MonotonicTimeNs();
+            LogEvent( index, 0, j*4004, j*4004 + k );
+            latency.push_back( (uint32_t)( MonotonicTimeNs() - t0 ) );
+        }
+
+        WaitMs(1);
+    }
+
+    if( Int32AtomicAdd( &ctx.running, -1 ) == 1 )
+    {
+        ctx.done.SetTrue();
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void RunLogBench( const char* name )
+{
+    SLogBenchCtx* ctx = new SLogBenchCtx;
+    ctx->next_thread = 0;
+    ctx->running = g_log_threads;
+
+    for( int j = 0; j < g_log_threads; ++j )
+    {
+        ctx->latency_ns[j].reserve( g_log_bursts * g_log_burst_events );
+    }
+
+    uint32_t dropped = LogDropCount();
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int j = 0; j < g_log_threads; ++j )
+    {
+        StartThread( &LogBenchThreadFunc, ctx );
+    }
+
+    ctx->done.Wait();
+    LogFlush();
+    double elapsed_sec = (double)( MonotonicTimeNs() - t0 ) * 1e-9;
+
+    std::vector<uint32_t> all;
+
+    for( int j = 0; j < g_log_threads; ++j )
+    {
+        all.insert( all.end(), ctx->latency_ns[j].begin(), ctx->latency_ns[j].end() );
+    }
+
+    std::sort( all.begin(), all.end() );
+    size_t n = all.size();
+
+    printf( "  %-8s p50=%8lu ns, p99=%8lu ns, p99.9=%8lu ns, max=%8lu ns, dropped=%lu, %.2f sec\n",  name,
+                    (unsigned long)all[n/2],  (unsigned long)all[n*99/100],  (unsigned long)all[n*999/1000],
+                    (unsigned long)all[n-1],  (unsigned long)( LogDropCount() - dropped ),  elapsed_sec );
+    fflush(stdout);
+
+    delete ctx;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchLog()
+{
+    g_log_out = tmpfile();
+
+    if( g_log_out == NULL )
+    {
+        printf( "Log benchmark: a temporary file could not be created.\n" );
+        return 1;
+    }
+
+    printf( "Callback log latency: %d threads x %d bursts of %d messages, 1 ms apart (written to a temporary file)\n",
+                                                                g_log_threads, g_log_bursts, g_log_burst_events );
+
+    // The synchronous run goes first, LogStart() can start the writer thread only once.
+    LogStart( &FormatBenchRecord, true );
+    RunLogBench("printf");
+
+    LogStart( &FormatBenchRecord, false );
+    RunLogBench("ring");
+
+    fclose(g_log_out);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <Bench.h>
+#include <MemArena.h>
+#include <MemUtils.h>
+#include <utils.h>
+#include <stdio.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_bench_frames = 8;  // driver queue depth of one device
+static const int g_bench_rounds = 20;  // restart cycles: allocate, capture, free
+static const size_t g_bench_frame_size = 3840*2160*2;  // 4K UHD UYVY
+static const int g_bench_random_reads = 1 << 18;  // per frame
+
+static volatile uint32_t g_bench_sink;  // keeps the reads from being optimized out
+
+//---------------------------------------------------------------------------------------------------------------------
+// Allocates a queue of frames, emulates the DMA write of every frame and scattered reads of a consumer, frees the
+// frames; repeated g_bench_rounds times.
+static void RunBench( EMemArenaMode mode )
+{
+    MemArenaSetMode(mode);
+
+    SMemCounters c0, c1;
+    char* frames[g_bench_frames];
+    uint32_t x = 1, sum = 0;
+
+    MemCountersRead(&c0);
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int r = 0; r < g_bench_rounds; ++r )
+    {
+        for( int j = 0; j < g_bench_frames; ++j )
+        {
+            frames[j] = (char*)MemAlloc( (int)mode, g_bench_frame_size );
+
+            uint32_t* p = (uint32_t*)frames[j];
+            uint32_t* p1 = p + g_bench_frame_size/sizeof(uint32_t);
+
+            for( ; p < p1; ++p )
+            {
+                *p = 0x10801080U;
+            }
+        }
+
+        for( int j = 0; j < g_bench_frames; ++j )
+        {
+            const uint32_t* p = (const uint32_t*)frames[j];
+
+            for( int k = 0; k < g_bench_random_reads; ++k )
+            {
+                x = x*1664525U + 1013904223U;
+                sum += p[ ( x >> 8 ) % ( g_bench_frame_size/sizeof(uint32_t) ) ];
+            }
+        }
+
+        for( int j = 0; j < g_bench_frames; ++j )
+        {
+            MemFree( frames[j] );
+        }
+    }
+
+    double elapsed_sec = (double)( MonotonicTimeNs() - t0 ) * 1e-9;
+    MemCountersRead(&c1);
+
+    printf( "  %-8s %8.1f ms, write %6.2f GB/s, minor_faults=%9llu, major_faults=%4llu, dtlb_misses=",
+                        MemArenaModeName(mode),  elapsed_sec*1000.0,
+                        (double)g_bench_frame_size*g_bench_frames*g_bench_rounds / elapsed_sec * 1e-9,
+                        (unsigned long long)( c1.minor_faults - c0.minor_faults ),
+                        (unsigned long long)( c1.major_faults - c0.major_faults )  );
+
+    if( c1.has_dtlb )
+    {
+        printf( "%llu", (unsigned long long)( c1.dtlb_misses - c0.dtlb_misses ) );
+    }
+    else
+    {
+        printf( "n/a" );
+    }
+
+    printf("\n");
+    fflush(stdout);
+
+    g_bench_sink = sum;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchMemArena()
+{
+    MemCountersInit();
+
+    printf( "Frame buffer arena benchmark: %d rounds x %d frames x %lu bytes, %d random reads per frame\n\n",
+                    g_bench_rounds, g_bench_frames, (unsigned long)g_bench_frame_size, g_bench_random_reads );
+
+    EMemArenaMode saved_mode = MemArenaGetMode();
+
+    for( int mode = 0; mode < MemArenaModeCount; ++mode )
+    {
+        RunBench( (EMemArenaMode)mode );
+    }
+
+    MemArenaSetMode(saved_mode);
+    return 0;
+}
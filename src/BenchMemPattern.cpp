@@ -0,0 +1,139 @@
+#include <Bench.h>
+#include <MemFingerprint.h>
+#include <MemPattern.h>
+#include <MemUtils.h>
+#include <utils.h>
+#include <stdio.h>
+#include <string.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const size_t g_bench_buf_size = 10240*2160;  // 4K UHD v210
+static const int g_bench_repeats = 10;
+
+static const char* const g_bench_kernels[] = { "scalar", "sse2", "avx2", "avx512" };
+
+static const unsigned g_bench_sample_lines[] = { 0, 16, 4, 1 };
+
+//---------------------------------------------------------------------------------------------------------------------
+// Release (fingerprint) and reuse (fingerprint again, in two halves as the background verifier would) of a buffer
+// with the given number of sampled lines per page, GB/s of buffer size.
+static bool BenchFingerprint( const char* buf, unsigned sample_lines )
+{
+    bool ok = true;
+    uint64_t t0 = MonotonicTimeNs();
+    uint32_t expected = 0;
+
+    for( int j = 0; j < g_bench_repeats; ++j )
+    {
+        SMemFingerprint f;
+        MemFingerprintInit( &f, sample_lines, (uint32_t)j );
+        MemFingerprintUpdate( &f, buf, g_bench_buf_size, g_bench_buf_size );
+        expected ^= MemFingerprintValue(&f);
+    }
+
+    uint64_t t1 = MonotonicTimeNs();
+
+    for( int j = 0; j < g_bench_repeats; ++j )
+    {
+        SMemFingerprint f;
+        MemFingerprintInit( &f, sample_lines, (uint32_t)j );
+        MemFingerprintUpdate( &f, buf, g_bench_buf_size, g_bench_buf_size/2 );
+        MemFingerprintUpdate( &f, buf, g_bench_buf_size, g_bench_buf_size );
+        expected ^= MemFingerprintValue(&f);
+    }
+
+    uint64_t t2 = MonotonicTimeNs();
+
+    ok = ( expected == 0 );
+    double bytes = (double)g_bench_buf_size * g_bench_repeats;
+
+    if( sample_lines == 0 )
+    {
+        printf( "  %-8s release %7.2f GB/s, verify %7.2f GB/s%s\n",  "hash",
+                    bytes / (double)( t1 - t0 ),  bytes / (double)( t2 - t1 ),  ( ok ? "" : "  MISMATCH!!!" ) );
+    }
+    else
+    {
+        printf( "  sampled, %2u lines/page: release %7.2f GB/s, verify %7.2f GB/s%s\n",  sample_lines,
+                    bytes / (double)( t1 - t0 ),  bytes / (double)( t2 - t1 ),  ( ok ? "" : "  MISMATCH!!!" ) );
+    }
+
+    fflush(stdout);
+    return ok;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchMemPattern()
+{
+    printf( "Guard pattern benchmark: buf_size=%lu, %d repeats (default kernel: %s)\n\n",
+                                            (unsigned long)g_bench_buf_size, g_bench_repeats, MemPatternKernelName() );
+
+    char* ref = (char*)MemAlloc( 0, g_bench_buf_size );
+    char* buf = (char*)MemAlloc( 0, g_bench_buf_size );
+    const char* default_kernel = MemPatternKernelName();
+    int result = 0;
+
+    MemPatternSetKernel("scalar");
+    MemPatternFill( ref, g_bench_buf_size );
+
+    for( size_t k = 0; k < sizeof(g_bench_kernels)/sizeof(g_bench_kernels[0]); ++k )
+    {
+        if( !MemPatternSetKernel( g_bench_kernels[k] ) )
+        {
+            printf( "  %-8s not supported by the CPU\n", g_bench_kernels[k] );
+            continue;
+        }
+
+        memset( buf, 0, g_bench_buf_size );
+        bool ok = true;
+
+        uint64_t t0 = MonotonicTimeNs();
+
+        for( int j = 0; j < g_bench_repeats; ++j )
+        {
+            MemPatternFill( buf, g_bench_buf_size );
+        }
+
+        uint64_t t1 = MonotonicTimeNs();
+
+        for( int j = 0; j < g_bench_repeats; ++j )
+        {
+            ok &= MemPatternVerify( 0, buf, g_bench_buf_size );
+        }
+
+        uint64_t t2 = MonotonicTimeNs();
+
+        ok &= ( memcmp( ref, buf, g_bench_buf_size ) == 0 );
+        double bytes = (double)g_bench_buf_size * g_bench_repeats;
+
+        printf( "  %-8s fill %7.2f GB/s, verify %7.2f GB/s%s\n",  g_bench_kernels[k],
+                    bytes / (double)( t1 - t0 ),  bytes / (double)( t2 - t1 ),  ( ok ? "" : "  MISMATCH!!!" ) );
+        fflush(stdout);
+
+        if( !ok )
+        {
+            result = 1;
+        }
+    }
+
+    MemPatternSetKernel(default_kernel);
+
+    printf( "\nFingerprints instead of the pattern (%s), nothing is written to the buffer:\n",
+                                                                                        MemFingerprintKernelName() );
+
+    for( size_t k = 0; k < sizeof(g_bench_sample_lines)/sizeof(g_bench_sample_lines[0]); ++k )
+    {
+        if( !BenchFingerprint( buf, g_bench_sample_lines[k] ) )
+        {
+            result = 1;
+        }
+    }
+
+    MemFree(buf);
+    MemFree(ref);
+    return result;
+}
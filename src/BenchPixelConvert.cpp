@@ -0,0 +1,190 @@
+#include <Bench.h>
+#include <MemUtils.h>
+#include <PixelConvert.h>
+#include <WorkerPool.h>
+#include <utils.h>
+#include <stdio.h>
+#include <string.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+struct SBenchSize
+{
+    const char*  name;
+    unsigned  width, height;
+    unsigned  row_pad;  // source row bytes beyond width*2
+    bool  timed;  // false - correctness check only
+};
+
+// The last one is odd in every way the kernels care about: block tails, an odd last row and padded source rows.
+static const SBenchSize g_bench_sizes[] =
+{
+    { "SD",    720,  486, 0, true },
+    { "1080", 1920, 1080, 0, true },
+    { "2160", 3840, 2160, 0, true },
+    { "odd",  1926,   11, 36, false },
+};
+
+static const char* const g_bench_kernels[] = { "scalar", "ssse3", "avx2" };
+
+static const uint64_t g_bench_pixels = 1920*1080*48;  // converted per measurement, whatever the frame size
+
+//---------------------------------------------------------------------------------------------------------------------
+// Straightforward per-pixel conversion the kernels are checked against.
+static void ReferenceConvert( EPixelLayout layout, const uint8_t* src, size_t row_bytes, unsigned width,
+                                                                                unsigned height, uint8_t* dst )
+{
+    unsigned cw = width/2;
+    unsigned ch = ( layout == PixelLayoutYuv422p ? height : ( height + 1 ) / 2 );
+    uint8_t* u = dst + (size_t)width * height;
+    uint8_t* v = u + (size_t)cw * ch;
+
+    for( unsigned r = 0; r < height; ++r )
+    {
+        for( unsigned x = 0; x < width; ++x )
+        {
+            dst[ (size_t)r * width + x ] = src[ r * row_bytes + 2*x + 1 ];
+        }
+    }
+
+    for( unsigned r = 0; r < ch; ++r )
+    {
+        for( unsigned x = 0; x < cw; ++x )
+        {
+            const uint8_t* a;
+            const uint8_t* b;
+
+            if( layout == PixelLayoutYuv422p )
+            {
+                a = b = src + r * row_bytes + 4*x;
+            }
+            else
+            {
+                a = src + ( 2*r ) * row_bytes + 4*x;
+                b = ( 2*r + 1 < height ? a + row_bytes : a );
+            }
+
+            uint8_t cu = (uint8_t)( ( a[0] + b[0] + 1 ) / 2 );
+            uint8_t cv = (uint8_t)( ( a[2] + b[2] + 1 ) / 2 );
+
+            if( layout == PixelLayoutNv12 )
+            {
+                u[ (size_t)r * width + 2*x ] = cu;
+                u[ (size_t)r * width + 2*x + 1 ] = cv;
+            }
+            else
+            {
+                u[ (size_t)r * cw + x ] = cu;
+                v[ (size_t)r * cw + x ] = cv;
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Frames per second of 'repeats' conversions, checks the last one against 'ref'.
+static double Measure( EPixelLayout layout, const SBenchSize& s, const uint8_t* src, uint8_t* dst, const uint8_t* ref,
+                                                        CWorkerPool* workers, unsigned slices, int repeats, bool* ok )
+{
+    size_t size = PixelLayoutSize( layout, s.width, s.height );
+    size_t row_bytes = (size_t)s.width * 2 + s.row_pad;
+    memset( dst, 0, size );
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int j = 0; j < repeats; ++j )
+    {
+        PixelConvert( layout, src, row_bytes, s.width, s.height, dst, workers, slices );
+    }
+
+    uint64_t t1 = MonotonicTimeNs();
+
+    *ok = ( memcmp( dst, ref, size ) == 0 );
+    return  repeats * 1e9 / (double)( t1 - t0 );
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchPixelConvert()
+{
+    CWorkerPool& workers = CWorkerPool::Shared();
+    unsigned threads = (unsigned)workers.ThreadCount() + 1;
+    const char* default_kernel = PixelConvertKernelName();
+    int result = 0;
+
+    printf( "UYVY to planar conversion benchmark: frames/s on one core per kernel, then sliced on %u threads"
+                                                            " (default kernel: %s)\n", threads, default_kernel );
+
+    for( size_t n = 0; n < sizeof(g_bench_sizes)/sizeof(g_bench_sizes[0]); ++n )
+    {
+        const SBenchSize& s = g_bench_sizes[n];
+        size_t row_bytes = (size_t)s.width * 2 + s.row_pad;
+        size_t src_size = row_bytes * s.height;
+        size_t dst_size = PixelLayoutSize( PixelLayoutYuv422p, s.width, s.height );  // the largest layout
+        int repeats = ( s.timed ? (int)( g_bench_pixels / ( (uint64_t)s.width * s.height ) ) : 1 );
+
+        uint8_t* src = (uint8_t*)MemAlloc( 0, src_size );
+        uint8_t* dst = (uint8_t*)MemAlloc( 0, dst_size );
+        uint8_t* ref = (uint8_t*)MemAlloc( 0, dst_size );
+        uint32_t x = 0x12345678;
+
+        for( size_t j = 0; j < src_size; ++j )
+        {
+            x = x * 1664525 + 1013904223;
+            src[j] = (uint8_t)( x >> 24 );
+        }
+
+        printf( "\n%s %ux%u%s:\n", s.name, s.width, s.height, ( s.timed ? "" : " (correctness only)" ) );
+
+        for( int layout = 0; layout < PixelLayoutCount; ++layout )
+        {
+            EPixelLayout l = (EPixelLayout)layout;
+            ReferenceConvert( l, src, row_bytes, s.width, s.height, ref );
+
+            for( size_t k = 0; k < sizeof(g_bench_kernels)/sizeof(g_bench_kernels[0]); ++k )
+            {
+                if( !PixelConvertSetKernel( g_bench_kernels[k] ) )
+                {
+                    printf( "  %-8s not supported by the CPU\n", g_bench_kernels[k] );
+                    continue;
+                }
+
+                bool ok;
+                double fps = Measure( l, s, src, dst, ref, NULL, 1, repeats, &ok );
+                printf( "  %-8s %-8s", g_bench_kernels[k], PixelLayoutName(l) );
+
+                if( s.timed )
+                {
+                    printf( " %8.1f frames/s", fps );
+                }
+
+                printf( "%s\n", ( !ok ? "  MISMATCH!!!" : s.timed ? "" : "  ok" ) );
+                result = ( ok ? result : 1 );
+            }
+
+            PixelConvertSetKernel(default_kernel);
+
+            // A few slices even without workers, so the slice edges are checked on any machine.
+            bool ok;
+            double fps = Measure( l, s, src, dst, ref, &workers, ( s.timed ? threads : 3 ), repeats, &ok );
+            printf( "  %-8s %-8s", "sliced", PixelLayoutName(l) );
+
+            if( s.timed )
+            {
+                printf( " %8.1f frames/s, %8.1f frames/s per core", fps, fps / threads );
+            }
+
+            printf( "%s\n", ( !ok ? "  MISMATCH!!!" : s.timed ? "" : "  ok" ) );
+            result = ( ok ? result : 1 );
+            fflush(stdout);
+        }
+
+        MemFree(ref);
+        MemFree(dst);
+        MemFree(src);
+    }
+
+    return result;
+}
@@ -0,0 +1,183 @@
+#include <Bench.h>
+#include <MemArena.h>
+#include <MemUtils.h>
+#include <Recorder.h>
+#include <utils.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_bench_streams = 16;  // devices
+static const int g_bench_frames = 48;  // per stream and write path
+static const int g_bench_file_frames = 8;  // frame records per file, written over cyclically
+static const unsigned g_bench_queue_depth = 16;
+static const size_t g_bench_frame_size = 1920*1080*2;  // 1080p UYVY
+static const double g_bench_fps = 60.0;
+
+//---------------------------------------------------------------------------------------------------------------------
+struct SStream
+{
+    int  index;
+    int  fd;
+    ERecordIo  io;
+    char*  buffers[g_bench_file_frames];
+    volatile int32_t  errors;
+    CWaitableCondition  finished;
+
+    SStream() : index(0), fd(-1), io(RecordIoUring), errors(0)
+    {
+        memset( buffers, 0, sizeof(buffers) );
+    }
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static void WriteDone( void* ctx, void* /*item*/, long result )
+{
+    if( result < 0 )
+    {
+        Int32AtomicAdd( &( (SStream*)ctx )->errors, 1 );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Consumer thread of one device: writes its frames back to back through its own queue.
+static void StreamThreadFunc( void* ctx )
+{
+    SStream& s = *(SStream*)ctx;
+    size_t len = ( g_bench_frame_size + g_record_block - 1 ) / g_record_block * g_record_block;
+
+    {
+        CRecordQueue queue;
+        queue.Start( s.io, g_bench_queue_depth, 4, SThreadPlacement(), &WriteDone, &s );
+        s.io = queue.Io();
+
+        for( int f = 0; f < g_bench_frames; ++f )
+        {
+            int k = f % g_bench_file_frames;
+
+            if( !queue.Write( s.fd, s.buffers[k], len, (uint64_t)k * len, NULL ) )
+            {
+                Int32AtomicAdd( &s.errors, 1 );
+            }
+
+            queue.Poll();
+        }
+
+        queue.Flush();
+    }
+
+    s.finished.SetTrue();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void RunBench( ERecordIo io, SStream* streams )
+{
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int j = 0; j < g_bench_streams; ++j )
+    {
+        streams[j].io = io;
+        streams[j].errors = 0;
+        streams[j].finished.SetFalse();
+        StartThread( &StreamThreadFunc, &streams[j] );
+    }
+
+    int errors = 0;
+
+    for( int j = 0; j < g_bench_streams; ++j )
+    {
+        streams[j].finished.Wait();
+        errors += (int)streams[j].errors;
+    }
+
+    double elapsed_sec = (double)( MonotonicTimeNs() - t0 ) * 1e-9;
+    double bytes = (double)g_bench_frame_size * g_bench_frames * g_bench_streams;
+    double fps = (double)g_bench_frames * g_bench_streams / elapsed_sec;
+
+    printf( "  %-8s %8.1f ms, %6.2f GB/s, %7.1f frames/s (%.2fx of %d x %.0f fps), write_errors=%d\n",
+                    RecordIoName( streams[0].io ), elapsed_sec*1000.0, bytes / elapsed_sec * 1e-9, fps,
+                    fps / ( g_bench_streams * g_bench_fps ), g_bench_streams, g_bench_fps, errors );
+    fflush(stdout);
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchRecorder()
+{
+    const char* dir = ( RecordGetDir() != NULL ? RecordGetDir() : "/tmp" );
+    EMemArenaMode saved_mode = MemArenaGetMode();
+    MemArenaSetMode(MemArenaPages);
+
+    static SStream streams[g_bench_streams];
+    bool direct = true;
+    int exit_code = 0;
+
+    for(  int j = 0;  j < g_bench_streams  &&  exit_code == 0;  ++j  )
+    {
+        char path[1024];
+        snprintf( path, sizeof(path), "%s/bench-recorder%d.video", dir, j );
+
+        streams[j].index = j;
+        streams[j].fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644 );
+
+        if(  streams[j].fd < 0  &&  errno == EINVAL  )
+        {
+            direct = false;
+            streams[j].fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        }
+
+        if( streams[j].fd < 0 )
+        {
+            fprintf( stderr, "Cannot create %s: %s\n", path, strerror(errno) );
+            exit_code = 1;
+            break;
+        }
+
+        unlink(path);  // the file goes away with the descriptor
+
+        for( int k = 0; k < g_bench_file_frames; ++k )
+        {
+            streams[j].buffers[k] = (char*)MemAlloc( j, g_bench_frame_size );
+            memset( streams[j].buffers[k], 0x80 + k, g_bench_frame_size );
+        }
+    }
+
+    if( exit_code == 0 )
+    {
+        printf( "Recorder benchmark: %d streams x %d frames x %lu bytes to %s%s, %u writes in flight per stream;"
+                        " %d x 1080p%.0f needs %.2f GB/s\n\n", g_bench_streams, g_bench_frames,
+                        (unsigned long)g_bench_frame_size, dir, ( direct ? " (O_DIRECT)" : " (buffered)" ),
+                        g_bench_queue_depth, g_bench_streams, g_bench_fps,
+                        (double)g_bench_frame_size * g_bench_fps * g_bench_streams * 1e-9 );
+
+        for( int io = 0; io < RecordIoCount; ++io )
+        {
+            RunBench( (ERecordIo)io, streams );
+        }
+    }
+
+    for( int j = 0; j < g_bench_streams; ++j )
+    {
+        if( streams[j].fd >= 0 )
+        {
+            close( streams[j].fd );
+        }
+
+        for( int k = 0; k < g_bench_file_frames; ++k )
+        {
+            if( streams[j].buffers[k] != NULL )
+            {
+                MemFree( streams[j].buffers[k] );
+            }
+        }
+    }
+
+    MemArenaSetMode(saved_mode);
+    return exit_code;
+}
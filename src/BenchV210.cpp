@@ -0,0 +1,180 @@
+#include <Bench.h>
+#include <MemUtils.h>
+#include <PixelConvert.h>
+#include <WorkerPool.h>
+#include <utils.h>
+#include <stdio.h>
+#include <string.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+struct SBenchSize
+{
+    const char*  name;
+    unsigned  width, height;
+    bool  timed;  // false - correctness check only
+};
+
+// 1280 and 14 end in a partial group, 14 is narrower than a vector step plus a group.
+static const SBenchSize g_bench_sizes[] =
+{
+    { "SD",     720,  486, true },
+    { "720",   1280,  720, true },
+    { "1080",  1920, 1080, true },
+    { "2160",  3840, 2160, true },
+    { "narrow",  14,    5, false },
+};
+
+static const char* const g_bench_kernels[] = { "scalar", "ssse3", "avx2" };
+
+static const uint64_t g_bench_pixels = 1920*1080*24;  // per measurement, whatever the frame size
+
+//---------------------------------------------------------------------------------------------------------------------
+// Straightforward v210 packing the kernels are checked against: sample k of a group is in word k/3, bits 10*(k%3).
+static void ReferencePack( const uint16_t* planar, unsigned width, unsigned height, uint8_t* dst, size_t row_bytes )
+{
+    const uint16_t* y = planar;
+    const uint16_t* u = y + (size_t)width * height;
+    const uint16_t* v = u + (size_t)width/2 * height;
+    memset( dst, 0, row_bytes * height );
+
+    for( unsigned r = 0; r < height; ++r )
+    {
+        uint32_t* w = (uint32_t*)( dst + r * row_bytes );
+
+        for( unsigned x = 0; x < width; ++x )
+        {
+            unsigned k = 2*( x % 6 ) + 1;
+            w[ x/6*4 + k/3 ] |= (uint32_t)( y[ (size_t)r * width + x ] & 0x3ff ) << ( 10*(k%3) );
+
+            if( x % 2 == 0 )
+            {
+                size_t c = (size_t)r * ( width/2 ) + x/2;
+                k = 2*( x % 6 );
+                w[ x/6*4 + k/3 ] |= (uint32_t)( u[c] & 0x3ff ) << ( 10*(k%3) );
+                k += 2;
+                w[ x/6*4 + k/3 ] |= (uint32_t)( v[c] & 0x3ff ) << ( 10*(k%3) );
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Frames per second of 'repeats' unpacks and packs, checks the results bit for bit: v210 -> planar against the
+// original planar frame, planar -> v210 against the reference packing of it.
+static bool Measure( const SBenchSize& s, const uint8_t* v210, const uint16_t* planar, uint8_t* packed,
+                        uint16_t* unpacked, CWorkerPool* workers, unsigned slices, int repeats, double* fps )
+{
+    size_t row_bytes = V210RowBytes(s.width);
+    size_t planar_size = V210PlanarSize( s.width, s.height );
+    memset( unpacked, 0xff, planar_size );
+    memset( packed, 0xff, row_bytes * s.height );
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    for( int j = 0; j < repeats; ++j )
+    {
+        V210Unpack( v210, row_bytes, s.width, s.height, unpacked, workers, slices );
+    }
+
+    uint64_t t1 = MonotonicTimeNs();
+
+    for( int j = 0; j < repeats; ++j )
+    {
+        V210Pack( planar, s.width, s.height, packed, row_bytes, workers, slices );
+    }
+
+    uint64_t t2 = MonotonicTimeNs();
+
+    fps[0] = repeats * 1e9 / (double)( t1 - t0 );
+    fps[1] = repeats * 1e9 / (double)( t2 - t1 );
+
+    return  memcmp( unpacked, planar, planar_size ) == 0  &&  memcmp( packed, v210, row_bytes * s.height ) == 0;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+int BenchV210()
+{
+    CWorkerPool& workers = CWorkerPool::Shared();
+    unsigned threads = (unsigned)workers.ThreadCount() + 1;
+    const char* default_kernel = PixelConvertKernelName();
+    int result = 0;
+
+    printf( "v210 unpack (to 16-bit planar) and pack benchmark: frames/s on one core per kernel, then sliced on %u"
+                                            " threads, bit-exact round trips (default kernel: %s)\n", threads,
+                                            default_kernel );
+
+    for( size_t n = 0; n < sizeof(g_bench_sizes)/sizeof(g_bench_sizes[0]); ++n )
+    {
+        const SBenchSize& s = g_bench_sizes[n];
+        size_t row_bytes = V210RowBytes(s.width);
+        size_t v210_size = row_bytes * s.height;
+        size_t planar_size = V210PlanarSize( s.width, s.height );
+        int repeats = ( s.timed ? (int)( g_bench_pixels / ( (uint64_t)s.width * s.height ) ) : 1 );
+
+        uint16_t* planar = (uint16_t*)MemAlloc( 0, planar_size );
+        uint16_t* unpacked = (uint16_t*)MemAlloc( 0, planar_size );
+        uint8_t* v210 = (uint8_t*)MemAlloc( 0, v210_size );
+        uint8_t* packed = (uint8_t*)MemAlloc( 0, v210_size );
+        uint32_t x = 0x12345678;
+
+        for( size_t j = 0; j < planar_size/sizeof(uint16_t); ++j )
+        {
+            x = x * 1664525 + 1013904223;
+            planar[j] = (uint16_t)( x >> 22 );
+        }
+
+        ReferencePack( planar, s.width, s.height, v210, row_bytes );
+
+        size_t uyvy_size = PixelFormatRowBytes( bmdFormat8BitYUV, s.width ) * s.height;
+
+        printf( "\n%s %ux%u: v210 %lu bytes/frame (UYVY %lu, +%.0f%%)%s\n", s.name, s.width, s.height,
+                    (unsigned long)v210_size, (unsigned long)uyvy_size, 100.0 * v210_size / uyvy_size - 100.0,
+                    ( s.timed ? "" : ", correctness only" ) );
+
+        for( size_t k = 0; k <= sizeof(g_bench_kernels)/sizeof(g_bench_kernels[0]); ++k )
+        {
+            bool sliced = ( k == sizeof(g_bench_kernels)/sizeof(g_bench_kernels[0]) );
+            const char* name = ( sliced ? "sliced" : g_bench_kernels[k] );
+
+            if( !PixelConvertSetKernel( sliced ? default_kernel : name ) )
+            {
+                printf( "  %-8s not supported by the CPU\n", name );
+                continue;
+            }
+
+            // A few slices even without workers, so the slice edges are checked on any machine.
+            double fps[2];
+            bool ok = Measure( s, v210, planar, packed, unpacked, ( sliced ? &workers : NULL ),
+                                                    ( sliced ? ( s.timed ? threads : 3 ) : 1 ), repeats, fps );
+            printf( "  %-8s", name );
+
+            if( s.timed )
+            {
+                printf( " unpack %8.1f frames/s (%5.2f GB/s), pack %8.1f frames/s (%5.2f GB/s)", fps[0],
+                                                fps[0] * v210_size * 1e-9, fps[1], fps[1] * v210_size * 1e-9 );
+            }
+
+            if(  sliced  &&  s.timed  )
+            {
+                printf( ", per core %.1f / %.1f frames/s", fps[0] / threads, fps[1] / threads );
+            }
+
+            printf( "%s\n", ( !ok ? "  MISMATCH!!!" : s.timed ? "" : "  round trip ok" ) );
+            result = ( ok ? result : 1 );
+            fflush(stdout);
+        }
+
+        PixelConvertSetKernel(default_kernel);
+
+        MemFree(packed);
+        MemFree(v210);
+        MemFree(unpacked);
+        MemFree(planar);
+    }
+
+    return result;
+}
@@ -0,0 +1,682 @@
+#include <BufferPool.h>
+#include <MemUtils.h>
+#include <WorkerPool.h>
+#include <stdio.h>
+#include <new>
+
+//=====================================================================================================================
+static const int32_t g_max_buffers = 1024;
+static const int32_t g_max_size_classes = 32;
+static const size_t g_slots_count = 4096;  // must be a power of 2 and at least 2*g_max_buffers
+
+static const int32_t g_desc_spare = 0;
+static const int32_t g_desc_in_use = 1;
+static const int32_t g_desc_idle = 2;
+static const int32_t g_desc_protected = 3;  // idle, guarded by MemProtect, in the guarded list
+static const int32_t g_desc_verifying = 4;  // protected, VerifySome() is checking a chunk of it
+
+static const size_t g_verify_chunk = 256*1024;
+
+// A device may still be writing a buffer for a while after it has been released; a range checked before that is over
+// would have to be checked again. The pause of a full restart.
+static const uint64_t g_default_quiet_ns = 1000000000;
+
+static const int32_t g_slot_empty = -1;
+static const int32_t g_slot_removed = -2;
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline int64_t MakeHead( int32_t j, uint32_t tag )
+{
+    return (int64_t)( ( (uint64_t)tag << 32 ) | (uint32_t)j );
+}
+
+static inline int32_t HeadIndex( int64_t h )  { return (int32_t)(uint32_t)h; }
+static inline uint32_t HeadTag( int64_t h )  { return (uint32_t)( (uint64_t)h >> 32 ); }
+
+//---------------------------------------------------------------------------------------------------------------------
+CBufferPool::CBufferPool() : descs(NULL), descs_count(0), spare_head( MakeHead(-1,0) ),
+                                guarded_head( MakeHead(-1,0) ), classes(NULL), last_class(0), slots(NULL),
+                                slots_mask( g_slots_count - 1 ), outstanding(0), idle(0), corrupted(0),
+                                workers(NULL), jobs_index(-1), verify_next(0), quiet_ns(g_default_quiet_ns)
+{
+    descs = new SDesc[g_max_buffers];
+
+    try
+    {
+        classes = new SSizeClass[g_max_size_classes];
+        slots = new int32_t[g_slots_count];
+    }
+    catch(...)
+    {
+        delete[] classes;
+        delete[] descs;
+        throw;
+    }
+
+    // VerifySome() may look at a descriptor before NewDesc() has initialized it.
+    for( int32_t j = 0; j < g_max_buffers; ++j )
+    {
+        descs[j].ptr = NULL;
+        descs[j].state = g_desc_spare;
+    }
+
+    for( int32_t j = 0; j < g_max_size_classes; ++j )
+    {
+        classes[j].free_head = MakeHead(-1,0);
+        classes[j].size = 0;
+        classes[j].live = 0;
+    }
+
+    for( size_t j = 0; j < g_slots_count; ++j )
+    {
+        slots[j] = g_slot_empty;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CBufferPool::~CBufferPool()
+{
+    int32_t n = ( descs_count < g_max_buffers ? descs_count : g_max_buffers );
+
+    for( int32_t j = 0; j < n; ++j )
+    {
+        if( descs[j].state == g_desc_protected )
+        {
+            MemUnprotect( -1, descs[j].ptr, descs[j].size, descs[j].verified );
+        }
+
+        if(  descs[j].state == g_desc_idle  ||  descs[j].state == g_desc_protected  )
+        {
+            MemFree( descs[j].ptr );
+        }
+    }
+
+    delete[] slots;
+    delete[] classes;
+    delete[] descs;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int32_t CBufferPool::Pop( volatile int64_t* head )
+{
+    for(;;)
+    {
+        int64_t h = *head;
+        int32_t j = HeadIndex(h);
+
+        if( j < 0 )
+        {
+            return -1;
+        }
+
+        // descs[j] may be popped and reused by another thread meanwhile, the tag makes the CAS fail in that case.
+        int64_t h1 = MakeHead( descs[j].next, HeadTag(h) + 1 );
+
+        if( Int64CompareExchange( head, h1, h ) == h )
+        {
+            return j;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Pushes the chain first -> ... -> last (linked by SDesc::next) owned by the caller.
+void CBufferPool::Push( volatile int64_t* head, int32_t first, int32_t last )
+{
+    for(;;)
+    {
+        int64_t h = *head;
+        descs[last].next = HeadIndex(h);
+
+        if( Int64CompareExchange( head, MakeHead( first, HeadTag(h) + 1 ), h ) == h )
+        {
+            return;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Takes the whole list, returns its first descriptor (-1 if the list is empty).
+int32_t CBufferPool::Detach( volatile int64_t* head )
+{
+    for(;;)
+    {
+        int64_t h = *head;
+
+        if( HeadIndex(h) < 0 )
+        {
+            return -1;
+        }
+
+        if( Int64CompareExchange( head, MakeHead( -1, HeadTag(h) + 1 ), h ) == h )
+        {
+            return HeadIndex(h);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t CBufferPool::Slot( const char* ptr ) const
+{
+    // Buffers are at least 16-byte aligned, so the low bits carry no information.
+    uint64_t h = (uint64_t)( (uintptr_t)ptr >> 4 ) * 0x9e3779b97f4a7c15ULL;
+    return (size_t)( h >> 32 ) & slots_mask;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Counts the caller in 'live' of class 'k', so the class is not released under it. Returns false (and counts nothing)
+// if the class has been released, and possibly taken by another size, meanwhile.
+bool CBufferPool::PinClass( int32_t k, BM_UINT32 size )
+{
+    for(;;)
+    {
+        int32_t v = classes[k].live;
+
+        if( v < 0 )
+        {
+            YieldThread();  // ReleaseClasses() is just resetting it
+            continue;
+        }
+
+        if( Int32CompareExchange( &classes[k].live, v + 1, v ) == v )
+        {
+            break;
+        }
+    }
+
+    if( classes[k].size == (int32_t)size )
+    {
+        return true;
+    }
+
+    Int32AtomicAdd( &classes[k].live, -1 );
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Returns the class of 'size' pinned (PinClass), a new class if there is none yet.
+int32_t CBufferPool::FindClass( BM_UINT32 size )
+{
+    // 0 marks an unused class slot.
+    if(  size == 0  ||  size > 0x7fffffff  )
+    {
+        throw std::bad_alloc();
+    }
+
+    int32_t k = last_class;
+
+    if(  classes[k].size == (int32_t)size  &&  PinClass( k, size )  )
+    {
+        return k;
+    }
+
+    for( k = 0; k < g_max_size_classes; ++k )
+    {
+        int32_t s = classes[k].size;
+
+        if( s == 0 )
+        {
+            s = Int32CompareExchange( &classes[k].size, (int32_t)size, 0 );
+
+            if( s == 0 )
+            {
+                s = (int32_t)size;
+            }
+        }
+
+        if(  s == (int32_t)size  &&  PinClass( k, size )  )
+        {
+            last_class = k;
+            return k;
+        }
+    }
+
+    throw std::bad_alloc();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Frees the slots of classes without buffers, called by FreeIdle()/TrimIdle() once the buffers are freed.
+void CBufferPool::ReleaseClasses()
+{
+    for( int32_t k = 0; k < g_max_size_classes; ++k )
+    {
+        if(  classes[k].size != 0  &&  Int32CompareExchange( &classes[k].live, -1, 0 ) == 0  )
+        {
+            classes[k].size = 0;
+            classes[k].live = 0;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int32_t CBufferPool::NewDesc()
+{
+    int32_t j = Pop(&spare_head);
+
+    if( j >= 0 )
+    {
+        return j;
+    }
+
+    j = Int32AtomicAdd( &descs_count, 1 );
+
+    if( j >= g_max_buffers )
+    {
+        Int32AtomicAdd( &descs_count, -1 );
+        throw std::bad_alloc();
+    }
+
+    descs[j].ptr = NULL;
+    descs[j].state = g_desc_spare;
+    return j;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CBufferPool::IndexDesc( int32_t j )
+{
+    // Removed slots are reused, empty ones are never restored, so a probe sequence is never cut short.
+    for(  size_t s = Slot( descs[j].ptr );  ;  s = ( s + 1 ) & slots_mask  )
+    {
+        int32_t v = slots[s];
+
+        if(  v < 0  &&  Int32CompareExchange( &slots[s], j, v ) == v  )
+        {
+            return;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CBufferPool::UnindexDesc( int32_t j )
+{
+    for(  size_t s = Slot( descs[j].ptr ), n = 0;  n <= slots_mask;  s = ( s + 1 ) & slots_mask, ++n  )
+    {
+        if( slots[s] == j )
+        {
+            slots[s] = g_slot_removed;
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int32_t CBufferPool::LookupDesc( const void* ptr ) const
+{
+    for(  size_t s = Slot( (const char*)ptr ), n = 0;  n <= slots_mask;  s = ( s + 1 ) & slots_mask, ++n  )
+    {
+        int32_t j = slots[s];
+
+        if( j == g_slot_empty )
+        {
+            break;
+        }
+
+        if(  j >= 0  &&  descs[j].ptr == ptr  )
+        {
+            return j;
+        }
+    }
+
+    return -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Sets the state of a detached descriptor, waits while VerifySome() is checking a chunk of it. Returns the old state.
+int32_t CBufferPool::ClaimDesc( int32_t j, int32_t state )
+{
+    for(;;)
+    {
+        int32_t s = descs[j].state;
+
+        if(  s != g_desc_verifying  &&  Int32CompareExchange( &descs[j].state, state, s ) == s  )
+        {
+            return s;
+        }
+
+        YieldThread();
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+char* CBufferPool::Allocate( int index, BM_UINT32 size, bool* fresh )
+{
+    int32_t k = FindClass(size);
+    int32_t j = Pop( &classes[k].free_head );
+
+    if( fresh != NULL )
+    {
+        *fresh = ( j < 0 );
+    }
+
+    if( j >= 0 )
+    {
+        // The free lists hold unguarded buffers only, reuse never has to verify on the caller's thread.
+        descs[j].state = g_desc_in_use;
+        Int32AtomicAdd( &classes[k].live, -1 );  // the buffer keeps the class
+        Int32AtomicAdd( &idle, -1 );
+        Int32AtomicAdd( &outstanding, 1 );
+        return descs[j].ptr;
+    }
+
+    // The pin stays as the count of the new buffer, unless it cannot be made.
+    try
+    {
+        j = NewDesc();
+    }
+    catch(...)
+    {
+        Int32AtomicAdd( &classes[k].live, -1 );
+        throw;
+    }
+
+    SDesc& d = descs[j];
+
+    try
+    {
+        d.ptr = (char*)MemAlloc( index, size );
+    }
+    catch(...)
+    {
+        Push( &spare_head, j, j );
+        Int32AtomicAdd( &classes[k].live, -1 );
+        throw;
+    }
+
+    d.size = size;
+    d.size_class = k;
+    d.state = g_desc_in_use;
+
+    IndexDesc(j);
+    Int32AtomicAdd( &outstanding, 1 );
+    return d.ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CBufferPool::Release( void* ptr, BM_UINT32* size )
+{
+    int32_t j = LookupDesc(ptr);
+
+    if( j < 0 )
+    {
+        return false;
+    }
+
+    SDesc& d = descs[j];
+
+    if( size != NULL )
+    {
+        *size = d.size;
+    }
+
+    assert( d.state == g_desc_in_use );
+    if( d.state != g_desc_in_use )
+    {
+        return true;
+    }
+
+    d.state = g_desc_idle;
+    Int32AtomicAdd( &outstanding, -1 );
+    Int32AtomicAdd( &idle, 1 );
+
+    Push( &classes[d.size_class].free_head, j, j );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Takes all free lists and the guarded list and makes a job for every detached buffer (in list order).
+void CBufferPool::DetachIdle()
+{
+    idle_jobs.clear();
+
+    for( int32_t k = 0; k <= g_max_size_classes; ++k )
+    {
+        volatile int64_t* head = ( k < g_max_size_classes ? &classes[k].free_head : &guarded_head );
+
+        for(  int32_t j = Detach(head);  j >= 0;  j = descs[j].next  )
+        {
+            SIdleJob job;
+            job.desc = j;
+            job.ok = true;
+            job.report[0] = 0;
+            idle_jobs.push_back(job);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Puts a detached buffer back: unguarded ones on the free list of their class, guarded ones on the guarded list.
+void CBufferPool::Reattach( int32_t j )
+{
+    // A guarded buffer may be 'verifying' right now, VerifySome() leaves it 'protected' again.
+    if( descs[j].state == g_desc_idle )
+    {
+        Push( &classes[ descs[j].size_class ].free_head, j, j );
+    }
+    else
+    {
+        Push( &guarded_head, j, j );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Guards an unguarded buffer, or verifies and unguards one guarded by the previous ProtectIdle().
+void CBufferPool::ProtectJob( void* ctx, size_t j )
+{
+    CBufferPool& pool = *(CBufferPool*)ctx;
+    SIdleJob& job = pool.idle_jobs[j];
+    SDesc& d = pool.descs[job.desc];
+
+    if( d.state == g_desc_idle )
+    {
+        d.readable = MemProtect( pool.jobs_index, d.ptr, d.size );
+        d.verified = 0;
+        d.protect_ns = MonotonicTimeNs();
+        d.state = g_desc_protected;
+        return;
+    }
+
+    // Guarded too recently (restarts in quick succession), it stays guarded until the next call.
+    if( MonotonicTimeNs() - d.protect_ns < pool.quiet_ns )
+    {
+        return;
+    }
+
+    if( pool.ClaimDesc( job.desc, g_desc_idle ) == g_desc_protected )
+    {
+        job.ok = MemUnprotect( pool.jobs_index, d.ptr, d.size, d.verified, job.report, sizeof(job.report) );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CBufferPool::FreeJob( void* ctx, size_t j )
+{
+    CBufferPool& pool = *(CBufferPool*)ctx;
+    SIdleJob& job = pool.idle_jobs[j];
+    SDesc& d = pool.descs[job.desc];
+
+    if( pool.ClaimDesc( job.desc, g_desc_spare ) == g_desc_protected )
+    {
+        job.ok = MemUnprotect( pool.jobs_index, d.ptr, d.size, d.verified, job.report, sizeof(job.report) );
+    }
+
+    pool.UnindexDesc(job.desc);
+    MemFree(d.ptr);
+    Int32AtomicAdd( &pool.classes[d.size_class].live, -1 );
+
+    d.ptr = NULL;
+    d.state = g_desc_spare;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CBufferPool::ProtectIdle( int index )
+{
+    DetachIdle();
+
+    jobs_index = index;
+    ( workers != NULL ? *workers : CWorkerPool::Shared() ).Run( &ProtectJob, this, idle_jobs.size() );
+
+#if 0 // corrupt one of the buffers
+    if(  !idle_jobs.empty()  &&  descs[ idle_jobs[0].desc ].size > 80  )
+    {
+        memset( descs[ idle_jobs[0].desc ].ptr + descs[ idle_jobs[0].desc ].size/2, 0x80, 40 );
+    }
+#endif
+
+    for( size_t j = 0; j < idle_jobs.size(); ++j )
+    {
+        if( !idle_jobs[j].ok )
+        {
+            printf( "%s", idle_jobs[j].report );
+            corrupted = 1;
+        }
+
+        Reattach( idle_jobs[j].desc );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CBufferPool::FreeIdle( int index )
+{
+    bool ok = ( Int32CompareExchange( &corrupted, 0, 1 ) == 0 );
+
+    DetachIdle();
+
+    jobs_index = index;
+    ( workers != NULL ? *workers : CWorkerPool::Shared() ).Run( &FreeJob, this, idle_jobs.size() );
+
+    // Failures are reported in free list order whatever order the jobs have finished in.
+    for( size_t j = 0; j < idle_jobs.size(); ++j )
+    {
+        if( !idle_jobs[j].ok )
+        {
+            printf( "%s", idle_jobs[j].report );
+            ok = false;
+        }
+
+        descs[ idle_jobs[j].desc ].next = ( j + 1 < idle_jobs.size() ? idle_jobs[j+1].desc : -1 );
+    }
+
+    if( !idle_jobs.empty() )
+    {
+        Push( &spare_head, idle_jobs.front().desc, idle_jobs.back().desc );
+        Int32AtomicAdd( &idle, -(int32_t)idle_jobs.size() );
+    }
+
+    ReleaseClasses();
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t CBufferPool::VerifySome( int index, size_t max_bytes )
+{
+    size_t done = 0;
+    int32_t n = ( descs_count < g_max_buffers ? descs_count : g_max_buffers );
+    uint64_t now = MonotonicTimeNs();
+
+    // One round of the table at most, the budget may well outlast the protected buffers.
+    for(  int32_t m = 0;  m < n  &&  done < max_bytes;  ++m  )
+    {
+        int32_t j = ( verify_next < n ? verify_next : 0 );
+        SDesc& d = descs[j];
+
+        // Only what is checked after the quiet time counts, a buffer guarded more recently is left for later.
+        while(  done < max_bytes  &&  d.state == g_desc_protected  &&  d.readable  &&  d.verified < d.size
+                    &&  now - d.protect_ns >= quiet_ns
+                    &&  Int32CompareExchange( &d.state, g_desc_verifying, g_desc_protected ) == g_desc_protected  )
+        {
+            size_t len = d.size - d.verified;
+
+            if( len > g_verify_chunk )
+            {
+                len = g_verify_chunk;
+            }
+
+            char report[256];
+
+            if( MemVerifyRange( index, d.ptr, d.size, d.verified, d.verified + len, report, sizeof(report) ) )
+            {
+                d.verified += (BM_UINT32)len;
+            }
+            else
+            {
+                printf( "%s", report );
+                fflush(stdout);
+                corrupted = 1;
+                d.verified = d.size;  // reported, FreeIdle() does not need to find it again
+            }
+
+            done += len;
+            d.state = g_desc_protected;
+        }
+
+        // The next call goes on with this buffer if the budget has run out in the middle of it.
+        verify_next = ( done < max_bytes ? j + 1 : j );
+    }
+
+    return done;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t CBufferPool::Reserve( int index, BM_UINT32 size, size_t count )
+{
+    std::vector<char*> taken;
+    taken.reserve(count);
+
+    try
+    {
+        while( taken.size() < count )
+        {
+            char* ptr = Allocate( index, size );
+            taken.push_back(ptr);
+            MemPrefault( index, ptr, size );
+        }
+    }
+    catch(...)
+    {
+        // As many as there was memory for.
+    }
+
+    for( size_t j = 0; j < taken.size(); ++j )
+    {
+        Release( taken[j] );
+    }
+
+    return taken.size();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t CBufferPool::TrimIdle( size_t keep )
+{
+    size_t kept = 0;
+    size_t freed = 0;
+
+    DetachIdle();
+
+    for( size_t j = 0; j < idle_jobs.size(); ++j )
+    {
+        int32_t k = idle_jobs[j].desc;
+        SDesc& d = descs[k];
+
+        if(  kept < keep  ||  d.state != g_desc_idle  )
+        {
+            ++kept;
+            Reattach(k);
+            continue;
+        }
+
+        UnindexDesc(k);
+        MemFree(d.ptr);
+        Int32AtomicAdd( &classes[d.size_class].live, -1 );
+
+        d.ptr = NULL;
+        d.state = g_desc_spare;
+        Push( &spare_head, k, k );
+        Int32AtomicAdd( &idle, -1 );
+        ++freed;
+    }
+
+    ReleaseClasses();
+    return freed;
+}
@@ -0,0 +1,490 @@
+#include <FrameAnalyzer.h>
+#include <PixelConvert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__amd64__) || defined(_M_IX86) || defined(_M_X64)
+#define FRAME_ANALYZER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_ISA(isa) __attribute__(( target(isa) ))
+#else
+#define TARGET_ISA(isa)
+#endif
+
+//=====================================================================================================================
+// Row kernels. A row is read as 16-bit little-endian lanes with the 8-bit luma at 'shift': a UYVY pixel is U|Y<<8
+// (shift 8), a v210 row unpacked to 16-bit planar starts with the 10-bit Y plane (shift 2). A kernel sums whole
+// blocks of g_analyze_block_width pixels into 'blocks', adds the squares to 'sum_sq' and returns the number of pixels
+// done, the caller finishes the row with scalar code. psadbw against zero sums the bytes of the lanes (the high bytes
+// are zero after the shift), pmaddwd squares the lanes and adds them in pairs.
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+typedef unsigned (*FLumaRow)( const uint16_t* s, unsigned width, unsigned shift, uint32_t* blocks, uint64_t* sum_sq );
+
+//---------------------------------------------------------------------------------------------------------------------
+static void TailLuma( const uint16_t* s, unsigned x, unsigned width, unsigned shift, uint32_t* blocks,
+                                                                                                    uint64_t* sum_sq )
+{
+    uint64_t sq = 0;
+
+    for( ; x < width; ++x )
+    {
+        uint32_t y = (uint32_t)( s[x] >> shift );
+        blocks[ x / g_analyze_block_width ] += y;
+        sq += y * y;
+    }
+
+    *sum_sq += sq;
+}
+
+static unsigned LumaRowScalar( const uint16_t*, unsigned, unsigned, uint32_t*, uint64_t* )
+{
+    return 0;
+}
+
+#if defined(FRAME_ANALYZER_X86)
+//---------------------------------------------------------------------------------------------------------------------
+// SSE2: 8 pixels per load, a 32-bit square lane takes two squares per load, so it does not overflow below 131072
+// pixels per row.
+TARGET_ISA("sse2")
+static unsigned LumaRowSse2( const uint16_t* s, unsigned width, unsigned shift, uint32_t* blocks, uint64_t* sum_sq )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i count = _mm_cvtsi32_si128( (int)shift );
+    __m128i sq = zero;
+    unsigned x = 0;
+
+    for( ; x + g_analyze_block_width <= width; x += g_analyze_block_width )
+    {
+        __m128i sum = zero;
+
+        for( unsigned k = 0; k < g_analyze_block_width; k += 8 )
+        {
+            __m128i y = _mm_srl_epi16( _mm_loadu_si128( (const __m128i*)( s + x + k ) ), count );
+            sum = _mm_add_epi64( sum, _mm_sad_epu8( y, zero ) );
+            sq = _mm_add_epi32( sq, _mm_madd_epi16( y, y ) );
+        }
+
+        sum = _mm_add_epi64( sum, _mm_srli_si128( sum, 8 ) );
+        blocks[ x / g_analyze_block_width ] += (uint32_t)_mm_cvtsi128_si32(sum);
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128( (__m128i*)lanes, sq );
+    *sum_sq += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// AVX2: 16 pixels per load.
+TARGET_ISA("avx2")
+static unsigned LumaRowAvx2( const uint16_t* s, unsigned width, unsigned shift, uint32_t* blocks, uint64_t* sum_sq )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i count = _mm_cvtsi32_si128( (int)shift );
+    __m256i sq = zero;
+    unsigned x = 0;
+
+    for( ; x + g_analyze_block_width <= width; x += g_analyze_block_width )
+    {
+        __m256i sum = zero;
+
+        for( unsigned k = 0; k < g_analyze_block_width; k += 16 )
+        {
+            __m256i y = _mm256_srl_epi16( _mm256_loadu_si256( (const __m256i*)( s + x + k ) ), count );
+            sum = _mm256_add_epi64( sum, _mm256_sad_epu8( y, zero ) );
+            sq = _mm256_add_epi32( sq, _mm256_madd_epi16( y, y ) );
+        }
+
+        __m128i h = _mm_add_epi64( _mm256_castsi256_si128(sum), _mm256_extracti128_si256( sum, 1 ) );
+        h = _mm_add_epi64( h, _mm_srli_si128( h, 8 ) );
+        blocks[ x / g_analyze_block_width ] += (uint32_t)_mm_cvtsi128_si32(h);
+    }
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256( (__m256i*)lanes, sq );
+    *sum_sq += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#if defined(_MSC_VER)
+static bool CpuSupports( const char* isa )
+{
+    int r[4];
+    __cpuid( r, 0 );
+    int max_leaf = r[0];
+
+    __cpuid( r, 1 );
+    bool sse2 = ( r[3] & (1 << 26) ) != 0;
+    bool os_avx = (  ( r[2] & (1 << 27) ) != 0  &&  ( r[2] & (1 << 28) ) != 0  &&  ( _xgetbv(0) & 0x06 ) == 0x06  );
+
+    if( max_leaf >= 7 )
+    {
+        __cpuidex( r, 7, 0 );
+    }
+    else
+    {
+        r[1] = 0;
+    }
+
+    if( strcmp( isa, "sse2" ) == 0 )  return sse2;
+    if( strcmp( isa, "avx2" ) == 0 )  return os_avx  &&  ( r[1] & (1 << 5) ) != 0;
+    return false;
+}
+#else
+static bool CpuSupports( const char* isa )
+{
+    __builtin_cpu_init();
+
+    if( strcmp( isa, "sse2" ) == 0 )  return __builtin_cpu_supports("sse2");
+    if( strcmp( isa, "avx2" ) == 0 )  return __builtin_cpu_supports("avx2");
+    return false;
+}
+#endif
+
+#endif // defined(FRAME_ANALYZER_X86)
+
+//---------------------------------------------------------------------------------------------------------------------
+struct SLumaKernel
+{
+    const char*  name;
+    const char*  isa;  // NULL - always supported
+    FLumaRow  row;
+};
+
+static const SLumaKernel g_kernels[] =
+{
+    { "scalar",  NULL,    &LumaRowScalar },
+#if defined(FRAME_ANALYZER_X86)
+    { "sse2",    "sse2",  &LumaRowSse2 },
+    { "avx2",    "avx2",  &LumaRowAvx2 },
+#endif
+};
+
+static const int g_kernels_count = (int)( sizeof(g_kernels) / sizeof(g_kernels[0]) );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Picks the widest supported kernel before main() starts.
+class CLumaDispatch
+{
+public:
+    const SLumaKernel* volatile  kernel;
+
+    CLumaDispatch() : kernel(&g_kernels[0])
+    {
+        for( int j = g_kernels_count - 1; j > 0; --j )
+        {
+            if( IsSupported( g_kernels[j] ) )
+            {
+                kernel = &g_kernels[j];
+                break;
+            }
+        }
+    }
+
+    static bool IsSupported( const SLumaKernel& k )
+    {
+#if defined(FRAME_ANALYZER_X86)
+        return  k.isa == NULL  ||  CpuSupports(k.isa);
+#else
+        return  k.isa == NULL;
+#endif
+    }
+};
+
+static CLumaDispatch g_dispatch;
+
+static const char* const g_condition_names[CFrameAnalyzer::ConditionCount] = { "black", "flat", "freeze" };
+
+//---------------------------------------------------------------------------------------------------------------------
+static unsigned SampledRows( unsigned height, unsigned row_step )
+{
+    return ( height + row_step - 1 ) / row_step;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+double SFrameLuma::Mean() const
+{
+    return ( count != 0 ? (double)sum / count : 0.0 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+double SFrameLuma::Variance() const
+{
+    double mean = Mean();
+    return ( count != 0 ? (double)sum_sq / count - mean * mean : 0.0 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t FrameAnalyzeBlockCount( unsigned width, unsigned height, unsigned row_step )
+{
+    size_t columns = ( width + g_analyze_block_width - 1 ) / g_analyze_block_width;
+    size_t bands = ( SampledRows( height, row_step ) + g_analyze_block_rows - 1 ) / g_analyze_block_rows;
+    return columns * bands;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t FrameAnalyzeScratchSize( unsigned width )
+{
+    return V210PlanarSize( width, 1 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool FrameAnalyze( BMDPixelFormat format, const void* src, size_t row_bytes, unsigned width, unsigned height,
+                                        unsigned row_step, void* scratch, uint32_t* blocks, SFrameLuma* luma )
+{
+    if(  format != bmdFormat8BitYUV  &&  format != bmdFormat10BitYUV  )
+    {
+        return false;
+    }
+
+    FLumaRow kernel = g_dispatch.kernel->row;
+    bool v210 = ( format == bmdFormat10BitYUV );
+    unsigned shift = ( v210 ? 2 : 8 );
+    size_t columns = ( width + g_analyze_block_width - 1 ) / g_analyze_block_width;
+    uint64_t sum_sq = 0;
+    unsigned sampled = 0;
+
+    memset( blocks, 0, FrameAnalyzeBlockCount( width, height, row_step ) * sizeof(uint32_t) );
+
+    for( unsigned r = 0; r < height; r += row_step, ++sampled )
+    {
+        const uint16_t* s = (const uint16_t*)( (const uint8_t*)src + r * row_bytes );
+
+        if( v210 )
+        {
+            // The row as a frame of its own, the Y plane comes first.
+            V210UnpackRows( s, row_bytes, width, 1, scratch, 0, 1 );
+            s = (const uint16_t*)scratch;
+        }
+
+        uint32_t* b = blocks + sampled / g_analyze_block_rows * columns;
+        unsigned x = kernel( s, width, shift, b, &sum_sq );
+        TailLuma( s, x, width, shift, b, &sum_sq );
+    }
+
+    size_t count = FrameAnalyzeBlockCount( width, height, row_step );
+    luma->count = (uint64_t)sampled * width;
+    luma->sum = 0;
+    luma->sum_sq = sum_sq;
+
+    for( size_t j = 0; j < count; ++j )
+    {
+        luma->sum += blocks[j];
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+double FrameBlockDiff( const uint32_t* a, const uint32_t* b, unsigned width, unsigned height, unsigned row_step )
+{
+    unsigned sampled = SampledRows( height, row_step );
+    unsigned columns = ( width + g_analyze_block_width - 1 ) / g_analyze_block_width;
+    double max_diff = 0.0;
+
+    for( unsigned r0 = 0; r0 < sampled; r0 += g_analyze_block_rows )
+    {
+        unsigned rows = ( sampled - r0 < g_analyze_block_rows ? sampled - r0 : g_analyze_block_rows );
+
+        for( unsigned c = 0; c < columns; ++c, ++a, ++b )
+        {
+            unsigned x0 = c * g_analyze_block_width;
+            unsigned w = ( width - x0 < g_analyze_block_width ? width - x0 : g_analyze_block_width );
+            double diff = (double)( *a > *b ? *a - *b : *b - *a ) / ( (double)w * rows );
+            max_diff = ( diff > max_diff ? diff : max_diff );
+        }
+    }
+
+    return max_diff;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* FrameAnalyzeKernelName()
+{
+    return g_dispatch.kernel->name;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool FrameAnalyzeSetKernel( const char* name )
+{
+    for( int j = 0; j < g_kernels_count; ++j )
+    {
+        if(  strcmp( g_kernels[j].name, name ) == 0  &&  CLumaDispatch::IsSupported( g_kernels[j] )  )
+        {
+            g_dispatch.kernel = &g_kernels[j];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//=====================================================================================================================
+CFrameAnalyzer::CFrameAnalyzer() : index(-1), current(0), have_previous(false), width(0), height(0), last_end(0),
+                                                                                    frames(0), no_signal(0), skipped(0)
+{
+    memset( conditions, 0, sizeof(conditions) );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameAnalyzer::Init( int device_index, const SAnalyzeParams& analyze_params )
+{
+    index = device_index;
+    params = analyze_params;
+    params.row_step = ( params.row_step != 0 ? params.row_step : 1 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// A condition takes effect once 'hold_frames' consecutive frames disagree with it, as of the first of them.
+void CFrameAnalyzer::Update( ECondition c, bool state, int64_t time, const SFrameLuma& luma, double diff )
+{
+    SCondition& s = conditions[c];
+
+    if( state == s.active )
+    {
+        s.run = 0;
+        return;
+    }
+
+    if( s.run++ == 0 )
+    {
+        s.run_time = time;
+    }
+
+    if( s.run < params.hold_frames )
+    {
+        return;
+    }
+
+    if( !state )
+    {
+        Stop( c, s.run_time );
+        return;
+    }
+
+    s.active = true;
+    s.run = 0;
+    s.since = s.run_time;
+    ++s.events;
+    printf( "[%d] CFrameAnalyzer: %s started - video_time=%lld/240000, mean=%.1f, variance=%.1f, block_diff=%.2f\n",
+                    index, g_condition_names[c], (long long)s.since, luma.Mean(), luma.Variance(), diff );
+    fflush(stdout);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameAnalyzer::Stop( ECondition c, int64_t time )
+{
+    SCondition& s = conditions[c];
+    s.active = false;
+    s.run = 0;
+    s.total += time - s.since;
+    printf( "[%d] CFrameAnalyzer: %s stopped - video_time=%lld/240000, duration=%.3f s\n", index,
+                                            g_condition_names[c], (long long)time, ( time - s.since ) / 240000.0 );
+    fflush(stdout);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameAnalyzer::Stage( void* ctx, const SCapturedFrame& frame )
+{
+    CFrameAnalyzer& a = *(CFrameAnalyzer*)ctx;
+    IDeckLinkVideoInputFrame* video = frame.video;
+    BMDPixelFormat format = video->GetPixelFormat();
+    BMDTimeValue time, duration;
+    void* bytes = NULL;
+
+    if( ( video->GetFlags() & bmdFrameHasNoInputSource ) != 0 )
+    {
+        ++a.no_signal;
+        a.have_previous = false;
+        return;
+    }
+
+    if(  ( format != bmdFormat8BitYUV  &&  format != bmdFormat10BitYUV )
+            ||  FAILED( video->GetBytes(&bytes) )  ||  bytes == NULL
+            ||  FAILED( video->GetStreamTime( &time, &duration, 240000 ) )  )
+    {
+        ++a.skipped;
+        return;
+    }
+
+    unsigned width = (unsigned)video->GetWidth();
+    unsigned height = (unsigned)video->GetHeight();
+
+    // Neither a restart nor a format change leaves a frame to compare with.
+    if( time < a.last_end )
+    {
+        for( int c = 0; c < ConditionCount; ++c )
+        {
+            if( a.conditions[c].active )
+            {
+                a.Stop( (ECondition)c, a.last_end );
+            }
+
+            a.conditions[c].run = 0;
+        }
+
+        a.have_previous = false;
+    }
+
+    if(  width != a.width  ||  height != a.height  )
+    {
+        size_t count = FrameAnalyzeBlockCount( width, height, a.params.row_step );
+        a.blocks[0].resize(count);
+        a.blocks[1].resize(count);
+        a.scratch.resize( FrameAnalyzeScratchSize(width) );
+        a.width = width;
+        a.height = height;
+        a.have_previous = false;
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    uint32_t* cur = &a.blocks[a.current][0];
+    SFrameLuma luma;
+    FrameAnalyze( format, bytes, (size_t)video->GetRowBytes(), width, height, a.params.row_step, &a.scratch[0], cur,
+                                                                                                            &luma );
+    double diff = ( a.have_previous ?
+                    FrameBlockDiff( cur, &a.blocks[ a.current ^ 1 ][0], width, height, a.params.row_step ) : -1.0 );
+
+    a.analyze_ns.Record( MonotonicTimeNs() - t0 );
+
+    bool flat = ( luma.Variance() <= a.params.flat_variance );
+    bool black = (  flat  &&  luma.Mean() <= a.params.black_luma  );
+
+    a.Update( Black, black, time, luma, diff );
+    a.Update( Flat, flat && !black, time, luma, diff );
+    a.Update( Freeze, a.have_previous && !flat && diff <= a.params.freeze_diff, time, luma, diff );
+
+    a.current ^= 1;
+    a.have_previous = true;
+    a.last_end = time + duration;
+    ++a.frames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameAnalyzer::PrintStats()
+{
+    printf( "[%d] CFrameAnalyzer (%s, row step %u): %llu frames, analyze p50=%.3f ms, p99=%.3f ms, max=%.3f ms,"
+                    " no_signal=%llu, skipped=%llu\n", index, FrameAnalyzeKernelName(), params.row_step,
+                    (unsigned long long)frames, analyze_ns.Percentile(0.5) * 1e-6, analyze_ns.Percentile(0.99) * 1e-6,
+                    analyze_ns.Max() * 1e-6, (unsigned long long)no_signal, (unsigned long long)skipped );
+
+    for( int c = 0; c < ConditionCount; ++c )
+    {
+        const SCondition& s = conditions[c];
+        int64_t total = s.total + ( s.active ? last_end - s.since : 0 );
+
+        printf( "[%d]   %-6s %u times, %.1f s%s\n", index, g_condition_names[c], s.events, total / 240000.0,
+                                                                            ( s.active ? " (still on)" : "" ) );
+    }
+}
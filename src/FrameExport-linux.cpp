@@ -0,0 +1,357 @@
+#include <FrameExport.h>
+#include <MemArena.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint64_t LoadSeq( const volatile uint64_t* p )  { return __atomic_load_n( p, __ATOMIC_SEQ_CST ); }
+static inline void StoreSeq( volatile uint64_t* p, uint64_t value )  { __atomic_store_n( p, value, __ATOMIC_RELEASE ); }
+
+//---------------------------------------------------------------------------------------------------------------------
+// True if 'name' is the open export of a process that is still running, '*owner' is set to its pid.
+static bool ExportInUse( const char* name, int32_t* owner )
+{
+    int fd = shm_open( name, O_RDONLY, 0 );
+
+    if( fd < 0 )
+    {
+        return false;
+    }
+
+    struct stat st;
+    void* p = MAP_FAILED;
+
+    if(  fstat( fd, &st ) == 0  &&  (size_t)st.st_size >= sizeof(SExportHeader)  )
+    {
+        p = mmap( NULL, sizeof(SExportHeader), PROT_READ, MAP_SHARED, fd, 0 );
+    }
+
+    close(fd);
+
+    if( p == MAP_FAILED )
+    {
+        return false;  // not even created completely
+    }
+
+    const SExportHeader* header = (const SExportHeader*)p;
+    *owner = header->pid;
+
+    // EPERM - the process exists, it is just not ours to signal.
+    bool running = (  header->closed == 0  &&  header->pid > 0
+                                        &&  ( kill( header->pid, 0 ) == 0  ||  errno == EPERM )  );
+    munmap( p, sizeof(SExportHeader) );
+    return running;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+CFrameExporter::CFrameExporter() : index(-1), header(NULL), write_seq(0), stopping(0), started(false), published(0),
+                                                            overflows(0), unshared(0), revoked(0), readers_dropped(0)
+{
+    name[0] = 0;
+    memset( held, 0, sizeof(held) );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CFrameExporter::~CFrameExporter()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameExporter::Close()
+{
+    if( started )
+    {
+        Int32AtomicAdd( &stopping, 1 );
+        stopped.Wait();
+        started = false;
+    }
+
+    if( header == NULL )
+    {
+        return;
+    }
+
+    Drain();
+    header->closed = 1;
+    munmap( header, sizeof(SExportHeader) );
+    header = NULL;
+
+    // Readers keep their mapping, the name is free for the next exporter.
+    shm_unlink(name);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameExporter::Open( int device_index, const SThreadPlacement& placement )
+{
+    assert( header == NULL );
+
+    index = device_index;
+    snprintf( name, sizeof(name), "/cct-export-dev%d", index );
+
+    uint64_t arena_size;
+    int arena_fd = MemArenaSharedFd( index, &arena_size );
+
+    if( arena_fd < 0 )
+    {
+        fprintf( stderr, "[%d] CFrameExporter: no shared arena.\n", index );
+        return false;
+    }
+
+    int32_t owner;
+
+    if( ExportInUse( name, &owner ) )
+    {
+        fprintf( stderr, "[%d] CFrameExporter: %s is in use by process %d.\n", index, name, (int)owner );
+        return false;
+    }
+
+    // A stale object of a process that has gone, its readers keep their mapping.
+    shm_unlink(name);
+    int fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+
+    if(  fd < 0  ||  ftruncate( fd, sizeof(SExportHeader) ) != 0  )
+    {
+        fprintf( stderr, "[%d] CFrameExporter: cannot create %s: %s\n", index, name, strerror(errno) );
+
+        if( fd >= 0 )
+        {
+            close(fd);
+            shm_unlink(name);
+        }
+
+        return false;
+    }
+
+    void* p = mmap( NULL, sizeof(SExportHeader), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0 );
+    close(fd);
+
+    if( p == MAP_FAILED )
+    {
+        fprintf( stderr, "[%d] CFrameExporter: mmap of %s failed: %s\n", index, name, strerror(errno) );
+        shm_unlink(name);
+        return false;
+    }
+
+    header = (SExportHeader*)p;
+    header->version = g_export_version;
+    header->pid = (int32_t)getpid();
+    header->arena_fd = arena_fd;
+    header->arena_size = arena_size;
+    header->capacity = g_export_capacity;
+    header->max_readers = g_export_max_readers;
+    __atomic_store_n( &header->magic, g_export_magic, __ATOMIC_RELEASE );  // readers check it last
+
+    started = true;
+    StartThread( &ThreadFunc, this, placement );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameExporter::Publish( const void* bytes, const SExportFrame& frame, IUnknown* hold )
+{
+    uint64_t seq = write_seq;
+
+    if( seq - __atomic_load_n( &header->release_seq, __ATOMIC_ACQUIRE ) >= g_export_capacity )
+    {
+        ++overflows;
+        return false;
+    }
+
+    uint64_t offset;
+
+    if( !MemArenaSharedOffset( index, bytes, &offset ) )
+    {
+        ++unshared;
+        return false;
+    }
+
+    unsigned slot = (unsigned)( seq & ( g_export_capacity - 1 ) );
+    SExportFrame& f = header->frames[slot];
+    f = frame;
+    f.seq = seq;
+    f.offset = offset;
+
+    hold->AddRef();
+    held[slot] = hold;
+
+    StoreSeq( &header->write_seq, seq + 1 );  // publish, the slot writes come before it
+    write_seq = seq + 1;
+    ++published;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameExporter::Publish( IDeckLinkVideoInputFrame* video, uint64_t arrived_ns )
+{
+    void* bytes = NULL;
+
+    if(  FAILED( video->GetBytes(&bytes) )  ||  bytes == NULL  )
+    {
+        return false;
+    }
+
+    SExportFrame f;
+    memset( &f, 0, sizeof(f) );
+
+    BMDTimeValue stream_time = 0, duration = 0;
+    video->GetStreamTime( &stream_time, &duration, 240000 );
+    f.stream_time = stream_time;
+    f.duration = duration;
+    f.arrived_ns = arrived_ns;
+    f.width = (uint32_t)video->GetWidth();
+    f.height = (uint32_t)video->GetHeight();
+    f.row_bytes = (uint32_t)video->GetRowBytes();
+    f.size = f.row_bytes * f.height;
+    f.pixel_format = (uint32_t)video->GetPixelFormat();
+    f.flags = (uint32_t)video->GetFlags();
+
+    return Publish( bytes, f, video );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// The oldest frame an active reader still uses, or the next frame to publish if there is none. Called under
+// 'release_lock'. A reader that joins meanwhile reads 'write_seq' after it is active, so it never starts below the
+// 'write_seq' read here.
+uint64_t CFrameExporter::AckedSeq( bool check_readers )
+{
+    uint64_t seq = LoadSeq( &header->write_seq );
+
+    for( int j = 0; j < g_export_max_readers; ++j )
+    {
+        SExportReader& r = header->readers[j];
+
+        if( __atomic_load_n( &r.state, __ATOMIC_SEQ_CST ) != ExportReaderActive )
+        {
+            continue;
+        }
+
+        if(  check_readers  &&  kill( r.pid, 0 ) != 0  &&  errno == ESRCH  )
+        {
+            uint32_t active = ExportReaderActive;
+
+            if( __atomic_compare_exchange_n( &r.state, &active, (uint32_t)ExportReaderFree, false,
+                                                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) )
+            {
+                Int32AtomicAdd( &readers_dropped, 1 );
+            }
+
+            continue;
+        }
+
+        uint64_t ack = LoadSeq( &r.ack_seq );
+        seq = ( ack < seq ? ack : seq );
+    }
+
+    return seq;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameExporter::ReleaseTo( uint64_t seq )
+{
+    uint64_t released = header->release_seq;
+
+    if( seq <= released )
+    {
+        return;
+    }
+
+    for( uint64_t j = released; j < seq; ++j )
+    {
+        unsigned slot = (unsigned)( j & ( g_export_capacity - 1 ) );
+        IUnknown* hold = held[slot];
+        held[slot] = NULL;
+        hold->Release();
+    }
+
+    StoreSeq( &header->release_seq, seq );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameExporter::Drain()
+{
+    if( header == NULL )
+    {
+        return;
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    for(;;)
+    {
+        {
+            CMutexLockGuard lock_guard(release_lock);
+            uint64_t seq = LoadSeq( &header->write_seq );
+
+            ReleaseTo( AckedSeq(true) );
+
+            if( header->release_seq == seq )
+            {
+                return;
+            }
+
+            if( MonotonicTimeNs() - t0 >= (uint64_t)g_drain_timeout_ms * 1000000 )
+            {
+                Int32AtomicAdd( &revoked, (int32_t)( seq - header->release_seq ) );
+                ReleaseTo(seq);
+                return;
+            }
+        }
+
+        WaitMs(g_poll_period_ms);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int CFrameExporter::ReaderCount() const
+{
+    int count = 0;
+
+    for(  int j = 0;  header != NULL  &&  j < g_export_max_readers;  ++j  )
+    {
+        if( header->readers[j].state == ExportReaderActive )
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameExporter::PrintStats()
+{
+    printf( "[%d] CFrameExporter %s: %llu frames published, %d readers, overflows=%llu, not in shared arena=%llu,"
+                    " revoked=%d, readers dropped=%d\n", index, name, (unsigned long long)published, ReaderCount(),
+                    (unsigned long long)overflows, (unsigned long long)unshared, (int)revoked, (int)readers_dropped );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameExporter::ThreadFunc( void* ctx )
+{
+    CFrameExporter& e = *(CFrameExporter*)ctx;
+    unsigned since_check_ms = 0;
+
+    while( e.stopping == 0 )
+    {
+        WaitMs(g_poll_period_ms);
+
+        since_check_ms += g_poll_period_ms;
+        bool check = ( since_check_ms >= g_reader_check_period_ms );
+        since_check_ms = ( check ? 0 : since_check_ms );
+
+        CMutexLockGuard lock_guard(e.release_lock);
+        e.ReleaseTo( e.AckedSeq(check) );
+    }
+
+    e.stopped.SetTrue();
+}
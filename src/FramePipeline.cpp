@@ -0,0 +1,143 @@
+#include <FramePipeline.h>
+
+//=====================================================================================================================
+CFramePipeline::CFramePipeline() : head(0), tail(0), depth_limit(0), stage_count(0), stopping(0),
+                                                    started(false), high_water(0), overflow_count(0), processed_count(0)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CFramePipeline::~CFramePipeline()
+{
+    Stop();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFramePipeline::Stop()
+{
+    if( started )
+    {
+        Int32AtomicAdd( &stopping, 1 );
+        stopped.Wait();
+        started = false;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFramePipeline::AddStage( FFrameStage func, void* ctx )
+{
+    assert( !started );
+
+    if( stage_count >= g_max_stages )
+    {
+        return false;
+    }
+
+    stages[stage_count].func = func;
+    stages[stage_count].ctx = ctx;
+    ++stage_count;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFramePipeline::Start( unsigned depth, const SThreadPlacement& placement )
+{
+    assert( !started );
+
+    depth_limit = (  depth < 1  ?  1  :  depth > (unsigned)g_capacity  ?  g_capacity  :  (int32_t)depth  );
+    started = true;
+    StartThread( &ThreadFunc, this, placement );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFramePipeline::Push( int index, IDeckLinkVideoInputFrame* video, IDeckLinkAudioInputPacket* audio,
+                                                                                                uint64_t arrived_ns )
+{
+    int32_t pos = tail;
+    int32_t depth = pos - head;
+
+    if( depth >= depth_limit )
+    {
+        Int32AtomicAdd( &overflow_count, 1 );
+        return false;
+    }
+
+    SCapturedFrame& slot = ring[ pos & ( g_capacity - 1 ) ];
+    slot.index = index;
+    slot.video = video;
+    slot.audio = audio;
+    slot.arrived_ns = arrived_ns;
+
+    video->AddRef();
+
+    if( audio != NULL )
+    {
+        audio->AddRef();
+    }
+
+    Int32AtomicAdd( &tail, 1 );  // publish, the atomic add orders the slot writes before it
+
+    if( depth + 1 > high_water )
+    {
+        high_water = depth + 1;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Processes the published frames, returns when the ring is empty.
+void CFramePipeline::Consume()
+{
+    for(;;)
+    {
+        int32_t pos = head;
+
+        if( Int32AtomicAdd( &tail, 0 ) == pos )
+        {
+            return;
+        }
+
+        SCapturedFrame& frame = ring[ pos & ( g_capacity - 1 ) ];
+
+        for( int j = 0; j < stage_count; ++j )
+        {
+            stages[j].func( stages[j].ctx, frame );
+        }
+
+        if( frame.audio != NULL )
+        {
+            frame.audio->Release();
+        }
+
+        frame.video->Release();
+
+        Int32AtomicAdd( &processed_count, 1 );
+        Int32AtomicAdd( &head, 1 );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFramePipeline::ThreadFunc( void* ctx )
+{
+    CFramePipeline& p = *(CFramePipeline*)ctx;
+
+    while( p.stopping == 0 )
+    {
+        p.Consume();
+        WaitMs(g_poll_period_ms);
+    }
+
+    p.Consume();
+
+    p.stopped.SetTrue();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFramePipeline::Drain()
+{
+    while( Depth() > 0 )
+    {
+        WaitMs(1);
+    }
+}
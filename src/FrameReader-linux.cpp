@@ -0,0 +1,206 @@
+#include <FrameReader.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return  (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+CFrameReader::CFrameReader() : header(NULL), arena(NULL), arena_size(0), slot(-1), next_seq(0), poll_us(50)
+{
+    memset( &frame, 0, sizeof(frame) );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameReader::Open( const char* name )
+{
+    Close();
+
+    int fd = shm_open( name, O_RDWR, 0 );
+    struct stat st;
+
+    if(  fd < 0  ||  fstat( fd, &st ) != 0  ||  (size_t)st.st_size < sizeof(SExportHeader)  )
+    {
+        fprintf( stderr, "CFrameReader: cannot open %s: %s\n", name, ( fd < 0 ? strerror(errno) : "too small" ) );
+
+        if( fd >= 0 )
+        {
+            close(fd);
+        }
+
+        return false;
+    }
+
+    void* p = mmap( NULL, sizeof(SExportHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close(fd);
+
+    if( p == MAP_FAILED )
+    {
+        fprintf( stderr, "CFrameReader: mmap of %s failed: %s\n", name, strerror(errno) );
+        return false;
+    }
+
+    header = (SExportHeader*)p;
+
+    if(  __atomic_load_n( &header->magic, __ATOMIC_ACQUIRE ) != g_export_magic  ||  header->version != g_export_version
+            ||  header->capacity != g_export_capacity  ||  header->closed != 0  )
+    {
+        fprintf( stderr, "CFrameReader: %s is not an open frame export of this version.\n", name );
+        Close();
+        return false;
+    }
+
+    char path[64];
+    snprintf( path, sizeof(path), "/proc/%d/fd/%d", (int)header->pid, (int)header->arena_fd );
+    fd = open( path, O_RDONLY );
+
+    if( fd >= 0 )
+    {
+        p = mmap( NULL, header->arena_size, PROT_READ, MAP_SHARED | MAP_NORESERVE, fd, 0 );
+        close(fd);
+    }
+
+    if(  fd < 0  ||  p == MAP_FAILED  )
+    {
+        int err = errno;
+        fprintf( stderr, "CFrameReader: cannot map the frame buffers (%s): %s%s\n", path, strerror(err),
+                            ( err == EACCES ? " (needs ptrace access to the exporter, see FrameReader.h)" : "" ) );
+        Close();
+        return false;
+    }
+
+    arena = (const char*)p;
+    arena_size = header->arena_size;
+
+    for(  int j = 0;  j < g_export_max_readers  &&  slot < 0;  ++j  )
+    {
+        uint32_t state = ExportReaderFree;
+
+        if( __atomic_compare_exchange_n( &header->readers[j].state, &state, (uint32_t)ExportReaderJoining, false,
+                                                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) )
+        {
+            slot = j;
+        }
+    }
+
+    if( slot < 0 )
+    {
+        fprintf( stderr, "CFrameReader: %s has %d readers already.\n", name, g_export_max_readers );
+        Close();
+        return false;
+    }
+
+    // Active with ack_seq 0 first: the exporter holds everything it has not released yet, then the reader starts
+    // at the frames published from now on.
+    SExportReader& r = header->readers[slot];
+    r.pid = (int32_t)getpid();
+    __atomic_store_n( &r.ack_seq, (uint64_t)0, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &r.state, (uint32_t)ExportReaderActive, __ATOMIC_SEQ_CST );
+    next_seq = __atomic_load_n( &header->write_seq, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &r.ack_seq, next_seq, __ATOMIC_SEQ_CST );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameReader::Close()
+{
+    if( header != NULL )
+    {
+        if( slot >= 0 )
+        {
+            __atomic_store_n( &header->readers[slot].state, (uint32_t)ExportReaderFree, __ATOMIC_SEQ_CST );
+        }
+
+        munmap( header, sizeof(SExportHeader) );
+    }
+
+    if( arena != NULL )
+    {
+        munmap( (void*)arena, arena_size );
+    }
+
+    header = NULL;
+    arena = NULL;
+    arena_size = 0;
+    slot = -1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameReader::Closed() const
+{
+    return  header == NULL  ||  __atomic_load_n( &header->closed, __ATOMIC_ACQUIRE ) != 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const SExportFrame* CFrameReader::Next( unsigned timeout_ms )
+{
+    if( slot < 0 )
+    {
+        return NULL;
+    }
+
+    uint64_t t0 = 0;
+
+    for(;;)
+    {
+        if( __atomic_load_n( &header->write_seq, __ATOMIC_ACQUIRE ) > next_seq )
+        {
+            frame = header->frames[ next_seq & ( g_export_capacity - 1 ) ];
+            ++next_seq;
+            return &frame;
+        }
+
+        if( Closed() )
+        {
+            return NULL;
+        }
+
+        uint64_t now = NowNs();
+        t0 = ( t0 == 0 ? now : t0 );
+
+        if( now - t0 >= (uint64_t)timeout_ms * 1000000 )
+        {
+            return NULL;
+        }
+
+        if( poll_us > 0 )
+        {
+            usleep(poll_us);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CFrameReader::Valid( const SExportFrame& f ) const
+{
+    return  header != NULL  &&  __atomic_load_n( &header->release_seq, __ATOMIC_ACQUIRE ) <= f.seq;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameReader::Ack( const SExportFrame& f )
+{
+    if(  slot >= 0  &&  f.seq + 1 > header->readers[slot].ack_seq  )
+    {
+        __atomic_store_n( &header->readers[slot].ack_seq, f.seq + 1, __ATOMIC_RELEASE );
+    }
+}
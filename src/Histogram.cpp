@@ -0,0 +1,147 @@
+#include <Histogram.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_half = 1 << ( CHistogram::g_sub_bits - 1 );
+static const uint64_t g_value_limit = ( (uint64_t)1 << CHistogram::g_value_bits ) - 1;
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline int HighestBit( uint64_t v )
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long j;
+    _BitScanReverse64( &j, v );
+    return (int)j;
+#elif defined(_MSC_VER)
+    // No _BitScanReverse64 on 32-bit targets, the high half first.
+    unsigned long j;
+
+    if( _BitScanReverse( &j, (unsigned long)( v >> 32 ) ) )
+    {
+        return (int)j + 32;
+    }
+
+    _BitScanReverse( &j, (unsigned long)v );
+    return (int)j;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Values below 2*g_half get a bucket each, above that every power of two is split into g_half buckets.
+static inline int BucketIndex( uint64_t v )
+{
+    if( v < 2*g_half )
+    {
+        return (int)v;
+    }
+
+    if( v > g_value_limit )
+    {
+        v = g_value_limit;
+    }
+
+    int shift = HighestBit(v) - ( CHistogram::g_sub_bits - 1 );
+    return shift*g_half + (int)( v >> shift );
+}
+
+static inline uint64_t BucketUpperBound( int j )
+{
+    if( j < 2*g_half )
+    {
+        return (uint64_t)j;
+    }
+
+    int shift = j/g_half - 1;
+    uint64_t mantissa = (uint64_t)( j - shift*g_half );
+    return ( ( mantissa + 1 ) << shift ) - 1;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void CHistogram::Record( uint64_t v )
+{
+    volatile int32_t& c = counts[ BucketIndex(v) ];
+    c = c + 1;
+
+    if( v > max_value )
+    {
+        max_value = v;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CHistogram::Reset()
+{
+    for( int j = 0; j < g_bucket_count; ++j )
+    {
+        counts[j] = 0;
+    }
+
+    max_value = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CHistogram::Add( const CHistogram& h )
+{
+    for( int j = 0; j < g_bucket_count; ++j )
+    {
+        counts[j] = counts[j] + h.counts[j];
+    }
+
+    uint64_t m = h.max_value;
+
+    if( m > max_value )
+    {
+        max_value = m;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint64_t CHistogram::Count() const
+{
+    uint64_t n = 0;
+
+    for( int j = 0; j < g_bucket_count; ++j )
+    {
+        n += (uint32_t)counts[j];
+    }
+
+    return n;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint64_t CHistogram::Percentile( double q ) const
+{
+    uint64_t n = Count();
+
+    if( n == 0 )
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)( q * (double)n + 0.5 );
+    rank = (  rank < 1  ?  1  :  rank > n  ?  n  :  rank  );
+
+    uint64_t seen = 0;
+
+    for( int j = 0; j < g_bucket_count; ++j )
+    {
+        seen += (uint32_t)counts[j];
+
+        if( seen >= rank )
+        {
+            uint64_t v = BucketUpperBound(j);
+            return (  v < max_value  &&  j < g_bucket_count - 1  ?  v  :  max_value  );
+        }
+    }
+
+    return max_value;
+}
@@ -0,0 +1,180 @@
+#include <Log.h>
+#include <stdio.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int32_t g_ring_size = 4096;  // must be a power of 2
+static const unsigned g_writer_period_ms = 2;
+
+// Bounded MPSC ring with a sequence number per cell (D. Vyukov's bounded queue): a producer claims a position with
+// CAS and publishes the cell by advancing its sequence, the writer frees the cell by moving the sequence one lap on.
+// Positions and sequences wrap around: they are compared by uint32_t differences, never directly.
+struct SLogCell
+{
+    volatile int32_t  seq;
+    SLogRecord  rec;
+};
+
+static SLogCell g_ring[g_ring_size];
+static volatile int32_t g_enqueue_pos = 0;
+static volatile int32_t g_dequeue_pos = 0;  // written by the writer thread only
+static volatile int32_t g_printed_pos = 0;  // records before it are printed and flushed, written by the writer thread
+static volatile int32_t g_dropped = 0;
+
+static FLogFormat g_format = NULL;
+static bool g_sync = false;
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool InitRing()
+{
+    for( int32_t j = 0; j < g_ring_size; ++j )
+    {
+        g_ring[j].seq = j;
+    }
+
+    return true;
+}
+
+static bool g_ring_ready = InitRing();
+
+//---------------------------------------------------------------------------------------------------------------------
+// Prints whatever has been published, returns the number of records printed.
+static int DrainRing()
+{
+    int count = 0;
+
+    for(;;)
+    {
+        uint32_t pos = (uint32_t)g_dequeue_pos;
+        SLogCell& cell = g_ring[ pos & ( g_ring_size - 1 ) ];
+
+        // The atomic read keeps the record reads below it.
+        if( (uint32_t)Int32AtomicAdd( &cell.seq, 0 ) != pos + 1 )
+        {
+            return count;
+        }
+
+        SLogRecord rec = cell.rec;
+        Int32AtomicAdd( &cell.seq, g_ring_size - 1 );
+        g_dequeue_pos = (int32_t)( pos + 1 );
+
+        g_format(rec);
+        ++count;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void WriterThreadFunc( void* /*ctx*/ )
+{
+    uint32_t dropped_reported = 0;
+
+    for(;;)
+    {
+        int count = DrainRing();
+        uint32_t dropped = (uint32_t)g_dropped;
+
+        if( dropped != dropped_reported )
+        {
+            printf( "Log: %lu records dropped (ring of %d is full)\n",
+                                                    (unsigned long)( dropped - dropped_reported ), (int)g_ring_size );
+            dropped_reported = dropped;
+            ++count;
+        }
+
+        if( count > 0 )
+        {
+            fflush(stdout);
+            g_printed_pos = g_dequeue_pos;
+        }
+        else
+        {
+            WaitMs(g_writer_period_ms);
+        }
+    }
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void LogStart( FLogFormat format, bool sync )
+{
+    g_format = format;
+    g_sync = sync;
+
+    if( !sync )
+    {
+        StartThread( &WriterThreadFunc, NULL );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool LogEvent( int index, int event, int64_t a0, int64_t a1, int64_t a2, int64_t a3 )
+{
+    SLogRecord rec;
+    rec.time_ns = MonotonicTimeNs();
+    rec.index = index;
+    rec.event = event;
+    rec.args[0] = a0;
+    rec.args[1] = a1;
+    rec.args[2] = a2;
+    rec.args[3] = a3;
+
+    if(  g_sync  ||  g_format == NULL  )
+    {
+        if( g_format != NULL )
+        {
+            g_format(rec);
+            fflush(stdout);
+        }
+
+        return true;
+    }
+
+    for(;;)
+    {
+        uint32_t pos = (uint32_t)g_enqueue_pos;
+        SLogCell& cell = g_ring[ pos & ( g_ring_size - 1 ) ];
+        int32_t diff = (int32_t)( (uint32_t)cell.seq - pos );
+
+        if( diff == 0 )
+        {
+            if( Int32CompareExchange( &g_enqueue_pos, (int32_t)( pos + 1 ), (int32_t)pos ) == (int32_t)pos )
+            {
+                cell.rec = rec;
+                Int32AtomicAdd( &cell.seq, 1 );  // publish, the atomic add orders the record writes before it
+                return true;
+            }
+        }
+        else if( diff < 0 )
+        {
+            // The writer is a whole lap behind: drop the record rather than wait.
+            Int32AtomicAdd( &g_dropped, 1 );
+            return false;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void LogFlush()
+{
+    if(  g_sync  ||  g_format == NULL  )
+    {
+        fflush(stdout);
+        return;
+    }
+
+    uint32_t end = (uint32_t)g_enqueue_pos;
+
+    // Until the writer has printed and flushed every record queued before the call.
+    while( (int32_t)( (uint32_t)g_printed_pos - end ) < 0 )
+    {
+        WaitMs(1);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t LogDropCount()
+{
+    return (uint32_t)g_dropped;
+}
@@ -1,8 +1,9 @@
+#include <stdint.h>
 #include <new>
 #include <MemUtils.h>
 
 //=====================================================================================================================
-void* MemAlloc( size_t sz )
+void* MemAlloc( int /*index*/, size_t sz )
 {
     void* ptr;
 
@@ -24,3 +25,14 @@ void MemFree( void* ptr )
 {
     operator delete(ptr);
 }
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemPrefault( int /*index*/, void* ptr, size_t sz )
+{
+    volatile char* p = (volatile char*)ptr;
+
+    for( size_t j = 0; j < sz; j += 4096 )
+    {
+        p[j] = 0;
+    }
+}
@@ -0,0 +1,717 @@
+#include <MemUtils.h>
+#include <MemArena.h>
+#include <utils.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <map>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const int g_max_arenas = 17;  // 16 devices + one for any other index
+static const size_t g_arena_reserve = (size_t)32 << 30;
+static const size_t g_huge_page_size = (size_t)2 << 20;
+
+static EMemArenaMode g_arena_mode = MemArenaHeap;
+static bool g_arena_shared = false;
+static bool g_mem_lock = false;
+static volatile int32_t g_mem_lock_failed = 0;
+
+#if !defined(MPOL_BIND)
+#define MPOL_BIND  2
+#endif
+
+static const int g_max_nodes = 1024;  // size of the mbind node mask
+static const size_t g_node_query_batch = 512;  // pages per move_pages call
+static int g_arena_nodes[g_max_arenas];  // node + 1, 0 - no binding
+static volatile int32_t g_mbind_failed = 0;
+
+static const char* const g_arena_mode_names[MemArenaModeCount] = { "heap", "pages", "thp", "hugetlb" };
+
+//---------------------------------------------------------------------------------------------------------------------
+class CArena
+{
+    CMutex  lock;
+    char*  base;
+    size_t  top;  // [base, base+top) is mapped read/write, the rest is reserved only
+    size_t  granule;
+    EMemArenaMode  mode;
+    int  node;  // -1 - not bound
+    int  fd;  // memfd of a shared arena, -1 - anonymous memory
+    std::map<char*,size_t>  free_extents;  // address -> size, adjacent extents are merged
+    std::map<char*,size_t>  used_extents;
+
+    char* Commit( size_t len );
+
+public:
+    int index;
+
+    CArena( int j, EMemArenaMode arena_mode, int arena_node, bool shared );
+    ~CArena()  {  munmap( base, g_arena_reserve );  if( fd >= 0 )  close(fd);  }
+
+    bool Contains( const void* ptr ) const
+    {
+        return  (const char*)ptr >= base  &&  (const char*)ptr < base + g_arena_reserve;
+    }
+
+    int Fd() const  { return fd; }
+    uint64_t Offset( const void* ptr ) const  { return (uint64_t)( (const char*)ptr - base ); }
+
+    void* Alloc( size_t sz );
+    void Free( void* ptr );
+
+    int Node() const  { return node; }
+    void CountNodePages( SMemNodePages* pages );
+};
+
+static CArena* volatile  g_arenas[g_max_arenas];
+static CMutex  g_arenas_lock;
+
+//---------------------------------------------------------------------------------------------------------------------
+static int ArenaSlot( int index )
+{
+    return (  index >= 0  &&  index < g_max_arenas - 1  ?  index  :  g_max_arenas - 1  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Sets the MPOL_BIND policy of [p, p+len), pages faulted in later come from 'node'. Returns false if the kernel
+// refuses (no NUMA support, a node without memory), reported once.
+static bool BindToNode( int index, void* p, size_t len, int node )
+{
+    const int bits = 8 * sizeof(unsigned long);
+    unsigned long mask[ g_max_nodes / bits ];
+    memset( mask, 0, sizeof(mask) );
+    mask[ node / bits ] |= 1UL << ( node % bits );
+
+    // The kernel reads maxnode - 1 bits of the mask.
+    if( syscall( SYS_mbind, p, len, MPOL_BIND, mask, (unsigned long)g_max_nodes + 1, 0 ) == 0 )
+    {
+        return true;
+    }
+
+    if( Int32AtomicAdd( &g_mbind_failed, 1 ) == 0 )
+    {
+        printf( "[%d] MemAlloc: mbind to node %d failed (errno=%d), buffers are not bound.\n", index, node, errno );
+        fflush(stdout);
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Parses a sysfs node list ("0-1,3"), nodes above 63 are ignored.
+static bool ReadNodeList( const char* path, uint64_t* mask )
+{
+    FILE* f = fopen( path, "r" );
+
+    if( f == NULL )
+    {
+        return false;
+    }
+
+    *mask = 0;
+    unsigned first, last;
+    char sep;
+
+    while( fscanf( f, "%u", &first ) == 1 )
+    {
+        last = first;
+
+        if(  fscanf( f, "%c", &sep ) == 1  &&  sep == '-'  )
+        {
+            if( fscanf( f, "%u", &last ) != 1 )
+            {
+                break;
+            }
+
+            sep = 0;
+
+            if( fscanf( f, "%c", &sep ) != 1 )
+            {
+                sep = 0;
+            }
+        }
+
+        for( unsigned j = first; j <= last && j < 64; ++j )
+        {
+            *mask |= (uint64_t)1 << j;
+        }
+
+        if( sep != ',' )
+        {
+            break;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CArena::CArena( int j, EMemArenaMode arena_mode, int arena_node, bool shared ) : base(NULL), top(0), granule(4096),
+                                                            mode(arena_mode), node(arena_node), fd(-1), index(j)
+{
+    void* p;
+
+    if( shared )
+    {
+        char name[32];
+        snprintf( name, sizeof(name), "cct-arena%d", index );
+
+        // A sparse file of the whole reservation, extents get pages when they are touched.
+        fd = memfd_create( name, MFD_CLOEXEC );
+
+        if(  fd < 0  ||  ftruncate( fd, (off_t)g_arena_reserve ) != 0  )
+        {
+            printf( "[%d] MemAlloc: shared arena file failed (errno=%d).\n", index, errno );
+            fflush(stdout);
+
+            if( fd >= 0 )
+            {
+                close(fd);
+            }
+
+            throw std::bad_alloc();
+        }
+
+        if( mode == MemArenaHugeTlb )
+        {
+            mode = MemArenaThp;
+        }
+
+        p = mmap( NULL, g_arena_reserve, PROT_NONE, MAP_SHARED | MAP_NORESERVE, fd, 0 );
+    }
+    else
+    {
+        p = mmap( NULL, g_arena_reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    }
+
+    if( p == MAP_FAILED )
+    {
+        if( fd >= 0 )
+        {
+            close(fd);
+        }
+
+        throw std::bad_alloc();
+    }
+
+    base = (char*)p;
+
+    // The policy of the reservation carries over to the extents mprotect()-ed out of it later.
+    if(  node >= 0  &&  !BindToNode( index, base, g_arena_reserve, node )  )
+    {
+        node = -1;
+    }
+
+    if( mode != MemArenaPages )
+    {
+        // Huge pages need 2M-aligned extents, the reservation itself is only page aligned.
+        granule = g_huge_page_size;
+        top = ( g_huge_page_size - (uintptr_t)base % g_huge_page_size ) % g_huge_page_size;
+    }
+    else
+    {
+        granule = (size_t)sysconf(_SC_PAGESIZE);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Maps 'len' bytes at the top of the arena, called under 'lock'.
+char* CArena::Commit( size_t len )
+{
+    if( len > g_arena_reserve - top )
+    {
+        return NULL;
+    }
+
+    char* p = base + top;
+
+    if( mode == MemArenaHugeTlb )
+    {
+        if( mmap( p, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0 )
+                                                                                                        != MAP_FAILED )
+        {
+            // A new mapping, the policy of the reservation is gone.
+            if( node >= 0 )
+            {
+                BindToNode( index, p, len, node );
+            }
+
+            top += len;
+            return p;
+        }
+
+        printf( "[%d] MemAlloc: MAP_HUGETLB failed (errno=%d), falling back to transparent huge pages.\n",
+                                                                                                    index, errno );
+        fflush(stdout);
+        mode = MemArenaThp;
+
+        // A failed MAP_FIXED mmap may have unmapped the range, map it again.
+        if( mmap( p, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0 ) == MAP_FAILED )
+        {
+            return NULL;
+        }
+
+        if( node >= 0 )
+        {
+            BindToNode( index, p, len, node );
+        }
+    }
+    else if( mprotect( p, len, PROT_READ | PROT_WRITE ) != 0 )
+    {
+        return NULL;
+    }
+
+    if( mode == MemArenaThp )
+    {
+        madvise( p, len, MADV_HUGEPAGE );
+    }
+
+    top += len;
+    return p;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void* CArena::Alloc( size_t sz )
+{
+    size_t len = ( sz + granule - 1 ) / granule * granule;
+    CMutexLockGuard lock_guard(lock);
+    char* p = NULL;
+
+    for(  std::map<char*,size_t>::iterator it = free_extents.begin();  it != free_extents.end();  ++it  )
+    {
+        if( it->second >= len )
+        {
+            p = it->first;
+
+            if( it->second > len )
+            {
+                free_extents[ p + len ] = it->second - len;
+            }
+
+            free_extents.erase(it);
+            break;
+        }
+    }
+
+    if(  p == NULL  &&  ( p = Commit(len) ) == NULL  )
+    {
+        throw std::bad_alloc();
+    }
+
+    used_extents[p] = len;
+    return p;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CArena::Free( void* ptr )
+{
+    CMutexLockGuard lock_guard(lock);
+    std::map<char*,size_t>::iterator it = used_extents.find( (char*)ptr );
+
+    assert( it != used_extents.end() );
+    if( it == used_extents.end() )
+    {
+        return;
+    }
+
+    char* p = it->first;
+    size_t len = it->second;
+    used_extents.erase(it);
+
+    // The pages go back to the kernel, the range stays mapped and is refaulted (zero-filled) on reuse. Locked pages
+    // can not be dropped, unlock them first (a no-op if MemPrefault has not locked them). The pages of a shared arena
+    // belong to the file, MADV_DONTNEED would only unmap them.
+    if( g_mem_lock )
+    {
+        munlock( p, len );
+    }
+
+    madvise( p, len, ( fd >= 0 ? MADV_REMOVE : MADV_DONTNEED ) );
+
+    std::map<char*,size_t>::iterator next = free_extents.lower_bound(p);
+
+    if(  next != free_extents.end()  &&  p + len == next->first  )
+    {
+        len += next->second;
+        free_extents.erase(next++);
+    }
+
+    if( next != free_extents.begin() )
+    {
+        std::map<char*,size_t>::iterator prev = next;
+        --prev;
+
+        if( prev->first + prev->second == p )
+        {
+            prev->second += len;
+            return;
+        }
+    }
+
+    free_extents[p] = len;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Counts the pages of the used extents by their node, a batch of pages per move_pages(2) call (no nodes given: it
+// only reports where the pages are).
+void CArena::CountNodePages( SMemNodePages* pages )
+{
+    CMutexLockGuard lock_guard(lock);
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void* addrs[g_node_query_batch];
+    int status[g_node_query_batch];
+
+    std::map<char*,size_t>::iterator it = used_extents.begin();
+    size_t offset = 0;
+
+    while( it != used_extents.end() )
+    {
+        size_t n = 0;
+
+        while(  n < g_node_query_batch  &&  it != used_extents.end()  )
+        {
+            addrs[n++] = it->first + offset;
+            offset += page;
+
+            if( offset >= it->second )
+            {
+                ++it;
+                offset = 0;
+            }
+        }
+
+        if( syscall( SYS_move_pages, 0, n, addrs, NULL, status, 0 ) != 0 )
+        {
+            pages->absent += n;
+            continue;
+        }
+
+        for( size_t j = 0; j < n; ++j )
+        {
+            if( status[j] == node )
+            {
+                ++pages->local;
+            }
+            else if( status[j] >= 0 )
+            {
+                ++pages->remote;
+            }
+            else
+            {
+                ++pages->absent;
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static CArena* GetArena( int index )
+{
+    int j = ArenaSlot(index);
+    CArena* arena = g_arenas[j];
+
+    if( arena == NULL )
+    {
+        CMutexLockGuard lock_guard(g_arenas_lock);
+
+        if( ( arena = g_arenas[j] ) == NULL )
+        {
+            arena = new CArena( index, g_arena_mode, g_arena_nodes[j] - 1, g_arena_shared );
+            g_arenas[j] = arena;
+        }
+    }
+
+    return arena;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static int g_perf_dtlb_fd = -1;
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void* MemAlloc( int index, size_t sz )
+{
+    if( g_arena_mode != MemArenaHeap )
+    {
+        return GetArena(index)->Alloc(sz);
+    }
+
+    void* ptr;
+
+    if( posix_memalign( &ptr, 16, sz ) != 0 )
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemFree( void* ptr )
+{
+    for( int j = 0; j < g_max_arenas; ++j )
+    {
+        CArena* arena = g_arenas[j];
+
+        if(  arena != NULL  &&  arena->Contains(ptr)  )
+        {
+            arena->Free(ptr);
+            return;
+        }
+    }
+
+    free(ptr);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemPrefault( int index, void* ptr, size_t sz )
+{
+    if(  g_mem_lock  &&  g_arena_mode != MemArenaHeap  &&  g_mem_lock_failed == 0  )
+    {
+        // mlock populates the range as well.
+        if( mlock( ptr, sz ) == 0 )
+        {
+            return;
+        }
+
+        if( Int32AtomicAdd( &g_mem_lock_failed, 1 ) == 0 )
+        {
+            printf( "[%d] MemPrefault: mlock failed (errno=%d), buffers are not locked.\n", index, errno );
+            fflush(stdout);
+        }
+    }
+
+#if defined(MADV_POPULATE_WRITE)
+    // Page-granular range around the buffer, heap buffers are not page aligned.
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)ptr & ~( page - 1 );
+    uintptr_t end = ( (uintptr_t)ptr + sz + page - 1 ) & ~( page - 1 );
+
+    if( madvise( (void*)begin, end - begin, MADV_POPULATE_WRITE ) == 0 )
+    {
+        return;
+    }
+#endif
+
+    // Older kernels: touch every page.
+    volatile char* p = (volatile char*)ptr;
+
+    for( size_t j = 0; j < sz; j += 4096 )
+    {
+        p[j] = 0;
+    }
+}
+
+//=====================================================================================================================
+void MemArenaSetMode( EMemArenaMode mode )
+{
+    g_arena_mode = mode;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemArenaSetLock( bool lock )
+{
+    g_mem_lock = lock;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemArenaGetLock()
+{
+    return g_mem_lock;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+EMemArenaMode MemArenaGetMode()
+{
+    return g_arena_mode;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemArenaSetShared( bool shared )
+{
+    g_arena_shared = shared;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemArenaGetShared()
+{
+    return g_arena_shared;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int MemArenaSharedFd( int index, uint64_t* size )
+{
+    if(  !g_arena_shared  ||  g_arena_mode == MemArenaHeap  )
+    {
+        return -1;
+    }
+
+    CArena* arena;
+
+    try
+    {
+        arena = GetArena(index);
+    }
+    catch(...)
+    {
+        return -1;
+    }
+
+    *size = g_arena_reserve;
+    return arena->Fd();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemArenaSharedOffset( int index, const void* ptr, uint64_t* offset )
+{
+    CArena* arena = g_arenas[ ArenaSlot(index) ];
+
+    if(  arena == NULL  ||  arena->Fd() < 0  ||  !arena->Contains(ptr)  )
+    {
+        return false;
+    }
+
+    *offset = arena->Offset(ptr);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* MemArenaModeName( EMemArenaMode mode )
+{
+    return (  mode >= 0  &&  mode < MemArenaModeCount  ?  g_arena_mode_names[mode]  :  "UNRECOGNIZED"  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemArenaParseMode( const char* name, EMemArenaMode* mode )
+{
+    for( int j = 0; j < MemArenaModeCount; ++j )
+    {
+        if( strcmp( name, g_arena_mode_names[j] ) == 0 )
+        {
+            *mode = (EMemArenaMode)j;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//=====================================================================================================================
+void MemArenaSetNode( int index, int node )
+{
+    g_arena_nodes[ ArenaSlot(index) ] = (  node >= 0  &&  node < g_max_nodes  ?  node + 1  :  0  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int MemArenaGetNode( int index )
+{
+    return g_arena_nodes[ ArenaSlot(index) ] - 1;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemNodeIsOnline( int node )
+{
+    uint64_t mask;
+
+    if( !ReadNodeList( "/sys/devices/system/node/online", &mask ) )
+    {
+        // No NUMA support, everything is on node 0.
+        return node == 0;
+    }
+
+    return  node >= 0  &&  node < 64  &&  ( mask & ( (uint64_t)1 << node ) ) != 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int MemNodeOfDevice( int index )
+{
+    char path[128];
+    snprintf( path, sizeof(path), "/sys/class/blackmagic/io%d/device/numa_node", index );
+
+    FILE* f = fopen( path, "r" );
+    int node = -1;
+
+    if( f != NULL )
+    {
+        if( fscanf( f, "%d", &node ) != 1 )
+        {
+            node = -1;
+        }
+
+        fclose(f);
+    }
+
+    return node;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemArenaNodePages( int index, SMemNodePages* pages )
+{
+    CArena* arena = g_arenas[ ArenaSlot(index) ];
+    memset( pages, 0, sizeof(*pages) );
+
+    if(  arena == NULL  ||  arena->Node() < 0  )
+    {
+        return false;
+    }
+
+    arena->CountNodePages(pages);
+    return true;
+}
+
+//=====================================================================================================================
+void MemCountersInit()
+{
+    if( g_perf_dtlb_fd >= 0 )
+    {
+        return;
+    }
+
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+                    | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    g_perf_dtlb_fd = (int)syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+
+    if( g_perf_dtlb_fd < 0 )
+    {
+        printf( "MemCountersInit: dTLB miss counter is not available (errno=%d).\n", errno );
+        fflush(stdout);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemCountersRead( SMemCounters* counters )
+{
+    struct rusage ru;
+    getrusage( RUSAGE_SELF, &ru );
+
+    counters->minor_faults = (uint64_t)ru.ru_minflt;
+    counters->major_faults = (uint64_t)ru.ru_majflt;
+    counters->dtlb_misses = 0;
+    counters->has_dtlb = false;
+
+    uint64_t value;
+
+    if(  g_perf_dtlb_fd >= 0  &&  read( g_perf_dtlb_fd, &value, sizeof(value) ) == (ssize_t)sizeof(value)  )
+    {
+        counters->dtlb_misses = value;
+        counters->has_dtlb = true;
+    }
+}
@@ -0,0 +1,243 @@
+#include <MemFingerprint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MEM_FINGERPRINT_SSE42
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_ISA(isa) __attribute__(( target(isa) ))
+#else
+#define TARGET_ISA(isa)
+#endif
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const size_t g_block_size = 32;  // 4 streams x 8 bytes
+static const size_t g_page_size = 4096;
+static const size_t g_line_size = 64;
+static const uint32_t g_crc32c_poly = 0x82f63b78U;  // reflected
+
+static uint32_t g_crc_table[256];
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t CrcByte( uint32_t c, uint8_t b )
+{
+    return g_crc_table[ ( c ^ b ) & 0xff ] ^ ( c >> 8 );
+}
+
+static inline uint32_t CrcWord( uint32_t c, uint64_t q, int bytes )
+{
+    for( int j = 0; j < bytes; ++j, q >>= 8 )
+    {
+        c = CrcByte( c, (uint8_t)q );
+    }
+
+    return c;
+}
+
+static inline uint64_t Load64( const char* p )
+{
+    uint64_t q;
+    memcpy( &q, p, sizeof(q) );
+    return q;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// A kernel hashes 'blocks' whole 32-byte blocks, word k of every block goes to stream k.
+typedef void (*FBlocksKernel)( uint32_t* crc, const char* p, size_t blocks );
+
+static void BlocksTable( uint32_t* crc, const char* p, size_t blocks )
+{
+    for( ; blocks > 0; --blocks, p += g_block_size )
+    {
+        for( int k = 0; k < 4; ++k )
+        {
+            crc[k] = CrcWord( crc[k], Load64( p + 8*k ), 8 );
+        }
+    }
+}
+
+#if defined(MEM_FINGERPRINT_SSE42)
+// The crc32 instruction has a latency of 3 cycles and a throughput of 1, four independent streams keep it busy.
+TARGET_ISA("sse4.2")
+static void BlocksSse42( uint32_t* crc, const char* p, size_t blocks )
+{
+    uint64_t c0 = crc[0], c1 = crc[1], c2 = crc[2], c3 = crc[3];
+
+    for( ; blocks > 0; --blocks, p += g_block_size )
+    {
+        c0 = _mm_crc32_u64( c0, Load64(p) );
+        c1 = _mm_crc32_u64( c1, Load64( p + 8 ) );
+        c2 = _mm_crc32_u64( c2, Load64( p + 16 ) );
+        c3 = _mm_crc32_u64( c3, Load64( p + 24 ) );
+    }
+
+    crc[0] = (uint32_t)c0;
+    crc[1] = (uint32_t)c1;
+    crc[2] = (uint32_t)c2;
+    crc[3] = (uint32_t)c3;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#if defined(_MSC_VER)
+static bool CpuHasSse42()
+{
+    int r[4];
+    __cpuid( r, 1 );
+    return ( r[2] & (1 << 20) ) != 0;
+}
+#else
+static bool CpuHasSse42()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#endif
+#endif // defined(MEM_FINGERPRINT_SSE42)
+
+//---------------------------------------------------------------------------------------------------------------------
+// Builds the CRC table and picks the kernel before main() starts.
+class CFingerprintDispatch
+{
+public:
+    FBlocksKernel  blocks;
+    const char*  name;
+
+    CFingerprintDispatch() : blocks(&BlocksTable), name("crc32c-table")
+    {
+        for( uint32_t j = 0; j < 256; ++j )
+        {
+            uint32_t c = j;
+
+            for( int k = 0; k < 8; ++k )
+            {
+                c = (  ( c & 1 ) != 0  ?  ( c >> 1 ) ^ g_crc32c_poly  :  c >> 1  );
+            }
+
+            g_crc_table[j] = c;
+        }
+
+#if defined(MEM_FINGERPRINT_SSE42)
+        if( CpuHasSse42() )
+        {
+            blocks = &BlocksSse42;
+            name = "crc32c-sse4.2";
+        }
+#endif
+    }
+};
+
+static CFingerprintDispatch g_dispatch;
+
+//---------------------------------------------------------------------------------------------------------------------
+// Cache line of the page picked for sample k.
+static inline size_t SampleLine( uint32_t seed, size_t page, unsigned sample_lines, unsigned k )
+{
+    uint32_t h = (uint32_t)( page*sample_lines + k ) * 0x9e3779b9U + seed;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6dU;
+    h ^= h >> 12;
+    return (size_t)( h % ( g_page_size / g_line_size ) );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void HashTail( SMemFingerprint* f, const char* p, size_t n )
+{
+    for( size_t j = 0; j < n; ++j )
+    {
+        f->crc[0] = CrcByte( f->crc[0], (uint8_t)p[j] );
+    }
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void MemFingerprintInit( SMemFingerprint* f, unsigned sample_lines, uint32_t seed )
+{
+    for( int k = 0; k < 4; ++k )
+    {
+        f->crc[k] = 0xffffffffU;
+    }
+
+    f->seed = seed;
+    f->sample_lines = sample_lines;
+    f->end = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemFingerprintUpdate( SMemFingerprint* f, const void* ptr, size_t sz, size_t end )
+{
+    const char* p = (const char*)ptr;
+
+    if( end > sz )
+    {
+        end = sz;
+    }
+
+    if( f->end >= end )
+    {
+        return;
+    }
+
+    if( f->sample_lines == 0 )
+    {
+        size_t blocks = ( end - f->end ) / g_block_size;
+        g_dispatch.blocks( f->crc, p + f->end, blocks );
+        f->end += blocks * g_block_size;
+
+        if( end == sz )
+        {
+            HashTail( f, p + f->end, sz - f->end );
+            f->end = sz;
+        }
+
+        return;
+    }
+
+    // A page is hashed as a whole, the last one may be partial.
+    while(  f->end < end  &&  (  f->end + g_page_size <= end  ||  end == sz  )  )
+    {
+        size_t page = f->end / g_page_size;
+
+        for( unsigned k = 0; k < f->sample_lines; ++k )
+        {
+            size_t offset = f->end + SampleLine( f->seed, page, f->sample_lines, k ) * g_line_size;
+
+            if( offset + g_line_size <= sz )
+            {
+                g_dispatch.blocks( f->crc, p + offset, g_line_size / g_block_size );
+            }
+            else if( offset < sz )
+            {
+                HashTail( f, p + offset, sz - offset );
+            }
+        }
+
+        f->end = ( f->end + g_page_size < sz ? f->end + g_page_size : sz );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint32_t MemFingerprintValue( const SMemFingerprint* f )
+{
+    uint32_t c = f->crc[0];
+
+    for( int k = 1; k < 4; ++k )
+    {
+        c = CrcWord( c, f->crc[k], 4 );
+    }
+
+    return ~c;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* MemFingerprintKernelName()
+{
+    return g_dispatch.name;
+}
@@ -0,0 +1,626 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <MemPattern.h>
+
+#if defined(__i386__) || defined(__amd64__) || defined(_M_IX86) || defined(_M_X64)
+#define MEM_PATTERN_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_ISA(isa) __attribute__(( target(isa) ))
+#else
+#define TARGET_ISA(isa)
+#endif
+
+//=====================================================================================================================
+static const uint32_t g_magic_base = 0xf4aeac59U;
+static const uint32_t g_magic_factor = 0xaa39456bU;
+static const uint32_t g_magic_init = 0x155c96f9U;
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline uint32_t NextMagic( uint32_t x )
+{
+    return (uint32_t)( (uint64_t)x*g_magic_factor % g_magic_base );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// x[n] = x[0]*F^n mod B, by squaring.
+static uint32_t MagicAt( size_t n )
+{
+    uint64_t x = g_magic_init;
+
+    for(  uint64_t f = g_magic_factor;  n != 0;  n >>= 1, f = f*f % g_magic_base  )
+    {
+        if( ( n & 1 ) != 0 )
+        {
+            x = x*f % g_magic_base;
+        }
+    }
+
+    return (uint32_t)x;
+}
+
+//=====================================================================================================================
+// Vector kernels. The pattern is x[n+1] = x[n]*F mod B, so x[n+L] = x[n]*F^L mod B: L lanes start with L consecutive
+// words and all of them jump L words ahead with one constant multiplication. The modular multiplication by the
+// constant W = F^L mod B uses Shoup's precomputed quotient W' = floor(W*2^32/B): q = (x*W') >> 32, r = x*W - q*B is
+// in [0, 2B) and needs one conditional subtraction. B > 2^31, so r is kept in 64-bit lanes.
+//
+// A kernel processes whole blocks of L words starting with the pattern word *x, returns the number of words done and
+// sets *x to the pattern word at that position; the caller finishes the tail (or locates a mismatch) with scalar code.
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const size_t g_max_lanes = 64;
+
+struct SJumpTable
+{
+    uint32_t  mul;  // F^L mod B
+    uint32_t  mul_q;  // floor( mul*2^32 / B )
+};
+
+static void InitJumpTable( SJumpTable* t, size_t lanes )
+{
+    uint32_t m = 1;
+
+    for( size_t j = 0; j < lanes; ++j )
+    {
+        m = (uint32_t)( (uint64_t)m*g_magic_factor % g_magic_base );
+    }
+
+    t->mul = m;
+    t->mul_q = (uint32_t)( ( (uint64_t)m << 32 ) / g_magic_base );
+}
+
+// Lane starting words x, x*F, ..., x*F^(L-1).
+static void LaneStart( uint32_t x, uint32_t* start, size_t lanes )
+{
+    for( size_t j = 0; j < lanes; ++j, x = NextMagic(x) )
+    {
+        start[j] = x;
+    }
+}
+
+typedef size_t (*FFillKernel)( uint32_t* p, size_t n, uint32_t* x );
+typedef size_t (*FVerifyKernel)( const uint32_t* p, size_t n, uint32_t* x );
+
+//---------------------------------------------------------------------------------------------------------------------
+static size_t FillScalar( uint32_t* /*p*/, size_t /*n*/, uint32_t* /*x*/ )
+{
+    return 0;
+}
+
+static size_t VerifyScalar( const uint32_t* /*p*/, size_t /*n*/, uint32_t* /*x*/ )
+{
+    return 0;
+}
+
+#if defined(MEM_PATTERN_X86)
+//---------------------------------------------------------------------------------------------------------------------
+// SSE2: 2 lanes per register, 8 registers in flight.
+static const size_t g_sse2_lanes = 16;
+static SJumpTable g_sse2_table;
+
+struct SSse2State
+{
+    __m128i  x[8];
+    __m128i  mul, mul_q, base;
+};
+
+TARGET_ISA("sse2")
+static inline void Sse2Init( SSse2State& s, uint32_t x0 )
+{
+    uint32_t x[g_sse2_lanes];
+    LaneStart( x0, x, g_sse2_lanes );
+
+    for( int j = 0; j < 8; ++j )
+    {
+        s.x[j] = _mm_set_epi32( 0, (int)x[2*j+1], 0, (int)x[2*j] );
+    }
+
+    s.mul = _mm_set1_epi32( (int)g_sse2_table.mul );
+    s.mul_q = _mm_set1_epi32( (int)g_sse2_table.mul_q );
+    s.base = _mm_set_epi32( 0, (int)g_magic_base, 0, (int)g_magic_base );
+}
+
+TARGET_ISA("sse2")
+static inline __m128i Sse2Step( __m128i x, const SSse2State& s )
+{
+    __m128i q = _mm_srli_epi64( _mm_mul_epu32( x, s.mul_q ), 32 );
+    __m128i r = _mm_sub_epi64( _mm_mul_epu32( x, s.mul ), _mm_mul_epu32( q, s.base ) );
+    __m128i t = _mm_sub_epi64( r, s.base );
+    __m128i neg = _mm_srai_epi32( _mm_shuffle_epi32( t, _MM_SHUFFLE(3,3,1,1) ), 31 );  // r < B
+    return _mm_or_si128( _mm_and_si128( neg, r ), _mm_andnot_si128( neg, t ) );
+}
+
+TARGET_ISA("sse2")
+static inline __m128i Sse2Pack( __m128i a, __m128i b )
+{
+    __m128i a1 = _mm_shuffle_epi32( a, _MM_SHUFFLE(3,1,2,0) );
+    __m128i b1 = _mm_shuffle_epi32( b, _MM_SHUFFLE(3,1,2,0) );
+    return _mm_unpacklo_epi64( a1, b1 );
+}
+
+TARGET_ISA("sse2")
+static size_t FillSse2( uint32_t* p, size_t n, uint32_t* x )
+{
+    SSse2State s;
+    Sse2Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_sse2_lanes <= n; done += g_sse2_lanes )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            _mm_storeu_si128( (__m128i*)( p + done + 4*j ), Sse2Pack( s.x[2*j], s.x[2*j+1] ) );
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Sse2Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm_cvtsi128_si32( s.x[0] );
+    return done;
+}
+
+TARGET_ISA("sse2")
+static size_t VerifySse2( const uint32_t* p, size_t n, uint32_t* x )
+{
+    SSse2State s;
+    Sse2Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_sse2_lanes <= n; done += g_sse2_lanes )
+    {
+        __m128i eq = _mm_set1_epi32(-1);
+
+        for( int j = 0; j < 4; ++j )
+        {
+            __m128i v = _mm_loadu_si128( (const __m128i*)( p + done + 4*j ) );
+            eq = _mm_and_si128( eq, _mm_cmpeq_epi32( v, Sse2Pack( s.x[2*j], s.x[2*j+1] ) ) );
+        }
+
+        if( _mm_movemask_epi8(eq) != 0xffff )
+        {
+            break;
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Sse2Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm_cvtsi128_si32( s.x[0] );
+    return done;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// AVX2: 4 lanes per register, 8 registers in flight.
+static const size_t g_avx2_lanes = 32;
+static SJumpTable g_avx2_table;
+
+struct SAvx2State
+{
+    __m256i  x[8];
+    __m256i  mul, mul_q, base, pack;
+};
+
+TARGET_ISA("avx2")
+static inline void Avx2Init( SAvx2State& s, uint32_t x0 )
+{
+    uint32_t x[g_avx2_lanes];
+    LaneStart( x0, x, g_avx2_lanes );
+
+    for( int j = 0; j < 8; ++j )
+    {
+        s.x[j] = _mm256_set_epi64x( x[4*j+3], x[4*j+2], x[4*j+1], x[4*j] );
+    }
+
+    s.mul = _mm256_set1_epi32( (int)g_avx2_table.mul );
+    s.mul_q = _mm256_set1_epi32( (int)g_avx2_table.mul_q );
+    s.base = _mm256_set1_epi64x(g_magic_base);
+    s.pack = _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 );
+}
+
+TARGET_ISA("avx2")
+static inline __m256i Avx2Step( __m256i x, const SAvx2State& s )
+{
+    __m256i q = _mm256_srli_epi64( _mm256_mul_epu32( x, s.mul_q ), 32 );
+    __m256i r = _mm256_sub_epi64( _mm256_mul_epu32( x, s.mul ), _mm256_mul_epu32( q, s.base ) );
+    __m256i t = _mm256_sub_epi64( r, s.base );
+    return _mm256_blendv_epi8( t, r, _mm256_cmpgt_epi64( s.base, r ) );
+}
+
+TARGET_ISA("avx2")
+static inline __m256i Avx2Pack( __m256i a, __m256i b, const SAvx2State& s )
+{
+    __m256i pa = _mm256_permutevar8x32_epi32( a, s.pack );
+    __m256i pb = _mm256_permutevar8x32_epi32( b, s.pack );
+    return _mm256_inserti128_si256( pa, _mm256_castsi256_si128(pb), 1 );
+}
+
+TARGET_ISA("avx2")
+static size_t FillAvx2( uint32_t* p, size_t n, uint32_t* x )
+{
+    SAvx2State s;
+    Avx2Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_avx2_lanes <= n; done += g_avx2_lanes )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            _mm256_storeu_si256( (__m256i*)( p + done + 8*j ), Avx2Pack( s.x[2*j], s.x[2*j+1], s ) );
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Avx2Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm256_extract_epi32( s.x[0], 0 );
+    return done;
+}
+
+TARGET_ISA("avx2")
+static size_t VerifyAvx2( const uint32_t* p, size_t n, uint32_t* x )
+{
+    SAvx2State s;
+    Avx2Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_avx2_lanes <= n; done += g_avx2_lanes )
+    {
+        __m256i eq = _mm256_set1_epi32(-1);
+
+        for( int j = 0; j < 4; ++j )
+        {
+            __m256i v = _mm256_loadu_si256( (const __m256i*)( p + done + 8*j ) );
+            eq = _mm256_and_si256( eq, _mm256_cmpeq_epi32( v, Avx2Pack( s.x[2*j], s.x[2*j+1], s ) ) );
+        }
+
+        if( _mm256_movemask_epi8(eq) != -1 )
+        {
+            break;
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Avx2Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm256_extract_epi32( s.x[0], 0 );
+    return done;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// AVX-512: 8 lanes per register, 8 registers in flight.
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about the _mm512_undefined_epi32() self-initialization inside avx512fintrin.h.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+static const size_t g_avx512_lanes = 64;
+static SJumpTable g_avx512_table;
+
+struct SAvx512State
+{
+    __m512i  x[8];
+    __m512i  mul, mul_q, base, pack;
+};
+
+TARGET_ISA("avx512f")
+static inline void Avx512Init( SAvx512State& s, uint32_t x0 )
+{
+    uint32_t x[g_avx512_lanes];
+    LaneStart( x0, x, g_avx512_lanes );
+
+    for( int j = 0; j < 8; ++j )
+    {
+        s.x[j] = _mm512_set_epi64( x[8*j+7], x[8*j+6], x[8*j+5], x[8*j+4], x[8*j+3], x[8*j+2], x[8*j+1], x[8*j] );
+    }
+
+    s.mul = _mm512_set1_epi32( (int)g_avx512_table.mul );
+    s.mul_q = _mm512_set1_epi32( (int)g_avx512_table.mul_q );
+    s.base = _mm512_set1_epi64(g_magic_base);
+    s.pack = _mm512_setr_epi32( 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30 );
+}
+
+TARGET_ISA("avx512f")
+static inline __m512i Avx512Step( __m512i x, const SAvx512State& s )
+{
+    __m512i q = _mm512_srli_epi64( _mm512_mul_epu32( x, s.mul_q ), 32 );
+    __m512i r = _mm512_sub_epi64( _mm512_mul_epu32( x, s.mul ), _mm512_mul_epu32( q, s.base ) );
+    return _mm512_mask_sub_epi64( r, _mm512_cmpge_epu64_mask( r, s.base ), r, s.base );
+}
+
+TARGET_ISA("avx512f")
+static inline __m512i Avx512Pack( __m512i a, __m512i b, const SAvx512State& s )
+{
+    return _mm512_permutex2var_epi32( a, s.pack, b );
+}
+
+TARGET_ISA("avx512f")
+static size_t FillAvx512( uint32_t* p, size_t n, uint32_t* x )
+{
+    SAvx512State s;
+    Avx512Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_avx512_lanes <= n; done += g_avx512_lanes )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            _mm512_storeu_si512( (void*)( p + done + 16*j ), Avx512Pack( s.x[2*j], s.x[2*j+1], s ) );
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Avx512Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm_cvtsi128_si32( _mm512_castsi512_si128( s.x[0] ) );
+    return done;
+}
+
+TARGET_ISA("avx512f")
+static size_t VerifyAvx512( const uint32_t* p, size_t n, uint32_t* x )
+{
+    SAvx512State s;
+    Avx512Init( s, *x );
+    size_t done = 0;
+
+    for( ; done + g_avx512_lanes <= n; done += g_avx512_lanes )
+    {
+        __mmask16 ne = 0;
+
+        for( int j = 0; j < 4; ++j )
+        {
+            __m512i v = _mm512_loadu_si512( (const void*)( p + done + 16*j ) );
+            ne |= _mm512_cmpneq_epi32_mask( v, Avx512Pack( s.x[2*j], s.x[2*j+1], s ) );
+        }
+
+        if( ne != 0 )
+        {
+            break;
+        }
+
+        for( int j = 0; j < 8; ++j )
+        {
+            s.x[j] = Avx512Step( s.x[j], s );
+        }
+    }
+
+    *x = (uint32_t)_mm_cvtsi128_si32( _mm512_castsi512_si128( s.x[0] ) );
+    return done;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+#if defined(_MSC_VER)
+static bool CpuSupports( const char* isa )
+{
+    int r[4];
+    __cpuid( r, 0 );
+    int max_leaf = r[0];
+
+    __cpuid( r, 1 );
+    bool sse2 = ( r[3] & (1 << 26) ) != 0;
+    bool os_avx = (  ( r[2] & (1 << 27) ) != 0  &&  ( r[2] & (1 << 28) ) != 0  &&  ( _xgetbv(0) & 0x06 ) == 0x06  );
+    bool os_avx512 = (  os_avx  &&  ( _xgetbv(0) & 0xe6 ) == 0xe6  );
+
+    if( max_leaf >= 7 )
+    {
+        __cpuidex( r, 7, 0 );
+    }
+    else
+    {
+        r[1] = 0;
+    }
+
+    if( strcmp( isa, "sse2" ) == 0 )  return sse2;
+    if( strcmp( isa, "avx2" ) == 0 )  return os_avx  &&  ( r[1] & (1 << 5) ) != 0;
+    if( strcmp( isa, "avx512f" ) == 0 )  return os_avx512  &&  ( r[1] & (1 << 16) ) != 0;
+    return false;
+}
+#else
+static bool CpuSupports( const char* isa )
+{
+    __builtin_cpu_init();
+
+    if( strcmp( isa, "sse2" ) == 0 )  return __builtin_cpu_supports("sse2");
+    if( strcmp( isa, "avx2" ) == 0 )  return __builtin_cpu_supports("avx2");
+    if( strcmp( isa, "avx512f" ) == 0 )  return __builtin_cpu_supports("avx512f");
+    return false;
+}
+#endif
+
+#endif // defined(MEM_PATTERN_X86)
+
+//---------------------------------------------------------------------------------------------------------------------
+struct SPatternKernel
+{
+    const char*  name;
+    const char*  isa;  // NULL - always supported
+    FFillKernel  fill;
+    FVerifyKernel  verify;
+};
+
+static const SPatternKernel g_kernels[] =
+{
+    { "scalar",  NULL,       &FillScalar,  &VerifyScalar },
+#if defined(MEM_PATTERN_X86)
+    { "sse2",    "sse2",     &FillSse2,    &VerifySse2 },
+    { "avx2",    "avx2",     &FillAvx2,    &VerifyAvx2 },
+    { "avx512",  "avx512f",  &FillAvx512,  &VerifyAvx512 },
+#endif
+};
+
+static const int g_kernels_count = (int)( sizeof(g_kernels) / sizeof(g_kernels[0]) );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Builds the jump tables and picks the widest supported kernel before main() starts.
+class CPatternDispatch
+{
+public:
+    const SPatternKernel* volatile  kernel;
+
+    CPatternDispatch() : kernel(&g_kernels[0])
+    {
+#if defined(MEM_PATTERN_X86)
+        InitJumpTable( &g_sse2_table, g_sse2_lanes );
+        InitJumpTable( &g_avx2_table, g_avx2_lanes );
+        InitJumpTable( &g_avx512_table, g_avx512_lanes );
+#endif
+
+        for( int j = g_kernels_count - 1; j > 0; --j )
+        {
+            if( IsSupported( g_kernels[j] ) )
+            {
+                kernel = &g_kernels[j];
+                break;
+            }
+        }
+    }
+
+    static bool IsSupported( const SPatternKernel& k )
+    {
+#if defined(MEM_PATTERN_X86)
+        return  k.isa == NULL  ||  CpuSupports(k.isa);
+#else
+        return  k.isa == NULL;
+#endif
+    }
+};
+
+static CPatternDispatch g_dispatch;
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void MemPatternFill( void* ptr, size_t sz )
+{
+    uint32_t* p = (uint32_t*)ptr;
+    size_t n = sz/sizeof(uint32_t);
+    uint32_t x = g_magic_init;
+
+    size_t j = g_dispatch.kernel->fill( p, n, &x );
+
+    for( ; j < n; ++j, x = NextMagic(x) )
+    {
+        p[j] = x;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#if UINTPTR_MAX > 0xffffffffUL
+#define PRINTF_PTR_SIZE "16"
+#else
+#define PRINTF_PTR_SIZE "8"
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemPatternVerify( int index, const void* ptr, size_t sz, char* report, size_t report_size )
+{
+    return MemPatternVerifyRange( index, ptr, sz, 0, sz, report, report_size );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemPatternVerifyRange( int index, const void* ptr, size_t sz, size_t begin, size_t end,
+                                                                                char* report, size_t report_size )
+{
+    size_t n = sz/sizeof(uint32_t);
+    size_t j0 = begin/sizeof(uint32_t);
+    size_t j1 = ( end < sz ? end/sizeof(uint32_t) : n );
+
+    if( j0 >= j1 )
+    {
+        return true;
+    }
+
+    uint32_t x = MagicAt(j0);
+    const uint32_t* p0 = (const uint32_t*)ptr;
+    const uint32_t* p1 = p0 + j1;
+    const uint32_t* p = p0 + j0;
+
+    p += g_dispatch.kernel->verify( p, j1 - j0, &x );
+
+    for(  ;;  ++p,  x = NextMagic(x)  )
+    {
+        if( p >= p1 )
+        {
+            return true;
+        }
+
+        if( *p != x )
+        {
+            break;
+        }
+    }
+
+    uint32_t x1 = *p;
+    const uint32_t* p2 = p;
+
+    while(  ++p < p1  &&  *p == x1  );
+
+    MemReport(  report,  report_size,  "\n[%d] ALERT!!! Buffer verification failed: ptr=0x%0" PRINTF_PTR_SIZE
+                                                "llx, total_size=%lu, valid_size=%lu, content=%lu*{0x%08lx}...\n\n",
+        index,  (unsigned long long)ptr,  (unsigned long)sz,  (unsigned long)( (const char*)p2 - (const char*)ptr ),
+                                                                    (unsigned long)( p - p2 ),  (unsigned long)x1  );
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemReport( char* report, size_t report_size, const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+
+    if( report == NULL )
+    {
+        vprintf( format, args );
+    }
+    else if( report_size > 0 )
+    {
+        vsnprintf( report, report_size, format, args );
+    }
+
+    va_end(args);
+}
+
+//=====================================================================================================================
+const char* MemPatternKernelName()
+{
+    return g_dispatch.kernel->name;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemPatternSetKernel( const char* name )
+{
+    for( int j = 0; j < g_kernels_count; ++j )
+    {
+        if(  strcmp( name, g_kernels[j].name ) == 0  &&  CPatternDispatch::IsSupported( g_kernels[j] )  )
+        {
+            g_dispatch.kernel = &g_kernels[j];
+            return true;
+        }
+    }
+
+    return false;
+}
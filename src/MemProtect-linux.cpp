@@ -0,0 +1,421 @@
+#include <MemUtils.h>
+#include <MemFingerprint.h>
+#include <MemPattern.h>
+#include <MemVerify.h>
+#include <utils.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static EMemVerifyMode g_verify_mode = MemVerifyPattern;
+
+static const char* const g_verify_mode_names[MemVerifyModeCount] = { "pattern", "pages", "hash", "sampled" };
+
+static unsigned g_sample_lines = 4;
+
+//---------------------------------------------------------------------------------------------------------------------
+// Registry of PROT_NONE (or fingerprinted) buffers, shared with the SIGSEGV handler: a fixed open-addressing table,
+// entries are only published (ptr != NULL, release) when complete, so the handler never sees a half-written entry.
+// Fingerprinted buffers stay accessible, the handler never gets a fault in them. Entries are added and removed under
+// 'g_guard_lock', lookups take no lock.
+struct SGuard
+{
+    volatile int32_t  state;
+    int  index;
+    char*  ptr;
+    size_t  size;
+    volatile int32_t  faults;
+    volatile int32_t  fault_tid;
+    volatile int64_t  first_fault;  // offset << 2 | EFaultAccess of the first fault, 0 - none yet
+
+    bool  fingerprint;
+    uint32_t  expected;  // fingerprint taken by MemProtect
+    SMemFingerprint  running;  // fingerprint being recomputed, MemVerifyRange() advances it
+};
+
+static const int32_t g_guard_empty = 0;
+static const int32_t g_guard_used = 1;
+static const int32_t g_guard_removed = 2;
+
+enum EFaultAccess
+{
+    FaultAccess = 1,  // read or write, not known
+    FaultRead,
+    FaultWrite
+};
+
+static const char* const g_fault_access_names[4] = { "access", "access", "read", "write" };
+
+static const size_t g_max_guards = 32768;  // must be a power of 2
+static SGuard g_guards[g_max_guards];
+static CMutex g_guard_lock;
+static volatile int32_t g_guards_full = 0;
+
+static size_t g_page_size = 4096;
+static struct sigaction g_prev_sigsegv;
+
+//---------------------------------------------------------------------------------------------------------------------
+static size_t GuardSlot( const void* ptr )
+{
+    uint64_t h = (uint64_t)( (uintptr_t)ptr >> 12 ) * 0x9e3779b97f4a7c15ULL;
+    return (size_t)( h >> 32 ) & ( g_max_guards - 1 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static SGuard* AddGuard( int index, char* ptr, size_t sz )
+{
+    CMutexLockGuard lock_guard(g_guard_lock);
+
+    for(  size_t s = GuardSlot(ptr), n = 0;  n < g_max_guards;  s = ( s + 1 ) & ( g_max_guards - 1 ), ++n  )
+    {
+        SGuard& g = g_guards[s];
+
+        if( g.state != g_guard_used )
+        {
+            g.state = g_guard_used;
+            g.index = index;
+            g.size = sz;
+            g.faults = 0;
+            g.fault_tid = 0;
+            g.first_fault = 0;
+            g.fingerprint = false;
+            __atomic_store_n( &g.ptr, ptr, __ATOMIC_RELEASE );
+            return &g;
+        }
+    }
+
+    if( Int32AtomicAdd( &g_guards_full, 1 ) == 0 )
+    {
+        printf( "[%d] MemProtect: all %lu guard entries are used, more buffers get only the guard pattern.\n",
+                                                                                index, (unsigned long)g_max_guards );
+        fflush(stdout);
+    }
+
+    return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// A removed entry is left as a tombstone, so the probe sequences through it go on; tombstones at the end of a probe
+// sequence (the next slot is empty) are emptied again, or lookups would eventually probe the whole table. No live
+// entry lies beyond such a slot, and none can be added meanwhile.
+static void RemoveGuard( SGuard* g )
+{
+    CMutexLockGuard lock_guard(g_guard_lock);
+
+    __atomic_store_n( &g->ptr, (char*)NULL, __ATOMIC_RELEASE );
+    g->state = g_guard_removed;
+
+    const size_t mask = g_max_guards - 1;
+
+    for(  size_t s = (size_t)( g - g_guards );
+            g_guards[s].state == g_guard_removed  &&  g_guards[ ( s + 1 ) & mask ].state == g_guard_empty;
+            s = ( s - 1 ) & mask  )
+    {
+        g_guards[s].state = g_guard_empty;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static SGuard* FindGuard( const void* ptr )
+{
+    for(  size_t s = GuardSlot(ptr), n = 0;  n < g_max_guards;  s = ( s + 1 ) & ( g_max_guards - 1 ), ++n  )
+    {
+        SGuard& g = g_guards[s];
+
+        if( g.state == g_guard_empty )
+        {
+            break;
+        }
+
+        if(  g.state == g_guard_used  &&  __atomic_load_n( &g.ptr, __ATOMIC_ACQUIRE ) == ptr  )
+        {
+            return &g;
+        }
+    }
+
+    return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#if UINTPTR_MAX > 0xffffffffUL
+#define PRINTF_PTR_SIZE "16"
+#else
+#define PRINTF_PTR_SIZE "8"
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+// Records the first access to a protected buffer and lets the faulting thread continue: the page is made accessible
+// again and MemUnprotect reports the access. Only async-signal-safe calls here, nothing is printed.
+static void SigSegvHandler( int sig, siginfo_t* info, void* uctx )
+{
+    char* addr = (char*)info->si_addr;
+
+    for( size_t j = 0; j < g_max_guards; ++j )
+    {
+        SGuard& g = g_guards[j];
+        char* p = __atomic_load_n( &g.ptr, __ATOMIC_ACQUIRE );
+
+        if(  p == NULL  ||  addr < p  ||  addr >= p + g.size  )
+        {
+            continue;
+        }
+
+        // The entry may have been replaced while its size was read.
+        if( __atomic_load_n( &g.ptr, __ATOMIC_ACQUIRE ) != p )
+        {
+            continue;
+        }
+
+        if( Int32AtomicAdd( &g.faults, 1 ) == 0 )
+        {
+            int64_t access = FaultAccess;
+#if defined(__x86_64__)
+            access = (  ( ((ucontext_t*)uctx)->uc_mcontext.gregs[REG_ERR] & 2 ) != 0  ?  FaultWrite  :  FaultRead  );
+#endif
+            g.fault_tid = (int32_t)syscall(SYS_gettid);
+            __atomic_store_n( &g.first_fault, ( (int64_t)( addr - p ) << 2 ) | access, __ATOMIC_RELEASE );
+        }
+
+        mprotect( (void*)( (uintptr_t)addr & ~( (uintptr_t)g_page_size - 1 ) ), g_page_size, PROT_READ | PROT_WRITE );
+        return;
+    }
+
+    // Not a guarded buffer: a previous handler gets the fault, otherwise the default action ends the process when the
+    // access faults again.
+    if(  ( g_prev_sigsegv.sa_flags & SA_SIGINFO ) != 0  &&  g_prev_sigsegv.sa_sigaction != NULL  )
+    {
+        g_prev_sigsegv.sa_sigaction( sig, info, uctx );
+        return;
+    }
+
+    if(  g_prev_sigsegv.sa_handler != SIG_DFL  &&  g_prev_sigsegv.sa_handler != SIG_IGN  )
+    {
+        g_prev_sigsegv.sa_handler(sig);
+        return;
+    }
+
+    signal( SIGSEGV, SIG_DFL );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool IsPageAligned( const void* ptr )
+{
+    return (uintptr_t)ptr % g_page_size == 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool AddFingerprint( int index, char* ptr, size_t sz )
+{
+    SGuard* g = AddGuard( index, ptr, sz );
+
+    if( g == NULL )
+    {
+        return false;
+    }
+
+    // A new seed on every release, so the sampled lines are not always the same.
+    uint32_t seed = (uint32_t)MonotonicTimeNs();
+    unsigned lines = ( g_verify_mode == MemVerifySampled ? g_sample_lines : 0 );
+
+    MemFingerprintInit( &g->running, lines, seed );
+    MemFingerprintUpdate( &g->running, ptr, sz, sz );
+    g->expected = MemFingerprintValue( &g->running );
+
+    MemFingerprintInit( &g->running, lines, seed );
+    g->fingerprint = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static bool CheckFingerprint( SGuard* g, int index, void* ptr, size_t sz, char* report, size_t report_size )
+{
+    MemFingerprintUpdate( &g->running, ptr, sz, sz );
+    uint32_t value = MemFingerprintValue( &g->running );
+    unsigned lines = g->running.sample_lines;
+
+    uint32_t expected = g->expected;
+    RemoveGuard(g);
+
+    if( value == expected )
+    {
+        return true;
+    }
+
+    char sampling[32] = "all bytes";
+
+    if( lines > 0 )
+    {
+        snprintf( sampling, sizeof(sampling), "%u lines/page", lines );
+    }
+
+    MemReport(  report,  report_size,  "\n[%d] ALERT!!! Buffer verification failed: ptr=0x%0" PRINTF_PTR_SIZE
+                                                "llx, total_size=%lu, fingerprint=0x%08lx, expected=0x%08lx (%s)\n\n",
+                index,  (unsigned long long)ptr,  (unsigned long)sz,  (unsigned long)value,
+                (unsigned long)expected,  sampling  );
+    return false;
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+bool MemProtect( int index, void* ptr, size_t sz )
+{
+    if(  ( g_verify_mode == MemVerifyHash  ||  g_verify_mode == MemVerifySampled )
+            &&  AddFingerprint( index, (char*)ptr, sz )  )
+    {
+        return true;
+    }
+
+    MemPatternFill( ptr, sz );
+
+    // Device DMA does not go through the page tables, PROT_NONE only traps the CPU: the pattern under the protection
+    // is what catches a late write of the device.
+    if(  g_verify_mode == MemVerifyPages  &&  IsPageAligned(ptr)  )
+    {
+        SGuard* g = AddGuard( index, (char*)ptr, sz );
+
+        if( g == NULL )
+        {
+            return true;
+        }
+
+        if( mprotect( ptr, sz, PROT_NONE ) == 0 )
+        {
+            return false;
+        }
+
+        printf(  "[%d] mprotect( 0x%0" PRINTF_PTR_SIZE "llx, %lu, PROT_NONE ) failed.\n",
+                                                                index, (unsigned long long)ptr, (unsigned long)sz  );
+        RemoveGuard(g);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemUnprotect( int index, void* ptr, size_t sz, size_t verified, char* report, size_t report_size )
+{
+    SGuard* g = NULL;
+
+    if(  g_verify_mode == MemVerifyPattern  ||  ( g = FindGuard(ptr) ) == NULL  )
+    {
+        return MemPatternVerifyRange( index, ptr, sz, verified, sz, report, report_size );
+    }
+
+    if( g->fingerprint )
+    {
+        return CheckFingerprint( g, index, ptr, sz, report, report_size );
+    }
+
+    if( mprotect( ptr, sz, PROT_READ | PROT_WRITE ) != 0 )
+    {
+        printf(  "\n[%d] mprotect( 0x%0" PRINTF_PTR_SIZE "llx, %lu, PROT_READ | PROT_WRITE ) failed.\n",
+                                                                index, (unsigned long long)ptr, (unsigned long)sz  );
+    }
+
+    int32_t faults = g->faults;
+    int64_t first_fault = __atomic_load_n( &g->first_fault, __ATOMIC_ACQUIRE );
+    long tid = g->fault_tid;
+    RemoveGuard(g);
+
+    // MemVerifyRange() cannot read a protected buffer, the pattern is checked here in full.
+    if( faults == 0 )
+    {
+        return MemPatternVerifyRange( index, ptr, sz, 0, sz, report, report_size );
+    }
+
+    MemReport(  report,  report_size,  "\n[%d] ALERT!!! %s of a released buffer: ptr=0x%0" PRINTF_PTR_SIZE
+                                        "llx, total_size=%lu, offset=%lu, thread=%ld, %ld fault(s)\n\n",
+                index,  g_fault_access_names[ first_fault & 3 ],  (unsigned long long)ptr,  (unsigned long)sz,
+                (unsigned long)( first_fault >> 2 ),  tid,  (long)faults  );
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemVerifyRange( int index, const void* ptr, size_t sz, size_t begin, size_t end, char* report, size_t report_size )
+{
+    SGuard* g = NULL;
+
+    if(  g_verify_mode != MemVerifyPattern  &&  ( g = FindGuard(ptr) ) != NULL  )
+    {
+        // A protected buffer cannot be read (MemUnprotect checks its pattern), a fingerprint is compared once
+        // complete (in MemUnprotect).
+        if( g->fingerprint )
+        {
+            MemFingerprintUpdate( &g->running, ptr, sz, end );
+        }
+
+        return true;
+    }
+
+    return MemPatternVerifyRange( index, ptr, sz, begin, end, report, report_size );
+}
+
+//=====================================================================================================================
+void MemVerifySetMode( EMemVerifyMode mode )
+{
+    if(  mode == MemVerifyPages  &&  g_verify_mode != MemVerifyPages  )
+    {
+        g_page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+        struct sigaction sa;
+        memset( &sa, 0, sizeof(sa) );
+        sa.sa_sigaction = &SigSegvHandler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+
+        if( sigaction( SIGSEGV, &sa, &g_prev_sigsegv ) != 0 )
+        {
+            printf( "MemVerifySetMode: sigaction(SIGSEGV) failed, using the guard pattern.\n" );
+            fflush(stdout);
+            return;
+        }
+    }
+
+    g_verify_mode = mode;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+EMemVerifyMode MemVerifyGetMode()
+{
+    return g_verify_mode;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* MemVerifyModeName( EMemVerifyMode mode )
+{
+    return (  mode >= 0  &&  mode < MemVerifyModeCount  ?  g_verify_mode_names[mode]  :  "UNRECOGNIZED"  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool MemVerifyParseMode( const char* name, EMemVerifyMode* mode )
+{
+    for( int j = 0; j < MemVerifyModeCount; ++j )
+    {
+        if( strcmp( name, g_verify_mode_names[j] ) == 0 )
+        {
+            *mode = (EMemVerifyMode)j;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void MemVerifySetSampleLines( unsigned lines )
+{
+    g_sample_lines = (  lines < 1  ?  1  :  lines > 64  ?  64  :  lines  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+unsigned MemVerifyGetSampleLines()
+{
+    return g_sample_lines;
+}
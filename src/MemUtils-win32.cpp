@@ -1,6 +1,7 @@
 #if 1
 #include "MemAlloc-generic.cpp"
 #include "MemProtect-generic.cpp"
+#include "MemPattern.cpp"
 #else
 //=====================================================================================================================
 #include <stdint.h>
@@ -21,7 +22,7 @@
 #endif
 
 //---------------------------------------------------------------------------------------------------------------------
-void MemProtect( int index, void* ptr, size_t sz )
+bool MemProtect( int index, void* ptr, size_t sz )
 {
     DWORD old_protect = PAGE_NOACCESS;
 
@@ -37,10 +38,12 @@ void MemProtect( int index, void* ptr, size_t sz )
         printf(  "\n[%d] Warning: buffer protection flags has been changed: "
                     "ptr=0x0" PRINTF_PTR_SIZE "llx, size=%lu\n",  index, (unsigned long long)ptr, (unsigned long)sz  );
     }
+
+    return false;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-bool MemUnprotect( int index, void* ptr, size_t sz )
+bool MemUnprotect( int index, void* ptr, size_t sz, size_t /*verified*/, char* /*report*/, size_t /*report_size*/ )
 {
     DWORD old_protect = PAGE_READWRITE;
 
@@ -61,9 +64,15 @@ bool MemUnprotect( int index, void* ptr, size_t sz )
     return true;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+bool MemVerifyRange( int, const void*, size_t, size_t, size_t, char*, size_t )
+{
+    return true;  // page protection, nothing to scan
+}
+
 #endif
 //=====================================================================================================================
-void* MemAlloc( size_t sz )
+void* MemAlloc( int /*index*/, size_t sz )
 {
     void* ptr = ::VirtualAlloc( NULL, sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
 
@@ -81,4 +90,15 @@ void MemFree( void* ptr )
     ::VirtualFree( ptr, 0, MEM_RELEASE );
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+void MemPrefault( int /*index*/, void* ptr, size_t sz )
+{
+    volatile char* p = (volatile char*)ptr;
+
+    for( size_t j = 0; j < sz; j += 4096 )
+    {
+        p[j] = 0;
+    }
+}
+
 #endif
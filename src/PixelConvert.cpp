@@ -0,0 +1,996 @@
+#include <PixelConvert.h>
+#include <WorkerPool.h>
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+#if defined(__i386__) || defined(__amd64__) || defined(_M_IX86) || defined(_M_X64)
+#define PIXEL_CONVERT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_ISA(isa) __attribute__(( target(isa) ))
+#else
+#define TARGET_ISA(isa)
+#endif
+
+//=====================================================================================================================
+// Row kernels. A UYVY pixel pair is U Y0 V Y1. A kernel converts whole blocks of pixels of one row (4:2:2) or of a
+// row pair (4:2:0) and returns the number of pixels done, the caller finishes the row with scalar code. Luma is a
+// byte shuffle; 4:2:0 chroma is the rounded average of the two rows, (a+b+1)>>1, which is what pavgb computes.
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+typedef unsigned (*FRowsI420)( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                                                                                    unsigned width );
+typedef unsigned (*FRowsNv12)( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                                                                                                    unsigned width );
+typedef unsigned (*FRowYuv422p)( const uint8_t* s, uint8_t* y, uint8_t* u, uint8_t* v, unsigned width );
+
+// v210 kernels work on whole 6-pixel groups, the returned count is a multiple of 6.
+typedef unsigned (*FRowV210Unpack)( const uint8_t* s, uint16_t* y, uint16_t* u, uint16_t* v, unsigned width );
+typedef unsigned (*FRowV210Pack)( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint8_t* d,
+                                                                                                    unsigned width );
+
+//---------------------------------------------------------------------------------------------------------------------
+static void TailI420( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                                                                        unsigned x, unsigned width )
+{
+    for( ; x < width; x += 2 )
+    {
+        const uint8_t* a = s0 + 2*x;
+        const uint8_t* b = s1 + 2*x;
+        y0[x] = a[1];
+        y0[x+1] = a[3];
+        y1[x] = b[1];
+        y1[x+1] = b[3];
+        u[x/2] = (uint8_t)( ( a[0] + b[0] + 1 ) >> 1 );
+        v[x/2] = (uint8_t)( ( a[2] + b[2] + 1 ) >> 1 );
+    }
+}
+
+static void TailNv12( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                                                                                        unsigned x, unsigned width )
+{
+    for( ; x < width; x += 2 )
+    {
+        const uint8_t* a = s0 + 2*x;
+        const uint8_t* b = s1 + 2*x;
+        y0[x] = a[1];
+        y0[x+1] = a[3];
+        y1[x] = b[1];
+        y1[x+1] = b[3];
+        uv[x] = (uint8_t)( ( a[0] + b[0] + 1 ) >> 1 );
+        uv[x+1] = (uint8_t)( ( a[2] + b[2] + 1 ) >> 1 );
+    }
+}
+
+static void TailYuv422p( const uint8_t* s, uint8_t* y, uint8_t* u, uint8_t* v, unsigned x, unsigned width )
+{
+    for( ; x < width; x += 2 )
+    {
+        const uint8_t* a = s + 2*x;
+        y[x] = a[1];
+        y[x+1] = a[3];
+        u[x/2] = a[0];
+        v[x/2] = a[2];
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Pixels [x, width) of a v210 row, 'x' is a multiple of 6; samples of the last group beyond the width are dropped.
+static void TailV210Unpack( const uint8_t* s, uint16_t* y, uint16_t* u, uint16_t* v, unsigned x, unsigned width )
+{
+    for( ; x < width; x += 6 )
+    {
+        uint32_t w[4];
+        uint16_t t[12];
+        memcpy( w, s + x/6*16, sizeof(w) );
+
+        for( int k = 0; k < 12; ++k )
+        {
+            t[k] = (uint16_t)( ( w[k/3] >> ( 10*(k%3) ) ) & 0x3ff );
+        }
+
+        for(  unsigned c = 0;  c < 3  &&  x + 2*c < width;  ++c  )
+        {
+            u[ x/2 + c ] = t[4*c];
+            y[ x + 2*c ] = t[4*c + 1];
+            v[ x/2 + c ] = t[4*c + 2];
+            y[ x + 2*c + 1 ] = t[4*c + 3];
+        }
+    }
+}
+
+// Groups from pixel 'x' (a multiple of 6) to the end of the row and the zero padding up to 'row_bytes'.
+static void TailV210Pack( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint8_t* d, unsigned x,
+                                                                                unsigned width, size_t row_bytes )
+{
+    for( ; x < width; x += 6 )
+    {
+        uint32_t t[12] = { 0 };
+        uint32_t w[4];
+
+        for(  unsigned c = 0;  c < 3  &&  x + 2*c < width;  ++c  )
+        {
+            t[4*c] = u[ x/2 + c ] & 0x3ffU;
+            t[4*c + 1] = y[ x + 2*c ] & 0x3ffU;
+            t[4*c + 2] = v[ x/2 + c ] & 0x3ffU;
+            t[4*c + 3] = y[ x + 2*c + 1 ] & 0x3ffU;
+        }
+
+        for( int k = 0; k < 4; ++k )
+        {
+            w[k] = t[3*k] | ( t[3*k + 1] << 10 ) | ( t[3*k + 2] << 20 );
+        }
+
+        memcpy( d + x/6*16, w, sizeof(w) );
+    }
+
+    size_t used = ( width + 5 ) / 6 * 16;
+    memset( d + used, 0, row_bytes - used );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static unsigned I420Scalar( const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, unsigned )
+{
+    return 0;
+}
+
+static unsigned Nv12Scalar( const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, unsigned )
+{
+    return 0;
+}
+
+static unsigned Yuv422pScalar( const uint8_t*, uint8_t*, uint8_t*, uint8_t*, unsigned )
+{
+    return 0;
+}
+
+static unsigned V210UnpackScalar( const uint8_t*, uint16_t*, uint16_t*, uint16_t*, unsigned )
+{
+    return 0;
+}
+
+static unsigned V210PackScalar( const uint16_t*, const uint16_t*, const uint16_t*, uint8_t*, unsigned )
+{
+    return 0;
+}
+
+#if defined(PIXEL_CONVERT_X86)
+//---------------------------------------------------------------------------------------------------------------------
+// SSSE3: 16 pixels (two 16-byte loads) per step. pshufb is all the kernel needs beyond SSE2, so it runs on every
+// SSE4 CPU as well. Luma takes the odd bytes of both loads, planar chroma packs U into bytes 0-7 and V into 8-15,
+// NV12 chroma takes the even bytes, which are interleaved UV already.
+TARGET_ISA("ssse3")
+static inline __m128i Ssse3Luma( __m128i a, __m128i b )
+{
+    const __m128i lo = _mm_setr_epi8( 1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m128i hi = _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, 1, 3, 5, 7, 9, 11, 13, 15 );
+    return _mm_or_si128( _mm_shuffle_epi8( a, lo ), _mm_shuffle_epi8( b, hi ) );
+}
+
+TARGET_ISA("ssse3")
+static inline __m128i Ssse3Chroma( __m128i a, __m128i b )
+{
+    const __m128i lo = _mm_setr_epi8( 0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14, -1, -1, -1, -1 );
+    const __m128i hi = _mm_setr_epi8( -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14 );
+    return _mm_or_si128( _mm_shuffle_epi8( a, lo ), _mm_shuffle_epi8( b, hi ) );
+}
+
+TARGET_ISA("ssse3")
+static inline __m128i Ssse3ChromaPairs( __m128i a, __m128i b )
+{
+    const __m128i lo = _mm_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m128i hi = _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, 0, 2, 4, 6, 8, 10, 12, 14 );
+    return _mm_or_si128( _mm_shuffle_epi8( a, lo ), _mm_shuffle_epi8( b, hi ) );
+}
+
+TARGET_ISA("ssse3")
+static unsigned I420Ssse3( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                                                                                    unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i a0 = _mm_loadu_si128( (const __m128i*)( s0 + 2*x ) );
+        __m128i b0 = _mm_loadu_si128( (const __m128i*)( s0 + 2*x + 16 ) );
+        __m128i a1 = _mm_loadu_si128( (const __m128i*)( s1 + 2*x ) );
+        __m128i b1 = _mm_loadu_si128( (const __m128i*)( s1 + 2*x + 16 ) );
+
+        _mm_storeu_si128( (__m128i*)( y0 + x ), Ssse3Luma( a0, b0 ) );
+        _mm_storeu_si128( (__m128i*)( y1 + x ), Ssse3Luma( a1, b1 ) );
+
+        __m128i c = Ssse3Chroma( _mm_avg_epu8( a0, a1 ), _mm_avg_epu8( b0, b1 ) );
+        _mm_storel_epi64( (__m128i*)( u + x/2 ), c );
+        _mm_storel_epi64( (__m128i*)( v + x/2 ), _mm_srli_si128( c, 8 ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("ssse3")
+static unsigned Nv12Ssse3( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                                                                                                    unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i a0 = _mm_loadu_si128( (const __m128i*)( s0 + 2*x ) );
+        __m128i b0 = _mm_loadu_si128( (const __m128i*)( s0 + 2*x + 16 ) );
+        __m128i a1 = _mm_loadu_si128( (const __m128i*)( s1 + 2*x ) );
+        __m128i b1 = _mm_loadu_si128( (const __m128i*)( s1 + 2*x + 16 ) );
+
+        _mm_storeu_si128( (__m128i*)( y0 + x ), Ssse3Luma( a0, b0 ) );
+        _mm_storeu_si128( (__m128i*)( y1 + x ), Ssse3Luma( a1, b1 ) );
+        _mm_storeu_si128( (__m128i*)( uv + x ), Ssse3ChromaPairs( _mm_avg_epu8( a0, a1 ), _mm_avg_epu8( b0, b1 ) ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("ssse3")
+static unsigned Yuv422pSsse3( const uint8_t* s, uint8_t* y, uint8_t* u, uint8_t* v, unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i a = _mm_loadu_si128( (const __m128i*)( s + 2*x ) );
+        __m128i b = _mm_loadu_si128( (const __m128i*)( s + 2*x + 16 ) );
+
+        _mm_storeu_si128( (__m128i*)( y + x ), Ssse3Luma( a, b ) );
+
+        __m128i c = Ssse3Chroma( a, b );
+        _mm_storel_epi64( (__m128i*)( u + x/2 ), c );
+        _mm_storel_epi64( (__m128i*)( v + x/2 ), _mm_srli_si128( c, 8 ) );
+    }
+
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// v210, one 6-pixel group per step. Unpacking splits the words into 'ab' (sample 0 in the low and sample 1 in the
+// high half of every word) and 'c' (sample 2), then two shuffles gather Y into words 0-5 and U into words 0-2 and V
+// into words 4-6. The stores are 8 words wide and overlap the next group, so a step needs 8 pixels of room in the
+// row. Packing shuffles the samples of each of the three word positions into place and shifts them together.
+TARGET_ISA("ssse3")
+static inline void Ssse3V210Split( __m128i w, __m128i* y, __m128i* uv )
+{
+    const __m128i mask = _mm_set1_epi32(0x3ff);
+    const __m128i y_ab = _mm_setr_epi8( 2, 3, 4, 5, -1, -1, 10, 11, 12, 13, -1, -1, -1, -1, -1, -1 );
+    const __m128i y_c = _mm_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1 );
+    const __m128i uv_ab = _mm_setr_epi8( 0, 1, 6, 7, -1, -1, -1, -1, -1, -1, 8, 9, 14, 15, -1, -1 );
+    const __m128i uv_c = _mm_setr_epi8( -1, -1, -1, -1, 8, 9, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1 );
+
+    __m128i b = _mm_and_si128( _mm_srli_epi32( w, 10 ), mask );
+    __m128i ab = _mm_or_si128( _mm_and_si128( w, mask ), _mm_slli_epi32( b, 16 ) );
+    __m128i c = _mm_and_si128( _mm_srli_epi32( w, 20 ), mask );
+
+    *y = _mm_or_si128( _mm_shuffle_epi8( ab, y_ab ), _mm_shuffle_epi8( c, y_c ) );
+    *uv = _mm_or_si128( _mm_shuffle_epi8( ab, uv_ab ), _mm_shuffle_epi8( c, uv_c ) );
+}
+
+// 'y' - Y0..Y5 in words 0-5, 'uv' - U0..U2 in words 0-2 and V0..V2 in words 4-6.
+TARGET_ISA("ssse3")
+static inline __m128i Ssse3V210Join( __m128i y, __m128i uv )
+{
+    const __m128i mask = _mm_set1_epi32(0x3ff);
+    const __m128i a_y = _mm_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1 );
+    const __m128i a_uv = _mm_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1 );
+    const __m128i b_y = _mm_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1 );
+    const __m128i b_uv = _mm_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1 );
+    const __m128i c_y = _mm_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1 );
+    const __m128i c_uv = _mm_setr_epi8( 8, 9, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1 );
+
+    __m128i a = _mm_and_si128( _mm_or_si128( _mm_shuffle_epi8( y, a_y ), _mm_shuffle_epi8( uv, a_uv ) ), mask );
+    __m128i b = _mm_and_si128( _mm_or_si128( _mm_shuffle_epi8( y, b_y ), _mm_shuffle_epi8( uv, b_uv ) ), mask );
+    __m128i c = _mm_and_si128( _mm_or_si128( _mm_shuffle_epi8( y, c_y ), _mm_shuffle_epi8( uv, c_uv ) ), mask );
+    return _mm_or_si128( a, _mm_or_si128( _mm_slli_epi32( b, 10 ), _mm_slli_epi32( c, 20 ) ) );
+}
+
+TARGET_ISA("ssse3")
+static unsigned V210UnpackSsse3( const uint8_t* s, uint16_t* y, uint16_t* u, uint16_t* v, unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 8 <= width; x += 6 )
+    {
+        __m128i yw, uv;
+        Ssse3V210Split( _mm_loadu_si128( (const __m128i*)( s + x/6*16 ) ), &yw, &uv );
+
+        _mm_storeu_si128( (__m128i*)( y + x ), yw );
+        _mm_storel_epi64( (__m128i*)( u + x/2 ), uv );
+        _mm_storel_epi64( (__m128i*)( v + x/2 ), _mm_srli_si128( uv, 8 ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("ssse3")
+static unsigned V210PackSsse3( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint8_t* d, unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 8 <= width; x += 6 )
+    {
+        __m128i yw = _mm_loadu_si128( (const __m128i*)( y + x ) );
+        __m128i uv = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*)( u + x/2 ) ),
+                                                                    _mm_loadl_epi64( (const __m128i*)( v + x/2 ) ) );
+
+        _mm_storeu_si128( (__m128i*)( d + x/6*16 ), Ssse3V210Join( yw, uv ) );
+    }
+
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// AVX2: 32 pixels (two 32-byte loads) per step. vpshufb works within 128-bit lanes, so the SSSE3 masks leave the
+// lanes of 'a' and 'b' interleaved: one cross-lane permutation puts the quadwords (luma, NV12 chroma) or the dwords
+// (planar chroma, U in the low half and V in the high half) in order.
+TARGET_ISA("avx2")
+static inline __m256i Avx2Luma( __m256i a, __m256i b )
+{
+    const __m256i lo = _mm256_setr_epi8( 1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m256i hi = _mm256_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, 1, 3, 5, 7, 9, 11, 13, 15,
+                                         -1, -1, -1, -1, -1, -1, -1, -1, 1, 3, 5, 7, 9, 11, 13, 15 );
+    __m256i y = _mm256_or_si256( _mm256_shuffle_epi8( a, lo ), _mm256_shuffle_epi8( b, hi ) );
+    return _mm256_permute4x64_epi64( y, _MM_SHUFFLE(3,1,2,0) );
+}
+
+TARGET_ISA("avx2")
+static inline __m256i Avx2Chroma( __m256i a, __m256i b )
+{
+    const __m256i lo = _mm256_setr_epi8( 0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14, -1, -1, -1, -1,
+                                         0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14, -1, -1, -1, -1 );
+    const __m256i hi = _mm256_setr_epi8( -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14,
+                                         -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, 2, 6, 10, 14 );
+    const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+    __m256i c = _mm256_or_si256( _mm256_shuffle_epi8( a, lo ), _mm256_shuffle_epi8( b, hi ) );
+    return _mm256_permutevar8x32_epi32( c, order );
+}
+
+TARGET_ISA("avx2")
+static inline __m256i Avx2ChromaPairs( __m256i a, __m256i b )
+{
+    const __m256i lo = _mm256_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m256i hi = _mm256_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, 0, 2, 4, 6, 8, 10, 12, 14,
+                                         -1, -1, -1, -1, -1, -1, -1, -1, 0, 2, 4, 6, 8, 10, 12, 14 );
+    __m256i c = _mm256_or_si256( _mm256_shuffle_epi8( a, lo ), _mm256_shuffle_epi8( b, hi ) );
+    return _mm256_permute4x64_epi64( c, _MM_SHUFFLE(3,1,2,0) );
+}
+
+TARGET_ISA("avx2")
+static unsigned I420Avx2( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                                                                                    unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i a0 = _mm256_loadu_si256( (const __m256i*)( s0 + 2*x ) );
+        __m256i b0 = _mm256_loadu_si256( (const __m256i*)( s0 + 2*x + 32 ) );
+        __m256i a1 = _mm256_loadu_si256( (const __m256i*)( s1 + 2*x ) );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i*)( s1 + 2*x + 32 ) );
+
+        _mm256_storeu_si256( (__m256i*)( y0 + x ), Avx2Luma( a0, b0 ) );
+        _mm256_storeu_si256( (__m256i*)( y1 + x ), Avx2Luma( a1, b1 ) );
+
+        __m256i c = Avx2Chroma( _mm256_avg_epu8( a0, a1 ), _mm256_avg_epu8( b0, b1 ) );
+        _mm_storeu_si128( (__m128i*)( u + x/2 ), _mm256_castsi256_si128(c) );
+        _mm_storeu_si128( (__m128i*)( v + x/2 ), _mm256_extracti128_si256( c, 1 ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("avx2")
+static unsigned Nv12Avx2( const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1, uint8_t* uv,
+                                                                                                    unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i a0 = _mm256_loadu_si256( (const __m256i*)( s0 + 2*x ) );
+        __m256i b0 = _mm256_loadu_si256( (const __m256i*)( s0 + 2*x + 32 ) );
+        __m256i a1 = _mm256_loadu_si256( (const __m256i*)( s1 + 2*x ) );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i*)( s1 + 2*x + 32 ) );
+
+        _mm256_storeu_si256( (__m256i*)( y0 + x ), Avx2Luma( a0, b0 ) );
+        _mm256_storeu_si256( (__m256i*)( y1 + x ), Avx2Luma( a1, b1 ) );
+        _mm256_storeu_si256( (__m256i*)( uv + x ),
+                                        Avx2ChromaPairs( _mm256_avg_epu8( a0, a1 ), _mm256_avg_epu8( b0, b1 ) ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("avx2")
+static unsigned Yuv422pAvx2( const uint8_t* s, uint8_t* y, uint8_t* u, uint8_t* v, unsigned width )
+{
+    unsigned x = 0;
+
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i a = _mm256_loadu_si256( (const __m256i*)( s + 2*x ) );
+        __m256i b = _mm256_loadu_si256( (const __m256i*)( s + 2*x + 32 ) );
+
+        _mm256_storeu_si256( (__m256i*)( y + x ), Avx2Luma( a, b ) );
+
+        __m256i c = Avx2Chroma( a, b );
+        _mm_storeu_si128( (__m128i*)( u + x/2 ), _mm256_castsi256_si128(c) );
+        _mm_storeu_si128( (__m128i*)( v + x/2 ), _mm256_extracti128_si256( c, 1 ) );
+    }
+
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// v210, two groups (12 pixels) per step, one in each lane with the SSSE3 masks. The Y words of the two lanes are
+// moved together for one store, the chroma of the second lane is stored 3 samples after the first.
+TARGET_ISA("avx2")
+static unsigned V210UnpackAvx2( const uint8_t* s, uint16_t* y, uint16_t* u, uint16_t* v, unsigned width )
+{
+    const __m256i mask = _mm256_set1_epi32(0x3ff);
+    const __m256i y_ab = _mm256_setr_epi8( 2, 3, 4, 5, -1, -1, 10, 11, 12, 13, -1, -1, -1, -1, -1, -1,
+                                           2, 3, 4, 5, -1, -1, 10, 11, 12, 13, -1, -1, -1, -1, -1, -1 );
+    const __m256i y_c = _mm256_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1 );
+    const __m256i uv_ab = _mm256_setr_epi8( 0, 1, 6, 7, -1, -1, -1, -1, -1, -1, 8, 9, 14, 15, -1, -1,
+                                            0, 1, 6, 7, -1, -1, -1, -1, -1, -1, 8, 9, 14, 15, -1, -1 );
+    const __m256i uv_c = _mm256_setr_epi8( -1, -1, -1, -1, 8, 9, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1,
+                                           -1, -1, -1, -1, 8, 9, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1 );
+    const __m256i y_order = _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 7, 7 );
+    unsigned x = 0;
+
+    for( ; x + 16 <= width; x += 12 )
+    {
+        __m256i w = _mm256_loadu_si256( (const __m256i*)( s + x/6*16 ) );
+        __m256i ab = _mm256_or_si256( _mm256_and_si256( w, mask ),
+                                        _mm256_slli_epi32( _mm256_and_si256( _mm256_srli_epi32( w, 10 ), mask ), 16 ) );
+        __m256i c = _mm256_and_si256( _mm256_srli_epi32( w, 20 ), mask );
+
+        __m256i yw = _mm256_or_si256( _mm256_shuffle_epi8( ab, y_ab ), _mm256_shuffle_epi8( c, y_c ) );
+        __m256i uv = _mm256_or_si256( _mm256_shuffle_epi8( ab, uv_ab ), _mm256_shuffle_epi8( c, uv_c ) );
+        __m128i uv0 = _mm256_castsi256_si128(uv);
+        __m128i uv1 = _mm256_extracti128_si256( uv, 1 );
+
+        _mm256_storeu_si256( (__m256i*)( y + x ), _mm256_permutevar8x32_epi32( yw, y_order ) );
+        _mm_storel_epi64( (__m128i*)( u + x/2 ), uv0 );
+        _mm_storel_epi64( (__m128i*)( u + x/2 + 3 ), uv1 );
+        _mm_storel_epi64( (__m128i*)( v + x/2 ), _mm_srli_si128( uv0, 8 ) );
+        _mm_storel_epi64( (__m128i*)( v + x/2 + 3 ), _mm_srli_si128( uv1, 8 ) );
+    }
+
+    return x;
+}
+
+TARGET_ISA("avx2")
+static unsigned V210PackAvx2( const uint16_t* y, const uint16_t* u, const uint16_t* v, uint8_t* d, unsigned width )
+{
+    const __m256i mask = _mm256_set1_epi32(0x3ff);
+    const __m256i a_y = _mm256_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1,
+                                          -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1 );
+    const __m256i a_uv = _mm256_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1,
+                                           0, 1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1 );
+    const __m256i b_y = _mm256_setr_epi8( 0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1,
+                                          0, 1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, -1, -1 );
+    const __m256i b_uv = _mm256_setr_epi8( -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1,
+                                           -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1 );
+    const __m256i c_y = _mm256_setr_epi8( -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1,
+                                          -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1 );
+    const __m256i c_uv = _mm256_setr_epi8( 8, 9, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1,
+                                           8, 9, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1, -1, -1 );
+    unsigned x = 0;
+
+    for( ; x + 16 <= width; x += 12 )
+    {
+        __m256i yw = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)( y + x ) ) ),
+                                                            _mm_loadu_si128( (const __m128i*)( y + x + 6 ) ), 1 );
+        __m128i uv0 = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*)( u + x/2 ) ),
+                                                                    _mm_loadl_epi64( (const __m128i*)( v + x/2 ) ) );
+        __m128i uv1 = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*)( u + x/2 + 3 ) ),
+                                                                _mm_loadl_epi64( (const __m128i*)( v + x/2 + 3 ) ) );
+        __m256i uv = _mm256_inserti128_si256( _mm256_castsi128_si256(uv0), uv1, 1 );
+
+        __m256i a = _mm256_or_si256( _mm256_shuffle_epi8( yw, a_y ), _mm256_shuffle_epi8( uv, a_uv ) );
+        __m256i b = _mm256_or_si256( _mm256_shuffle_epi8( yw, b_y ), _mm256_shuffle_epi8( uv, b_uv ) );
+        __m256i c = _mm256_or_si256( _mm256_shuffle_epi8( yw, c_y ), _mm256_shuffle_epi8( uv, c_uv ) );
+        b = _mm256_slli_epi32( _mm256_and_si256( b, mask ), 10 );
+        c = _mm256_slli_epi32( _mm256_and_si256( c, mask ), 20 );
+        __m256i w = _mm256_or_si256( _mm256_and_si256( a, mask ), _mm256_or_si256( b, c ) );
+
+        _mm256_storeu_si256( (__m256i*)( d + x/6*16 ), w );
+    }
+
+    return x;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#if defined(_MSC_VER)
+static bool CpuSupports( const char* isa )
+{
+    int r[4];
+    __cpuid( r, 0 );
+    int max_leaf = r[0];
+
+    __cpuid( r, 1 );
+    bool ssse3 = ( r[2] & (1 << 9) ) != 0;
+    bool os_avx = (  ( r[2] & (1 << 27) ) != 0  &&  ( r[2] & (1 << 28) ) != 0  &&  ( _xgetbv(0) & 0x06 ) == 0x06  );
+
+    if( max_leaf >= 7 )
+    {
+        __cpuidex( r, 7, 0 );
+    }
+    else
+    {
+        r[1] = 0;
+    }
+
+    if( strcmp( isa, "ssse3" ) == 0 )  return ssse3;
+    if( strcmp( isa, "avx2" ) == 0 )  return os_avx  &&  ( r[1] & (1 << 5) ) != 0;
+    return false;
+}
+#else
+static bool CpuSupports( const char* isa )
+{
+    __builtin_cpu_init();
+
+    if( strcmp( isa, "ssse3" ) == 0 )  return __builtin_cpu_supports("ssse3");
+    if( strcmp( isa, "avx2" ) == 0 )  return __builtin_cpu_supports("avx2");
+    return false;
+}
+#endif
+
+#endif // defined(PIXEL_CONVERT_X86)
+
+//---------------------------------------------------------------------------------------------------------------------
+struct SConvertKernel
+{
+    const char*  name;
+    const char*  isa;  // NULL - always supported
+    FRowsI420  i420;
+    FRowsNv12  nv12;
+    FRowYuv422p  yuv422p;
+    FRowV210Unpack  v210_unpack;
+    FRowV210Pack  v210_pack;
+};
+
+static const SConvertKernel g_kernels[] =
+{
+    { "scalar",  NULL,     &I420Scalar,  &Nv12Scalar,  &Yuv422pScalar,  &V210UnpackScalar,  &V210PackScalar },
+#if defined(PIXEL_CONVERT_X86)
+    { "ssse3",   "ssse3",  &I420Ssse3,   &Nv12Ssse3,   &Yuv422pSsse3,   &V210UnpackSsse3,   &V210PackSsse3 },
+    { "avx2",    "avx2",   &I420Avx2,    &Nv12Avx2,    &Yuv422pAvx2,    &V210UnpackAvx2,    &V210PackAvx2 },
+#endif
+};
+
+static const int g_kernels_count = (int)( sizeof(g_kernels) / sizeof(g_kernels[0]) );
+
+//---------------------------------------------------------------------------------------------------------------------
+// Picks the widest supported kernel before main() starts.
+class CConvertDispatch
+{
+public:
+    const SConvertKernel* volatile  kernel;
+
+    CConvertDispatch() : kernel(&g_kernels[0])
+    {
+        for( int j = g_kernels_count - 1; j > 0; --j )
+        {
+            if( IsSupported( g_kernels[j] ) )
+            {
+                kernel = &g_kernels[j];
+                break;
+            }
+        }
+    }
+
+    static bool IsSupported( const SConvertKernel& k )
+    {
+#if defined(PIXEL_CONVERT_X86)
+        return  k.isa == NULL  ||  CpuSupports(k.isa);
+#else
+        return  k.isa == NULL;
+#endif
+    }
+};
+
+static CConvertDispatch g_dispatch;
+
+static const char* const g_layout_names[PixelLayoutCount] = { "i420", "nv12", "yuv422p" };
+
+//---------------------------------------------------------------------------------------------------------------------
+enum ESliceOp
+{
+    SliceConvert,
+    SliceV210Unpack,
+    SliceV210Pack
+};
+
+struct SSliceJob
+{
+    ESliceOp  op;
+    EPixelLayout  layout;  // SliceConvert
+    const void*  src;
+    void*  dst;
+    size_t  row_bytes;  // of the packed side
+    unsigned  width, height;
+    unsigned  slice_rows;  // even
+};
+
+static void SliceJob( void* ctx, size_t j )
+{
+    const SSliceJob& job = *(const SSliceJob*)ctx;
+    unsigned row0 = (unsigned)j * job.slice_rows;
+    unsigned row1 = ( row0 + job.slice_rows < job.height ? row0 + job.slice_rows : job.height );
+
+    if( row0 >= row1 )
+    {
+        return;
+    }
+
+    switch(job.op)
+    {
+    case SliceConvert:
+        PixelConvertRows( job.layout, job.src, job.row_bytes, job.width, job.height, job.dst, row0, row1 );
+        break;
+    case SliceV210Unpack:
+        V210UnpackRows( job.src, job.row_bytes, job.width, job.height, job.dst, row0, row1 );
+        break;
+    case SliceV210Pack:
+        V210PackRows( job.src, job.width, job.height, job.dst, job.row_bytes, row0, row1 );
+        break;
+    }
+}
+
+// Runs the rows of 'job' on the calling thread or in slices of even rows on 'workers'.
+static void RunSlices( SSliceJob& job, CWorkerPool* workers, unsigned slices )
+{
+    if(  workers == NULL  ||  slices <= 1  ||  job.height < 4  )
+    {
+        job.slice_rows = job.height + 1;
+        SliceJob( &job, 0 );
+        return;
+    }
+
+    job.slice_rows = ( ( job.height + slices - 1 ) / slices + 1 ) & ~1U;
+    workers->Run( &SliceJob, &job, ( job.height + job.slice_rows - 1 ) / job.slice_rows );
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+const char* PixelLayoutName( EPixelLayout layout )
+{
+    return  ( (unsigned)layout < PixelLayoutCount ? g_layout_names[layout] : "unknown" );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool PixelLayoutParse( const char* name, EPixelLayout* layout )
+{
+    for( int j = 0; j < PixelLayoutCount; ++j )
+    {
+        if( strcmp( name, g_layout_names[j] ) == 0 )
+        {
+            *layout = (EPixelLayout)j;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t PixelLayoutSize( EPixelLayout layout, unsigned width, unsigned height )
+{
+    size_t luma = (size_t)width * height;
+    return  luma + ( layout == PixelLayoutYuv422p ? luma : (size_t)width * ( ( height + 1 ) / 2 ) );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void PixelConvertRows( EPixelLayout layout, const void* src, size_t src_row_bytes, unsigned width, unsigned height,
+                                                                            void* dst, unsigned row0, unsigned row1 )
+{
+    assert(  ( width & 1 ) == 0  &&  ( row0 & 1 ) == 0  );
+
+    const SConvertKernel& k = *g_dispatch.kernel;
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+    uint8_t* c = d + (size_t)width * height;  // chroma planes
+    unsigned cw = width/2;
+
+    if( layout == PixelLayoutYuv422p )
+    {
+        for( unsigned r = row0; r < row1; ++r )
+        {
+            const uint8_t* sr = s + r * src_row_bytes;
+            uint8_t* y = d + (size_t)r * width;
+            uint8_t* u = c + (size_t)r * cw;
+            uint8_t* v = u + (size_t)cw * height;
+
+            TailYuv422p( sr, y, u, v, k.yuv422p( sr, y, u, v, width ), width );
+        }
+
+        return;
+    }
+
+    size_t chroma_rows = ( height + 1 ) / 2;
+
+    for( unsigned r = row0; r < row1; r += 2 )
+    {
+        // The odd last row makes a pair with itself.
+        size_t next = ( r + 1 < height ? 1 : 0 );
+        const uint8_t* s0 = s + r * src_row_bytes;
+        const uint8_t* s1 = s0 + next * src_row_bytes;
+        uint8_t* y0 = d + (size_t)r * width;
+        uint8_t* y1 = y0 + next * width;
+
+        if( layout == PixelLayoutNv12 )
+        {
+            uint8_t* uv = c + (size_t)( r/2 ) * width;
+            TailNv12( s0, s1, y0, y1, uv, k.nv12( s0, s1, y0, y1, uv, width ), width );
+        }
+        else
+        {
+            uint8_t* u = c + (size_t)( r/2 ) * cw;
+            uint8_t* v = u + cw * chroma_rows;
+            TailI420( s0, s1, y0, y1, u, v, k.i420( s0, s1, y0, y1, u, v, width ), width );
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void PixelConvert( EPixelLayout layout, const void* src, size_t src_row_bytes, unsigned width, unsigned height,
+                                                                    void* dst, CWorkerPool* workers, unsigned slices )
+{
+    SSliceJob job;
+    job.op = SliceConvert;
+    job.layout = layout;
+    job.src = src;
+    job.dst = dst;
+    job.row_bytes = src_row_bytes;
+    job.width = width;
+    job.height = height;
+
+    RunSlices( job, workers, slices );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t V210RowBytes( unsigned width )
+{
+    return  (size_t)( width + 47 ) / 48 * 128;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t V210PlanarSize( unsigned width, unsigned height )
+{
+    return  (size_t)width * height * 2 * sizeof(uint16_t);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void V210UnpackRows( const void* src, size_t src_row_bytes, unsigned width, unsigned height, void* dst,
+                                                                                        unsigned row0, unsigned row1 )
+{
+    assert( ( width & 1 ) == 0 );
+
+    const SConvertKernel& k = *g_dispatch.kernel;
+    uint16_t* y0 = (uint16_t*)dst;
+    uint16_t* u0 = y0 + (size_t)width * height;
+    uint16_t* v0 = u0 + (size_t)width/2 * height;
+
+    for( unsigned r = row0; r < row1; ++r )
+    {
+        const uint8_t* s = (const uint8_t*)src + r * src_row_bytes;
+        uint16_t* y = y0 + (size_t)r * width;
+        uint16_t* u = u0 + (size_t)r * ( width/2 );
+        uint16_t* v = v0 + (size_t)r * ( width/2 );
+
+        TailV210Unpack( s, y, u, v, k.v210_unpack( s, y, u, v, width ), width );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void V210PackRows( const void* src, unsigned width, unsigned height, void* dst, size_t dst_row_bytes,
+                                                                                        unsigned row0, unsigned row1 )
+{
+    assert(  ( width & 1 ) == 0  &&  dst_row_bytes >= ( width + 5 ) / 6 * 16  );
+
+    const SConvertKernel& k = *g_dispatch.kernel;
+    const uint16_t* y0 = (const uint16_t*)src;
+    const uint16_t* u0 = y0 + (size_t)width * height;
+    const uint16_t* v0 = u0 + (size_t)width/2 * height;
+
+    for( unsigned r = row0; r < row1; ++r )
+    {
+        uint8_t* d = (uint8_t*)dst + r * dst_row_bytes;
+        const uint16_t* y = y0 + (size_t)r * width;
+        const uint16_t* u = u0 + (size_t)r * ( width/2 );
+        const uint16_t* v = v0 + (size_t)r * ( width/2 );
+
+        TailV210Pack( y, u, v, d, k.v210_pack( y, u, v, d, width ), width, dst_row_bytes );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void V210Unpack( const void* src, size_t src_row_bytes, unsigned width, unsigned height, void* dst,
+                                                                                CWorkerPool* workers, unsigned slices )
+{
+    SSliceJob job;
+    job.op = SliceV210Unpack;
+    job.layout = PixelLayoutCount;
+    job.src = src;
+    job.dst = dst;
+    job.row_bytes = src_row_bytes;
+    job.width = width;
+    job.height = height;
+
+    RunSlices( job, workers, slices );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void V210Pack( const void* src, unsigned width, unsigned height, void* dst, size_t dst_row_bytes,
+                                                                                CWorkerPool* workers, unsigned slices )
+{
+    SSliceJob job;
+    job.op = SliceV210Pack;
+    job.layout = PixelLayoutCount;
+    job.src = src;
+    job.dst = dst;
+    job.row_bytes = dst_row_bytes;
+    job.width = width;
+    job.height = height;
+
+    RunSlices( job, workers, slices );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* PixelFormatName( BMDPixelFormat format )
+{
+    switch(format)
+    {
+    case bmdFormat8BitYUV:
+        return "uyvy";
+    case bmdFormat10BitYUV:
+        return "v210";
+    default:
+        return "other";
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool PixelFormatParse( const char* name, BMDPixelFormat* format )
+{
+    if( strcmp( name, "uyvy" ) == 0 )
+    {
+        *format = bmdFormat8BitYUV;
+        return true;
+    }
+
+    if( strcmp( name, "v210" ) == 0 )
+    {
+        *format = bmdFormat10BitYUV;
+        return true;
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t PixelFormatRowBytes( BMDPixelFormat format, unsigned width )
+{
+    switch(format)
+    {
+    case bmdFormat8BitYUV:
+        return (size_t)width * 2;
+    case bmdFormat10BitYUV:
+        return V210RowBytes(width);
+    default:
+        return (size_t)width * 4;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* PixelConvertKernelName()
+{
+    return g_dispatch.kernel->name;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool PixelConvertSetKernel( const char* name )
+{
+    for( int j = 0; j < g_kernels_count; ++j )
+    {
+        if(  strcmp( g_kernels[j].name, name ) == 0  &&  CConvertDispatch::IsSupported( g_kernels[j] )  )
+        {
+            g_dispatch.kernel = &g_kernels[j];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//=====================================================================================================================
+CFrameConverter::CFrameConverter() : index(-1), layout(PixelLayoutI420), workers(NULL), slices(1), frames(0),
+                                                                        v210_frames(0), skipped(0), alloc_failures(0)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameConverter::Init( int device_index, EPixelLayout pixel_layout, CWorkerPool* worker_pool,
+                                                                                                unsigned slice_count )
+{
+    index = device_index;
+    layout = pixel_layout;
+    workers = ( worker_pool != NULL ? worker_pool : &CWorkerPool::Shared() );
+    slices = ( slice_count != 0 ? slice_count : (unsigned)workers->ThreadCount() + 1 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameConverter::Stage( void* ctx, const SCapturedFrame& frame )
+{
+    CFrameConverter& c = *(CFrameConverter*)ctx;
+    IDeckLinkVideoInputFrame* video = frame.video;
+    BMDPixelFormat format = video->GetPixelFormat();
+    void* bytes = NULL;
+
+    if(  ( format != bmdFormat8BitYUV  &&  format != bmdFormat10BitYUV )
+            ||  FAILED( video->GetBytes(&bytes) )  ||  bytes == NULL  )
+    {
+        ++c.skipped;
+        return;
+    }
+
+    unsigned width = (unsigned)video->GetWidth();
+    unsigned height = (unsigned)video->GetHeight();
+    size_t row_bytes = (size_t)video->GetRowBytes();
+    bool v210 = ( format == bmdFormat10BitYUV );
+    char* dst;
+
+    try
+    {
+        size_t size = ( v210 ? V210PlanarSize( width, height ) : PixelLayoutSize( c.layout, width, height ) );
+        dst = c.pool.Allocate( c.index, (BM_UINT32)size );
+    }
+    catch( const std::bad_alloc& )
+    {
+        ++c.alloc_failures;
+        return;
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
+    if( v210 )
+    {
+        V210Unpack( bytes, row_bytes, width, height, dst, c.workers, c.slices );
+        ++c.v210_frames;
+    }
+    else
+    {
+        PixelConvert( c.layout, bytes, row_bytes, width, height, dst, c.workers, c.slices );
+    }
+
+    c.convert_ns.Record( MonotonicTimeNs() - t0 );
+
+    c.pool.Release(dst);
+    ++c.frames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CFrameConverter::PrintStats()
+{
+    printf( "[%d] CFrameConverter (%s, %s, %u slices): %llu frames (v210 unpacked=%llu), convert p50=%.2f ms,"
+                    " p99=%.2f ms, max=%.2f ms, skipped=%llu, alloc_failures=%llu\n", index, PixelLayoutName(layout),
+                    PixelConvertKernelName(), slices, (unsigned long long)frames, (unsigned long long)v210_frames,
+                    convert_ns.Percentile(0.5) * 1e-6, convert_ns.Percentile(0.99) * 1e-6, convert_ns.Max() * 1e-6,
+                    (unsigned long long)skipped, (unsigned long long)alloc_failures );
+}
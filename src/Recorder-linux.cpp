@@ -0,0 +1,611 @@
+#include <Recorder.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const char* const g_record_io_names[RecordIoCount] = { "uring", "threads" };
+
+static const unsigned g_record_queue_depth = 16;  // video writes in flight per device
+static const int g_record_writer_threads = 4;  // per device, RecordIoThreads
+
+static const char* g_record_dir = NULL;
+static ERecordIo g_record_io = RecordIoUring;
+static volatile int32_t g_uring_failed = 0;
+
+//---------------------------------------------------------------------------------------------------------------------
+static inline unsigned LoadAcquire( const unsigned* p )  { return __atomic_load_n( p, __ATOMIC_ACQUIRE ); }
+static inline void StoreRelease( unsigned* p, unsigned value )  { __atomic_store_n( p, value, __ATOMIC_RELEASE ); }
+
+//---------------------------------------------------------------------------------------------------------------------
+static int IoUringSetup( unsigned entries, struct io_uring_params* params )
+{
+    return (int)syscall( __NR_io_uring_setup, entries, params );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static int IoUringEnter( int fd, unsigned to_submit, unsigned min_complete, unsigned flags )
+{
+    return (int)syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static long WriteAt( int fd, const struct iovec* iov, uint64_t offset )
+{
+    ssize_t n = pwritev( fd, iov, 1, (off_t)offset );
+    return ( n < 0 ? -(long)errno : (long)n );
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+const char* RecordIoName( ERecordIo io )
+{
+    return (  io >= 0  &&  io < RecordIoCount  ?  g_record_io_names[io]  :  "unknown"  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool RecordIoParse( const char* name, ERecordIo* io )
+{
+    for( int j = 0; j < RecordIoCount; ++j )
+    {
+        if( strcmp( name, g_record_io_names[j] ) == 0 )
+        {
+            *io = (ERecordIo)j;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void RecordSetDir( const char* dir )  { g_record_dir = dir; }
+const char* RecordGetDir()  { return g_record_dir; }
+void RecordSetIo( ERecordIo io )  { g_record_io = io; }
+ERecordIo RecordGetIo()  { return g_record_io; }
+
+//=====================================================================================================================
+CRecordQueue::CRecordQueue() : io(RecordIoThreads), depth(0), done(NULL), done_ctx(NULL), ring_fd(-1),
+                                sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sq_ring_size(0), cq_ring_size(0),
+                                sqes((struct io_uring_sqe*)MAP_FAILED), running_threads(0), stopping(false)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CRecordQueue::~CRecordQueue()
+{
+    if( depth > 0 )
+    {
+        Flush();
+    }
+
+    if( running_threads > 0 )
+    {
+        lock.Lock();
+        stopping = true;
+        int count = running_threads;
+        lock.Unlock();
+
+        queued.Post(count);
+        stopped.Wait();
+    }
+
+    if( sqes != MAP_FAILED )
+    {
+        munmap( sqes, depth * sizeof(struct io_uring_sqe) );
+    }
+
+    if(  cq_ring != MAP_FAILED  &&  cq_ring != sq_ring  )
+    {
+        munmap( cq_ring, cq_ring_size );
+    }
+
+    if( sq_ring != MAP_FAILED )
+    {
+        munmap( sq_ring, sq_ring_size );
+    }
+
+    if( ring_fd >= 0 )
+    {
+        close(ring_fd);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// A ring of 'depth' submission entries; the completion ring the kernel sizes (twice as large) never overflows since no
+// more than 'depth' writes are in flight.
+bool CRecordQueue::SetupRing()
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof(params) );
+
+    ring_fd = IoUringSetup( depth, &params );
+    if( ring_fd < 0 )
+    {
+        int err = errno;
+
+        if( Int32CompareExchange( &g_uring_failed, 1, 0 ) == 0 )
+        {
+            fprintf( stderr, "CRecordQueue: io_uring_setup failed: %s, using writer threads.\n", strerror(err) );
+        }
+
+        return false;
+    }
+
+    depth = params.sq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        sq_ring_size = cq_ring_size = ( sq_ring_size > cq_ring_size ? sq_ring_size : cq_ring_size );
+    }
+
+    sq_ring = mmap( NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                                                                                                IORING_OFF_SQ_RING );
+    if( sq_ring != MAP_FAILED )
+    {
+        cq_ring = (  params.features & IORING_FEAT_SINGLE_MMAP  ?  sq_ring  :  mmap( NULL, cq_ring_size,
+                            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING )  );
+    }
+
+    if( cq_ring != MAP_FAILED )
+    {
+        sqes = (struct io_uring_sqe*)mmap( NULL, depth * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                                                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES );
+    }
+
+    if( sqes == MAP_FAILED )
+    {
+        fprintf( stderr, "CRecordQueue: io_uring ring mmap failed: %s, using writer threads.\n", strerror(errno) );
+        return false;
+    }
+
+    char* sq = (char*)sq_ring;
+    sq_head = (unsigned*)( sq + params.sq_off.head );
+    sq_tail = (unsigned*)( sq + params.sq_off.tail );
+    sq_mask = (unsigned*)( sq + params.sq_off.ring_mask );
+    sq_array = (unsigned*)( sq + params.sq_off.array );
+
+    char* cq = (char*)cq_ring;
+    cq_head = (unsigned*)( cq + params.cq_off.head );
+    cq_tail = (unsigned*)( cq + params.cq_off.tail );
+    cq_mask = (unsigned*)( cq + params.cq_off.ring_mask );
+    cqes = (struct io_uring_cqe*)( cq + params.cq_off.cqes );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecordQueue::Start( ERecordIo mode, unsigned queue_depth, int writer_threads,
+                                                    const SThreadPlacement& placement, FDone done_func, void* ctx )
+{
+    assert( depth == 0 );
+
+    done = done_func;
+    done_ctx = ctx;
+    depth = ( queue_depth < 1 ? 1 : queue_depth );
+    io = mode;
+
+    if(  io == RecordIoUring  &&  !SetupRing()  )
+    {
+        io = RecordIoThreads;
+        depth = ( queue_depth < 1 ? 1 : queue_depth );
+    }
+
+    iovs.resize(depth);
+    slots.resize(depth);
+
+    for( unsigned j = depth; j > 0; --j )
+    {
+        free_slots.push_back( j - 1 );
+    }
+
+    if( io == RecordIoThreads )
+    {
+        slots_free.Post( (int32_t)depth );
+        running_threads = ( writer_threads < 1 ? 1 : writer_threads );
+
+        for( int j = 0; j < running_threads; ++j )
+        {
+            StartThread( &ThreadFunc, this, placement );
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Completion of the write in 'slot' on whichever thread saw it, the slot is free again after the callback.
+void CRecordQueue::Complete( unsigned slot, long result )
+{
+    long expected = (long)iovs[slot].iov_len;
+    done( done_ctx, slots[slot].item, ( result >= 0 && result != expected ? -EIO : result ) );
+
+    if( io == RecordIoThreads )
+    {
+        lock.Lock();
+        free_slots.push_back(slot);
+        lock.Unlock();
+        slots_free.Post();
+    }
+    else
+    {
+        free_slots.push_back(slot);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// io_uring: completes what the kernel has posted. With 'wait' blocks for one completion first. Returns false if
+// io_uring_enter failed.
+bool CRecordQueue::Reap( bool wait )
+{
+    if(  wait  &&  LoadAcquire(cq_tail) == *cq_head  )
+    {
+        if(  IoUringEnter( ring_fd, 0, 1, IORING_ENTER_GETEVENTS ) < 0  &&  errno != EINTR  )
+        {
+            return false;
+        }
+    }
+
+    unsigned head = *cq_head;
+
+    while( head != LoadAcquire(cq_tail) )
+    {
+        const struct io_uring_cqe& cqe = cqes[ head & *cq_mask ];
+        unsigned slot = (unsigned)cqe.user_data;
+        long result = cqe.res;
+
+        StoreRelease( cq_head, ++head );  // the entry has been read, the kernel may reuse it
+        Complete( slot, result );
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CRecordQueue::Write( int fd, const void* buf, size_t len, uint64_t offset, void* item )
+{
+    unsigned slot;
+
+    if( io == RecordIoThreads )
+    {
+        slots_free.Wait();
+        lock.Lock();
+        slot = free_slots.back();
+        free_slots.pop_back();
+        lock.Unlock();
+    }
+    else
+    {
+        while( free_slots.empty() )
+        {
+            if( !Reap(true) )
+            {
+                return false;
+            }
+        }
+
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+
+    SWrite& w = slots[slot];
+    w.fd = fd;
+    w.offset = offset;
+    w.item = item;
+
+    struct iovec& iov = iovs[slot];
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+
+    if( io == RecordIoThreads )
+    {
+        lock.Lock();
+        pending.push_back(slot);
+        lock.Unlock();
+        queued.Post();
+        return true;
+    }
+
+    unsigned tail = *sq_tail;
+    unsigned k = tail & *sq_mask;
+    struct io_uring_sqe& sqe = sqes[k];
+    memset( &sqe, 0, sizeof(sqe) );
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = (uint64_t)(uintptr_t)&iov;
+    sqe.len = 1;
+    sqe.user_data = slot;
+    sq_array[k] = k;
+    StoreRelease( sq_tail, tail + 1 );
+
+    int n;
+
+    do
+    {
+        n = IoUringEnter( ring_fd, 1, 0, 0 );
+    }
+    while(  n < 0  &&  ( errno == EINTR || errno == EAGAIN || errno == EBUSY )  &&  Reap(false)  );
+
+    if( n < 0 )
+    {
+        // Not consumed by the kernel: take the entry back.
+        StoreRelease( sq_tail, tail );
+        free_slots.push_back(slot);
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecordQueue::Poll()
+{
+    if(  io == RecordIoUring  &&  depth > 0  )
+    {
+        Reap(false);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecordQueue::Flush()
+{
+    if( io == RecordIoThreads )
+    {
+        for( unsigned j = 0; j < depth; ++j )
+        {
+            slots_free.Wait();
+        }
+
+        slots_free.Post( (int32_t)depth );
+        return;
+    }
+
+    while(  free_slots.size() < depth  &&  Reap(true)  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecordQueue::ThreadFunc( void* ctx )
+{
+    CRecordQueue& q = *(CRecordQueue*)ctx;
+
+    for(;;)
+    {
+        q.queued.Wait();
+        q.lock.Lock();
+
+        if( q.pending.empty() )
+        {
+            bool last = ( q.stopping  &&  --q.running_threads == 0 );
+            q.lock.Unlock();
+
+            if( last )
+            {
+                q.stopped.SetTrue();
+            }
+
+            if( q.stopping )
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        unsigned slot = q.pending.front();
+        q.pending.pop_front();
+        q.lock.Unlock();
+
+        q.Complete( slot, WriteAt( q.slots[slot].fd, &q.iovs[slot], q.slots[slot].offset ) );
+    }
+}
+
+//=====================================================================================================================
+CRecorder::CRecorder() : index(-1), video_fd(-1), audio_fd(-1), direct(false), index_file(NULL), video_offset(0),
+                        audio_offset(0), audio_frame_bytes(0), write_errors(0), frames(0), skipped(0),
+                        video_bytes(0), audio_bytes(0), first_ns(0), last_ns(0)
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CRecorder::~CRecorder()
+{
+    if( video_fd >= 0 )
+    {
+        Flush();
+        close(video_fd);
+    }
+
+    if( audio_fd >= 0 )
+    {
+        close(audio_fd);
+    }
+
+    if( index_file != NULL )
+    {
+        fclose(index_file);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CRecorder::Open( const char* dir, int device_index, ERecordIo io, uint32_t audio_sample_frame_bytes,
+                                                                                const SThreadPlacement& placement )
+{
+    index = device_index;
+    audio_frame_bytes = audio_sample_frame_bytes;
+
+    char path[1024];
+    snprintf( path, sizeof(path), "%s/dev%d.video", dir, index );
+
+    video_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644 );
+    direct = ( video_fd >= 0 );
+
+    if(  video_fd < 0  &&  errno == EINVAL  )
+    {
+        // tmpfs and some other file systems have no O_DIRECT, the writes go through the page cache then.
+        printf( "[%d] CRecorder: %s does not support O_DIRECT, buffered writes\n", index, dir );
+        video_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    }
+
+    if( video_fd < 0 )
+    {
+        fprintf( stderr, "[%d] CRecorder: cannot create %s: %s\n", index, path, strerror(errno) );
+        return false;
+    }
+
+    snprintf( path, sizeof(path), "%s/dev%d.audio", dir, index );
+    audio_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+    if( audio_fd < 0 )
+    {
+        fprintf( stderr, "[%d] CRecorder: cannot create %s: %s\n", index, path, strerror(errno) );
+        return false;
+    }
+
+    snprintf( path, sizeof(path), "%s/dev%d.index", dir, index );
+    index_file = fopen( path, "wb" );
+
+    if( index_file == NULL )
+    {
+        fprintf( stderr, "[%d] CRecorder: cannot create %s: %s\n", index, path, strerror(errno) );
+        return false;
+    }
+
+    queue.Start( io, g_record_queue_depth, g_record_writer_threads, placement, &VideoDone, this );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// The write of the frame is done, its buffer goes back to the allocator.
+void CRecorder::VideoDone( void* ctx, void* item, long result )
+{
+    CRecorder& r = *(CRecorder*)ctx;
+
+    if( result < 0 )
+    {
+        if( Int32AtomicAdd( &r.write_errors, 1 ) == 0 )
+        {
+            fprintf( stderr, "[%d] CRecorder: video write failed: %s\n", r.index, strerror( (int)-result ) );
+        }
+    }
+
+    ( (IDeckLinkVideoInputFrame*)item )->Release();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// The video record is the frame buffer itself rounded up to g_record_block: the allocator buffers are whole pages, so
+// the rounded length stays inside the buffer. A buffer that is not block-aligned (heap arena) cannot go to an
+// O_DIRECT file and the frame is skipped, its index entry has video_size 0.
+void CRecorder::Stage( void* ctx, const SCapturedFrame& frame )
+{
+    CRecorder& r = *(CRecorder*)ctx;
+    r.queue.Poll();
+
+    SRecordIndexEntry entry;
+    memset( &entry, 0, sizeof(entry) );
+
+    IDeckLinkVideoInputFrame* video = frame.video;
+    BMDTimeValue stream_time = 0, duration = 0;
+    video->GetStreamTime( &stream_time, &duration, 240000 );
+    entry.stream_time = stream_time;
+    entry.duration = duration;
+    entry.width = (uint32_t)video->GetWidth();
+    entry.height = (uint32_t)video->GetHeight();
+    entry.row_bytes = (uint32_t)video->GetRowBytes();
+    entry.pixel_format = (uint32_t)video->GetPixelFormat();
+    entry.flags = (uint32_t)video->GetFlags();
+
+    if( frame.audio != NULL )
+    {
+        void* audio_bytes = NULL;
+        size_t len = (size_t)frame.audio->GetSampleFrameCount() * r.audio_frame_bytes;
+
+        if(  len > 0  &&  SUCCEEDED( frame.audio->GetBytes(&audio_bytes) )  &&  audio_bytes != NULL  )
+        {
+            ssize_t n = pwrite( r.audio_fd, audio_bytes, len, (off_t)r.audio_offset );
+
+            if( n == (ssize_t)len )
+            {
+                entry.audio_offset = r.audio_offset;
+                entry.audio_size = (uint32_t)len;
+                r.audio_offset += len;
+                r.audio_bytes += len;
+            }
+            else if( Int32AtomicAdd( &r.write_errors, 1 ) == 0 )
+            {
+                fprintf( stderr, "[%d] CRecorder: audio write failed: %s\n", r.index,
+                                                                ( n < 0 ? strerror(errno) : "short write" ) );
+            }
+        }
+    }
+
+    void* bytes = NULL;
+    size_t size = (size_t)entry.row_bytes * entry.height;
+    size_t len = ( size + g_record_block - 1 ) / g_record_block * g_record_block;
+
+    if(  size == 0  ||  FAILED( video->GetBytes(&bytes) )  ||  bytes == NULL
+            ||  ( r.direct  &&  (uintptr_t)bytes % g_record_block != 0 )  )
+    {
+        ++r.skipped;
+    }
+    else
+    {
+        video->AddRef();
+
+        if( r.queue.Write( r.video_fd, bytes, len, r.video_offset, video ) )
+        {
+            entry.video_offset = r.video_offset;
+            entry.video_size = (uint32_t)size;
+            r.video_offset += len;
+            r.video_bytes += size;
+            ++r.frames;
+
+            r.last_ns = frame.arrived_ns;
+            if( r.first_ns == 0 )
+            {
+                r.first_ns = frame.arrived_ns;
+            }
+        }
+        else
+        {
+            video->Release();
+            ++r.skipped;
+
+            if( Int32AtomicAdd( &r.write_errors, 1 ) == 0 )
+            {
+                fprintf( stderr, "[%d] CRecorder: video write could not be queued.\n", r.index );
+            }
+        }
+    }
+
+    fwrite( &entry, sizeof(entry), 1, r.index_file );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecorder::Flush()
+{
+    queue.Flush();
+
+    if( index_file != NULL )
+    {
+        fflush(index_file);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRecorder::PrintStats()
+{
+    double elapsed_sec = (double)( last_ns - first_ns ) * 1e-9;
+
+    printf( "[%d] CRecorder (%s%s): %llu frames, %.1f MB video, %.1f MB audio, %.1f MB/s, skipped=%llu,"
+                    " write_errors=%d\n", index, RecordIoName( queue.Io() ), ( direct ? ", O_DIRECT" : "" ),
+                    (unsigned long long)frames, (double)video_bytes / ( 1 << 20 ), (double)audio_bytes / ( 1 << 20 ),
+                    ( elapsed_sec > 0 ? (double)video_bytes / ( 1 << 20 ) / elapsed_sec : 0.0 ),
+                    (unsigned long long)skipped, (int)write_errors );
+}
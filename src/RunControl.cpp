@@ -0,0 +1,182 @@
+#include <RunControl.h>
+#include <stdio.h>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+static const char* const g_state_names[RunStateCount] =
+{
+    "idle", "starting", "streaming", "stopping", "verifying", "failed"
+};
+
+static const char* const g_status_names[RunStatusCount] =
+{
+    "active", "completed", "device_error", "validation_failed"
+};
+
+// Process exit code of every status.
+static const int g_status_codes[RunStatusCount] = { 3, 0, 2, 1 };
+
+} //unnamed namespace
+
+//=====================================================================================================================
+const char* RunStateName( ERunState state )
+{
+    return (  state >= 0  &&  state < RunStateCount  ?  g_state_names[state]  :  "unknown"  );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+const char* RunStatusName( ERunStatus status )
+{
+    return (  status >= 0  &&  status < RunStatusCount  ?  g_status_names[status]  :  "unknown"  );
+}
+
+//=====================================================================================================================
+CRunControl::CRunControl() : status(RunActive), stop_index(-1), active(0), device_count(0), start_ns(0), stop_ns(0)
+{
+    for( int j = 0; j < g_max_devices; ++j )
+    {
+        devices[j].wakeup = NULL;
+        devices[j].state = RunIdle;
+        devices[j].wake_ns = 0;
+        devices[j].restart_count = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRunControl::Register( int index, CWaitableCondition* wakeup )
+{
+    assert(  index >= 0  &&  index < g_max_devices  );
+
+    if( start_ns == 0 )
+    {
+        start_ns = MonotonicTimeNs();
+    }
+
+    devices[index].wakeup = wakeup;
+    device_count = ( index + 1 > device_count ? index + 1 : device_count );
+    Int32AtomicAdd( &active, 1 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CRunControl::Stop( ERunStatus s, int index )
+{
+    int32_t cur = status;
+
+    while( cur < s )
+    {
+        int32_t prev = Int32CompareExchange( &status, s, cur );
+
+        if( prev == cur )
+        {
+            break;
+        }
+
+        cur = prev;
+    }
+
+    if( cur >= s )
+    {
+        return false;
+    }
+
+    stop_index = index;
+
+    if( cur == RunActive )
+    {
+        stop_ns = MonotonicTimeNs();
+
+        // A device thread always finds the status set when it wakes up.
+        for( int j = 0; j < device_count; ++j )
+        {
+            if( devices[j].wakeup != NULL )
+            {
+                devices[j].wakeup->SetTrue();
+            }
+        }
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRunControl::SetState( int index, ERunState state )
+{
+    SDevice& d = devices[index];
+
+    if(  d.state == RunStreaming  &&  state != RunStreaming  &&  stop_ns != 0  &&  d.wake_ns == 0  )
+    {
+        uint64_t now = MonotonicTimeNs();
+        d.wake_ns = ( now > stop_ns ? now - stop_ns : 1 );
+    }
+
+    d.state = state;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRunControl::Leave( int index )
+{
+    if( devices[index].state != RunFailed )
+    {
+        SetState( index, RunIdle );
+    }
+
+    if( Int32AtomicAdd( &active, -1 ) <= 1 )
+    {
+        if( !Stopped() )
+        {
+            // The devices have given up on their own.
+            Stop( RunDeviceError, index );
+        }
+
+        finished.SetTrue();
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CRunControl::WaitFinished( unsigned timeout_ms )
+{
+    if( timeout_ms == 0 )
+    {
+        finished.Wait();
+        return true;
+    }
+
+    return finished.Wait(timeout_ms);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int CRunControl::PrintStatus() const
+{
+    ERunStatus s = Status();
+    uint64_t restarts = 0;
+    uint64_t max_wake_ns = 0;
+    int failed = 0;
+
+    for( int j = 0; j < device_count; ++j )
+    {
+        restarts += devices[j].restart_count;
+        max_wake_ns = ( devices[j].wake_ns > max_wake_ns ? devices[j].wake_ns : max_wake_ns );
+        failed += ( devices[j].state == RunFailed ? 1 : 0 );
+    }
+
+    if(  s == RunCompleted  &&  failed > 0  )
+    {
+        s = RunDeviceError;
+    }
+
+    printf( "RESULT status=%s device=%d devices=%d failed_devices=%d restarts=%llu elapsed_sec=%.1f"
+                " max_stop_wake_ms=%.3f states=", RunStatusName(s), (int)stop_index, device_count, failed,
+                (unsigned long long)restarts, (double)( MonotonicTimeNs() - start_ns ) * 1e-9,
+                (double)max_wake_ns * 1e-6 );
+
+    for( int j = 0; j < device_count; ++j )
+    {
+        printf( "%s%s", ( j > 0 ? "," : "" ), RunStateName( State(j) ) );
+    }
+
+    printf( "\n" );
+    fflush(stdout);
+
+    return g_status_codes[s];
+}
@@ -0,0 +1,1095 @@
+#include <SimDeckLink.h>
+#include <MemUtils.h>
+#include <errno.h>
+#include <stdio.h>
+#include <map>
+
+//=====================================================================================================================
+namespace {
+//---------------------------------------------------------------------------------------------------------------------
+struct SSimModeInfo
+{
+    BMDDisplayMode  mode;
+    const char*  name;
+    long  width, height;
+    BMDTimeValue  frame_duration;
+    BMDTimeScale  time_scale;
+    BMDFieldDominance  field_dominance;
+};
+
+static const SSimModeInfo g_sim_modes[] =
+{
+    { bmdModeNTSC,          "NTSC",             720,  486, 1001, 30000, bmdLowerFieldFirst },
+    { bmdModeNTSC2398,      "NTSC 23.98",       720,  486, 1001, 24000, bmdLowerFieldFirst },
+    { bmdModePAL,           "PAL",              720,  576, 1000, 25000, bmdUpperFieldFirst },
+    { bmdModeNTSCp,         "NTSC Progressive", 720,  486, 1001, 60000, bmdProgressiveFrame },
+    { bmdModePALp,          "PAL Progressive",  720,  576, 1000, 50000, bmdProgressiveFrame },
+    { bmdModeHD1080p2398,   "HD 1080p 23.98",  1920, 1080, 1001, 24000, bmdProgressiveFrame },
+    { bmdModeHD1080p24,     "HD 1080p 24",     1920, 1080, 1000, 24000, bmdProgressiveFrame },
+    { bmdModeHD1080p25,     "HD 1080p 25",     1920, 1080, 1000, 25000, bmdProgressiveFrame },
+    { bmdModeHD1080p2997,   "HD 1080p 29.97",  1920, 1080, 1001, 30000, bmdProgressiveFrame },
+    { bmdModeHD1080p30,     "HD 1080p 30",     1920, 1080, 1000, 30000, bmdProgressiveFrame },
+    { bmdModeHD1080i50,     "HD 1080i 50",     1920, 1080, 1000, 25000, bmdUpperFieldFirst },
+    { bmdModeHD1080i5994,   "HD 1080i 59.94",  1920, 1080, 1001, 30000, bmdUpperFieldFirst },
+    { bmdModeHD1080i6000,   "HD 1080i 60",     1920, 1080, 1000, 30000, bmdUpperFieldFirst },
+    { bmdModeHD1080p50,     "HD 1080p 50",     1920, 1080, 1000, 50000, bmdProgressiveFrame },
+    { bmdModeHD1080p5994,   "HD 1080p 59.94",  1920, 1080, 1001, 60000, bmdProgressiveFrame },
+    { bmdModeHD1080p6000,   "HD 1080p 60",     1920, 1080, 1000, 60000, bmdProgressiveFrame },
+    { bmdModeHD720p50,      "HD 720p 50",      1280,  720, 1000, 50000, bmdProgressiveFrame },
+    { bmdModeHD720p5994,    "HD 720p 59.94",   1280,  720, 1001, 60000, bmdProgressiveFrame },
+    { bmdModeHD720p60,      "HD 720p 60",      1280,  720, 1000, 60000, bmdProgressiveFrame },
+    { bmdMode2k2398,        "2K 23.98",        2048, 1556, 1001, 24000, bmdProgressiveFrame },
+    { bmdMode2k24,          "2K 24",           2048, 1556, 1000, 24000, bmdProgressiveFrame },
+    { bmdMode2k25,          "2K 25",           2048, 1556, 1000, 25000, bmdProgressiveFrame },
+    { bmdMode2kDCI2398,     "2K DCI 23.98",    2048, 1080, 1001, 24000, bmdProgressiveFrame },
+    { bmdMode2kDCI24,       "2K DCI 24",       2048, 1080, 1000, 24000, bmdProgressiveFrame },
+    { bmdMode2kDCI25,       "2K DCI 25",       2048, 1080, 1000, 25000, bmdProgressiveFrame },
+    { bmdMode4K2160p2398,   "4K 2160p 23.98",  3840, 2160, 1001, 24000, bmdProgressiveFrame },
+    { bmdMode4K2160p24,     "4K 2160p 24",     3840, 2160, 1000, 24000, bmdProgressiveFrame },
+    { bmdMode4K2160p25,     "4K 2160p 25",     3840, 2160, 1000, 25000, bmdProgressiveFrame },
+    { bmdMode4K2160p2997,   "4K 2160p 29.97",  3840, 2160, 1001, 30000, bmdProgressiveFrame },
+    { bmdMode4K2160p30,     "4K 2160p 30",     3840, 2160, 1000, 30000, bmdProgressiveFrame },
+    { bmdMode4K2160p50,     "4K 2160p 50",     3840, 2160, 1000, 50000, bmdProgressiveFrame },
+    { bmdMode4K2160p5994,   "4K 2160p 59.94",  3840, 2160, 1001, 60000, bmdProgressiveFrame },
+    { bmdMode4K2160p60,     "4K 2160p 60",     3840, 2160, 1000, 60000, bmdProgressiveFrame },
+    { bmdMode4kDCI2398,     "4K DCI 23.98",    4096, 2160, 1001, 24000, bmdProgressiveFrame },
+    { bmdMode4kDCI24,       "4K DCI 24",       4096, 2160, 1000, 24000, bmdProgressiveFrame },
+    { bmdMode4kDCI25,       "4K DCI 25",       4096, 2160, 1000, 25000, bmdProgressiveFrame },
+};
+
+static const size_t g_sim_modes_count = sizeof(g_sim_modes)/sizeof(g_sim_modes[0]);
+
+static unsigned g_sim_content_period_sec = 0;  // SimSetContentCycle
+
+// Display modes the simulated signal cycles through on every format change.
+static const BMDDisplayMode g_sim_format_cycle[] =
+{
+    bmdModeHD1080i50,  bmdModeHD720p60,  bmdModeHD1080p25,  bmdModePAL,  bmdModeHD1080i5994
+};
+
+static const size_t g_sim_format_cycle_count = sizeof(g_sim_format_cycle)/sizeof(g_sim_format_cycle[0]);
+
+//---------------------------------------------------------------------------------------------------------------------
+static const SSimModeInfo* FindSimMode( BMDDisplayMode mode )
+{
+    for( size_t j = 0; j < g_sim_modes_count; ++j )
+    {
+        if( g_sim_modes[j].mode == mode )
+        {
+            return &g_sim_modes[j];
+        }
+    }
+
+    return NULL;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static BMDDisplayMode NextSimFormat( BMDDisplayMode mode )
+{
+    for( size_t j = 0; j < g_sim_format_cycle_count; ++j )
+    {
+        if( g_sim_format_cycle[j] == mode )
+        {
+            return g_sim_format_cycle[ (j+1) % g_sim_format_cycle_count ];
+        }
+    }
+
+    return g_sim_format_cycle[0];
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static long SimRowBytes( BMDPixelFormat pixel_format, long width )
+{
+    switch(pixel_format)
+    {
+    case bmdFormat8BitYUV:
+        return width*2;
+    case bmdFormat10BitYUV:
+        return (width+47)/48*128;
+    case bmdFormat10BitRGB:
+        return (width+63)/64*256;
+    case bmdFormat12BitRGB:
+    case bmdFormat12BitRGBLE:
+        return (width*36+7)/8;
+    default:
+        return width*4;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Converts non-negative time value between time scales without intermediate overflow.
+static BMDTimeValue ScaleTime( BMDTimeValue value, BMDTimeScale from_scale, BMDTimeScale to_scale )
+{
+    return  value / from_scale * to_scale  +  value % from_scale * to_scale / from_scale;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Fills a UYVY or v210 frame with a luma ramp across the rows, 'shift' moves it to the left.
+static void FillSimRamp( BMDPixelFormat pixel_format, void* buffer, long row_bytes, long height, uint64_t shift )
+{
+    uint32_t* row = (uint32_t*)buffer;
+
+    if( pixel_format == bmdFormat8BitYUV )
+    {
+        for( long x = 0; x < row_bytes/4; ++x )
+        {
+            uint32_t y = 16 + (uint32_t)( ( x + shift ) % 220 );
+            row[x] = 0x00800080U | ( y << 8 ) | ( y << 24 );
+        }
+    }
+    else
+    {
+        // Six pixels of a group share the luma: U Y V | Y U Y | V Y U | Y V Y, U and V 512.
+        for( long g = 0; g < row_bytes/16; ++g )
+        {
+            uint32_t y = 4 * ( 16 + (uint32_t)( ( g + shift ) % 220 ) );
+            row[4*g] = 0x20000200U | ( y << 10 );
+            row[4*g + 1] = y | 0x00080000U | ( y << 20 );
+            row[4*g + 2] = 0x00000200U | ( y << 10 ) | 0x20000000U;
+            row[4*g + 3] = y | 0x00080000U | ( y << 20 );
+        }
+    }
+
+    for( long r = 1; r < height; ++r )
+    {
+        memcpy( (char*)buffer + r * row_bytes, buffer, (size_t)row_bytes );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void SleepUntilNs( uint64_t deadline_ns )
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)( deadline_ns / 1000000000ULL );
+    ts.tv_nsec = (long)( deadline_ns % 1000000000ULL );
+
+    while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR );
+}
+
+//=====================================================================================================================
+class CSimDisplayMode : public IDeckLinkDisplayMode
+{
+    volatile int32_t  ref_count;
+    const SSimModeInfo&  info;
+
+public:
+    CSimDisplayMode( const SSimModeInfo& mode_info ) : ref_count(1), info(mode_info)  {}
+
+    virtual HRESULT STDMETHODCALLTYPE GetName( const char** name )  { *name = info.name;  return S_OK; }
+    virtual BMDDisplayMode STDMETHODCALLTYPE GetDisplayMode()  { return info.mode; }
+    virtual long STDMETHODCALLTYPE GetWidth()  { return info.width; }
+    virtual long STDMETHODCALLTYPE GetHeight()  { return info.height; }
+
+    virtual HRESULT STDMETHODCALLTYPE GetFrameRate( BMDTimeValue* frame_duration, BMDTimeScale* time_scale )
+    {
+        *frame_duration = info.frame_duration;
+        *time_scale = info.time_scale;
+        return S_OK;
+    }
+
+    virtual BMDFieldDominance STDMETHODCALLTYPE GetFieldDominance()  { return info.field_dominance; }
+
+    virtual BMDDisplayModeFlags STDMETHODCALLTYPE GetFlags()
+    {
+        return  info.height <= 576 ? bmdDisplayModeColorspaceRec601 : bmdDisplayModeColorspaceRec709;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if(  IsEqualGUID( riid, IID_IDeckLinkDisplayMode )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkDisplayMode*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+class CSimAudioPacket : public IDeckLinkAudioInputPacket
+{
+    volatile int32_t  ref_count;
+    char*  buffer;
+    long  sample_frame_count;
+    BMDTimeValue  packet_time;  // in samples, i.e. in 1/48000 sec units
+
+public:
+    CSimAudioPacket( long sample_frames, size_t sample_frame_bytes, BMDTimeValue time )
+        : ref_count(1), buffer( new char[ sample_frames*sample_frame_bytes + 1 ] ),
+                                                            sample_frame_count(sample_frames), packet_time(time)
+    {
+        memset( buffer, 0, sample_frames*sample_frame_bytes );
+    }
+
+    ~CSimAudioPacket()  { delete[] buffer; }
+
+    virtual long STDMETHODCALLTYPE GetSampleFrameCount()  { return sample_frame_count; }
+    virtual HRESULT STDMETHODCALLTYPE GetBytes( void** pBuffer )  { *pBuffer = buffer;  return S_OK; }
+
+    virtual HRESULT STDMETHODCALLTYPE GetPacketTime( BMDTimeValue* time, BMDTimeScale time_scale )
+    {
+        *time = ScaleTime( packet_time, bmdAudioSampleRate48kHz, time_scale );
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if(  IsEqualGUID( riid, IID_IDeckLinkAudioInputPacket )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkAudioInputPacket*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+class CSimVideoFrame : public IDeckLinkVideoInputFrame
+{
+    volatile int32_t  ref_count;
+    IUnknown*  owner;  // keeps the input (and so its allocator) alive until the buffer is returned
+    IDeckLinkMemoryAllocator*  alloc;
+    void*  buffer;
+    long  width, height, row_bytes;
+    BMDPixelFormat  pixel_format;
+    BMDFrameFlags  flags;
+    BMDTimeValue  stream_time, frame_duration;
+    BMDTimeScale  time_scale;
+    uint64_t  hw_time_ns;
+
+public:
+    CSimVideoFrame(
+                IUnknown* owner_obj,  IDeckLinkMemoryAllocator* allocator,  void* buf,
+                const SSimModeInfo& mode,  BMDPixelFormat format,  BMDFrameFlags frame_flags,
+                BMDTimeValue time,  uint64_t hw_time
+                )
+        : ref_count(1), owner(owner_obj), alloc(allocator), buffer(buf),
+            width(mode.width), height(mode.height), row_bytes( SimRowBytes( format, mode.width ) ),
+            pixel_format(format), flags(frame_flags),
+            stream_time(time), frame_duration(mode.frame_duration), time_scale(mode.time_scale),  hw_time_ns(hw_time)
+    {
+        owner->AddRef();
+    }
+
+    ~CSimVideoFrame()
+    {
+        if( alloc != NULL )
+        {
+            alloc->ReleaseBuffer(buffer);
+        }
+        else
+        {
+            MemFree(buffer);
+        }
+
+        owner->Release();
+    }
+
+    virtual long STDMETHODCALLTYPE GetWidth()  { return width; }
+    virtual long STDMETHODCALLTYPE GetHeight()  { return height; }
+    virtual long STDMETHODCALLTYPE GetRowBytes()  { return row_bytes; }
+    virtual BMDPixelFormat STDMETHODCALLTYPE GetPixelFormat()  { return pixel_format; }
+    virtual BMDFrameFlags STDMETHODCALLTYPE GetFlags()  { return flags; }
+    virtual HRESULT STDMETHODCALLTYPE GetBytes( void** pBuffer )  { *pBuffer = buffer;  return S_OK; }
+
+    virtual HRESULT STDMETHODCALLTYPE GetTimecode( BMDTimecodeFormat, IDeckLinkTimecode** timecode )
+    {
+        *timecode = NULL;
+        return S_FALSE;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE GetAncillaryData( IDeckLinkVideoFrameAncillary** ancillary )
+    {
+        *ancillary = NULL;
+        return S_FALSE;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE GetStreamTime( BMDTimeValue* time, BMDTimeValue* duration, BMDTimeScale scale )
+    {
+        *time = ScaleTime( stream_time, time_scale, scale );
+        *duration = ScaleTime( frame_duration, time_scale, scale );
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE GetHardwareReferenceTimestamp(
+                                                    BMDTimeScale scale, BMDTimeValue* time, BMDTimeValue* duration )
+    {
+        *time = ScaleTime( (BMDTimeValue)hw_time_ns, 1000000000, scale );
+        *duration = ScaleTime( frame_duration, time_scale, scale );
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if(  IsEqualGUID( riid, IID_IDeckLinkVideoInputFrame )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkVideoInputFrame*>(this);
+            return S_OK;
+        }
+
+        if( IsEqualGUID( riid, IID_IDeckLinkVideoFrame ) )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkVideoFrame*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+class CSimDeckLink;
+
+class CSimInput : public IDeckLinkInput
+{
+    volatile int32_t  ref_count;
+    CSimDeckLink*  device;
+    int  index;
+    unsigned  format_change_period_sec;
+
+    CMutex  state_lock;
+    IDeckLinkMemoryAllocator*  alloc;
+    IDeckLinkInputCallback*  callback;
+    const SSimModeInfo*  mode;
+    BMDPixelFormat  pixel_format;
+    BMDVideoInputFlags  video_flags;
+    bool  video_enabled, audio_enabled;
+    uint32_t  audio_sample_frame_bytes;
+
+    volatile int32_t  stop_requested;
+    bool  streaming;
+    CWaitableCondition  stream_finished;
+
+    static void StreamThreadFunc( void* ctx )  { static_cast<CSimInput*>(ctx)->StreamLoop(); }
+    void StreamLoop();
+    void DeliverFrame( BMDTimeValue video_time, BMDTimeValue audio_sample_pos, long audio_sample_frames );
+    void NotifyFormatChange();
+
+public:
+    CSimInput( CSimDeckLink* owner_device, int device_index, unsigned format_change_period );
+    ~CSimInput();
+
+    virtual HRESULT STDMETHODCALLTYPE DoesSupportVideoMode(
+                                                BMDDisplayMode display_mode,  BMDPixelFormat pixel_format,
+                                                BMDVideoInputFlags flags,  BMDDisplayModeSupport* result,
+                                                IDeckLinkDisplayMode** result_display_mode
+                                                );
+
+    virtual HRESULT STDMETHODCALLTYPE GetDisplayModeIterator( IDeckLinkDisplayModeIterator** iterator )
+    {
+        *iterator = NULL;
+        return E_NOTIMPL;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE SetScreenPreviewCallback( IDeckLinkScreenPreviewCallback* )  { return S_OK; }
+
+    virtual HRESULT STDMETHODCALLTYPE EnableVideoInput(
+                            BMDDisplayMode display_mode, BMDPixelFormat pixel_format, BMDVideoInputFlags flags );
+    virtual HRESULT STDMETHODCALLTYPE DisableVideoInput();
+
+    virtual HRESULT STDMETHODCALLTYPE GetAvailableVideoFrameCount( uint32_t* count )  { *count = 0;  return S_OK; }
+    virtual HRESULT STDMETHODCALLTYPE SetVideoInputFrameMemoryAllocator( IDeckLinkMemoryAllocator* allocator );
+
+    virtual HRESULT STDMETHODCALLTYPE EnableAudioInput(
+                            BMDAudioSampleRate sample_rate, BMDAudioSampleType sample_type, uint32_t channel_count );
+    virtual HRESULT STDMETHODCALLTYPE DisableAudioInput();
+
+    virtual HRESULT STDMETHODCALLTYPE GetAvailableAudioSampleFrameCount( uint32_t* count )
+    {
+        *count = 0;
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE StartStreams();
+    virtual HRESULT STDMETHODCALLTYPE StopStreams();
+    virtual HRESULT STDMETHODCALLTYPE PauseStreams()  { return StopStreams(); }
+    virtual HRESULT STDMETHODCALLTYPE FlushStreams()  { return S_OK; }
+    virtual HRESULT STDMETHODCALLTYPE SetCallback( IDeckLinkInputCallback* cb );
+
+    virtual HRESULT STDMETHODCALLTYPE GetHardwareReferenceClock(
+                                        BMDTimeScale scale,  BMDTimeValue* hardware_time,
+                                        BMDTimeValue* time_in_frame,  BMDTimeValue* ticks_per_frame
+                                        );
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp );
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+    virtual ULONG STDMETHODCALLTYPE Release();
+};
+
+//=====================================================================================================================
+class CSimConfiguration : public IDeckLinkConfiguration
+{
+    volatile int32_t  ref_count;
+    CMutex  values_lock;
+    std::map<BMDDeckLinkConfigurationID,int64_t>  int_values;
+
+public:
+    CSimConfiguration() : ref_count(1)  {}
+
+    virtual HRESULT STDMETHODCALLTYPE SetFlag( BMDDeckLinkConfigurationID id, bool value )  { return SetInt(id,value); }
+
+    virtual HRESULT STDMETHODCALLTYPE GetFlag( BMDDeckLinkConfigurationID id, bool* value )
+    {
+        int64_t x = 0;
+        HRESULT hr = GetInt( id, &x );
+        *value = ( x != 0 );
+        return hr;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE SetInt( BMDDeckLinkConfigurationID id, int64_t value )
+    {
+        CMutexLockGuard lock_guard(values_lock);
+        int_values[id] = value;
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE GetInt( BMDDeckLinkConfigurationID id, int64_t* value )
+    {
+        CMutexLockGuard lock_guard(values_lock);
+        std::map<BMDDeckLinkConfigurationID,int64_t>::const_iterator it = int_values.find(id);
+
+        if( it == int_values.end() )
+        {
+            *value = 0;
+            return E_INVALIDARG;
+        }
+
+        *value = it->second;
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE SetFloat( BMDDeckLinkConfigurationID, double )  { return E_NOTIMPL; }
+    virtual HRESULT STDMETHODCALLTYPE GetFloat( BMDDeckLinkConfigurationID, double* )  { return E_NOTIMPL; }
+    virtual HRESULT STDMETHODCALLTYPE SetString( BMDDeckLinkConfigurationID, const char* )  { return E_NOTIMPL; }
+    virtual HRESULT STDMETHODCALLTYPE GetString( BMDDeckLinkConfigurationID, const char** )  { return E_NOTIMPL; }
+    virtual HRESULT STDMETHODCALLTYPE WriteConfigurationToPreferences()  { return S_OK; }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if(  IsEqualGUID( riid, IID_IDeckLinkConfiguration )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkConfiguration*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+class CSimDeckLink : public IDeckLink
+{
+    volatile int32_t  ref_count;
+    int  index;
+    unsigned  format_change_period_sec;
+    char  display_name[64];
+    CSimConfiguration*  conf;
+
+public:
+    CSimDeckLink( int device_index, unsigned format_change_period )
+        : ref_count(1), index(device_index), format_change_period_sec(format_change_period),
+                                                                                    conf( new CSimConfiguration() )
+    {
+        snprintf( display_name, sizeof(display_name), "Simulated DeckLink (%d)", index );
+    }
+
+    ~CSimDeckLink()  { conf->Release(); }
+
+    virtual HRESULT STDMETHODCALLTYPE GetModelName( const char** name )
+    {
+        *name = strdup("Simulated DeckLink");
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE GetDisplayName( const char** name )
+    {
+        *name = strdup(display_name);
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if( IsEqualGUID( riid, IID_IDeckLinkInput ) )
+        {
+            *pp = static_cast<IDeckLinkInput*>( new CSimInput( this, index, format_change_period_sec ) );
+            return S_OK;
+        }
+
+        if( IsEqualGUID( riid, IID_IDeckLinkConfiguration ) )
+        {
+            conf->AddRef();
+            *pp = static_cast<IDeckLinkConfiguration*>(conf);
+            return S_OK;
+        }
+
+        if(  IsEqualGUID( riid, IID_IDeckLink )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLink*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+class CSimIterator : public IDeckLinkIterator
+{
+    volatile int32_t  ref_count;
+    int  device_count, next_index;
+    unsigned  format_change_period_sec;
+
+public:
+    CSimIterator( int count, unsigned format_change_period )
+        : ref_count(1), device_count(count), next_index(0), format_change_period_sec(format_change_period)  {}
+
+    virtual ~CSimIterator()  {}
+
+    virtual HRESULT STDMETHODCALLTYPE Next( IDeckLink** deck_link )
+    {
+        if( next_index >= device_count )
+        {
+            *deck_link = NULL;
+            return S_FALSE;
+        }
+
+        *deck_link = new CSimDeckLink( next_index++, format_change_period_sec );
+        return S_OK;
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface( REFIID riid, void** pp )
+    {
+        if(  IsEqualGUID( riid, IID_IDeckLinkIterator )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+        {
+            AddRef();
+            *pp = static_cast<IDeckLinkIterator*>(this);
+            return S_OK;
+        }
+
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef()  { return Int32AtomicAdd( &ref_count, 1 ) + 1; }
+
+    virtual ULONG STDMETHODCALLTYPE Release()
+    {
+        long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+        if( cnt <= 0 )
+        {
+            delete this;
+        }
+
+        return cnt;
+    }
+};
+
+//=====================================================================================================================
+CSimInput::CSimInput( CSimDeckLink* owner_device, int device_index, unsigned format_change_period )
+    : ref_count(1), device(owner_device), index(device_index), format_change_period_sec(format_change_period),
+        alloc(NULL), callback(NULL), mode(NULL), pixel_format(bmdFormat8BitYUV), video_flags(bmdVideoInputFlagDefault),
+        video_enabled(false), audio_enabled(false), audio_sample_frame_bytes(0),
+        stop_requested(0), streaming(false)
+{
+    device->AddRef();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CSimInput::~CSimInput()
+{
+    assert( !streaming );
+
+    if( callback != NULL )
+    {
+        callback->Release();
+    }
+
+    if( alloc != NULL )
+    {
+        alloc->Release();
+    }
+
+    device->Release();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::QueryInterface( REFIID riid, void** pp )
+{
+    if(  IsEqualGUID( riid, IID_IDeckLinkInput )  ||  IsEqualGUID( riid, IID_IUnknown )  )
+    {
+        AddRef();
+        *pp = static_cast<IDeckLinkInput*>(this);
+        return S_OK;
+    }
+
+    return E_NOINTERFACE;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+ULONG STDMETHODCALLTYPE CSimInput::Release()
+{
+    long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
+
+    if( cnt <= 0 )
+    {
+        if( streaming )
+        {
+            StopStreams();
+        }
+
+        delete this;
+    }
+
+    return cnt;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::DoesSupportVideoMode(
+                                                BMDDisplayMode display_mode,  BMDPixelFormat /*pixel_format*/,
+                                                BMDVideoInputFlags /*flags*/,  BMDDisplayModeSupport* result,
+                                                IDeckLinkDisplayMode** result_display_mode
+                                                )
+{
+    const SSimModeInfo* info = FindSimMode(display_mode);
+    *result = ( info != NULL ? bmdDisplayModeSupported : bmdDisplayModeNotSupported );
+
+    if( result_display_mode != NULL )
+    {
+        *result_display_mode = ( info != NULL ? new CSimDisplayMode(*info) : NULL );
+    }
+
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::EnableVideoInput(
+                                        BMDDisplayMode display_mode, BMDPixelFormat format, BMDVideoInputFlags flags )
+{
+    const SSimModeInfo* info = FindSimMode(display_mode);
+    CMutexLockGuard lock_guard(state_lock);
+
+    if(  info == NULL  ||  streaming  )
+    {
+        return E_FAIL;
+    }
+
+    mode = info;
+    pixel_format = format;
+    video_flags = flags;
+    video_enabled = true;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::DisableVideoInput()
+{
+    CMutexLockGuard lock_guard(state_lock);
+
+    if( streaming )
+    {
+        return E_FAIL;
+    }
+
+    video_enabled = false;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::SetVideoInputFrameMemoryAllocator( IDeckLinkMemoryAllocator* allocator )
+{
+    CMutexLockGuard lock_guard(state_lock);
+
+    if( streaming )
+    {
+        return E_FAIL;
+    }
+
+    if( allocator != NULL )
+    {
+        allocator->AddRef();
+    }
+
+    if( alloc != NULL )
+    {
+        alloc->Release();
+    }
+
+    alloc = allocator;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::EnableAudioInput(
+                                BMDAudioSampleRate sample_rate, BMDAudioSampleType sample_type, uint32_t channel_count )
+{
+    CMutexLockGuard lock_guard(state_lock);
+
+    if(  sample_rate != bmdAudioSampleRate48kHz  ||  channel_count == 0  ||  streaming  )
+    {
+        return E_FAIL;
+    }
+
+    audio_sample_frame_bytes = channel_count * ( sample_type / 8 );
+    audio_enabled = true;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::DisableAudioInput()
+{
+    CMutexLockGuard lock_guard(state_lock);
+
+    if( streaming )
+    {
+        return E_FAIL;
+    }
+
+    audio_enabled = false;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::SetCallback( IDeckLinkInputCallback* cb )
+{
+    CMutexLockGuard lock_guard(state_lock);
+
+    if( streaming )
+    {
+        return E_FAIL;
+    }
+
+    if( cb != NULL )
+    {
+        cb->AddRef();
+    }
+
+    if( callback != NULL )
+    {
+        callback->Release();
+    }
+
+    callback = cb;
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::StartStreams()
+{
+    {
+        CMutexLockGuard lock_guard(state_lock);
+
+        if(  !video_enabled  ||  streaming  )
+        {
+            return E_FAIL;
+        }
+
+        if( alloc != NULL )
+        {
+            alloc->Commit();
+        }
+
+        stop_requested = 0;
+        streaming = true;
+        stream_finished.SetFalse();
+    }
+
+    StartThread( &StreamThreadFunc, this );
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::StopStreams()
+{
+    if( !streaming )
+    {
+        return E_FAIL;
+    }
+
+    Int32AtomicAdd( &stop_requested, 1 );
+    stream_finished.Wait();
+
+    CMutexLockGuard lock_guard(state_lock);
+    streaming = false;
+
+    if( alloc != NULL )
+    {
+        alloc->Decommit();
+    }
+
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+HRESULT STDMETHODCALLTYPE CSimInput::GetHardwareReferenceClock(
+                                                BMDTimeScale scale,  BMDTimeValue* hardware_time,
+                                                BMDTimeValue* time_in_frame,  BMDTimeValue* ticks_per_frame
+                                                )
+{
+    const SSimModeInfo* info = mode;
+    *hardware_time = ScaleTime( (BMDTimeValue)MonotonicTimeNs(), 1000000000, scale );
+    *ticks_per_frame = ( info != NULL ? ScaleTime( info->frame_duration, info->time_scale, scale ) : 0 );
+    *time_in_frame = ( *ticks_per_frame != 0 ? *hardware_time % *ticks_per_frame : 0 );
+    return S_OK;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Timer thread: wakes up on absolute deadlines derived from the display mode frame rate, so the long-term cadence
+// does not drift regardless of the time spent in the callback. If the thread falls behind by more than a frame
+// (e.g. the callback blocks) the missed frames are skipped like hardware would drop them.
+void CSimInput::StreamLoop()
+{
+    const SSimModeInfo* cur_mode = mode;
+    uint64_t start_ns = MonotonicTimeNs();
+    uint64_t format_change_ns = start_ns + (uint64_t)format_change_period_sec*1000000000ULL;
+    BMDTimeValue base_time = 0;  // stream time of frame #0 of the current mode, in cur_mode->time_scale units
+    BMDTimeValue audio_sample_pos = 0;
+
+    for( uint64_t frame_no = 0;  ;  ++frame_no )
+    {
+        uint64_t frame_ns = (uint64_t)cur_mode->frame_duration * 1000000000ULL / cur_mode->time_scale;
+        uint64_t deadline_ns = start_ns + (uint64_t)ScaleTime(
+                                    (BMDTimeValue)( frame_no + 1 ) * cur_mode->frame_duration,
+                                                                                cur_mode->time_scale, 1000000000 );
+        SleepUntilNs(deadline_ns);
+
+        if( stop_requested != 0 )
+        {
+            break;
+        }
+
+        uint64_t now_ns = MonotonicTimeNs();
+
+        while( now_ns >= deadline_ns + frame_ns )
+        {
+            ++frame_no;
+            deadline_ns += frame_ns;
+        }
+
+        BMDTimeValue video_time = base_time + (BMDTimeValue)frame_no * cur_mode->frame_duration;
+        BMDTimeValue next_audio_pos = ScaleTime(
+                                                video_time + cur_mode->frame_duration,
+                                                cur_mode->time_scale,  bmdAudioSampleRate48kHz  );
+
+        DeliverFrame( video_time, audio_sample_pos, (long)( next_audio_pos - audio_sample_pos ) );
+        audio_sample_pos = next_audio_pos;
+
+        if(  format_change_period_sec != 0  &&  now_ns >= format_change_ns  &&
+                                                            ( video_flags & bmdVideoInputEnableFormatDetection ) != 0  )
+        {
+            NotifyFormatChange();
+            format_change_ns = now_ns + (uint64_t)format_change_period_sec*1000000000ULL;
+
+            const SSimModeInfo* new_mode = mode;
+            base_time = ScaleTime( video_time + cur_mode->frame_duration, cur_mode->time_scale, new_mode->time_scale );
+            start_ns = deadline_ns;
+            frame_no = (uint64_t)-1;
+            cur_mode = new_mode;
+        }
+    }
+
+    stream_finished.SetTrue();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CSimInput::DeliverFrame( BMDTimeValue video_time, BMDTimeValue audio_sample_pos, long audio_sample_frames )
+{
+    const SSimModeInfo& cur_mode = *mode;
+    long row_bytes = SimRowBytes( pixel_format, cur_mode.width );
+    BM_UINT32 buf_size = (BM_UINT32)( row_bytes * cur_mode.height );
+    void* buffer = NULL;
+
+    if( alloc != NULL )
+    {
+        if(  FAILED( alloc->AllocateBuffer( buf_size, &buffer ) )  ||  buffer == NULL  )
+        {
+            printf( "[%d] SimDeckLink: AllocateBuffer(%lu) failed, frame dropped.\n", index, (unsigned long)buf_size );
+            fflush(stdout);
+            return;
+        }
+    }
+    else
+    {
+        buffer = MemAlloc( index, buf_size );
+    }
+
+    // Emulate the DMA transfer of a black frame or, with a content cycle, of a moving ramp, then the last picture of
+    // it frozen, then black, 'period' frames each.
+    uint64_t frame_no = (uint64_t)( video_time / cur_mode.frame_duration );
+    uint64_t period = (uint64_t)g_sim_content_period_sec * cur_mode.time_scale / cur_mode.frame_duration;
+    uint64_t phase = ( period != 0 ? frame_no / period % 3 : 2 );
+
+    if(  phase != 2  &&  ( pixel_format == bmdFormat8BitYUV  ||  pixel_format == bmdFormat10BitYUV )  )
+    {
+        uint64_t shift = ( phase == 0 ? frame_no : frame_no / ( 3*period ) * 3*period + period - 1 );
+        FillSimRamp( pixel_format, buffer, row_bytes, cur_mode.height, shift );
+    }
+    else if( pixel_format == bmdFormat8BitYUV )
+    {
+        uint32_t* p = (uint32_t*)buffer;
+        uint32_t* p1 = p + buf_size/sizeof(uint32_t);
+
+        for( ; p < p1; ++p )
+        {
+            *p = 0x10801080U;
+        }
+    }
+    else if( pixel_format == bmdFormat10BitYUV )
+    {
+        // Y 64, U and V 512: U Y V | Y U Y | V Y U | Y V Y, the row padding is part of the pattern.
+        static const uint32_t black[4] = { 0x20010200U, 0x04080040U, 0x20010200U, 0x04080040U };
+        uint32_t* p = (uint32_t*)buffer;
+        uint32_t* p1 = p + buf_size/sizeof(uint32_t);
+
+        for( ; p < p1; p += 4 )
+        {
+            memcpy( p, black, sizeof(black) );
+        }
+    }
+    else
+    {
+        memset( buffer, 0, buf_size );
+    }
+
+    CSimVideoFrame* frame = new CSimVideoFrame(
+                                static_cast<IDeckLinkInput*>(this),  alloc,  buffer,  cur_mode,  pixel_format,
+                                                        bmdFrameFlagDefault,  video_time,  MonotonicTimeNs()  );
+
+    CSimAudioPacket* packet = NULL;
+
+    if( audio_enabled )
+    {
+        packet = new CSimAudioPacket( audio_sample_frames, audio_sample_frame_bytes, audio_sample_pos );
+    }
+
+    if( callback != NULL )
+    {
+        callback->VideoInputFrameArrived( frame, packet );
+    }
+
+    if( packet != NULL )
+    {
+        packet->Release();
+    }
+
+    frame->Release();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CSimInput::NotifyFormatChange()
+{
+    const SSimModeInfo* new_mode = FindSimMode( NextSimFormat( mode->mode ) );
+    assert( new_mode != NULL );
+
+    BMDVideoInputFormatChangedEvents events = bmdVideoInputDisplayModeChanged;
+
+    if( new_mode->field_dominance != mode->field_dominance )
+    {
+        events |= bmdVideoInputFieldDominanceChanged;
+    }
+
+    if( ( new_mode->height <= 576 ) != ( mode->height <= 576 ) )
+    {
+        events |= bmdVideoInputColorspaceChanged;
+    }
+
+    mode = new_mode;
+
+    if( callback != NULL )
+    {
+        CSimDisplayMode* display_mode = new CSimDisplayMode(*new_mode);
+        callback->VideoInputFormatChanged( events, display_mode, bmdDetectedVideoInputYCbCr422 );
+        display_mode->Release();
+    }
+}
+
+} //unnamed namespace
+
+//=====================================================================================================================
+void SimSetContentCycle( unsigned period_sec )
+{
+    g_sim_content_period_sec = period_sec;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+IDeckLinkIterator* CreateSimDeckLinkIteratorInstance( int device_count, unsigned format_change_period_sec )
+{
+    return new CSimIterator( device_count, format_change_period_sec );
+}
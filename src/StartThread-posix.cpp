@@ -1,6 +1,7 @@
 #include <memory>
 #include <utils.h>
 #include <stdio.h>
+#include <string.h>
 
 //=====================================================================================================================
 namespace {
@@ -9,8 +10,10 @@ struct SParam
 {
     FTaskAction Func;
     void* Ctx;
+    SThreadPlacement Placement;
 
-    SParam( FTaskAction func, void* ctx ) : Func(func), Ctx(ctx)  {}
+    SParam( FTaskAction func, void* ctx, const SThreadPlacement& placement ) : Func(func), Ctx(ctx),
+                                                                                            Placement(placement)  {}
 };
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -20,6 +23,7 @@ static void* ThreadProc( void* param )
     FTaskAction func = p->Func;
     void* ctx = p->Ctx;
 
+    PlaceThread( p->Placement );
     delete p;
 
     InitCom();
@@ -42,9 +46,15 @@ static void* ThreadProc( void* param )
 
 } //unnamed namespace
 //=====================================================================================================================
-void ThreadStart( FTaskAction func, void* ctx )
+void StartThread( FTaskAction func, void* ctx )
 {
-    std::auto_ptr<SParam> paParam( new SParam(func,ctx) );
+    StartThread( func, ctx, SThreadPlacement() );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void StartThread( FTaskAction func, void* ctx, const SThreadPlacement& placement )
+{
+    std::auto_ptr<SParam> paParam( new SParam(func,ctx,placement) );
     pthread_t thr;
     int err = pthread_create( &thr, NULL, &ThreadProc, paParam.get() );
 
@@ -57,3 +67,106 @@ void ThreadStart( FTaskAction func, void* ctx )
     pthread_detach(thr);
     paParam.release();
 }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool PlaceThread( const SThreadPlacement& placement )
+{
+    bool ok = true;
+    int err;
+
+    if( placement.name[0] != 0 )
+    {
+#if defined(__APPLE__)
+        err = pthread_setname_np(placement.name);
+#else
+        err = pthread_setname_np( pthread_self(), placement.name );
+#endif
+        if( err != 0 )
+        {
+            fprintf( stderr, "PlaceThread: pthread_setname_np(%s) failed: %s\n", placement.name, strerror(err) );
+            ok = false;
+        }
+    }
+
+    if( !placement.cpus.Empty() )
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for( int j = 0; j < SCpuSet::g_max_cpus  &&  j < CPU_SETSIZE; ++j )
+        {
+            if( placement.cpus.IsSet(j) )
+            {
+                CPU_SET( j, &set );
+            }
+        }
+
+        err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+        if( err != 0 )
+        {
+            fprintf( stderr, "PlaceThread: pthread_setaffinity_np failed: %s\n", strerror(err) );
+            ok = false;
+        }
+#else
+        fprintf( stderr, "PlaceThread: CPU affinity is not supported on this OS.\n" );
+        ok = false;
+#endif
+    }
+
+    if( placement.sched != ThreadSchedDefault )
+    {
+        struct sched_param param;
+        memset( &param, 0, sizeof(param) );
+        param.sched_priority = placement.priority;
+
+        err = pthread_setschedparam( pthread_self(), ( placement.sched == ThreadSchedFifo ? SCHED_FIFO : SCHED_RR ),
+                                                                                                            &param );
+        if( err != 0 )
+        {
+            fprintf( stderr, "PlaceThread: pthread_setschedparam(%s, %d) failed: %s\n",
+                                ( placement.sched == ThreadSchedFifo ? "SCHED_FIFO" : "SCHED_RR" ),
+                                placement.priority, strerror(err) );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void GetThreadPlacement( SThreadPlacement* placement )
+{
+    *placement = SThreadPlacement();
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if( pthread_getaffinity_np( pthread_self(), sizeof(set), &set ) == 0 )
+    {
+        for( int j = 0; j < SCpuSet::g_max_cpus  &&  j < CPU_SETSIZE; ++j )
+        {
+            if( CPU_ISSET( j, &set ) )
+            {
+                placement->cpus.Set(j);
+            }
+        }
+    }
+#endif
+
+    int policy;
+    struct sched_param param;
+
+    if( pthread_getschedparam( pthread_self(), &policy, &param ) == 0 )
+    {
+        placement->sched = (  policy == SCHED_FIFO  ?  ThreadSchedFifo  :
+                                                policy == SCHED_RR  ?  ThreadSchedRr  :  ThreadSchedDefault  );
+        placement->priority = ( placement->sched != ThreadSchedDefault ? param.sched_priority : 0 );
+    }
+
+    if( pthread_getname_np( pthread_self(), placement->name, sizeof(placement->name) ) != 0 )
+    {
+        placement->name[0] = 0;
+    }
+}
@@ -1,6 +1,7 @@
 #include <memory>
 #include <utils.h>
 #include <stdio.h>
+#include <string.h>
 
 //=====================================================================================================================
 namespace {
@@ -9,8 +10,10 @@ struct SParam
 {
     FTaskAction Func;
     void* Ctx;
+    SThreadPlacement Placement;
 
-    SParam( FTaskAction func, void* ctx ) : Func(func), Ctx(ctx)  {}
+    SParam( FTaskAction func, void* ctx, const SThreadPlacement& placement ) : Func(func), Ctx(ctx),
+                                                                                            Placement(placement)  {}
 };
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -20,6 +23,7 @@ static DWORD WINAPI ThreadProc( LPVOID param )
     FTaskAction func = p->Func;
     void* ctx = p->Ctx;
 
+    PlaceThread( p->Placement );
     delete p;
 
     InitCom();
@@ -45,7 +49,13 @@ static DWORD WINAPI ThreadProc( LPVOID param )
 //=====================================================================================================================
 void StartThread( FTaskAction func, void* ctx )
 {
-    std::auto_ptr<SParam> paParam( new SParam(func,ctx) );
+    StartThread( func, ctx, SThreadPlacement() );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void StartThread( FTaskAction func, void* ctx, const SThreadPlacement& placement )
+{
+    std::auto_ptr<SParam> paParam( new SParam(func,ctx,placement) );
     HANDLE h = ::CreateThread( NULL, 0, &ThreadProc, paParam.get(), 0, NULL );
 
     if( h == NULL )
@@ -57,3 +67,73 @@ void StartThread( FTaskAction func, void* ctx )
     ::CloseHandle(h);
     paParam.release();
 }
+
+//---------------------------------------------------------------------------------------------------------------------
+// There is no FIFO/RR policy: both map to THREAD_PRIORITY_TIME_CRITICAL, the priority number is not used. The name
+// is not set (SetThreadDescription needs Windows 10). A thread runs in one processor group, the CPUs must all be in
+// the same group.
+bool PlaceThread( const SThreadPlacement& placement )
+{
+    bool ok = true;
+    int group = -1;
+
+    for( int j = 0; j < SCpuSet::g_max_cpus/64; ++j )
+    {
+        if( placement.cpus.bits[j] == 0 )
+        {
+            continue;
+        }
+
+        if( group >= 0 )
+        {
+            fprintf( stderr, "PlaceThread: the CPUs are in more than one processor group.\n" );
+            ok = false;
+            group = -1;
+            break;
+        }
+
+        group = j;
+    }
+
+    if( group >= 0 )
+    {
+        GROUP_AFFINITY affinity;
+        memset( &affinity, 0, sizeof(affinity) );
+        affinity.Mask = (KAFFINITY)placement.cpus.bits[group];
+        affinity.Group = (WORD)group;
+
+        if( !::SetThreadGroupAffinity( ::GetCurrentThread(), &affinity, NULL ) )
+        {
+            fprintf( stderr, "PlaceThread: SetThreadGroupAffinity failed - error %lu.\n", ::GetLastError() );
+            ok = false;
+        }
+    }
+
+    if(  placement.sched != ThreadSchedDefault
+            &&  !::SetThreadPriority( ::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL )  )
+    {
+        fprintf( stderr, "PlaceThread: SetThreadPriority failed - error %lu.\n", ::GetLastError() );
+        ok = false;
+    }
+
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void GetThreadPlacement( SThreadPlacement* placement )
+{
+    *placement = SThreadPlacement();
+
+    GROUP_AFFINITY affinity;
+
+    if( ::GetThreadGroupAffinity( ::GetCurrentThread(), &affinity ) )
+    {
+        placement->cpus.bits[ affinity.Group % ( SCpuSet::g_max_cpus/64 ) ] = (uint64_t)affinity.Mask;
+    }
+
+    if( ::GetThreadPriority( ::GetCurrentThread() ) == THREAD_PRIORITY_TIME_CRITICAL )
+    {
+        placement->sched = ThreadSchedFifo;
+        placement->priority = THREAD_PRIORITY_TIME_CRITICAL;
+    }
+}
@@ -0,0 +1,153 @@
+#include <ThreadPlacement.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//=====================================================================================================================
+bool ParseCpuList( const char* s, SCpuSet* cpus )
+{
+    const unsigned long max_cpu = SCpuSet::g_max_cpus - 1;
+    SCpuSet set;
+
+    for(;;)
+    {
+        char* end;
+        unsigned long first = strtoul( s, &end, 10 );
+        unsigned long last = first;
+
+        if(  end == s  ||  first > max_cpu  )
+        {
+            return false;
+        }
+
+        s = end;
+
+        if( *s == '-' )
+        {
+            ++s;
+            last = strtoul( s, &end, 10 );
+
+            if(  end == s  ||  last > max_cpu  ||  last < first  )
+            {
+                return false;
+            }
+
+            s = end;
+        }
+
+        for( unsigned long j = first; j <= last; ++j )
+        {
+            set.Set( (int)j );
+        }
+
+        if( *s == 0 )
+        {
+            break;
+        }
+
+        if( *s != ',' )
+        {
+            return false;
+        }
+
+        ++s;
+    }
+
+    *cpus = set;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool ParseThreadSched( const char* s, SThreadPlacement* placement )
+{
+    if( strcmp( s, "other" ) == 0 )
+    {
+        placement->sched = ThreadSchedDefault;
+        placement->priority = 0;
+        return true;
+    }
+
+    int sched;
+
+    if( strncmp( s, "fifo:", 5 ) == 0 )
+    {
+        sched = ThreadSchedFifo;
+        s += 5;
+    }
+    else if( strncmp( s, "rr:", 3 ) == 0 )
+    {
+        sched = ThreadSchedRr;
+        s += 3;
+    }
+    else
+    {
+        return false;
+    }
+
+    char* end;
+    long priority = strtol( s, &end, 10 );
+
+    if(  end == s  ||  *end != 0  ||  priority < 1  ||  priority > 99  )
+    {
+        return false;
+    }
+
+    placement->sched = sched;
+    placement->priority = (int)priority;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void FormatThreadPlacement( const SThreadPlacement& placement, char* buf, size_t size )
+{
+    char cpus[256];
+    size_t len = 0;
+    cpus[0] = 0;
+
+    if( placement.cpus.Empty() )
+    {
+        strcpy( cpus, "any" );
+    }
+
+    // A list too long for the buffer is cut short.
+    for(  int j = 0;  j < SCpuSet::g_max_cpus  &&  len < sizeof(cpus);  ++j  )
+    {
+        if( !placement.cpus.IsSet(j) )
+        {
+            continue;
+        }
+
+        int last = j;
+
+        while(  last + 1 < SCpuSet::g_max_cpus  &&  placement.cpus.IsSet( last + 1 )  )
+        {
+            ++last;
+        }
+
+        if( last == j )
+        {
+            len += snprintf( cpus + len, sizeof(cpus) - len, "%s%d", ( len > 0 ? "," : "" ), j );
+        }
+        else
+        {
+            len += snprintf( cpus + len, sizeof(cpus) - len, "%s%d-%d", ( len > 0 ? "," : "" ), j, last );
+        }
+
+        j = last;
+    }
+
+    static const char* const sched_names[] = { "other", "fifo", "rr" };
+    char sched[32];
+
+    if( placement.sched == ThreadSchedDefault )
+    {
+        strcpy( sched, sched_names[0] );
+    }
+    else
+    {
+        snprintf( sched, sizeof(sched), "%s:%d", sched_names[placement.sched], placement.priority );
+    }
+
+    snprintf( buf, size, "cpus=%s sched=%s%s%s", cpus, sched, ( placement.name[0] != 0 ? " name=" : "" ),
+                                                                                                    placement.name );
+}
@@ -0,0 +1,153 @@
+#include <WorkerPool.h>
+
+//=====================================================================================================================
+CWorkerPool::CWorkerPool( int thread_count ) : batches(NULL), threads(0), stopping(false), running_threads(0)
+{
+    for( int j = 0; j < thread_count; ++j )
+    {
+        {
+            CMutexLockGuard lock_guard(lock);
+            ++running_threads;
+        }
+
+        StartThread( &ThreadFunc, this );
+        ++threads;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CWorkerPool::~CWorkerPool()
+{
+    {
+        CMutexLockGuard lock_guard(lock);
+        stopping = true;
+
+        if( running_threads == 0 )
+        {
+            return;
+        }
+    }
+
+    wake.Post(threads);
+    stopped.Wait();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Picks the next job of 'only' (or of any batch if 'only' is NULL).
+bool CWorkerPool::TakeJob( SBatch* only, SBatch** batch, size_t* j )
+{
+    CMutexLockGuard lock_guard(lock);
+
+    for( SBatch* b = ( only != NULL ? only : batches );  b != NULL;  b = ( only != NULL ? NULL : b->next_batch ) )
+    {
+        if( b->next < b->count )
+        {
+            *batch = b;
+            *j = b->next++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CWorkerPool::FinishJob( SBatch* batch )
+{
+    CMutexLockGuard lock_guard(lock);
+
+    // The batch may be destroyed by its owner as soon as the lock is released.
+    if( ++batch->done == batch->count )
+    {
+        batch->finished.SetTrue();
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CWorkerPool::ThreadFunc( void* ctx )
+{
+    CWorkerPool& pool = *(CWorkerPool*)ctx;
+
+    for(;;)
+    {
+        pool.wake.Wait();
+
+        {
+            CMutexLockGuard lock_guard(pool.lock);
+
+            if( pool.stopping )
+            {
+                if( --pool.running_threads == 0 )
+                {
+                    pool.stopped.SetTrue();
+                }
+
+                return;
+            }
+        }
+
+        SBatch* batch;
+        size_t j;
+
+        while( pool.TakeJob( NULL, &batch, &j ) )
+        {
+            batch->func( batch->ctx, j );
+            pool.FinishJob(batch);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CWorkerPool::Run( FJob func, void* ctx, size_t count )
+{
+    if( count == 0 )
+    {
+        return;
+    }
+
+    SBatch b;
+    b.func = func;
+    b.ctx = ctx;
+    b.count = count;
+    b.next = 0;
+    b.done = 0;
+
+    {
+        CMutexLockGuard lock_guard(lock);
+        b.next_batch = batches;
+        batches = &b;
+    }
+
+    if(  threads > 0  &&  count > 1  )
+    {
+        wake.Post( (int32_t)( count - 1 < (size_t)threads ? count - 1 : threads ) );
+    }
+
+    SBatch* batch;
+    size_t j;
+
+    while( TakeJob( &b, &batch, &j ) )
+    {
+        func( ctx, j );
+        FinishJob(&b);
+    }
+
+    b.finished.Wait();
+
+    CMutexLockGuard lock_guard(lock);
+    SBatch** pp = &batches;
+
+    while( *pp != &b )
+    {
+        pp = &(*pp)->next_batch;
+    }
+
+    *pp = b.next_batch;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CWorkerPool& CWorkerPool::Shared()
+{
+    static CWorkerPool  pool( (int)CpuCount() - 1 );
+    return pool;
+}
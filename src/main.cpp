@@ -1,25 +1,172 @@
 #include <utils.h>
 #include <MemUtils.h>
+#include <BufferPool.h>
+#include <Bench.h>
+#include <AllocStats.h>
+#include <AvDrift.h>
+#include <FrameAnalyzer.h>
+#include <FramePipeline.h>
+#include <Histogram.h>
+#include <Log.h>
+#include <PixelConvert.h>
+#include <RunControl.h>
+#include <ThreadPlacement.h>
+#include <math.h>
+#include <stdlib.h>
 #include <stdio.h>
-#include <map>
+#include <string.h>
+
+#if defined(__linux__)
+#include <SimDeckLink.h>
+#include <MemArena.h>
+#include <MemVerify.h>
+#include <FrameExport.h>
+#include <Recorder.h>
+#endif
 
 //#define DISABLE_CUSTOM_ALLOCATOR
 //#define DISABLE_SELECT_SDI
 //#define DISABLE_SIGNAL_STOP_DETECTION
 
+//=====================================================================================================================
+// Callback and allocator messages, printed by the log writer thread (see Log.h) from the record args.
+enum ELogEvent
+{
+    LogInputFormatChanged,  // events, display mode, flags
+    LogInputFirstFrame,  // ns after StartStreams
+    LogInputThreadPlaced,  // 1 - placed as requested; the effective placement is in g_placed_threads
+    LogInputSignalStarted,  // video time, audio time, has audio
+    LogInputSignalStopped,  // video time
+    LogInputFrameGap,  // video time, frames dropped, allocator state (see PackAllocState), last allocation ns
+    LogInputFrameDuplicate,  // video time, 0, allocator state, last allocation ns
+    LogInputFrameBackward,  // video time, expected video time, allocator state, last allocation ns
+    LogInputQueryInterface,  // ref count, 0 - IDeckLinkInputCallback / 1 - IUnknown
+    LogInputAddRef,  // ref count
+    LogInputRelease,  // ref count, total frames, signal frames, 1 - the last reference
+    LogAllocAddRef,  // ref count
+    LogAllocRelease,  // ref count
+    LogAllocQueryInterface,  // ref count, 0 - IDeckLinkMemoryAllocator / 1 - IUnknown
+    LogAllocInsaneSize,  // buffer size
+    LogAllocFailed,  // buffer size
+    LogAllocFirstBuffer,  // ns, buffer size
+    LogAllocCommit,
+    LogAllocCommitReady,  // buffers, buffer size, ns
+    LogAllocNodePages,  // node, local pages, remote pages, absent pages
+    LogAllocDecommit,
+    LogAllocDecommitTrim  // buffers
+};
+
+static bool g_log_sync = false;  // print from the callbacks as before, for comparison
+
+// Frame timing histograms of a device.
+enum EFrameTiming
+{
+    FrameInterval,  // callback inter-arrival time
+    FrameDeviation,  // |inter-arrival time - frame duration of GetStreamTime|
+    FrameHwGap,  // |callback time - hardware reference timestamp|, relative to the first frame of the run
+    FrameTimingCount
+};
+
+// Stream time discontinuities of a device.
+struct SStreamTimeCounters
+{
+    uint32_t  gaps;
+    uint32_t  dropped;  // frames missing in the gaps
+    uint32_t  duplicates;
+    uint32_t  backward;
+};
+
+//=====================================================================================================================
+class CMemAlloc;
+
 //=====================================================================================================================
 class CInputCallback : public IDeckLinkInputCallback
 {
     volatile int32_t  ref_count;
     volatile int32_t  frame_count, signal_frame_count;
+    volatile int32_t  start_frame_count;
+    uint64_t  start_ns;
+    uint64_t  first_frame_ns;  // 0 - no frame since MarkStart
+    uint64_t  restart_request_ns;  // when need_restart was set by the callback
+    uint64_t  arrived_ns_sum, arrived_ns_max;  // VideoInputFrameArrived duration since MarkStart
+    uint32_t  arrived_count;
+    uint64_t  prev_arrived_ns;
+    int64_t  hw_gap_base;  // the clocks differ by an unknown offset, the first frame of the run sets it
+    bool  hw_gap_base_set;
+    CHistogram  timing[FrameTimingCount];  // written by the callback thread, since MarkStart
+    CHistogram  timing_total[FrameTimingCount];  // all finished runs
+    BMDTimeValue  prev_video_time;
+    bool  prev_video_time_set;
+    SStreamTimeCounters  stream_time, stream_time_total;
+    CAvDrift  av_drift;  // since MarkStart
+    CAvDrift  av_drift_worst;  // the run with the largest drift so far
+    double  av_max_offset_total;
+    uint64_t  placed_thread;  // CurrentThreadId of the last thread 'placement' was applied to
+
+    void CheckStreamTime( BMDTimeValue video_time, BMDTimeValue duration );
 
 public:
     int index;
     BMDDisplayMode  display_mode;
     CWaitableCondition  need_restart;
+    CFramePipeline*  pipeline;  // NULL - frames are only counted
+    CMemAlloc*  alloc;  // its state goes to the log of a stream time discontinuity
+    SThreadPlacement  placement;  // applied to every new callback thread, default - the driver threads are left alone
+#if defined(__linux__)
+    CFrameExporter*  exporter;  // NULL - no -export
+#endif
 
 public:
-    CInputCallback(): ref_count(0), frame_count(0), signal_frame_count(0), index(-1), display_mode(bmdModeHD720p60)  {}
+    CInputCallback(): ref_count(0), frame_count(0), signal_frame_count(0), start_frame_count(0), start_ns(0),
+                                first_frame_ns(0), restart_request_ns(0),
+                                arrived_ns_sum(0), arrived_ns_max(0), arrived_count(0), prev_arrived_ns(0),
+                                hw_gap_base(0), hw_gap_base_set(false), prev_video_time(0), prev_video_time_set(false),
+                                    av_max_offset_total(0), placed_thread(0),
+                                    index(-1), display_mode(bmdModeHD720p60), pipeline(NULL), alloc(NULL)
+    {
+        SStreamTimeCounters zero = {};
+        stream_time = zero;
+        stream_time_total = zero;
+#if defined(__linux__)
+        exporter = NULL;
+#endif
+    }
+
+    // Called right before StartStreams, the first frame after it reports its latency.
+    void MarkStart()
+    {
+        start_ns = MonotonicTimeNs();
+        start_frame_count = 0;
+        first_frame_ns = 0;
+        restart_request_ns = 0;
+        frame_count = 0;  signal_frame_count = 0;  // the callback is not released on a fast restart
+        arrived_ns_sum = 0;  arrived_ns_max = 0;  arrived_count = 0;
+        prev_arrived_ns = 0;  hw_gap_base_set = false;
+        prev_video_time_set = false;
+        av_drift.Reset();
+
+        SStreamTimeCounters zero = {};
+        stream_time = zero;
+
+        for( int j = 0; j < FrameTimingCount; ++j )
+        {
+            timing[j].Reset();
+        }
+    }
+
+    // Called after StopStreams, the frame timing of the run is added to the totals.
+    void PrintCallbackTime();
+
+    uint64_t StartNs() const  { return start_ns; }
+    uint64_t FirstFrameNs() const  { return first_frame_ns; }
+    uint64_t RestartRequestNs() const  { return restart_request_ns; }
+    long FrameCount() const  { return frame_count; }
+    long SignalFrameCount() const  { return signal_frame_count; }
+
+    const CHistogram& TimingTotal( int j ) const  { return timing_total[j]; }
+    const SStreamTimeCounters& StreamTimeTotal() const  { return stream_time_total; }
+    const CAvDrift& AvDriftWorst() const  { return av_drift_worst; }
+    double AvMaxOffsetTotal() const  { return av_max_offset_total; }
 
     // overrides from IDeckLinkInputCallback
     virtual HRESULT STDMETHODCALLTYPE VideoInputFormatChanged(
@@ -132,38 +279,92 @@ HRESULT STDMETHODCALLTYPE CInputCallback::VideoInputFormatChanged(
                                                             )
 {
     BMDDisplayMode displayModeId = displayMode->GetDisplayMode();
-    printf( "[%d] CInputCallback::VideoInputFormatChanged: changed=[ %s%s%s], display_mode=%s, flags=[ %s%s%s]\n",
-                                            index,
-                                            ( events & bmdVideoInputDisplayModeChanged ? "DISP_MODE " : "" ),
-                                            ( events & bmdVideoInputFieldDominanceChanged ? "FIELD_DOMINANCE " : "" ),
-                                            ( events & bmdVideoInputColorspaceChanged ? "COLORSPACE " : "" ),
-                                            DisplayModeName(displayModeId),
-                                            ( flags & bmdDetectedVideoInputYCbCr422 ? "YUV422 " : "" ),
-                                            ( flags & bmdDetectedVideoInputRGB444 ? "RGB " : "" ),
-                                            ( flags & bmdDetectedVideoInputDualStream3D ? "3D " : "" )
-                                            );
+    LogEvent( index, LogInputFormatChanged, events, displayModeId, flags );
 
     if( !need_restart.Value() )
     {
         display_mode = displayModeId;
+        restart_request_ns = MonotonicTimeNs();
         need_restart.SetTrue();
     }
 
     return S_OK;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+// Effective placement of the latest placed callback thread of every device, too big for the args of a log record. A
+// thread placed while the log writer prints the previous one may show up in that line already.
+static SThreadPlacement g_placed_threads[CRunControl::g_max_devices];
+
 //---------------------------------------------------------------------------------------------------------------------
 HRESULT STDMETHODCALLTYPE CInputCallback::VideoInputFrameArrived(
                                                             IDeckLinkVideoInputFrame* videoFrame,
                                                             IDeckLinkAudioInputPacket* audioPacket
                                                             )
 {
+    if(  placed_thread != CurrentThreadId()
+            &&  ( !placement.cpus.Empty()  ||  placement.sched != ThreadSchedDefault )  )
+    {
+        // Once per driver thread, before the frame is timed.
+        placed_thread = CurrentThreadId();
+        bool ok = PlaceThread(placement);
+
+        GetThreadPlacement( &g_placed_threads[index] );
+        LogEvent( index, LogInputThreadPlaced, ok );
+    }
+
+    uint64_t t0 = MonotonicTimeNs();
+
     if( videoFrame != 0 )
     {
         BMDTimeValue video_time, d;
         videoFrame->GetStreamTime( &video_time, &d, 240000 );
 
         Int32AtomicAdd( &frame_count, 1 );
+        CheckStreamTime( video_time, d );
+
+        if( audioPacket != 0 )
+        {
+            // 48 kHz samples are 5 units of 1/240000 s.
+            BMDTimeValue audio_time;
+            audioPacket->GetPacketTime( &audio_time, 240000 );
+            BMDTimeValue audio_end = audio_time + (BMDTimeValue)audioPacket->GetSampleFrameCount() * 5;
+
+            av_drift.Add( (double)video_time / 240000, (double)( audio_end - ( video_time + d ) ) / 240000 );
+        }
+
+        if( prev_arrived_ns != 0 )
+        {
+            uint64_t interval = t0 - prev_arrived_ns;
+            uint64_t nominal = (uint64_t)d * 12500 / 3;  // 1/240000 s to ns
+
+            timing[FrameInterval].Record(interval);
+            timing[FrameDeviation].Record( interval > nominal ? interval - nominal : nominal - interval );
+        }
+
+        prev_arrived_ns = t0;
+
+        BMDTimeValue hw_time, hw_duration;
+
+        if( videoFrame->GetHardwareReferenceTimestamp( 1000000000, &hw_time, &hw_duration ) == S_OK )
+        {
+            int64_t gap = (int64_t)t0 - (int64_t)hw_time;
+
+            if( !hw_gap_base_set )
+            {
+                hw_gap_base = gap;
+                hw_gap_base_set = true;
+            }
+
+            gap -= hw_gap_base;
+            timing[FrameHwGap].Record( (uint64_t)( gap >= 0 ? gap : -gap ) );
+        }
+
+        if( Int32AtomicAdd( &start_frame_count, 1 ) == 0 )
+        {
+            first_frame_ns = t0;
+            LogEvent( index, LogInputFirstFrame, t0 - start_ns );
+        }
 
         if( ( videoFrame->GetFlags() & bmdFrameHasNoInputSource ) == 0 )
         {
@@ -174,40 +375,126 @@ HRESULT STDMETHODCALLTYPE CInputCallback::VideoInputFrameArrived(
                     BMDTimeValue audio_time;
                     audioPacket->GetPacketTime( &audio_time, 240000 );
 
-                    printf(  "[%d] CInputCallback::VideoInputFrameArrived: signal started - video_time=%lld/240000, "
-                                "audio_time=%lld/240000\n",  index,  (long long)video_time,  (long long)audio_time  );
-                    fflush(stdout);
+                    LogEvent( index, LogInputSignalStarted, video_time, audio_time, 1 );
                 }
                 else
                 {
-                    printf( "[%d] CInputCallback::VideoInputFrameArrived: signal started - video_time=%lld/240000\n",
-                                                                                    index,  (long long)video_time  );
-                    fflush(stdout);
+                    LogEvent( index, LogInputSignalStarted, video_time, 0, 0 );
                 }
             }
         }
 #ifndef DISABLE_SIGNAL_STOP_DETECTION
         else if(  signal_frame_count > 0  &&  !need_restart.Value()  )
         {
-            printf( "[%d] CInputCallback::VideoInputFrameArrived: signal stopped - video_time=%lld/240000\n",
-                                                                                    index,  (long long)video_time  );
+            LogEvent( index, LogInputSignalStopped, video_time );
 //            display_mode = bmdModeHD720p60;
+            restart_request_ns = t0;
             need_restart.SetTrue();
         }
 #endif
+
+        if( pipeline != NULL )
+        {
+            pipeline->Push( index, videoFrame, audioPacket, t0 );
+        }
+
+#if defined(__linux__)
+        if( exporter != NULL )
+        {
+            exporter->Publish( videoFrame, t0 );
+        }
+#endif
     }
 
+    uint64_t dt = MonotonicTimeNs() - t0;
+    arrived_ns_sum += dt;
+    arrived_ns_max = ( dt > arrived_ns_max ? dt : arrived_ns_max );
+    ++arrived_count;
     return S_OK;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+static void PrintStreamTime( int index, const SStreamTimeCounters& c )
+{
+    printf( "[%d] Stream time: %lu gaps (%lu frames dropped), %lu duplicates, %lu backward jumps\n", index,
+            (unsigned long)c.gaps, (unsigned long)c.dropped, (unsigned long)c.duplicates, (unsigned long)c.backward );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void PrintAvDrift( int index, const char* what, const CAvDrift& drift, double max_offset_sec )
+{
+    if( drift.Count() == 0 )
+    {
+        return;
+    }
+
+    printf( "[%d] A/V drift%s: %lu packets over %.1f s, drift=%+.2f ppm, first_offset=%+.1f us, max_offset=%.1f us\n",
+                    index, what, (unsigned long)drift.Count(), drift.SpanSec(), drift.DriftPpm(),
+                    drift.FirstOffsetSec() * 1e6, max_offset_sec * 1e6 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void PrintFrameTiming( int index, const CHistogram* timing )
+{
+    static const char* const names[FrameTimingCount] = {
+                                                        "inter-arrival", "deviation from nominal", "hw reference gap" };
+
+    for( int j = 0; j < FrameTimingCount; ++j )
+    {
+        const CHistogram& h = timing[j];
+
+        if( h.Count() == 0 )
+        {
+            continue;
+        }
+
+        printf( "[%d] Frame timing: %-22s n=%lu, p50=%.1f us, p99=%.1f us, p99.9=%.1f us, max=%.1f us\n",
+                    index, names[j], (unsigned long)h.Count(), (double)h.Percentile(0.5) * 1e-3,
+                    (double)h.Percentile(0.99) * 1e-3, (double)h.Percentile(0.999) * 1e-3, (double)h.Max() * 1e-3 );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CInputCallback::PrintCallbackTime()
+{
+    if( arrived_count > 0 )
+    {
+        printf( "[%d] CInputCallback::VideoInputFrameArrived: %lu calls, avg=%.1f us, max=%.1f us (%s log)\n", index,
+                    (unsigned long)arrived_count, (double)arrived_ns_sum * 1e-3 / arrived_count,
+                    (double)arrived_ns_max * 1e-3, ( g_log_sync ? "sync" : "async" ) );
+    }
+
+    PrintFrameTiming( index, timing );
+    PrintStreamTime( index, stream_time );
+    PrintAvDrift( index, "", av_drift, av_drift.MaxAbsOffsetSec() );
+
+    if(  av_drift.Count() > 1  &&
+            (  av_drift_worst.Count() < 2  ||  fabs( av_drift.DriftPpm() ) > fabs( av_drift_worst.DriftPpm() )  )  )
+    {
+        av_drift_worst = av_drift;
+    }
+
+    av_max_offset_total = ( av_drift.MaxAbsOffsetSec() > av_max_offset_total ?
+                                                                av_drift.MaxAbsOffsetSec() : av_max_offset_total );
+
+    stream_time_total.gaps += stream_time.gaps;
+    stream_time_total.dropped += stream_time.dropped;
+    stream_time_total.duplicates += stream_time.duplicates;
+    stream_time_total.backward += stream_time.backward;
+
+    for( int j = 0; j < FrameTimingCount; ++j )
+    {
+        timing_total[j].Add( timing[j] );
+    }
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 HRESULT STDMETHODCALLTYPE CInputCallback::QueryInterface( REFIID riid, void** pp )
 {
     if( IsEqualGUID( riid, IID_IDeckLinkInputCallback ) )
     {
         long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-        printf( "[%d] CInputCallback::QueryInterface(IDeckLinkInputCallback) - new_ref_count=%ld\n", index, cnt );
-        fflush(stdout);
+        LogEvent( index, LogInputQueryInterface, cnt, 0 );
         *pp = static_cast<IDeckLinkInputCallback*>(this);
         return S_OK;
     }
@@ -215,8 +502,7 @@ HRESULT STDMETHODCALLTYPE CInputCallback::QueryInterface( REFIID riid, void** pp
     if( IsEqualGUID( riid, IID_IUnknown ) )
     {
         long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-        printf( "[%d] CInputCallback::QueryInterface(IUnknown) - new_ref_count=%ld\n", index, cnt );
-        fflush(stdout);
+        LogEvent( index, LogInputQueryInterface, cnt, 1 );
         *pp = static_cast<IUnknown*>(this);
         return S_OK;
     }
@@ -228,8 +514,7 @@ HRESULT STDMETHODCALLTYPE CInputCallback::QueryInterface( REFIID riid, void** pp
 ULONG STDMETHODCALLTYPE CInputCallback::AddRef(void)
 {
     long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-    printf( "[%d] CInputCallback::AddRef - new_ref_count=%ld\n", index, cnt );
-    fflush(stdout);
+    LogEvent( index, LogInputAddRef, cnt );
     return cnt;
 }
 
@@ -240,32 +525,46 @@ ULONG STDMETHODCALLTYPE CInputCallback::Release(void)
 
     if( cnt <= 0 )
     {
-        printf(  "[%d] CInputCallback::Release - new_ref_count=%ld, total_frame_count=%ld, signal_frame_count=%ld\n",
-                                                            index, cnt, (long)frame_count, (long)signal_frame_count  );
+        LogEvent( index, LogInputRelease, cnt, frame_count, signal_frame_count, 1 );
         frame_count = 0;  signal_frame_count = 0;
     }
     else
     {
-        printf( "[%d] CInputCallback::Release - new_ref_count=%ld\n", index, cnt );
+        LogEvent( index, LogInputRelease, cnt );
     }
 
     return cnt;
 }
 
 //=====================================================================================================================
+static unsigned g_warm_frames = 8;  // buffers pre-allocated by CMemAlloc::Commit, 0 - allocate on demand only
+static int g_warm_keep = -1;  // idle buffers CMemAlloc::Decommit trims the pool to, -1 - no trimming
+
+//---------------------------------------------------------------------------------------------------------------------
 class CMemAlloc: public IDeckLinkMemoryAllocator
 {
     volatile int32_t  ref_count;
-    CMutex  buffers_lock;
-    std::multimap<BM_UINT32,char*>  free_buffers;
-    std::map<char*,BM_UINT32>  alloc_buffers;
+    CBufferPool  buffers;  // lock-free, the driver threads never wait for Reset()
+    volatile int32_t  first_alloc;  // the next AllocateBuffer is the first one after Commit
+    volatile int32_t  last_alloc_ns;  // duration of the latest AllocateBuffer
+    CAllocStats  stats;  // since the start of the test
 
 public:
     int index;
+    BM_UINT32  frame_size;  // of the enabled display mode (0 - unknown), Commit() pre-allocates buffers of this size
 
 public:
-    CMemAlloc(): ref_count(0), index(-1)  {}
+    CMemAlloc(): ref_count(0), first_alloc(0), last_alloc_ns(0), index(-1), frame_size(0)  {}
     bool Reset();
+    bool Protect();
+
+    size_t IdleCount() const  { return buffers.IdleCount(); }
+    size_t OutstandingCount() const  { return buffers.OutstandingCount(); }
+    uint32_t LastAllocNs() const  { return (uint32_t)last_alloc_ns; }
+    size_t VerifySome( size_t max_bytes )  { return buffers.VerifySome( index, max_bytes ); }
+
+    void StatsSnapshot( SAllocStatsSnapshot* s ) const  { stats.Snapshot(s); }
+    void PrintStats() const;
 
     virtual ULONG STDMETHODCALLTYPE AddRef();
     virtual ULONG STDMETHODCALLTYPE Release();
@@ -281,25 +580,45 @@ public:
 //---------------------------------------------------------------------------------------------------------------------
 bool CMemAlloc::Reset()
 {
-    bool ok = true;
-    CMutexLockGuard lock_guard(buffers_lock);
+    size_t count = buffers.IdleCount();
+    uint64_t t0 = MonotonicTimeNs();
+    bool ok = buffers.FreeIdle(index);
 
-    for(  std::multimap<BM_UINT32,char*>::const_iterator it = free_buffers.begin();  it != free_buffers.end();  ++it  )
-    {
-        ok &= MemUnprotect( index, it->second, it->first );
-        MemFree(it->second);
-    }
+    printf( "[%d] CMemAlloc::Reset: %lu buffers verified in %.1f ms\n", index, (unsigned long)count,
+                                                                        (double)( MonotonicTimeNs() - t0 ) * 1e-6 );
+    return ok;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Fast restart: the allocator stays alive, so its idle buffers are guarded here instead of in Release(); the buffers
+// guarded by the previous fast restart are checked here too, before the streams start, and are reused by this run.
+// Returns false if a guarded buffer has been found corrupted since the last Reset().
+bool CMemAlloc::Protect()
+{
+    size_t count = buffers.IdleCount();
+    uint64_t t0 = MonotonicTimeNs();
 
-    free_buffers.clear();
+    buffers.ProtectIdle(index);
+    bool ok = !buffers.Corrupted();
+
+    printf( "[%d] CMemAlloc::Protect: %lu idle buffers protected or verified in %.1f ms\n", index,
+                                                (unsigned long)count, (double)( MonotonicTimeNs() - t0 ) * 1e-6 );
     return ok;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+void CMemAlloc::PrintStats() const
+{
+    SAllocStatsSnapshot s;
+    stats.Snapshot(&s);
+    PrintAllocStats( index, s, buffers.IdleCount() );
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 ULONG STDMETHODCALLTYPE CMemAlloc::AddRef()
 {
     long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-    printf( "[%d] CMemAlloc::AddRef - new_ref_count=%ld\n", index, cnt );
-    fflush(stdout);
+    LogEvent( index, LogAllocAddRef, cnt );
     return cnt;
 }
 
@@ -307,26 +626,13 @@ ULONG STDMETHODCALLTYPE CMemAlloc::AddRef()
 ULONG STDMETHODCALLTYPE CMemAlloc::Release()
 {
     long cnt = Int32AtomicAdd( &ref_count, -1 ) - 1;
-    printf( "[%d] CMemAlloc::Release - new_ref_count=%ld\n", index, cnt );
+    LogEvent( index, LogAllocRelease, cnt );
 
     if( cnt <= 0 )
     {
-        CMutexLockGuard lock_guard(buffers_lock);
+        assert( buffers.OutstandingCount() == 0 );
 
-        assert( alloc_buffers.empty() );
-
-        for(  std::multimap<BM_UINT32,char*>::const_iterator it = free_buffers.begin();  it != free_buffers.end();  ++it  )
-        {
-            MemProtect( index, it->second, it->first );
-        }
-
-#if 0 // corrupt one of the buffers
-        std::multimap<BM_UINT32,char*>::const_iterator it = free_buffers.begin();
-        if(  it != free_buffers.end()  &&  it->first > 80  )
-        {
-            memset( (char*)it->second + it->first/2, 0x80, 40 );
-        }
-#endif
+        buffers.ProtectIdle(index);
     }
 
     return cnt;
@@ -338,7 +644,7 @@ HRESULT STDMETHODCALLTYPE CMemAlloc::QueryInterface( REFIID riid, void** pp )
     if( IsEqualGUID( riid, IID_IDeckLinkMemoryAllocator ) )
     {
         long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-        printf( "[%d] CMemAlloc::QueryInterface(IDeckLinkInputCallback) - new_ref_count=%ld\n", index, cnt );
+        LogEvent( index, LogAllocQueryInterface, cnt, 0 );
         *pp = static_cast<IDeckLinkMemoryAllocator*>(this);
         return S_OK;
     }
@@ -346,7 +652,7 @@ HRESULT STDMETHODCALLTYPE CMemAlloc::QueryInterface( REFIID riid, void** pp )
     if( IsEqualGUID( riid, IID_IUnknown ) )
     {
         long cnt = Int32AtomicAdd( &ref_count, 1 ) + 1;
-        printf( "[%d] CMemAlloc::QueryInterface(IUnknown) - new_ref_count=%ld\n", index, cnt );
+        LogEvent( index, LogAllocQueryInterface, cnt, 1 );
         *pp = static_cast<IUnknown*>(this);
         return S_OK;
     }
@@ -359,38 +665,35 @@ HRESULT STDMETHODCALLTYPE CMemAlloc::AllocateBuffer( BM_UINT32 buf_size, void**
 {
     if( buf_size >= 0x80000000UL )
     {
-        printf( "[%d] CMemAlloc::AllocateBuffer: buf_size=0x%08lx is not a sane value.\n", index, (unsigned long)buf_size );
-        fflush(stdout);
+        LogEvent( index, LogAllocInsaneSize, buf_size );
         return E_OUTOFMEMORY;
     }
 
     char* ptr;
+    bool fresh;
+    uint64_t t0 = MonotonicTimeNs();
 
     try
     {
-        CMutexLockGuard lock_guard(buffers_lock);
-        std::multimap<BM_UINT32,char*>::iterator it = free_buffers.lower_bound(buf_size);
-
-        if( it != free_buffers.end() )
-        {
-            ptr = it->second;
-            buf_size = it->first;
-            free_buffers.erase(it);
-        }
-        else
-        {
-            ptr = (char*)MemAlloc(buf_size);
-        }
-
-        alloc_buffers[ptr] = buf_size;
+        ptr = buffers.Allocate( index, buf_size, &fresh );
     }
     catch(...)
     {
-        printf( "[%d] CMemAlloc::AllocateBuffer: allocation failed (buf_size=%lu).\n", index, (unsigned long)buf_size );
-        fflush(stdout);
+        stats.Failed();
+        LogEvent( index, LogAllocFailed, buf_size );
         return E_OUTOFMEMORY;
     }
 
+    uint64_t t1 = MonotonicTimeNs();
+    uint64_t dt = t1 - t0;
+    last_alloc_ns = (int32_t)( dt < 0x7fffffff ? dt : 0x7fffffff );
+    stats.Allocated( buf_size, fresh, dt, t1 );
+
+    if(  first_alloc != 0  &&  Int32CompareExchange( &first_alloc, 0, 1 ) == 1  )
+    {
+        LogEvent( index, LogAllocFirstBuffer, dt, buf_size );
+    }
+
     *pBuffer = ptr;
     return S_OK;
 }
@@ -398,17 +701,15 @@ HRESULT STDMETHODCALLTYPE CMemAlloc::AllocateBuffer( BM_UINT32 buf_size, void**
 //---------------------------------------------------------------------------------------------------------------------
 HRESULT STDMETHODCALLTYPE CMemAlloc::ReleaseBuffer( void* buffer )
 {
-    {
-        CMutexLockGuard lock_guard(buffers_lock);
-        std::map<char*,BM_UINT32>::iterator it = alloc_buffers.find( (char*)buffer );
+    BM_UINT32 size;
+    uint64_t t0 = MonotonicTimeNs();
+    bool owned = buffers.Release( buffer, &size );
 
-        assert( it != alloc_buffers.end() );
-        if( it != alloc_buffers.end() )
-        {
-            free_buffers.insert( std::multimap<BM_UINT32,char*>::value_type( it->second, it->first ) );
-            alloc_buffers.erase(it);
-            return S_OK;
-        }
+    assert(owned);
+    if(owned)
+    {
+        stats.Released( size, MonotonicTimeNs() - t0 );
+        return S_OK;
     }
 
     MemFree(buffer);
@@ -418,118 +719,770 @@ HRESULT STDMETHODCALLTYPE CMemAlloc::ReleaseBuffer( void* buffer )
 //---------------------------------------------------------------------------------------------------------------------
 HRESULT STDMETHODCALLTYPE CMemAlloc::Commit(void)
 {
-    printf( "[%d] CMemAlloc::Commit\n", index );
+    LogEvent( index, LogAllocCommit );
+
+    if(  frame_size > 0  &&  g_warm_frames > 0  )
+    {
+        uint64_t t0 = MonotonicTimeNs();
+        size_t count = buffers.Reserve( index, frame_size, g_warm_frames );
+
+        LogEvent( index, LogAllocCommitReady, count, frame_size, MonotonicTimeNs() - t0 );
+    }
+
+#if defined(__linux__)
+    SMemNodePages pages;
+
+    if( MemArenaNodePages( index, &pages ) )
+    {
+        LogEvent( index, LogAllocNodePages, MemArenaGetNode(index), pages.local, pages.remote, pages.absent );
+    }
+#endif
+
+    first_alloc = 1;
     return S_OK;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
 HRESULT STDMETHODCALLTYPE CMemAlloc::Decommit(void)
 {
-    printf( "[%d] CMemAlloc::Decommit\n", index );
+    LogEvent( index, LogAllocDecommit );
+
+    if( g_warm_keep >= 0 )
+    {
+        size_t count = buffers.TrimIdle( (size_t)g_warm_keep );
+        LogEvent( index, LogAllocDecommitTrim, count );
+    }
+
     return S_OK;
 }
 
 //=====================================================================================================================
-class CDeviceItem
+// Idle and outstanding buffer counts in one log record argument.
+static int64_t PackAllocState( const CMemAlloc* alloc )
 {
-public:
-    IDeckLink* deck_link;
-    CMemAlloc  alloc;
-    CInputCallback  callback;
-
-    CDeviceItem(): deck_link(NULL)  {}
-    ~CDeviceItem()  {  if( deck_link != NULL)  deck_link->Release();  }
-
-    void SetIndex( int j )  { alloc.index = j; callback.index = j; }
-};
+    if( alloc == NULL )
+    {
+        return 0;
+    }
 
-#define VALIDATION_RESERVE  0x40000000L
-static volatile int32_t g_thread_count = VALIDATION_RESERVE;
-static CWaitableCondition  g_test_finished;
-static const size_t g_items_count = 16;
-static CDeviceItem g_items[g_items_count];
+    return (int64_t)( ( (uint64_t)alloc->IdleCount() << 32 ) | ( alloc->OutstandingCount() & 0xffffffffU ) );
+}
 
 //---------------------------------------------------------------------------------------------------------------------
-static void ThreadFunc( void* ctx )
+// Every frame should be 'duration' after the previous one: a larger step means dropped frames, the same time a
+// duplicate, a smaller one a backward jump. The allocator state at that moment goes to the log, to tell whether
+// a slow AllocateBuffer or an exhausted pool came with the drop.
+void CInputCallback::CheckStreamTime( BMDTimeValue video_time, BMDTimeValue duration )
 {
-    unsigned long long restart_count = 0;
-    CDeviceItem& item = *(CDeviceItem*)ctx;
-    HRESULT hr;
-    assert( item.deck_link != NULL );
+    BMDTimeValue expected = prev_video_time + duration;
+    bool checked = prev_video_time_set;
 
-#ifndef DISABLE_SELECT_SDI
-    IDeckLinkConfiguration* conf = NULL;
+    prev_video_time = video_time;
+    prev_video_time_set = true;
 
-    printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkConfiguration)...\n", item.callback.index );
-    hr = item.deck_link->QueryInterface( IID_IDeckLinkConfiguration, (void**)&conf );
-    if( FAILED(hr) )
+    if(  !checked  ||  video_time == expected  ||  duration <= 0  )
     {
-        printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkConfiguration) failed.\n", item.callback.index  );
-        assert( conf == NULL );
-        conf = NULL;
+        return;
     }
-    else
+
+    int64_t alloc_state = PackAllocState(alloc);
+    int64_t alloc_ns = ( alloc != NULL ? alloc->LastAllocNs() : 0 );
+
+    if( video_time > expected )
     {
-        printf( "[%d] IDeckLinkConfiguration::"
-                "SetInt( bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI )...\n", item.callback.index  );
-        hr = conf->SetInt( bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI );
+        BMDTimeValue dropped = ( video_time - expected + duration/2 ) / duration;
 
-        if( FAILED(hr) )
-        {
-            printf( "[%d] IDeckLinkConfiguration::SetInt( "
-                    "bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI ) failed.\n", item.callback.index  );
-        }
+        ++stream_time.gaps;
+        stream_time.dropped += (uint32_t)dropped;
+        LogEvent( index, LogInputFrameGap, video_time, dropped, alloc_state, alloc_ns );
     }
+    else if( video_time == expected - duration )
+    {
+        ++stream_time.duplicates;
+        LogEvent( index, LogInputFrameDuplicate, video_time, 0, alloc_state, alloc_ns );
+    }
+    else
+    {
+        ++stream_time.backward;
+        LogEvent( index, LogInputFrameBackward, video_time, expected, alloc_state, alloc_ns );
+    }
+}
 
-    fflush(stdout);
-#endif
-
-    Int32AtomicAdd( &g_thread_count, 1 );
+//=====================================================================================================================
+static void FormatLogRecord( const SLogRecord& r )
+{
+    const int64_t* a = r.args;
 
-    while( g_thread_count > VALIDATION_RESERVE )
+    switch( r.event )
     {
-        printf( "\n[%d] Starting Video+Audio Capture #%llu...\n", item.callback.index, restart_count++ );
-
-        IDeckLinkInput* input;
-        printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkInput)...\n", item.callback.index );
-        fflush(stdout);
-        hr = item.deck_link->QueryInterface( IID_IDeckLinkInput, (void**)&input );
-        if( FAILED(hr) )
+    case LogInputFormatChanged:
+        printf( "[%d] CInputCallback::VideoInputFormatChanged: changed=[ %s%s%s], display_mode=%s, flags=[ %s%s%s]\n",
+                                            r.index,
+                                            ( a[0] & bmdVideoInputDisplayModeChanged ? "DISP_MODE " : "" ),
+                                            ( a[0] & bmdVideoInputFieldDominanceChanged ? "FIELD_DOMINANCE " : "" ),
+                                            ( a[0] & bmdVideoInputColorspaceChanged ? "COLORSPACE " : "" ),
+                                            DisplayModeName( (BMDDisplayMode)a[1] ),
+                                            ( a[2] & bmdDetectedVideoInputYCbCr422 ? "YUV422 " : "" ),
+                                            ( a[2] & bmdDetectedVideoInputRGB444 ? "RGB " : "" ),
+                                            ( a[2] & bmdDetectedVideoInputDualStream3D ? "3D " : "" )
+                                            );
+        break;
+    case LogInputFirstFrame:
+        printf( "[%d] CInputCallback::VideoInputFrameArrived: first frame %.1f ms after StartStreams\n",
+                                                                                    r.index, (double)a[0] * 1e-6 );
+        break;
+    case LogInputThreadPlaced:
+    {
+        char text[320];
+        FormatThreadPlacement( g_placed_threads[r.index], text, sizeof(text) );
+        printf( "[%d] CInputCallback::VideoInputFrameArrived: callback thread placed%s: %s\n", r.index,
+                                                                ( a[0] != 0 ? "" : " (FAILED, see stderr)" ), text );
+        break;
+    }
+    case LogInputSignalStarted:
+        if( a[2] != 0 )
         {
-            printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkInput) failed.\n", item.callback.index  );
-            fflush(stdout);
-            break;
+            printf(  "[%d] CInputCallback::VideoInputFrameArrived: signal started - video_time=%lld/240000, "
+                                    "audio_time=%lld/240000\n",  r.index,  (long long)a[0],  (long long)a[1]  );
+        }
+        else
+        {
+            printf( "[%d] CInputCallback::VideoInputFrameArrived: signal started - video_time=%lld/240000\n",
+                                                                                    r.index,  (long long)a[0]  );
+        }
+        break;
+    case LogInputSignalStopped:
+        printf( "[%d] CInputCallback::VideoInputFrameArrived: signal stopped - video_time=%lld/240000\n",
+                                                                                    r.index,  (long long)a[0]  );
+        break;
+    case LogInputFrameGap:
+    case LogInputFrameDuplicate:
+    case LogInputFrameBackward:
+        if( r.event == LogInputFrameGap )
+        {
+            printf( "[%d] CInputCallback::VideoInputFrameArrived: %lld frames dropped before video_time=%lld/240000",
+                                                                    r.index, (long long)a[1], (long long)a[0] );
+        }
+        else if( r.event == LogInputFrameDuplicate )
+        {
+            printf( "[%d] CInputCallback::VideoInputFrameArrived: duplicate video_time=%lld/240000",
+                                                                                        r.index, (long long)a[0] );
+        }
+        else
+        {
+            printf( "[%d] CInputCallback::VideoInputFrameArrived: video_time=%lld/240000 went back from expected %lld",
+                                                                    r.index, (long long)a[0], (long long)a[1] );
         }
 
-#ifndef DISABLE_CUSTOM_ALLOCATOR
-        printf( "[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator...\n", item.callback.index );
-        fflush(stdout);
-        hr = input->SetVideoInputFrameMemoryAllocator(&item.alloc);
-        if( FAILED(hr) )
+        printf( " - idle_buffers=%lu, outstanding_buffers=%lu, last_alloc=%.1f us\n",
+                    (unsigned long)( (uint64_t)a[2] >> 32 ), (unsigned long)( a[2] & 0xffffffffU ),
+                    (double)a[3] * 1e-3 );
+        break;
+    case LogInputQueryInterface:
+        printf( "[%d] CInputCallback::QueryInterface(%s) - new_ref_count=%ld\n", r.index,
+                                                    ( a[1] == 0 ? "IDeckLinkInputCallback" : "IUnknown" ), (long)a[0] );
+        break;
+    case LogInputAddRef:
+        printf( "[%d] CInputCallback::AddRef - new_ref_count=%ld\n", r.index, (long)a[0] );
+        break;
+    case LogInputRelease:
+        if( a[3] != 0 )
         {
-            printf( "[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator(obj) failed.\n", item.callback.index );
-            fflush(stdout);
+            printf(  "[%d] CInputCallback::Release - new_ref_count=%ld, total_frame_count=%ld,"
+                        " signal_frame_count=%ld\n",  r.index, (long)a[0], (long)a[1], (long)a[2]  );
         }
         else
         {
-#endif
-            printf( "[%d] IDeckLinkInput::EnableVideoInput display_mode=%s\n", item.callback.index,
-                                                                        DisplayModeName(item.callback.display_mode) );
-            fflush(stdout);
-            hr = input->EnableVideoInput(
-                                    item.callback.display_mode, bmdFormat8BitYUV, bmdVideoInputEnableFormatDetection );
+            printf( "[%d] CInputCallback::Release - new_ref_count=%ld\n", r.index, (long)a[0] );
+        }
+        break;
+    case LogAllocAddRef:
+        printf( "[%d] CMemAlloc::AddRef - new_ref_count=%ld\n", r.index, (long)a[0] );
+        break;
+    case LogAllocRelease:
+        printf( "[%d] CMemAlloc::Release - new_ref_count=%ld\n", r.index, (long)a[0] );
+        break;
+    case LogAllocQueryInterface:
+        printf( "[%d] CMemAlloc::QueryInterface(%s) - new_ref_count=%ld\n", r.index,
+                                                    ( a[1] == 0 ? "IDeckLinkInputCallback" : "IUnknown" ), (long)a[0] );
+        break;
+    case LogAllocInsaneSize:
+        printf( "[%d] CMemAlloc::AllocateBuffer: buf_size=0x%08lx is not a sane value.\n",
+                                                                                    r.index, (unsigned long)a[0] );
+        break;
+    case LogAllocFailed:
+        printf( "[%d] CMemAlloc::AllocateBuffer: allocation failed (buf_size=%lu).\n", r.index, (unsigned long)a[0] );
+        break;
+    case LogAllocFirstBuffer:
+        printf( "[%d] CMemAlloc::AllocateBuffer: first buffer after Commit in %.1f us (buf_size=%lu)\n",
+                                                        r.index, (double)a[0] * 1e-3, (unsigned long)a[1] );
+        break;
+    case LogAllocCommit:
+        printf( "[%d] CMemAlloc::Commit\n", r.index );
+        break;
+    case LogAllocCommitReady:
+        printf( "[%d] CMemAlloc::Commit: %lu buffers x %lu bytes ready in %.1f ms\n", r.index, (unsigned long)a[0],
+                                                                    (unsigned long)a[1], (double)a[2] * 1e-6 );
+        break;
+    case LogAllocNodePages:
+        printf( "[%d] CMemAlloc::Commit: node %d pages: %llu local, %llu remote, %llu not present\n", r.index,
+                        (int)a[0], (unsigned long long)a[1], (unsigned long long)a[2], (unsigned long long)a[3] );
+        break;
+    case LogAllocDecommit:
+        printf( "[%d] CMemAlloc::Decommit\n", r.index );
+        break;
+    case LogAllocDecommitTrim:
+        printf( "[%d] CMemAlloc::Decommit: %lu idle buffers freed\n", r.index, (unsigned long)a[0] );
+        break;
+    default:
+        printf( "[%d] Unknown log event %d\n", r.index, (int)r.event );
+        break;
+    }
+}
 
-            if( FAILED(hr) )
-            {
-                printf( "[%d] IDeckLinkInput::EnableVideoInput failed.\n", item.callback.index );
-                fflush(stdout);
-            }
-            else
-            {
-                printf( "[%d] IDeckLinkInput::EnableAudioInput...\n", item.callback.index );
-                fflush(stdout);
-                hr = input->EnableAudioInput( bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, 16 );
-                if( FAILED(hr) )
+//=====================================================================================================================
+enum ERestartMode
+{
+    RestartFull,  // release the input, wait 1 sec, verify and free the idle buffers, set everything up again
+    RestartFast  // pause, re-enable the video input in place, keep the input and the buffers
+};
+
+static ERestartMode g_restart_mode = RestartFull;
+static const unsigned g_backoff_min_ms = 10;  // fast restart wait after a run without signal, doubled up to max
+static const unsigned g_backoff_max_ms = 1000;
+
+enum ERestartPhase
+{
+    RestartStop,  // StopStreams or PauseStreams
+    RestartDrain,  // frames held by the pipeline
+    RestartTeardown,  // SetCallback(NULL) .. IDeckLinkInput::Release (full)
+    RestartWait,  // fixed (full) or backoff (fast)
+    RestartReset,  // CMemAlloc::Reset (full) or CMemAlloc::Protect (fast)
+    RestartSetup,  // QueryInterface .. SetCallback (full) or EnableVideoInput + FlushStreams (fast)
+    RestartStart,  // StartStreams call
+    RestartFirstFrame,  // StartStreams to the first frame
+    RestartTotal,  // restart request (format change, signal loss) to the first frame
+    RestartPhaseCount
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// Phase durations of the restarts of a device. A restart is timed from its request to StartStreams, then it waits for
+// the first frame of the run it has started, which is known when that run ends.
+class CRestartTimer
+{
+    uint64_t  cur[RestartPhaseCount];  // the restart in progress
+    uint64_t  cur_request_ns, mark_ns;
+    int  cur_mode;
+    uint64_t  started[RestartPhaseCount];  // the restart which started the current run
+    uint64_t  started_request_ns;
+    int  started_mode;
+    unsigned long  count;
+    CHistogram  hist[2][RestartPhaseCount];  // by ERestartMode
+
+public:
+    CRestartTimer(): cur_request_ns(0), mark_ns(0), cur_mode(RestartFull), started_request_ns(0),
+                                                                            started_mode(RestartFull), count(0)  {}
+
+    // Starts timing unless a restart is in progress already.
+    void Request( uint64_t request_ns, ERestartMode mode )
+    {
+        if( cur_request_ns == 0 )
+        {
+            for( int j = 0; j < RestartPhaseCount; ++j )
+            {
+                cur[j] = 0;
+            }
+
+            cur_request_ns = ( request_ns != 0 ? request_ns : MonotonicTimeNs() );
+            mark_ns = MonotonicTimeNs();
+        }
+
+        cur_mode = mode;
+    }
+
+    // The time since the previous mark goes to phase 'p'.
+    void Phase( ERestartPhase p )
+    {
+        uint64_t now = MonotonicTimeNs();
+
+        if( cur_request_ns != 0 )
+        {
+            cur[p] += now - mark_ns;
+        }
+
+        mark_ns = now;
+    }
+
+    void Skip()  { mark_ns = MonotonicTimeNs(); }
+
+    // StartStreams has succeeded.
+    void Started()
+    {
+        Phase(RestartStart);
+
+        if( cur_request_ns != 0 )
+        {
+            for( int j = 0; j < RestartPhaseCount; ++j )
+            {
+                started[j] = cur[j];
+            }
+
+            started_request_ns = cur_request_ns;
+            started_mode = cur_mode;
+            cur_request_ns = 0;
+        }
+    }
+
+    // The run has ended, records and prints the restart which started it.
+    void Finish( int index, uint64_t start_ns, uint64_t first_frame_ns );
+
+    void PrintTotals( int index ) const;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+static const char* const g_restart_mode_names[2] = { "full", "fast" };
+
+void CRestartTimer::Finish( int index, uint64_t start_ns, uint64_t first_frame_ns )
+{
+    if( started_request_ns == 0 )
+    {
+        return;
+    }
+
+    if( first_frame_ns != 0 )
+    {
+        started[RestartFirstFrame] = first_frame_ns - start_ns;
+        started[RestartTotal] = first_frame_ns - started_request_ns;
+    }
+
+    for( int j = 0; j < RestartPhaseCount; ++j )
+    {
+        if(  first_frame_ns != 0  ||  j < RestartFirstFrame  )
+        {
+            hist[started_mode][j].Record( started[j] );
+        }
+    }
+
+    ++count;
+    printf( "[%d] Restart #%lu (%s): stop=%.1f, drain=%.1f, teardown=%.1f, wait=%.1f, reset=%.1f, setup=%.1f, "
+                "start=%.1f ms, ", index, count, g_restart_mode_names[started_mode], started[RestartStop] * 1e-6,
+                started[RestartDrain] * 1e-6, started[RestartTeardown] * 1e-6, started[RestartWait] * 1e-6,
+                started[RestartReset] * 1e-6, started[RestartSetup] * 1e-6, started[RestartStart] * 1e-6 );
+
+    if( first_frame_ns != 0 )
+    {
+        printf( "first_frame=%.1f ms, total=%.1f ms\n",
+                                                    started[RestartFirstFrame] * 1e-6, started[RestartTotal] * 1e-6 );
+    }
+    else
+    {
+        printf( "no frames\n" );
+    }
+
+    started_request_ns = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CRestartTimer::PrintTotals( int index ) const
+{
+    static const char* const names[RestartPhaseCount] = {
+                    "stop", "drain", "teardown", "wait", "reset", "setup", "start", "first_frame", "total" };
+
+    for( int m = 0; m < 2; ++m )
+    {
+        for( int j = 0; j < RestartPhaseCount; ++j )
+        {
+            const CHistogram& h = hist[m][j];
+
+            if( h.Count() == 0 )
+            {
+                continue;
+            }
+
+            printf( "[%d] Restart phases (%s): %-11s n=%lu, p50=%.1f ms, p99=%.1f ms, max=%.1f ms\n",
+                                    index, g_restart_mode_names[m], names[j], (unsigned long)h.Count(),
+                                    h.Percentile(0.5) * 1e-6, h.Percentile(0.99) * 1e-6, h.Max() * 1e-6 );
+        }
+    }
+}
+
+//=====================================================================================================================
+class CDeviceItem
+{
+public:
+    IDeckLink* deck_link;
+    CMemAlloc  alloc;
+    CInputCallback  callback;
+    CFramePipeline  pipeline;
+    CRestartTimer  restart;
+    CFrameConverter*  converter;  // NULL - no -convert
+    CFrameAnalyzer*  analyzer;  // NULL - no -analyze
+#if defined(__linux__)
+    CRecorder*  recorder;  // NULL - no -record
+
+    CDeviceItem(): deck_link(NULL), converter(NULL), analyzer(NULL), recorder(NULL)  { callback.alloc = &alloc; }
+#else
+    CDeviceItem(): deck_link(NULL), converter(NULL), analyzer(NULL)  { callback.alloc = &alloc; }
+#endif
+    ~CDeviceItem()  {  if( deck_link != NULL)  deck_link->Release();  }
+
+    void SetIndex( int j )  { alloc.index = j; callback.index = j; }
+
+    // Frames held by the consumer thread, by the recorder until their writes complete and by the readers of the
+    // export go back to the allocator.
+    void Drain()
+    {
+        pipeline.Drain();
+#if defined(__linux__)
+        if( recorder != NULL )
+        {
+            recorder->Flush();
+        }
+
+        if( callback.exporter != NULL )
+        {
+            callback.exporter->Drain();
+        }
+#endif
+    }
+};
+
+static CRunControl g_run;
+static const size_t g_items_count = CRunControl::g_max_devices;
+static CDeviceItem g_items[g_items_count];
+
+typedef int (*FBench)();
+static FBench g_bench = NULL;
+
+static unsigned g_duration_sec = 0;  // 0 - until a validation failure
+static SCpuSet g_device_cpus[g_items_count];  // -device-cpus, empty - any CPU
+static SThreadPlacement g_device_sched;  // -device-sched, of all device threads
+static unsigned g_pipeline_depth = 4;  // frames queued to the consumer thread per device, 0 - no pipeline
+static unsigned g_pipeline_work_us = 0;  // simulated processing time per frame
+static BMDPixelFormat g_pixel_format = bmdFormat8BitYUV;  // -pixel-format
+static bool g_convert = false;  // -convert
+static EPixelLayout g_convert_layout = PixelLayoutI420;
+static unsigned g_convert_slices = 0;  // 0 - one per worker thread and one for the consumer thread
+static bool g_analyze = false;  // -analyze
+static SAnalyzeParams g_analyze_params;
+static unsigned g_verify_rate_mb = 512;  // background verification per device, MB/s, 0 - everything in Reset()
+static const unsigned g_verify_period_ms = 2;
+static volatile int32_t g_verify_stopping = 0;
+static CWaitableCondition g_verify_stopped;
+#if defined(__linux__)
+static int g_sim_device_count = 0;  // 0 - use DeckLink driver
+static bool g_mem_node_auto = false;  // -mem-node=auto: the node of the device's PCI slot
+static bool g_mem_node_set = false;
+static unsigned g_sim_format_change_period_sec = 10;
+static unsigned g_sim_content_period_sec = 0;  // 0 - black frames only
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+// Stands in for real frame processing on the consumer thread (-pipeline-work-us).
+static void BusyStage( void* /*ctx*/, const SCapturedFrame& /*frame*/ )
+{
+    uint64_t t0 = MonotonicTimeNs();
+
+    while( MonotonicTimeNs() - t0 < (uint64_t)g_pipeline_work_us * 1000 );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Checks released buffers of all devices in small slices while the capture goes on, so CMemAlloc::Reset() on the
+// restart path only has to check what the thread has not got to yet. Runs until main() has seen every device thread
+// finish (the last Reset() comes after the test is stopped) and sets 'g_verify_stopping'.
+static void VerifyThreadFunc( void* /*ctx*/ )
+{
+    size_t budget = (size_t)g_verify_rate_mb * 1024 * 1024 / 1000 * g_verify_period_ms;
+
+    while( g_verify_stopping == 0 )
+    {
+        WaitMs(g_verify_period_ms);
+
+        for(  size_t j = 0;  j < g_items_count  &&  g_items[j].deck_link != NULL;  ++j  )
+        {
+            g_items[j].alloc.VerifySome(budget);
+        }
+    }
+
+    g_verify_stopped.SetTrue();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Stops every device, the test ends.
+static void FailValidation( int index )
+{
+    g_run.SetState( index, RunFailed );
+    g_run.Stop( RunValidationFailed, index );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Frame size of the display mode about to be enabled, Commit() pre-allocates buffers of it.
+static void UpdateFrameSize( CDeviceItem& item, IDeckLinkInput* input )
+{
+    BMDDisplayModeSupport support;
+    IDeckLinkDisplayMode* mode = NULL;
+    item.alloc.frame_size = 0;
+
+    if(  SUCCEEDED( input->DoesSupportVideoMode( item.callback.display_mode, g_pixel_format,
+                                    bmdVideoInputEnableFormatDetection, &support, &mode ) )  &&  mode != NULL  )
+    {
+        // UYVY: 2 bytes per pixel; v210: rows of 48 pixels in 128 bytes, a third more
+        item.alloc.frame_size = (BM_UINT32)( PixelFormatRowBytes( g_pixel_format, (unsigned)mode->GetWidth() )
+                                                                                                * mode->GetHeight() );
+        mode->Release();
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// End of a run, the callback messages of the run go out before the summary.
+static void PrintRunSummary( CDeviceItem& item )
+{
+    LogFlush();
+    item.callback.PrintCallbackTime();
+    item.alloc.PrintStats();
+
+    if( item.pipeline.IsStarted() )
+    {
+        printf( "[%d] CFramePipeline: %lu frames processed, high_water=%d/%d, overflows=%lu\n",
+                            item.callback.index, (unsigned long)item.pipeline.ProcessedCount(),
+                            (int)item.pipeline.HighWater(), (int)item.pipeline.DepthLimit(),
+                            (unsigned long)item.pipeline.OverflowCount() );
+    }
+
+    item.restart.Finish( item.callback.index, item.callback.StartNs(), item.callback.FirstFrameNs() );
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// FastRestart gives up after PauseStreams, the caller tears down stopped streams.
+static void StopPausedStreams( CDeviceItem& item, IDeckLinkInput* input )
+{
+    printf( "[%d] IDeckLinkInput::StopStreams...\n", item.callback.index );
+    HRESULT hr = input->StopStreams();
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLinkInput::StopStreams failed.\n", item.callback.index );
+    }
+
+    item.restart.Phase(RestartStop);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Restarts the streams in place with the display mode of the format change: PauseStreams, EnableVideoInput,
+// FlushStreams, StartStreams. The input, the callback and the allocator with its buffers stay; the idle buffers are
+// guarded (CMemAlloc::Protect) and checked on reuse instead of being verified and freed. A run without signal makes
+// the next restart wait, twice as long every time up to g_backoff_max_ms. Returns false if the streams are stopped,
+// the caller falls back to the full teardown.
+static bool FastRestart( CDeviceItem& item, IDeckLinkInput* input, unsigned* backoff_ms,
+                                                                            unsigned long long* restart_count )
+{
+    int index = item.callback.index;
+    item.restart.Request( item.callback.RestartRequestNs(), RestartFast );
+
+    printf( "[%d] IDeckLinkInput::PauseStreams...\n", index );
+    fflush(stdout);
+    HRESULT hr = input->PauseStreams();
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLinkInput::PauseStreams failed.\n", index );
+        input->StopStreams();
+        return false;
+    }
+
+    item.restart.Phase(RestartStop);
+    item.Drain();
+    item.restart.Phase(RestartDrain);
+
+    long signal_frames = item.callback.SignalFrameCount();
+    printf( "[%d] Paused Video+Audio Capture: total_frame_count=%ld, signal_frame_count=%ld\n", index,
+                                                                    item.callback.FrameCount(), signal_frames );
+    PrintRunSummary(item);
+    item.restart.Skip();
+    item.callback.need_restart.SetFalse();
+
+    if( g_run.Stopped() )
+    {
+        StopPausedStreams( item, input );
+        return false;
+    }
+
+    if( signal_frames > 0 )
+    {
+        *backoff_ms = 0;
+    }
+    else
+    {
+        *backoff_ms = ( *backoff_ms*2 < g_backoff_min_ms ? g_backoff_min_ms : *backoff_ms*2 );
+        *backoff_ms = ( *backoff_ms > g_backoff_max_ms ? g_backoff_max_ms : *backoff_ms );
+
+        printf( "[%d] Waiting %u ms...\n", index, *backoff_ms );
+        fflush(stdout);
+
+        // Stop() cuts the wait short.
+        if( item.callback.need_restart.Wait(*backoff_ms) )
+        {
+            StopPausedStreams( item, input );
+            return false;
+        }
+    }
+
+    item.restart.Phase(RestartWait);
+
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+    g_run.SetState( index, RunVerifying );
+
+    if( !item.alloc.Protect() )
+    {
+        fflush(stdout);
+        FailValidation(index);
+        StopPausedStreams( item, input );
+        return false;
+    }
+#endif
+
+    item.restart.Phase(RestartReset);
+    g_run.SetState( index, RunStarting );
+    g_run.CountRestart(index);
+
+    printf( "\n[%d] Restarting Video+Audio Capture #%llu (fast)...\n", index, (*restart_count)++ );
+    UpdateFrameSize( item, input );
+
+    printf( "[%d] IDeckLinkInput::EnableVideoInput display_mode=%s pixel_format=%s\n", index,
+                                    DisplayModeName(item.callback.display_mode), PixelFormatName(g_pixel_format) );
+    fflush(stdout);
+    hr = input->EnableVideoInput( item.callback.display_mode, g_pixel_format, bmdVideoInputEnableFormatDetection );
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLinkInput::EnableVideoInput failed.\n", index );
+        StopPausedStreams( item, input );
+        return false;
+    }
+
+    printf( "[%d] IDeckLinkInput::FlushStreams...\n", index );
+    hr = input->FlushStreams();
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLinkInput::FlushStreams failed.\n", index );
+    }
+
+    item.restart.Phase(RestartSetup);
+
+    printf( "[%d] IDeckLinkInput::StartStreams...\n", index );
+    fflush(stdout);
+    item.callback.MarkStart();
+    item.pipeline.ResetCounters();
+    hr = input->StartStreams();
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLinkInput::StartStreams failed.\n", index );
+        StopPausedStreams( item, input );
+        fflush(stdout);
+        return false;
+    }
+
+    item.restart.Started();
+    g_run.SetState( index, RunStreaming );
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+static void ThreadFunc( void* ctx )
+{
+    unsigned long long restart_count = 0;
+    unsigned backoff_ms = 0;
+    CDeviceItem& item = *(CDeviceItem*)ctx;
+    HRESULT hr;
+    assert( item.deck_link != NULL );
+
+    {
+        SThreadPlacement placement;
+        GetThreadPlacement(&placement);
+
+        char text[320];
+        FormatThreadPlacement( placement, text, sizeof(text) );
+        printf( "[%d] Device thread: %s\n", item.callback.index, text );
+    }
+
+#ifndef DISABLE_SELECT_SDI
+    IDeckLinkConfiguration* conf = NULL;
+
+    printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkConfiguration)...\n", item.callback.index );
+    hr = item.deck_link->QueryInterface( IID_IDeckLinkConfiguration, (void**)&conf );
+    if( FAILED(hr) )
+    {
+        printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkConfiguration) failed.\n", item.callback.index  );
+        assert( conf == NULL );
+        conf = NULL;
+    }
+    else
+    {
+        printf( "[%d] IDeckLinkConfiguration::"
+                "SetInt( bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI )...\n", item.callback.index  );
+        hr = conf->SetInt( bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI );
+
+        if( FAILED(hr) )
+        {
+            printf( "[%d] IDeckLinkConfiguration::SetInt( "
+                    "bmdDeckLinkConfigVideoInputConnection, bmdVideoConnectionSDI ) failed.\n", item.callback.index  );
+        }
+    }
+
+    fflush(stdout);
+#endif
+
+    while( !g_run.Stopped() )
+    {
+        g_run.SetState( item.callback.index, RunStarting );
+
+        if( restart_count > 0 )
+        {
+            g_run.CountRestart(item.callback.index);
+        }
+
+        printf( "\n[%d] Starting Video+Audio Capture #%llu...\n", item.callback.index, restart_count++ );
+
+        IDeckLinkInput* input;
+        printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkInput)...\n", item.callback.index );
+        fflush(stdout);
+        hr = item.deck_link->QueryInterface( IID_IDeckLinkInput, (void**)&input );
+        if( FAILED(hr) )
+        {
+            printf( "[%d] IDeckLink::QueryInterface(IID_IDeckLinkInput) failed.\n", item.callback.index  );
+            fflush(stdout);
+            g_run.SetState( item.callback.index, RunFailed );
+            break;
+        }
+
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+        printf( "[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator...\n", item.callback.index );
+        fflush(stdout);
+        hr = input->SetVideoInputFrameMemoryAllocator(&item.alloc);
+        if( FAILED(hr) )
+        {
+            printf( "[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator(obj) failed.\n", item.callback.index );
+            fflush(stdout);
+        }
+        else
+        {
+#endif
+            UpdateFrameSize( item, input );
+
+            printf( "[%d] IDeckLinkInput::EnableVideoInput display_mode=%s pixel_format=%s\n", item.callback.index,
+                                    DisplayModeName(item.callback.display_mode), PixelFormatName(g_pixel_format) );
+            fflush(stdout);
+            hr = input->EnableVideoInput(
+                                    item.callback.display_mode, g_pixel_format, bmdVideoInputEnableFormatDetection );
+
+            if( FAILED(hr) )
+            {
+                printf( "[%d] IDeckLinkInput::EnableVideoInput failed.\n", item.callback.index );
+                fflush(stdout);
+            }
+            else
+            {
+                printf( "[%d] IDeckLinkInput::EnableAudioInput...\n", item.callback.index );
+                fflush(stdout);
+                hr = input->EnableAudioInput( bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, 16 );
+                if( FAILED(hr) )
                 {
                     printf( "[%d] IDeckLinkInput::EnableAudioInput failed.\n", item.callback.index );
                     fflush(stdout);
@@ -546,8 +1499,12 @@ static void ThreadFunc( void* ctx )
                     }
                     else
                     {
+                        item.restart.Phase(RestartSetup);
+
                         printf( "[%d] IDeckLinkInput::StartStreams...\n", item.callback.index );
                         fflush(stdout);
+                        item.callback.MarkStart();
+                        item.pipeline.ResetCounters();
                         hr = input->StartStreams();
                         if( FAILED(hr) )
                         {
@@ -556,104 +1513,695 @@ static void ThreadFunc( void* ctx )
                         }
                         else
                         {
+                            item.restart.Started();
+                            g_run.SetState( item.callback.index, RunStreaming );
                             item.callback.need_restart.Wait();
+                            g_run.SetState( item.callback.index, RunStopping );
+
+                            bool streaming = true;
+
+                            while(  g_restart_mode == RestartFast  &&  streaming  &&  !g_run.Stopped()  )
+                            {
+                                streaming = FastRestart( item, input, &backoff_ms, &restart_count );
+
+                                if( streaming )
+                                {
+                                    item.callback.need_restart.Wait();
+                                    g_run.SetState( item.callback.index, RunStopping );
+                                }
+                            }
+
+                            item.restart.Request( item.callback.RestartRequestNs(), RestartFull );
+
+                            if( streaming )
+                            {
+                                printf("[%d] IDeckLinkInput::StopStreams...\n", item.callback.index);
+                                hr = input->StopStreams();
+                                if( FAILED(hr) )
+                                {
+                                    printf( "[%d] IDeckLinkInput::StopStreams failed.\n", item.callback.index );
+                                }
+
+                                item.restart.Phase(RestartStop);
+                            }
+                        }
+
+                        // Frames held by the consumer go back to the allocator before it is released.
+                        item.Drain();
+                        item.restart.Phase(RestartDrain);
+
+                        printf( "[%d] IDeckLinkInput::SetCallback(NULL)...\n", item.callback.index);
+                        hr = input->SetCallback(NULL);
+                        if( FAILED(hr) )
+                        {
+                            printf( "[%d] IDeckLinkInput::SetCallback failed.\n", item.callback.index );
+                        }
+                    }
+
+                    printf( "[%d] IDeckLinkInput::DisableAudioInput...\n", item.callback.index );
+                    hr = input->DisableAudioInput();
+                    if( FAILED(hr) )
+                    {
+                        printf( "[%d] IDeckLinkInput::DisableAudioInput failed.\n", item.callback.index );
+                    }
+                }
+
+                printf( "[%d] IDeckLinkInput::DisableVideoInput...\n", item.callback.index );
+                hr = input->DisableVideoInput();
+                if( FAILED(hr) )
+                {
+                    printf( "[%d] IDeckLinkInput::DisableVideoInput failed.\n", item.callback.index );
+                }
+            }
+
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+#if 0
+            hr = input->SetVideoInputFrameMemoryAllocator(NULL);
+            if( FAILED(hr) )
+            {
+                printf("[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator(NULL) failed.\n",item.callback.index);
+            }
+#endif
+        }
+#endif
+        printf( "[%d] IDeckLinkInput::Release...\n", item.callback.index );
+        input->Release();
+        item.restart.Phase(RestartTeardown);
+
+        PrintRunSummary(item);
+        item.restart.Skip();
+
+        printf( "[%d] Stopped Video+Audio Capture.\n\n", item.callback.index );
+        item.callback.need_restart.SetFalse();
+        fflush(stdout);
+
+        if( g_run.Status() == RunValidationFailed )
+        {
+            break;
+        }
+
+        printf( "[%d] Waiting 1 sec...\n\n", item.callback.index );
+        fflush(stdout);
+
+        // Stop() cuts the wait short, but the last Reset after the -duration stop still comes a full second after the
+        // streams have stopped, so a late device write into a released buffer is caught.
+        uint64_t wait_ns = MonotonicTimeNs();
+        item.callback.need_restart.Wait(1000);
+        unsigned waited_ms = (unsigned)( ( MonotonicTimeNs() - wait_ns ) / 1000000 );
+
+        if(  g_run.Stopped()  &&  waited_ms < 1000  )
+        {
+            WaitMs( 1000 - waited_ms );
+        }
+
+        item.restart.Phase(RestartWait);
+
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+        g_run.SetState( item.callback.index, RunVerifying );
+
+        if( !item.alloc.Reset() )
+        {
+            fflush(stdout);
+            FailValidation(item.callback.index);
+            break;
+        }
+#endif
+        item.restart.Phase(RestartReset);
+    }
+
+    g_run.Leave(item.callback.index);
+
+#ifndef DISABLE_SELECT_SDI
+    if( conf != NULL )
+    {
+        conf->Release();
+    }
+#endif
+}
+
+//=====================================================================================================================
+static bool ParseArgs( int argc, char* argv[] )
+{
+    for( int j = 1; j < argc; ++j )
+    {
+        const char* arg = argv[j];
+
+        if( strcmp( arg, "-bench-buffer-pool" ) == 0 )
+        {
+            g_bench = &BenchBufferPool;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-buffer-pool-contention" ) == 0 )
+        {
+            g_bench = &BenchBufferPoolContention;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-buffer-pool-reset" ) == 0 )
+        {
+            g_bench = &BenchBufferPoolReset;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-mem-pattern" ) == 0 )
+        {
+            g_bench = &BenchMemPattern;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-log" ) == 0 )
+        {
+            g_bench = &BenchLog;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-pixel-convert" ) == 0 )
+        {
+            g_bench = &BenchPixelConvert;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-v210" ) == 0 )
+        {
+            g_bench = &BenchV210;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-frame-analyzer" ) == 0 )
+        {
+            g_bench = &BenchFrameAnalyzer;
+            continue;
+        }
+
+        if( strncmp( arg, "-pixel-format=", 14 ) == 0 )
+        {
+            if( !PixelFormatParse( arg + 14, &g_pixel_format ) )
+            {
+                fprintf( stderr, "Unknown pixel format: %s\n", arg + 14 );
+                return false;
+            }
+
+            continue;
+        }
+
+        if( strcmp( arg, "-log-sync" ) == 0 )
+        {
+            g_log_sync = true;
+            continue;
+        }
+
+        if( sscanf( arg, "-duration=%u", &g_duration_sec ) == 1 )
+        {
+            continue;
+        }
+
+        if( strncmp( arg, "-device-cpus=", 13 ) == 0 )
+        {
+            const char* list = arg + 13;
+            unsigned device = 0;
+            int device_len = 0;
+            bool all = ( strchr( list, ':' ) == NULL );
+
+            if(  !all  &&  (  sscanf( list, "%u:%n", &device, &device_len ) != 1  ||  device_len == 0
+                                                                            ||  device >= g_items_count  )  )
+            {
+                fprintf( stderr, "Bad device in %s\n", arg );
+                return false;
+            }
+
+            SCpuSet cpus;
+
+            if( !ParseCpuList( list + device_len, &cpus ) )
+            {
+                fprintf( stderr, "Bad CPU list in %s\n", arg );
+                return false;
+            }
+
+            for( size_t j = 0; j < g_items_count; ++j )
+            {
+                if(  all  ||  j == device  )
+                {
+                    g_device_cpus[j] = cpus;
+                }
+            }
+
+            continue;
+        }
+
+        if( strncmp( arg, "-device-sched=", 14 ) == 0 )
+        {
+            if( !ParseThreadSched( arg + 14, &g_device_sched ) )
+            {
+                fprintf( stderr, "Unknown scheduling: %s\n", arg + 14 );
+                return false;
+            }
+
+            continue;
+        }
+
+        if( sscanf( arg, "-verify-rate=%u", &g_verify_rate_mb ) == 1 )
+        {
+            continue;
+        }
+
+        if( sscanf( arg, "-warm-frames=%u", &g_warm_frames ) == 1 )
+        {
+            continue;
+        }
+
+        if( sscanf( arg, "-pipeline-depth=%u", &g_pipeline_depth ) == 1 )
+        {
+            continue;
+        }
+
+        if( sscanf( arg, "-pipeline-work-us=%u", &g_pipeline_work_us ) == 1 )
+        {
+            continue;
+        }
+
+        if( strncmp( arg, "-convert=", 9 ) == 0 )
+        {
+            if( !PixelLayoutParse( arg + 9, &g_convert_layout ) )
+            {
+                fprintf( stderr, "Unknown conversion layout: %s\n", arg + 9 );
+                return false;
+            }
+
+            g_convert = true;
+            continue;
+        }
+
+        if( sscanf( arg, "-convert-slices=%u", &g_convert_slices ) == 1 )
+        {
+            continue;
+        }
+
+        if( strncmp( arg, "-convert-kernel=", 16 ) == 0 )
+        {
+            if( !PixelConvertSetKernel( arg + 16 ) )
+            {
+                fprintf( stderr, "Unknown or unsupported conversion kernel: %s\n", arg + 16 );
+                return false;
+            }
+
+            continue;
+        }
+
+        if( strcmp( arg, "-analyze" ) == 0 )
+        {
+            g_analyze = true;
+            continue;
+        }
+
+        if( sscanf( arg, "-analyze-black=%lf", &g_analyze_params.black_luma ) == 1 )
+        {
+            continue;
+        }
+
+        if( sscanf( arg, "-analyze-freeze=%lf", &g_analyze_params.freeze_diff ) == 1 )
+        {
+            continue;
+        }
+
+        if( sscanf( arg, "-analyze-hold=%u", &g_analyze_params.hold_frames ) == 1 )
+        {
+            continue;
+        }
+
+        if( strncmp( arg, "-analyze-kernel=", 16 ) == 0 )
+        {
+            if( !FrameAnalyzeSetKernel( arg + 16 ) )
+            {
+                fprintf( stderr, "Unknown or unsupported analyzer kernel: %s\n", arg + 16 );
+                return false;
+            }
+
+            continue;
+        }
 
-                            printf("[%d] IDeckLinkInput::StopStreams...\n", item.callback.index);
-                            hr = input->StopStreams();
-                            if( FAILED(hr) )
-                            {
-                                printf( "[%d] IDeckLinkInput::StopStreams failed.\n", item.callback.index );
-                            }
-                        }
+        if( sscanf( arg, "-warm-keep=%d", &g_warm_keep ) == 1 )
+        {
+            continue;
+        }
 
-                        printf( "[%d] IDeckLinkInput::SetCallback(NULL)...\n", item.callback.index);
-                        hr = input->SetCallback(NULL);
-                        if( FAILED(hr) )
-                        {
-                            printf( "[%d] IDeckLinkInput::SetCallback failed.\n", item.callback.index );
-                        }
-                    }
+        if( strncmp( arg, "-restart=", 9 ) == 0 )
+        {
+            if( strcmp( arg + 9, g_restart_mode_names[RestartFull] ) == 0 )
+            {
+                g_restart_mode = RestartFull;
+            }
+            else if( strcmp( arg + 9, g_restart_mode_names[RestartFast] ) == 0 )
+            {
+                g_restart_mode = RestartFast;
+            }
+            else
+            {
+                fprintf( stderr, "Unknown restart mode: %s\n", arg + 9 );
+                return false;
+            }
 
-                    printf( "[%d] IDeckLinkInput::DisableAudioInput...\n", item.callback.index );
-                    hr = input->DisableAudioInput();
-                    if( FAILED(hr) )
-                    {
-                        printf( "[%d] IDeckLinkInput::DisableAudioInput failed.\n", item.callback.index );
-                    }
-                }
+            continue;
+        }
 
-                printf( "[%d] IDeckLinkInput::DisableVideoInput...\n", item.callback.index );
-                hr = input->DisableVideoInput();
-                if( FAILED(hr) )
+#if defined(__linux__)
+        if( strcmp( arg, "-bench-mem-arena" ) == 0 )
+        {
+            g_bench = &BenchMemArena;
+            continue;
+        }
+
+        if( strncmp( arg, "-mem-arena=", 11 ) == 0 )
+        {
+            EMemArenaMode mode;
+
+            if( !MemArenaParseMode( arg + 11, &mode ) )
+            {
+                fprintf( stderr, "Unknown frame buffer arena mode: %s\n", arg + 11 );
+                return false;
+            }
+
+            MemArenaSetMode(mode);
+            continue;
+        }
+
+        if( strcmp( arg, "-mem-lock" ) == 0 )
+        {
+            MemArenaSetLock(true);
+            continue;
+        }
+
+        if( strncmp( arg, "-mem-verify=", 12 ) == 0 )
+        {
+            EMemVerifyMode mode;
+
+            if( !MemVerifyParseMode( arg + 12, &mode ) )
+            {
+                fprintf( stderr, "Unknown buffer verification mode: %s\n", arg + 12 );
+                return false;
+            }
+
+            MemVerifySetMode(mode);
+            continue;
+        }
+
+        if( strcmp( arg, "-mem-node=auto" ) == 0 )
+        {
+            g_mem_node_auto = true;
+            continue;
+        }
+
+        if( strncmp( arg, "-mem-node=", 10 ) == 0 )
+        {
+            const char* value = arg + 10;
+            unsigned device = 0;
+            int device_len = 0;
+            bool all = ( strchr( value, ':' ) == NULL );
+
+            if(  !all  &&  (  sscanf( value, "%u:%n", &device, &device_len ) != 1  ||  device_len == 0
+                                                                            ||  device >= g_items_count  )  )
+            {
+                fprintf( stderr, "Bad device in %s\n", arg );
+                return false;
+            }
+
+            char* end;
+            long node = strtol( value + device_len, &end, 10 );
+
+            if(  end == value + device_len  ||  *end != 0  ||  !MemNodeIsOnline( (int)node )  )
+            {
+                fprintf( stderr, "Not an online NUMA node in %s\n", arg );
+                return false;
+            }
+
+            for( size_t j = 0; j < g_items_count; ++j )
+            {
+                if(  all  ||  j == device  )
                 {
-                    printf( "[%d] IDeckLinkInput::DisableVideoInput failed.\n", item.callback.index );
+                    MemArenaSetNode( (int)j, (int)node );
                 }
             }
 
-#ifndef DISABLE_CUSTOM_ALLOCATOR
-#if 0
-            hr = input->SetVideoInputFrameMemoryAllocator(NULL);
-            if( FAILED(hr) )
+            g_mem_node_set = true;
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-frame-export" ) == 0 )
+        {
+            g_bench = &BenchFrameExport;
+            continue;
+        }
+
+        if( strcmp( arg, "-export" ) == 0 )
+        {
+            MemArenaSetShared(true);
+            continue;
+        }
+
+        if( strcmp( arg, "-bench-recorder" ) == 0 )
+        {
+            g_bench = &BenchRecorder;
+            continue;
+        }
+
+        if( strncmp( arg, "-record=", 8 ) == 0 )
+        {
+            if( access( arg + 8, W_OK ) != 0 )
             {
-                printf("[%d] IDeckLinkInput::SetVideoInputFrameMemoryAllocator(NULL) failed.\n",item.callback.index);
+                fprintf( stderr, "Not a writable directory in %s\n", arg );
+                return false;
             }
-#endif
-        }
-#endif
-        printf( "[%d] IDeckLinkInput::Release...\n", item.callback.index );
-        input->Release();
 
-        printf( "[%d] Stopped Video+Audio Capture.\n\n", item.callback.index );
-        item.callback.need_restart.SetFalse();
-        fflush(stdout);
+            RecordSetDir( arg + 8 );
+            continue;
+        }
 
-        if( g_thread_count < VALIDATION_RESERVE )
+        if( strncmp( arg, "-record-io=", 11 ) == 0 )
         {
-            break;
+            ERecordIo io;
+
+            if( !RecordIoParse( arg + 11, &io ) )
+            {
+                fprintf( stderr, "Unknown recorder write path: %s\n", arg + 11 );
+                return false;
+            }
+
+            RecordSetIo(io);
+            continue;
         }
 
-        printf( "[%d] Waiting 1 sec...\n\n", item.callback.index );
-        fflush(stdout);
-        WaitSec(1);
+        unsigned sample_lines;
 
-#ifndef DISABLE_CUSTOM_ALLOCATOR
-        if( !item.alloc.Reset() )
+        if( sscanf( arg, "-mem-verify-lines=%u", &sample_lines ) == 1 )
         {
-            fflush(stdout);
-            Int32AtomicAdd( &g_thread_count, -VALIDATION_RESERVE );
+            MemVerifySetSampleLines(sample_lines);
+            continue;
+        }
 
-            for( size_t j = 0; j < g_items_count; ++j )
+        if( strcmp( arg, "-sim" ) == 0 )
+        {
+            g_sim_device_count = (int)g_items_count;
+            continue;
+        }
+
+        if( sscanf( arg, "-sim=%d", &g_sim_device_count ) == 1 )
+        {
+            if(  g_sim_device_count <= 0  ||  g_sim_device_count > (int)g_items_count  )
             {
-                g_items[j].callback.need_restart.SetTrue();
+                fprintf( stderr, "Simulated device count must be in range 1..%d.\n", (int)g_items_count );
+                return false;
             }
 
-            break;
+            continue;
+        }
+
+        if( sscanf( arg, "-sim-content-cycle=%u", &g_sim_content_period_sec ) == 1 )
+        {
+            continue;
         }
+
+        if( sscanf( arg, "-sim-format-change=%u", &g_sim_format_change_period_sec ) == 1 )
+        {
+            continue;
+        }
+#endif
+
+        fprintf( stderr, "Unknown option: %s\n\n", arg );
+        fprintf( stderr, "Usage: %s [options]\n", argv[0] );
+        fprintf( stderr, "  -bench-buffer-pool           run frame buffer pool benchmark and exit\n" );
+        fprintf( stderr, "  -bench-buffer-pool-contention\n"
+                         "                               run buffer pool allocate/release/reset contention benchmark"
+                                                                                                    " and exit\n" );
+        fprintf( stderr, "  -bench-buffer-pool-reset     run buffer pool reset (parallel verification) benchmark and"
+                                                                                                        " exit\n" );
+        fprintf( stderr, "  -bench-mem-pattern           run guard pattern fill/verify benchmark and exit\n" );
+        fprintf( stderr, "  -bench-log                   run callback log latency benchmark (printf vs ring) and"
+                                                                                                        " exit\n" );
+        fprintf( stderr, "  -bench-pixel-convert         run UYVY to planar conversion benchmark and exit\n" );
+        fprintf( stderr, "  -bench-v210                  run v210 unpack/pack benchmark (bit-exact round trips) and"
+                                                                                                        " exit\n" );
+        fprintf( stderr, "  -bench-frame-analyzer        run black/freeze analyzer benchmark and exit\n" );
+        fprintf( stderr, "  -pixel-format=<format>       capture pixel format: uyvy (8-bit YUV) or v210 (10-bit YUV);"
+                                                            " default %s\n", PixelFormatName(g_pixel_format) );
+        fprintf( stderr, "  -log-sync                    print callback messages from the driver threads instead of"
+                                                                                        " the log writer thread\n" );
+        fprintf( stderr, "  -duration=<sec>              stop the test after <sec> and verify the buffers once more,"
+                                                                        " 0 - until a validation failure (default)\n" );
+        fprintf( stderr, "  -device-cpus=[<device>:]<cpus>\n"
+                         "                               CPUs (e.g. 2,4-5) of the device, callback and consumer"
+                                            " threads of one device or, without <device>, of all devices\n" );
+        fprintf( stderr, "  -device-sched=<policy>       scheduling of those threads: other (default), fifo:<1..99>"
+                                                                                            " or rr:<1..99>\n" );
+        fprintf( stderr, "  -verify-rate=<MB/s>          background verification of released buffers per device, 0 -"
+                                    " only in Reset, none with -mem-verify=pages (default %u)\n", g_verify_rate_mb );
+        fprintf( stderr, "  -warm-frames=<count>         buffers of the display mode frame size pre-allocated on"
+                                                                " allocator Commit (default %u)\n", g_warm_frames );
+        fprintf( stderr, "  -pipeline-depth=<frames>     frames queued to the per-device consumer thread, 0 - no"
+                                                            " consumer thread (default %u)\n", g_pipeline_depth );
+        fprintf( stderr, "  -pipeline-work-us=<us>       simulated processing time per frame on the consumer"
+                                                                                                    " thread\n" );
+        fprintf( stderr, "  -convert=<layout>            convert every UYVY frame to i420, nv12 or yuv422p and unpack"
+                                " every v210 frame to 16-bit planar on the consumer thread, in slices on the worker"
+                                " pool (needs -pipeline-depth > 0)\n" );
+        fprintf( stderr, "  -convert-slices=<count>      horizontal slices per frame (default: one per CPU)\n" );
+        fprintf( stderr, "  -convert-kernel=<kernel>     conversion kernel: scalar, ssse3 or avx2 (default %s)\n",
+                                                                                            PixelConvertKernelName() );
+        fprintf( stderr, "  -analyze                     report black, flat and frozen frames with their stream time,"
+                                " from luma mean/variance and block signatures of every %u rows on the consumer"
+                                " thread (needs -pipeline-depth > 0)\n", g_analyze_params.row_step );
+        fprintf( stderr, "  -analyze-black=<luma>        highest mean luma (8-bit) of a black frame (default %.0f)\n",
+                                                                                        g_analyze_params.black_luma );
+        fprintf( stderr, "  -analyze-freeze=<luma>       largest mean luma change of a block in a frozen frame"
+                                                                " (default %.1f)\n", g_analyze_params.freeze_diff );
+        fprintf( stderr, "  -analyze-hold=<frames>       consecutive frames that start or stop a condition"
+                                                                " (default %u)\n", g_analyze_params.hold_frames );
+        fprintf( stderr, "  -analyze-kernel=<kernel>     analyzer kernel: scalar, sse2 or avx2 (default %s)\n",
+                                                                                            FrameAnalyzeKernelName() );
+        fprintf( stderr, "  -warm-keep=<count>           trim idle buffers to <count> on allocator Decommit"
+                                                                                        " (default: no trimming)\n" );
+        fprintf( stderr, "  -restart=<mode>              restart on a format change: full (teardown, allocator"
+                                    " validation, 1 sec wait) or fast (pause and start again, idle buffers guarded;"
+                                    " default %s)\n", g_restart_mode_names[g_restart_mode] );
+#if defined(__linux__)
+        fprintf( stderr, "  -bench-mem-arena             run frame buffer arena benchmark and exit\n" );
+        fprintf( stderr, "  -mem-arena=<mode>            frame buffer memory: heap, pages, thp or hugetlb"
+                                                            " (default %s)\n", MemArenaModeName( MemArenaGetMode() ) );
+        fprintf( stderr, "  -mem-lock                    mlock pre-allocated buffers (implies -mem-arena=pages unless"
+                                                                                " another arena is selected)\n" );
+        fprintf( stderr, "  -mem-node=[<device>:]<node>  bind the buffers of one device or, without <device>, of all"
+                                    " devices to a NUMA node (implies -mem-arena=pages unless another arena is"
+                                    " selected)\n" );
+        fprintf( stderr, "  -mem-node=auto               bind the buffers of every device to the node of its PCI slot"
+                                                                    " where known, -mem-node=<device>:<node> wins\n" );
+        fprintf( stderr, "  -mem-verify=<mode>           released buffer guard: pattern, pages (pattern under mprotect,"
+                                " CPU accesses recorded when they happen, device writes caught by the pattern check;"
+                                " implies -mem-arena=pages unless another arena is selected), hash (CRC32C of the"
+                                " contents) or sampled (hash of a few cache lines per page); default %s\n",
+                                                                            MemVerifyModeName( MemVerifyGetMode() ) );
+        fprintf( stderr, "  -mem-verify-lines=<count>    cache lines per page hashed by -mem-verify=sampled"
+                                                                        " (default %u)\n", MemVerifyGetSampleLines() );
+        fprintf( stderr, "  -bench-frame-export          run shared-memory frame export latency benchmark (reader"
+                                                                                " processes) and exit\n" );
+        fprintf( stderr, "  -export                      publish the frames of every device to reader processes in"
+                                " shared memory /cct-export-dev<N> (see FrameReader.h; implies -mem-arena=pages unless"
+                                " another arena is selected)\n" );
+        fprintf( stderr, "  -bench-recorder              run recorder write path benchmark (to the -record directory or"
+                                                                                " /tmp) and exit\n" );
+        fprintf( stderr, "  -record=<dir>                write raw frames, audio and a frame index of every device to"
+                                    " <dir>/dev<N>.video|audio|index, zero-copy with O_DIRECT where <dir> supports it"
+                                    " (implies -mem-arena=pages unless another arena is selected, needs"
+                                    " -pipeline-depth > 0)\n" );
+        fprintf( stderr, "  -record-io=<path>            recorder writes: uring (io_uring, falls back to threads) or"
+                                        " threads (pwritev on writer threads); default %s\n",
+                                                                                RecordIoName( RecordGetIo() ) );
+        fprintf( stderr, "  -sim[=<count>]               use <count> (default %d) simulated devices instead of DeckLink"
+                                                                                " driver\n", (int)g_items_count );
+        fprintf( stderr, "  -sim-format-change=<sec>     simulated input format change period, 0 - never"
+                                                                    " (default %u)\n", g_sim_format_change_period_sec );
+        fprintf( stderr, "  -sim-content-cycle=<sec>     simulated frames cycle through <sec> of moving content, frozen"
+                                                                    " and black, 0 - black only (default)\n" );
 #endif
+        return false;
     }
 
-    if( Int32AtomicAdd( &g_thread_count, -1 ) <= 1 )
+    if(  g_convert  &&  g_pipeline_depth == 0  )
     {
-        g_test_finished.SetTrue();
+        fprintf( stderr, "-convert needs the consumer thread (-pipeline-depth > 0).\n" );
+        return false;
     }
 
-#ifndef DISABLE_SELECT_SDI
-    if( conf != NULL )
+    if(  g_analyze  &&  g_pipeline_depth == 0  )
     {
-        conf->Release();
+        fprintf( stderr, "-analyze needs the consumer thread (-pipeline-depth > 0).\n" );
+        return false;
+    }
+
+#if defined(__linux__)
+    if(  ( MemVerifyGetMode() == MemVerifyPages  ||  MemArenaGetLock()  ||  g_mem_node_set  ||  g_mem_node_auto
+                                        ||  MemArenaGetShared()  )  &&  MemArenaGetMode() == MemArenaHeap  )
+    {
+        // mprotect, mlock and mbind need page-aligned buffers, the export needs them in the arena file.
+        MemArenaSetMode(MemArenaPages);
+    }
+
+    if( RecordGetDir() != NULL )
+    {
+        if( g_pipeline_depth == 0 )
+        {
+            fprintf( stderr, "-record needs the consumer thread (-pipeline-depth > 0).\n" );
+            return false;
+        }
+
+        if( MemArenaGetMode() == MemArenaHeap )
+        {
+            // O_DIRECT writes straight from the frame buffers need them block-aligned.
+            MemArenaSetMode(MemArenaPages);
+        }
     }
 #endif
+
+    return true;
 }
 
-//=====================================================================================================================
+//---------------------------------------------------------------------------------------------------------------------
 int main( int argc, char* argv[] )
 {
+    if( !ParseArgs( argc, argv ) )
+    {
+        return 1;
+    }
+
+    if( g_bench != NULL )
+    {
+        return (*g_bench)();
+    }
+
     if( !InitCom() )
     {
         return 1;
     }
 
-    IDeckLinkIterator*  deckLinkIterator = CreateDeckLinkIteratorInstance();
+    LogStart( &FormatLogRecord, g_log_sync );
+
+    IDeckLinkIterator*  deckLinkIterator;
+
+#if defined(__linux__)
+    MemCountersInit();
+    printf( "Frame buffer arena: %s, released buffer guard: %s\n",
+                                    MemArenaModeName( MemArenaGetMode() ), MemVerifyModeName( MemVerifyGetMode() ) );
+
+    if( g_sim_device_count > 0 )
+    {
+        printf( "Using %d simulated DeckLink devices.\n", g_sim_device_count );
+        SimSetContentCycle(g_sim_content_period_sec);
+        deckLinkIterator = CreateSimDeckLinkIteratorInstance( g_sim_device_count, g_sim_format_change_period_sec );
+    }
+    else
+#endif
+    {
+        deckLinkIterator = CreateDeckLinkIteratorInstance();
+    }
+
     if( deckLinkIterator == NULL )
     {
         printf( "A DeckLink iterator could not be created. Probably DeckLink drivers not installed.\n" );
@@ -692,13 +2240,225 @@ int main( int argc, char* argv[] )
         CDeviceItem& item = g_items[j];
         item.SetIndex(j);
         item.deck_link = deck_link;
-        StartThread( &ThreadFunc, &item );
+
+#if defined(__linux__)
+        if(  g_mem_node_auto  &&  MemArenaGetNode(j) < 0  &&  MemNodeOfDevice(j) >= 0  )
+        {
+            MemArenaSetNode( j, MemNodeOfDevice(j) );
+        }
+
+        if(  g_mem_node_set  ||  g_mem_node_auto  )
+        {
+            if( MemArenaGetNode(j) >= 0 )
+            {
+                printf( "[%d] Frame buffers on NUMA node %d\n", j, MemArenaGetNode(j) );
+            }
+            else
+            {
+                printf( "[%d] Frame buffers not bound to a NUMA node (device locality unknown)\n", j );
+            }
+        }
+#endif
+
+        SThreadPlacement placement = g_device_sched;
+        placement.cpus = g_device_cpus[j];
+        item.callback.placement = placement;
+        snprintf( item.callback.placement.name, sizeof(placement.name), "cct-dev%d-cb", j );
+
+        if( g_pipeline_depth > 0 )
+        {
+            if( g_pipeline_work_us > 0 )
+            {
+                item.pipeline.AddStage( &BusyStage, NULL );
+            }
+
+            if( g_analyze )
+            {
+                item.analyzer = new CFrameAnalyzer();
+                item.analyzer->Init( j, g_analyze_params );
+                item.pipeline.AddStage( &CFrameAnalyzer::Stage, item.analyzer );
+            }
+
+            if( g_convert )
+            {
+                item.converter = new CFrameConverter();
+                item.converter->Init( j, g_convert_layout, NULL, g_convert_slices );
+                item.pipeline.AddStage( &CFrameConverter::Stage, item.converter );
+            }
+
+            SThreadPlacement consumer = placement;
+            snprintf( consumer.name, sizeof(consumer.name), "cct-dev%d-pipe", j );
+
+#if defined(__linux__)
+            if( RecordGetDir() != NULL )
+            {
+                SThreadPlacement writer = placement;
+                snprintf( writer.name, sizeof(writer.name), "cct-dev%d-rec", j );
+
+                // 16 channels of 32-bit samples, see EnableAudioInput.
+                item.recorder = new CRecorder();
+
+                if( item.recorder->Open( RecordGetDir(), j, RecordGetIo(), 16 * sizeof(int32_t), writer ) )
+                {
+                    item.pipeline.AddStage( &CRecorder::Stage, item.recorder );
+                }
+                else
+                {
+                    delete item.recorder;
+                    item.recorder = NULL;
+                    printf( "[%d] Not recorded.\n", j );
+                }
+            }
+#endif
+
+            item.pipeline.Start( g_pipeline_depth, consumer );
+            item.callback.pipeline = &item.pipeline;
+        }
+
+#if defined(__linux__)
+        if( MemArenaGetShared() )
+        {
+            SThreadPlacement releaser = placement;
+            snprintf( releaser.name, sizeof(releaser.name), "cct-dev%d-exp", j );
+            item.callback.exporter = new CFrameExporter();
+
+            if( item.callback.exporter->Open( j, releaser ) )
+            {
+                printf( "[%d] Frames exported to %s\n", j, item.callback.exporter->Name() );
+            }
+            else
+            {
+                delete item.callback.exporter;
+                item.callback.exporter = NULL;
+                printf( "[%d] Not exported.\n", j );
+            }
+        }
+#endif
+
+        g_run.Register( j, &item.callback.need_restart );
+        snprintf( placement.name, sizeof(placement.name), "cct-dev%d", j );
+        StartThread( &ThreadFunc, &item, placement );
+    }
+
+    if( g_items[0].deck_link == NULL )
+    {
+        printf( "No DeckLink devices found.\n" );
+        g_run.Stop( RunDeviceError, -1 );
+        deckLinkIterator->Release();
+        return g_run.PrintStatus();
+    }
+
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+    if( g_verify_rate_mb > 0 )
+    {
+        StartThread( &VerifyThreadFunc, NULL );
+    }
+#endif
+
+    if( !g_run.WaitFinished( g_duration_sec*1000 ) )
+    {
+        printf( "\nTest duration of %u sec has passed, stopping...\n", g_duration_sec );
+        fflush(stdout);
+        g_run.Stop( RunCompleted, -1 );
+        g_run.WaitFinished(0);
+    }
+
+    // The device threads have finished, none of the threads they used outlives main().
+#ifndef DISABLE_CUSTOM_ALLOCATOR
+    if( g_verify_rate_mb > 0 )
+    {
+        Int32AtomicAdd( &g_verify_stopping, 1 );
+        g_verify_stopped.Wait();
+    }
+#endif
+
+    for(  size_t j = 0;  j < g_items_count  &&  g_items[j].deck_link != NULL;  ++j  )
+    {
+        g_items[j].pipeline.Stop();
+    }
+
+    LogFlush();
+
+    CHistogram all_devices[FrameTimingCount];
+
+    for(  size_t j = 0;  j < g_items_count  &&  g_items[j].deck_link != NULL;  ++j  )
+    {
+        printf( "[%d] Frame timing of all runs:\n", (int)j );
+
+        CHistogram device[FrameTimingCount];
+
+        for( int k = 0; k < FrameTimingCount; ++k )
+        {
+            device[k].Add( g_items[j].callback.TimingTotal(k) );
+            all_devices[k].Add( device[k] );
+        }
+
+        PrintFrameTiming( (int)j, device );
+        PrintStreamTime( (int)j, g_items[j].callback.StreamTimeTotal() );
+        PrintAvDrift( (int)j, " (worst run)", g_items[j].callback.AvDriftWorst(),
+                                                                        g_items[j].callback.AvMaxOffsetTotal() );
+        g_items[j].restart.PrintTotals( (int)j );
+
+        if( g_items[j].analyzer != NULL )
+        {
+            g_items[j].analyzer->PrintStats();
+            delete g_items[j].analyzer;
+            g_items[j].analyzer = NULL;
+        }
+
+        if( g_items[j].converter != NULL )
+        {
+            g_items[j].converter->PrintStats();
+            delete g_items[j].converter;
+            g_items[j].converter = NULL;
+        }
+
+#if defined(__linux__)
+        if( g_items[j].recorder != NULL )
+        {
+            g_items[j].recorder->PrintStats();
+            delete g_items[j].recorder;  // flushes and stops the write queue
+            g_items[j].recorder = NULL;
+        }
+
+        if( g_items[j].callback.exporter != NULL )
+        {
+            g_items[j].callback.exporter->PrintStats();
+            delete g_items[j].callback.exporter;  // closes the shared memory object
+            g_items[j].callback.exporter = NULL;
+        }
+#endif
+    }
+
+    printf( "Frame timing of all devices:\n" );
+    PrintFrameTiming( -1, all_devices );
+
+#if defined(__linux__)
+    SMemCounters counters;
+    MemCountersRead(&counters);
+
+    if( counters.has_dtlb )
+    {
+        printf( "Memory counters: minor_faults=%llu, major_faults=%llu, dtlb_misses=%llu\n",
+                    (unsigned long long)counters.minor_faults, (unsigned long long)counters.major_faults,
+                    (unsigned long long)counters.dtlb_misses );
+    }
+    else
+    {
+        printf( "Memory counters: minor_faults=%llu, major_faults=%llu\n",
+                    (unsigned long long)counters.minor_faults, (unsigned long long)counters.major_faults );
+    }
+
+    fflush(stdout);
+#endif
+
+    if( g_run.Status() == RunValidationFailed )
+    {
+        fprintf( stderr, "\n!!!VALIDATION FAILED!!!\n" );
     }
 
-    g_test_finished.Wait();
-    fprintf( stderr, "\n!!!VALIDATION FAILED!!!\nPress ENTER to exit...\n" );
-    getc(stdin);
+    int exit_code = g_run.PrintStatus();
 
     deckLinkIterator->Release();
-    return 0;
+    return exit_code;
 }